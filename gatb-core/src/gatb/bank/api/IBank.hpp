@@ -126,6 +126,10 @@ public:
      * \return estimation of the size of sequences */
     virtual u_int64_t estimateSequencesSize () = 0;
 
+    /** Give the precision of the last estimation made by the 'estimate' method.
+     * \return relative standard error of the estimated sequences number; 0 if it is exact, negative if it is unknown */
+    virtual double getEstimateError () = 0;
+
     /** \return the number of sequences read from the bank for computing estimated information */
     virtual u_int64_t getEstimateThreshold () = 0;
 
@@ -78,17 +78,41 @@ struct Sequence
      * \param[in] seq : the genomic data as an ascii string */
     Sequence (char* seq) : _data(seq), _index(0)  {}
 
+    /** Copy constructor. The comment, the quality and the data are copied even if they are references
+     * (see setCommentRef), since the referred buffer may not live as long as the copy.
+     * \param[in] s : sequence to be copied */
+    Sequence (const Sequence& s) : _comment(s.getComment()), _quality(s.getQuality()), _data(s._data.getEncoding()), _index(s._index)
+    {
+        /** Data has no copy constructor (it would share the buffer); its affectation operator copies it. */
+        _data = s._data;
+    }
+
     /** Destructor. */
     virtual ~Sequence ()  { }
 
+    /** Affectation operator.
+     * \param[in] s : sequence to be copied
+     * \return the instance */
+    Sequence& operator= (const Sequence& s)
+    {
+        if (this != &s)
+        {
+            setComment (s.getComment());
+            setQuality (s.getQuality());
+            _data  = s._data;
+            _index = s._index;
+        }
+        return *this;
+    }
+
     /** \return description of the sequence */
-    virtual const std::string& getComment ()  const  { return _comment; }
+    virtual const std::string& getComment ()  const  { _commentRef.resolve (_comment);  return _comment; }
 
     /** \return description of the sequence until first space */
-    virtual const std::string getCommentShort ()  const  { return _comment.substr(0, _comment.find(' ')); }
+    virtual const std::string getCommentShort ()  const  { const std::string& cmt = getComment();  return cmt.substr(0, cmt.find(' ')); }
 
     /** \return quality of the sequence (set if the underlying bank is a fastq file). */
-    virtual const std::string& getQuality ()  const  { return _quality; }
+    virtual const std::string& getQuality ()  const  { _qualityRef.resolve (_quality);  return _quality; }
     
     /** \return the data as a Data structure. */
     virtual tools::misc::Data& getData () { return _data; }
@@ -132,20 +156,54 @@ struct Sequence
 
     /** Set the comment of the sequence (likely to be called by a IBank iterator).
      * \param[in] cmt : comment of the sequence */
-    void setComment (const std::string& cmt)  { _comment = cmt; }
+    void setComment (const std::string& cmt)  { _comment = cmt;  _commentRef.pending = false; }
 
     /** Set the quality string of the sequence (likely to be called by a fastq iterator).
      * \param[in] qual : quality string of the sequence. */
-    void setQuality (const std::string& qual)  { _quality = qual; }
+    void setQuality (const std::string& qual)  { _quality = qual;  _qualityRef.pending = false; }
+
+    /** Set the comment as a reference on a buffer owned by someone else (typically the parsing buffer of
+     * a bank iterator). The comment string is built only if getComment is called, so the buffer must
+     * remain valid as long as the comment may be asked for, ie. usually until the next iteration.
+     * \param[in] buffer : beginning of the comment
+     * \param[in] length : length of the comment */
+    void setCommentRef (const char* buffer, size_t length)  { _commentRef.set (buffer, length); }
+
+    /** Set the quality string as a reference on a buffer owned by someone else (see setCommentRef).
+     * \param[in] buffer : beginning of the quality string
+     * \param[in] length : length of the quality string */
+    void setQualityRef (const char* buffer, size_t length)  { _qualityRef.set (buffer, length); }
 
     /** Comment attribute (note: should be private with a setter and getter). */
-    std::string _comment;
+    mutable std::string _comment;
 
     /** Quality attribute (note: should be private with a setter and getter). */
-    std::string _quality;
+    mutable std::string _quality;
 
 private:
 
+    /** Reference on a string located in a buffer owned by someone else; it is copied into
+     * an actual string only when this string is needed. */
+    struct StringRef
+    {
+        StringRef () : buffer(0), length(0), pending(false)  {}
+
+        void set (const char* b, size_t l)  { buffer = b;  length = l;  pending = true; }
+
+        void resolve (std::string& str)
+        {
+            if (pending)  {  str.assign (length > 0 ? buffer : "", length);  pending = false;  }
+        }
+
+        const char* buffer;
+        size_t      length;
+        bool        pending;
+    };
+
+    /** Pending references on the comment and quality, if set by setCommentRef and setQualityRef. */
+    mutable StringRef _commentRef;
+    mutable StringRef _qualityRef;
+
     /** Object holding the genomic data of the sequence (ie a succession of nucleotides). */
     tools::misc::Data _data;
 
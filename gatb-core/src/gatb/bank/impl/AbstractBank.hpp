@@ -50,7 +50,7 @@ class AbstractBank : public IBank, public system::SmartPointer
 public:
 
     /** Constructor. */
-    AbstractBank () : _estimateThreshold(50000) {}
+    AbstractBank () : _estimateThreshold(50000), _estimateError(-1) {}
 
 	
 	std::string getIdNb (int i)  { return std::string("not_a_compo_bank"); }
@@ -72,6 +72,9 @@ public:
         u_int64_t number, totalSize, maxSize;    estimate (number, totalSize, maxSize);  return totalSize;
     }
 
+    /** \copydoc IBank::getEstimateError */
+    double getEstimateError ()  { return _estimateError; }
+
     /** \copydoc IBank::getEstimateThreshold */
     u_int64_t getEstimateThreshold ()  { return _estimateThreshold; }
 
@@ -91,9 +94,16 @@ public:
         return it->getComposition().size();
     }
 
+protected:
+
+    /** Set the precision of the last estimation (see getEstimateError).
+     * \param[in] error : relative standard error of the estimated sequences number */
+    void setEstimateError (double error)  { _estimateError = error; }
+
 private:
 
     u_int64_t _estimateThreshold;
+    double    _estimateError;
 };
 
 /********************************************************************************/
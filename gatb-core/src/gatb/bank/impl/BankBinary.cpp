@@ -22,7 +22,12 @@
 
 #include <gatb/system/impl/System.hpp>
 
+#include <algorithm>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace gatb::core::system;
@@ -39,20 +44,56 @@ static u_int64_t BINREADS_BUFFER = 100000;
 
 /********************************************************************************/
 
-static u_int64_t MAGIC_NUMBER = 0x12345678;  // set to 0 for no usage of magic number
+static u_int64_t MAGIC_NUMBER    = 0x12345678;  // set to 0 for no usage of magic number
+static u_int64_t MAGIC_NUMBER_V2 = 0x12345679;  // version 2: the file ends with an index of the blocks
 
 static void writeMagic (FILE* file)
 {
-    if (MAGIC_NUMBER != 0)  {  fwrite (&MAGIC_NUMBER, sizeof(MAGIC_NUMBER), 1, file);  }
+    if (MAGIC_NUMBER != 0)  {  fwrite (&MAGIC_NUMBER_V2, sizeof(MAGIC_NUMBER_V2), 1, file);  }
 }
 
-static bool checkMagic (FILE* file)
+static bool checkMagic (FILE* file, u_int64_t* magic=0)
 {
     if (MAGIC_NUMBER == 0)  { return true; }
 
     u_int64_t value = 0;
     fread (&value, sizeof(value), 1, file);
-    return  value==MAGIC_NUMBER;
+    if (magic != 0)  { *magic = value; }
+    return  value==MAGIC_NUMBER || value==MAGIC_NUMBER_V2;
+}
+
+/** Footer of a version 2 file. */
+struct BinaryFooter
+{
+    u_int64_t nbBlocks;
+    u_int64_t nbSequences;
+    u_int64_t totalSize;
+    u_int64_t maxSize;
+    u_int64_t indexOffset;
+    u_int64_t magic;
+};
+
+/** Returns the end of the blocks of a file read without its mapping: a version 2 file ends with
+ * the index of the blocks and its footer, which must not be read as blocks. The file position is kept. */
+static u_int64_t getBlocksEnd (FILE* file, u_int64_t magic)
+{
+    long current = ftell (file);
+
+    fseek (file, 0, SEEK_END);
+    u_int64_t end = ftell (file);
+
+    if (magic == MAGIC_NUMBER_V2  &&  end >= sizeof(MAGIC_NUMBER_V2) + sizeof(BinaryFooter))
+    {
+        BinaryFooter footer;
+        fseek (file, end - sizeof(footer), SEEK_SET);
+        if (fread (&footer, sizeof(footer), 1, file)  &&  footer.magic == MAGIC_NUMBER_V2  &&  footer.indexOffset <= end)
+        {
+            end = footer.indexOffset;
+        }
+    }
+
+    fseek (file, current, SEEK_SET);
+    return end;
 }
 
 /********************************************************************************/
@@ -101,7 +142,8 @@ unsigned char  code_n_NT(const char *seq, int nb)
 ** REMARKS :
 *********************************************************************/
 BankBinary::BankBinary (const std::string& filename, size_t nbValidLetters)
-    : _filename(filename), _nbValidLetters(nbValidLetters), binary_read_file(0)
+    : _filename(filename), _nbValidLetters(nbValidLetters), binary_read_file(0),
+      _nbSequences(0), _totalSize(0), _maxSize(0), _nbSeqBuffer(0), _writtenSize(0), _mapping(0), _mappingSize(0), _indexState(0), _synchro(0)
 {
     read_write_buffer_size = BINREADS_BUFFER;
 
@@ -110,6 +152,8 @@ BankBinary::BankBinary (const std::string& filename, size_t nbValidLetters)
     buffer = (unsigned char *) MALLOC (read_write_buffer_size*sizeof(unsigned char));
 
     cpt_buffer = 0;
+
+    _synchro = System::thread().newSynchronizer();
 }
 
 /*********************************************************************
@@ -126,6 +170,10 @@ BankBinary::~BankBinary ()
     {
         FREE (buffer); //buffer =NULL;
     }
+
+    unloadIndex ();
+
+    delete _synchro;
 }
 
 /*********************************************************************
@@ -146,7 +194,6 @@ void BankBinary::insert (const Sequence& seq)
     int readlen = 0;
     int tai = readlen;
     unsigned char rbin;
-    unsigned int block_size = 0;
     char *pt;
     
     char * pt_begin = pt_start;
@@ -187,15 +234,7 @@ void BankBinary::insert (const Sequence& seq)
         if(cpt_buffer >= (read_write_buffer_size-readlen) || cpt_buffer > 10000000 )  ////not enough space to store next read   true space is 4 + readlen/4 + rem
             //flush buffer to disk
         {
-            block_size = cpt_buffer;
-            
-            if(block_size) fwrite(&block_size, sizeof(unsigned int), 1, binary_read_file); // block header
-            if (!fwrite(buffer, 1, cpt_buffer, binary_read_file)) // write a block, it ends at end of a read
-            {
-                printf("error: can't fwrite (disk full?)\n");
-                exit(1);
-            }
-            cpt_buffer=0;
+            writeBlock ();
         }
         
         //check if still not enough space in empty buffer : can happen if large read, then enlarge buffer
@@ -223,9 +262,45 @@ void BankBinary::insert (const Sequence& seq)
             rbin = code_n_NT(pt,tai);
             buffer[cpt_buffer]=rbin; cpt_buffer++;
         }
+
+        /** We update the information for the index. */
+        _nbSeqBuffer ++;
+        _totalSize += readlen;
+        if ((u_int64_t)readlen > _maxSize)  { _maxSize = readlen; }
     }
  }
 
+/*********************************************************************
+** METHOD  :
+** PURPOSE : write the buffer as a block (which ends at end of a read)
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void BankBinary::writeBlock ()
+{
+    if (cpt_buffer == 0)  { return; }
+
+    unsigned int block_size = cpt_buffer;
+
+    fwrite(&block_size, sizeof(unsigned int), 1, binary_read_file); // block header
+    if (!fwrite(buffer, 1, cpt_buffer, binary_read_file))
+    {
+        throw gatb::core::system::ExceptionErrno (STR_BANK_unable_write_file);
+    }
+
+    /** We add the block to the index. */
+    _blockOffset.push_back   (_writtenSize);
+    _blockFirstSeq.push_back (_nbSequences);
+
+    _writtenSize += sizeof(unsigned int) + cpt_buffer;
+    _nbSequences += _nbSeqBuffer;
+
+    cpt_buffer   = 0;
+    _nbSeqBuffer = 0;
+}
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -236,24 +311,29 @@ void BankBinary::insert (const Sequence& seq)
 *********************************************************************/
 void BankBinary::flush ()
 {
-    unsigned int block_size =0;
-
     if (binary_read_file != 0)
     {
-        if(cpt_buffer)
+        writeBlock ();
+
+        /** We write the index of the blocks. */
+        for (size_t b=0; b<_blockOffset.size(); b++)
         {
-            block_size = cpt_buffer;
+            u_int64_t entry[2] = { _blockOffset[b], (b+1<_blockFirstSeq.size() ? _blockFirstSeq[b+1] : _nbSequences) - _blockFirstSeq[b] };
+            fwrite (entry, sizeof(entry), 1, binary_read_file);
+        }
 
-            fwrite(&block_size, sizeof(unsigned int), 1, binary_read_file); // block header
-            if (!fwrite(buffer, 1, cpt_buffer, binary_read_file))
-            {
-                throw gatb::core::system::ExceptionErrno (STR_BANK_unable_write_file);
-            }
+        /** We write the footer. */
+        BinaryFooter footer = { _blockOffset.size(), _nbSequences, _totalSize, _maxSize, _writtenSize, MAGIC_NUMBER_V2 };
+        if (!fwrite (&footer, sizeof(footer), 1, binary_read_file))
+        {
+            throw gatb::core::system::ExceptionErrno (STR_BANK_unable_write_file);
         }
-        cpt_buffer=0;
 
         fclose(binary_read_file);
         binary_read_file = 0;
+
+        /** The index may have been looked for while writing; it can be loaded now. */
+        _indexState = 0;
     }
 }
 
@@ -274,7 +354,172 @@ void BankBinary::open (bool write)
     }
 
     /** We write the magic number. */
-    if (write == true)  {  writeMagic (binary_read_file);  }
+    if (write == true)
+    {
+        writeMagic (binary_read_file);
+
+        /** The index is built again while writing. */
+        unloadIndex ();
+        _writtenSize = MAGIC_NUMBER != 0 ? sizeof(MAGIC_NUMBER_V2) : 0;
+        _nbSequences = _totalSize = _maxSize = 0;
+        _nbSeqBuffer = 0;
+    }
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+bool BankBinary::loadIndex ()
+{
+    if (_indexState == 0)
+    {
+        LocalSynchronizer ls (_synchro);
+        if (_indexState == 0)
+        {
+            int state = readIndex() ? 1 : 2;
+            __sync_synchronize();
+            _indexState = state;
+        }
+    }
+    return _indexState == 1;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : map the file in memory and read its index
+** INPUT   :
+** OUTPUT  :
+** RETURN  : false if the file is not indexed (version 1)
+** REMARKS :
+*********************************************************************/
+bool BankBinary::readIndex ()
+{
+    /** The file may be currently written. */
+    if (binary_read_file != 0)  { return false; }
+
+    int fd = ::open (_filename.c_str(), O_RDONLY);
+    if (fd < 0)  { return false; }
+
+    struct stat st;
+    void* ptr = MAP_FAILED;
+
+    if (fstat (fd, &st) == 0  &&  st.st_size >= (off_t) (sizeof(MAGIC_NUMBER_V2) + sizeof(BinaryFooter)))
+    {
+        /** The mapping is writable (copy on write), since the iterated sequences refer to it. */
+        ptr = mmap (0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+    }
+
+    //the mapping remains valid after the file descriptor is closed
+    ::close (fd);
+
+    if (ptr == MAP_FAILED)  { return false; }
+
+    u_int64_t    size = st.st_size;
+    BinaryFooter footer;
+    memcpy (&footer, (char*)ptr + size - sizeof(footer), sizeof(footer));
+
+    if (footer.magic != MAGIC_NUMBER_V2  ||  footer.indexOffset + footer.nbBlocks * 2 * sizeof(u_int64_t) + sizeof(footer) != size)
+    {
+        munmap (ptr, size);
+        return false;
+    }
+
+    _mapping     = (char*) ptr;
+    _mappingSize = size;
+    _nbSequences = footer.nbSequences;
+    _totalSize   = footer.totalSize;
+    _maxSize     = footer.maxSize;
+
+    /** We read the index; the last items are the end of the blocks and the number of sequences. */
+    _blockOffset.resize   (footer.nbBlocks + 1);
+    _blockFirstSeq.resize (footer.nbBlocks + 1);
+
+    const char* index = _mapping + footer.indexOffset;
+    u_int64_t   first = 0;
+    for (size_t b=0; b<footer.nbBlocks; b++)
+    {
+        u_int64_t entry[2];
+        memcpy (entry, index + b*sizeof(entry), sizeof(entry));
+        _blockOffset[b]   = entry[0];
+        _blockFirstSeq[b] = first;
+        first += entry[1];
+    }
+    _blockOffset  [footer.nbBlocks] = footer.indexOffset;
+    _blockFirstSeq[footer.nbBlocks] = first;
+
+    madvise (_mapping, _mappingSize, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void BankBinary::unloadIndex ()
+{
+    if (_mapping != 0)  {  munmap (_mapping, _mappingSize);  }
+
+    _mapping     = 0;
+    _mappingSize = 0;
+    _indexState  = 0;
+
+    _blockOffset.clear();
+    _blockFirstSeq.clear();
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+int64_t BankBinary::getNbItems ()
+{
+    return loadIndex() ? _nbSequences : -1;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS : the sequences of a block are read until the wanted one
+*********************************************************************/
+bool BankBinary::getSequence (u_int64_t index, Sequence& seq)
+{
+    if (loadIndex() == false  ||  index >= _nbSequences)  { return false; }
+
+    /** We look for the block holding the sequence. */
+    size_t b = std::upper_bound (_blockFirstSeq.begin(), _blockFirstSeq.end(), index) - _blockFirstSeq.begin() - 1;
+
+    char* loop = _mapping + _blockOffset[b] + sizeof(unsigned int);
+    int   len  = 0;
+
+    for (u_int64_t i=_blockFirstSeq[b]; ; i++)
+    {
+        memcpy (&len, loop, sizeof(int));
+        if (i == index)  { break; }
+        loop += sizeof(int) + (len+3)/4;
+    }
+
+    seq.getData().setRef (loop + sizeof(int), len);
+    seq.getData().setEncoding (Data::BINARY);
+    seq.setIndex (index);
+
+    return true;
 }
 
 /*********************************************************************
@@ -300,11 +545,22 @@ u_int64_t BankBinary::getSize ()
 *********************************************************************/
 void BankBinary::estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize)
 {
+    /** The information of an indexed file is exact and known from its footer. */
+    if (loadIndex())
+    {
+        number    = _nbSequences;
+        totalSize = _totalSize;
+        maxSize   = _maxSize;
+        setEstimateError (0);
+        return;
+    }
+
     /** We create an iterator for the bank. */
     BankBinary::Iterator it (*this);
 
     /** We return the estimation of sequences information. */
     it.estimate (number, totalSize, maxSize);
+    setEstimateError (-1);
 }
 
 /*********************************************************************
@@ -317,6 +573,7 @@ void BankBinary::estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& m
 *********************************************************************/
 void BankBinary::remove ()
 {
+    unloadIndex ();
     System::file().remove (_filename);
 }
 
@@ -365,8 +622,8 @@ bool BankBinary::check (const std::string& uri)
 *********************************************************************/
 BankBinary::Iterator::Iterator (BankBinary& ref)
     : _ref(ref), _isDone(true), _bufferData (0), cpt_buffer(0), blocksize_toread(0), nseq_lues(0),
-      binary_read_file(0),
-      _index(0)
+      binary_read_file(0), _blocksEnd(0),
+      _index(0), _block(0), _offset(0), _offsetEnd(0), _nextBlock(0)
 {
 }
 
@@ -395,6 +652,20 @@ BankBinary::Iterator::~Iterator ()
 *********************************************************************/
 void BankBinary::Iterator::first()
 {
+    _index = 0;
+
+    /** An indexed file is read from its mapping in memory. */
+    if (_ref.loadIndex())
+    {
+        _isDone    = false;
+        _block     = 0;
+        _offset    = 0;
+        _offsetEnd = 0;
+
+        next();
+        return;
+    }
+
     if (binary_read_file == 0)
     {
         /** We open the binary file at first call. */
@@ -409,7 +680,10 @@ void BankBinary::Iterator::first()
         rewind (binary_read_file);
 
         /** We read the magic number. */
-        if (checkMagic(binary_read_file)==false)  {  throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, _ref._filename.c_str());  }
+        u_int64_t magic = 0;
+        if (checkMagic(binary_read_file, &magic)==false)  {  throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, _ref._filename.c_str());  }
+
+        _blocksEnd = getBlocksEnd (binary_read_file, magic);
     }
 
     /** We reinitialize some attributes. */
@@ -435,11 +709,41 @@ void BankBinary::Iterator::next ()
     int len = 0;
     unsigned int block_size = 0;
 
+    if (_ref._mapping != 0)
+    {
+        /** We go to the next block if needed. */
+        while (_offset == _offsetEnd)
+        {
+            if (_block + 1 >= _ref._blockOffset.size())  {  _isDone = true;  return;  }
+
+            memcpy (&block_size, _ref._mapping + _ref._blockOffset[_block], sizeof(unsigned int));
+            _offset    = _ref._blockOffset[_block] + sizeof(unsigned int);
+            _offsetEnd = _offset + block_size;
+            _block ++;
+        }
+
+        memcpy (&len, _ref._mapping + _offset, sizeof(int));
+
+        /** The data of the sequence refers to the mapped file. */
+        _item->getData().setRef (_ref._mapping + _offset + sizeof(int), len);
+        _item->setIndex (_index++);
+
+        _offset += sizeof(int) + (len+3)/4;
+        return;
+    }
+
     //////////////////////////////////////////////
     //reading new block from disk if needed
     //////////////////////////////////////////////
     if (cpt_buffer == blocksize_toread)
     {
+        /** The blocks end before the index of a version 2 file. */
+        if ((u_int64_t) ftell (binary_read_file) >= _blocksEnd)
+        {
+            _isDone = true;
+            return;
+        }
+
         /** We read the size of the following cache buffer. */
         if (! fread(&block_size,sizeof(unsigned int),1, binary_read_file)) //read block header
         {
@@ -483,6 +787,60 @@ void BankBinary::Iterator::next ()
     }
 }
 
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+bool BankBinary::Iterator::getConcurrent (std::vector<Sequence>& current, ISynchronizer& synchro)
+{
+    /** A file without index can only be read sequentially. */
+    if (_ref.loadIndex() == false)  {  return tools::dp::Iterator<Sequence>::getConcurrent (current, synchro);  }
+
+    /** We get the next block to be read. */
+    u_int64_t block = __sync_fetch_and_add (&_nextBlock, 1);
+    if (block + 1 >= _ref._blockOffset.size())  {  current.clear();  return false;  }
+
+    size_t nb = _ref._blockFirstSeq[block+1] - _ref._blockFirstSeq[block];
+
+    /** Sequence objects can't be copied, so the vector must not be reallocated while not empty. */
+    if (nb > current.size())  {  current.clear();  }
+    current.resize (nb);
+
+    char* loop = _ref._mapping + _ref._blockOffset[block] + sizeof(unsigned int);
+    for (size_t i=0; i<nb; i++)
+    {
+        int len = 0;
+        memcpy (&len, loop, sizeof(int));
+
+        current[i].getData().setRef (loop + sizeof(int), len);
+        current[i].getData().setEncoding (Data::BINARY);
+        current[i].setIndex (_ref._blockFirstSeq[block] + i);
+
+        loop += sizeof(int) + (len+3)/4;
+    }
+
+    return true;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void BankBinary::Iterator::reset ()
+{
+    tools::dp::Iterator<Sequence>::reset ();
+
+    _nextBlock = 0;
+}
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -493,6 +851,9 @@ void BankBinary::Iterator::next ()
 *********************************************************************/
 void  BankBinary::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize)
 {
+    /** The information of an indexed file is known from its footer. */
+    if (_ref.loadIndex())  {  _ref.estimate (number, totalSize, maxSize);  return;  }
+
     /** We initialize the provided arguments. */
     number    = 0;
     totalSize = 0;
@@ -502,11 +863,15 @@ void  BankBinary::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u
     FILE* file = fopen (_ref._filename.c_str(), "rb");
     if (file != 0)
     {
-        if (checkMagic(file)==false)  {  throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, _ref._filename.c_str());  }
+        u_int64_t magic = 0;
+        if (checkMagic(file, &magic)==false)  {  throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, _ref._filename.c_str());  }
+
+        // the blocks end before the index of a version 2 file
+        u_int64_t end = getBlocksEnd (file, magic);
 
         vector<char> buffer;
 
-        while (feof (file) == false)
+        while (feof (file) == false  &&  (u_int64_t) ftell (file) < end)
         {
             unsigned int block_size = 0;
 
@@ -537,18 +902,12 @@ void  BankBinary::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u
             if (number >= _ref.getEstimateThreshold())  { break; }
         }
 
+        // we keep the current location in the file
+        u_int64_t current = ftell (file);
+
         // we extrapolate the result according to the current location in the file
-        if (feof (file) == false)
+        if (feof (file) == false  &&  current < end)
         {
-            // we keep the current location in the file
-            u_int64_t current = ftell (file);
-
-            // we go to the end of the file
-            fseek (file, 0, SEEK_END); /* cygwin doesnt like fseeko and fseek/fseeko seems similar */ 
-
-            // we keep the current location in the file
-            u_int64_t end = ftell (file);
-
             // we extrapolate the result
             number    = (number    * end) / current;
             totalSize = (totalSize * end) / current;
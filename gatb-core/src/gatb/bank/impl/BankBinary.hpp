@@ -52,7 +52,15 @@ namespace impl      {
  *                  - a sequence is:
  *                      - a sequence length (on 4 bytes)
  *                      - the nucleotides of the sequences (4 nucleotides encoded in 1 byte)
- * - number of sequences (on 4 bytes)
+ *    - (version 2) an index of the blocks
+ *        - for each block: its offset in the file and its number of sequences (on 8 bytes each)
+ *    - (version 2) a footer (on 8 bytes each): number of blocks, number of sequences, total and
+ *      maximum sequence size, offset of the index and magic number
+ *
+ * Files are written in version 2. They are mapped in memory for reading, which allows several threads
+ * to iterate whole blocks at the same time (see Iterator::getConcurrent), random access to the sequences
+ * (see getSequence) and exact information without reading the sequences (see estimate).
+ * Files of version 1 (without index) are read sequentially.
  *
  * Historically, BinaryBank has been used in the first step of the DSK tool to convert
  * one input FASTA file into a binary format. DSK used to read several times the reads
@@ -89,7 +97,7 @@ public:
     tools::dp::Iterator<Sequence>* iterator ()  { return new Iterator (*this); }
 
     /** \copydoc IBank::getNbItems */
-    int64_t getNbItems () { return -1; }
+    int64_t getNbItems ();
 
     /** \copydoc IBank::insert */
     void insert (const Sequence& item);
@@ -106,6 +114,18 @@ public:
     /** \copydoc IBank::remove. */
     void remove ();
 
+    /** Tells whether the file has an index of its blocks (ie. version 2), which is needed for random
+     * access and parallel iteration.
+     * \return true if the file is indexed. */
+    bool isIndexed ()  { return loadIndex(); }
+
+    /** Random access to a sequence of an indexed file. The data of the sequence refers to the file
+     * mapped in memory, so it remains valid as long as the bank is alive (and not written again).
+     * \param[in] index : index of the sequence in the bank
+     * \param[out] seq : the sequence
+     * \return false if the index is out of range or if the file is not indexed. */
+    bool getSequence (u_int64_t index, Sequence& seq);
+
     /** Set default buffer size (static method). 
       * \param[in] bufferSize : size of the buffer.    
       */
@@ -145,6 +165,17 @@ public:
             return *_item;
         }
 
+        /** Retrieve the sequences of one block for one of several threads sharing this iterator
+         * (see Dispatcher::iterate). For an indexed file, each thread gets whole blocks without
+         * holding the synchronizer; other files are iterated in the default way.
+         * \param[in] current : vector to be filled with the sequences of one block
+         * \param[in] synchro : synchronizer shared by the threads using this iterator
+         * \return true if the iteration is not finished, false otherwise. */
+        bool getConcurrent (std::vector<Sequence>& current, system::ISynchronizer& synchro);
+
+        /** \copydoc tools::dp::Iterator::reset */
+        void reset ();
+
         /** Estimation of the sequences information. */
         void estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize);
 
@@ -166,7 +197,18 @@ public:
 
         FILE* binary_read_file;
 
+        /** File without its mapping: end of the blocks (the index of a version 2 file is not read). */
+        u_int64_t _blocksEnd;
+
         size_t _index;
+
+        /** Indexed file: current block and position of the next sequence in the mapped file. */
+        size_t    _block;
+        u_int64_t _offset;
+        u_int64_t _offsetEnd;
+
+        /** Indexed file: next block to be given by getConcurrent. */
+        u_int64_t _nextBlock;
     };
 
 protected:
@@ -183,6 +225,37 @@ protected:
 
     void open  (bool write);
     void close ();
+
+    /** Index of the blocks: offset of each block and index of its first sequence. The last items
+     * are the end of the blocks and the number of sequences. It is filled while writing the file. */
+    std::vector<u_int64_t> _blockOffset;
+    std::vector<u_int64_t> _blockFirstSeq;
+
+    /** Sequences information (version 2) */
+    u_int64_t _nbSequences;
+    u_int64_t _totalSize;
+    u_int64_t _maxSize;
+
+    /** Writing: number of sequences in the buffer and number of bytes written so far. */
+    int       _nbSeqBuffer;
+    u_int64_t _writtenSize;
+
+    /** Write the buffer as a new block of the file. */
+    void writeBlock ();
+
+    /** Reading: the file is mapped in memory if it is indexed. */
+    char*     _mapping;
+    u_int64_t _mappingSize;
+
+    /** 0 if the index is not loaded yet, 1 if loaded, 2 if the file is not indexed. */
+    volatile int _indexState;
+    system::ISynchronizer* _synchro;
+
+    /** Load the index of the file, if any (done once).
+     * \return true if the file is indexed */
+    bool loadIndex ();
+    bool readIndex ();
+    void unloadIndex ();
 };
 
 /********************************************************************************/
@@ -33,6 +33,7 @@
 
 #include <vector>
 #include <string>
+#include <cmath>
 
 /********************************************************************************/
 namespace gatb      {
@@ -141,12 +142,22 @@ public:
     {
         number = totalSize = maxSize = 0;
 
+        /** The errors of the banks are independent, so their variances add up. */
+        double variance = 0;
+        bool   known    = true;
+
         u_int64_t numberIth=0, totalSizeIth=0, maxSizeIth=0;
         for (size_t i=0; i<_banks.size(); i++)
         {
             _banks[i]->estimate (numberIth, totalSizeIth, maxSizeIth);
             number += numberIth;  totalSize += totalSizeIth;  maxSize = std::max (maxSize, maxSizeIth);
+
+            double error = _banks[i]->getEstimateError();
+            if (error < 0)  { known = false; }
+            variance += (error * numberIth) * (error * numberIth);
         }
+
+        setEstimateError (known == false ? -1 : (number > 0 ? std::sqrt (variance) / number : 0));
     }
 
     /** */
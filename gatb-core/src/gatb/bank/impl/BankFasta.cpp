@@ -26,9 +26,19 @@
 #include <gatb/tools/designpattern/impl/IteratorHelpers.hpp>
 
 #include <algorithm>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <string.h>
 #include <errno.h>
 #include <zlib.h> // Added by Pierre Peterlongo on 02/08/2012.
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace gatb::core::tools::dp;
@@ -41,6 +51,14 @@ using namespace gatb::core::tools::misc;
 
 #define BUFFER_SIZE     (256*1024)
 
+/** Chunks of the input parsed by one thread (see BankFasta::Iterator::getConcurrent). */
+#define CHUNK_SIZE      (1024*1024)
+#define CHUNK_QUEUE     16      // decompressed chunks waiting to be parsed
+#define CHUNK_RING      4096    // max number of chunks being parsed at the same time
+#define CHUNK_BGZF      16      // BGZF blocks (64 KB at most) inflated by one thread at once
+
+#define PREFETCH_QUEUE  4       // inflated buffers read ahead in serial iteration
+
 #define nearest_power_of_2(x) (--(x), (x)|=(x)>>1, (x)|=(x)>>2, (x)|=(x)>>4, (x)|=(x)>>8, (x)|=(x)>>16, ++(x))
 
 /** https://graphics.stanford.edu/~seander/bithacks.html#DetermineIfPowerOf2 */
@@ -52,11 +70,176 @@ namespace gatb {  namespace core {  namespace bank {  namespace impl {
 
 size_t BankFasta::_dataLineSize = 70;
 
+/********************************************************************************/
+/** Tells whether a file starts with the gzip magic number. */
+static bool is_gzip (const char* fname)
+{
+    unsigned char magic[2] = {0, 0};
+    FILE* file = fopen (fname, "rb");
+    if (file == 0)  { return false; }
+    bool res = fread (magic, 1, 2, file) == 2  &&  magic[0] == 0x1f  &&  magic[1] == 0x8b;
+    fclose (file);
+    return res;
+}
+
+/********************************************************************************/
+/** Size of the BGZF block starting at 'p' (ie. BSIZE+1, see the SAM specification), 0 if 'p' is not a BGZF block. */
+static size_t bgzf_block_size (const unsigned char* p, size_t size)
+{
+    if (size < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || (p[3] & 4) == 0)  { return 0; }
+
+    size_t xlen = p[10] | (p[11] << 8);
+    for (size_t i=12;  i+4 <= 12+xlen  &&  i+6 <= size; )
+    {
+        size_t slen = p[i+2] | (p[i+3] << 8);
+        if (p[i] == 'B' && p[i+1] == 'C' && slen == 2)  { return (p[i+4] | (p[i+5] << 8)) + 1; }
+        i += 4 + slen;
+    }
+    return 0;
+}
+
+/** Inflates a whole BGZF block (ie. a gzip member), appending the data to 'out'. */
+static void bgzf_inflate (z_stream& z, const unsigned char* block, size_t blockSize, string& out)
+{
+    size_t xlen  = block[10] | (block[11] << 8);
+    const unsigned char* t = block + blockSize - 4;
+    size_t isize = t[0] | (t[1] << 8) | (t[2] << 16) | ((size_t)t[3] << 24);
+
+    size_t previous = out.size();
+    out.resize (previous + isize);
+
+    inflateReset (&z);
+    z.next_in   = (Bytef*) (block + 12 + xlen);
+    z.avail_in  = blockSize - 12 - xlen - 8;
+    z.next_out  = (Bytef*) &out[previous];
+    z.avail_out = isize;
+
+    if (isize > 0  &&  (inflate (&z, Z_FINISH) != Z_STREAM_END || z.avail_out != 0))
+    {
+        throw gatb::core::system::Exception ("unable to inflate BGZF block");
+    }
+}
+
+/** Uncompressed size of a BGZF file, computed from its index (.gzi file made by 'bgzip -i').
+ * \return false if there is no such index */
+static bool bgzf_indexed_size (const string& fname, u_int64_t& size)
+{
+    FILE* index = fopen ((fname + ".gzi").c_str(), "rb");
+    if (index == 0)  { return false; }
+
+    /** The index holds the (compressed, uncompressed) offsets of the blocks but the first one. */
+    u_int64_t nb = 0, offsets[2] = {0, 0};
+    bool ok = fread (&nb, sizeof(nb), 1, index) == 1;
+    if (ok && nb > 0)
+    {
+        ok = fseeko (index, sizeof(nb) + (nb-1)*sizeof(offsets), SEEK_SET) == 0  &&  fread (offsets, sizeof(offsets), 1, index) == 1;
+    }
+    fclose (index);
+
+    FILE* file = ok ? fopen (fname.c_str(), "rb") : 0;
+    if (file == 0)  { return false; }
+
+    /** We add the sizes of the blocks following the last indexed one. */
+    size = offsets[1];
+    unsigned char header[18];
+    for (u_int64_t offset = offsets[0];  fseeko (file, offset, SEEK_SET) == 0  &&  fread (header, 1, 18, file) == 18; )
+    {
+        size_t blockSize = bgzf_block_size (header, 18);
+        unsigned char isize[4];
+        if (blockSize == 0  ||  fseeko (file, offset + blockSize - 4, SEEK_SET) != 0  ||  fread (isize, 1, 4, file) != 4)  { ok = false;  break; }
+
+        size   += isize[0] | (isize[1] << 8) | (isize[2] << 16) | ((u_int64_t)isize[3] << 24);
+        offset += blockSize;
+    }
+    fclose (file);
+
+    return ok;
+}
+
+/********************************************************************************/
+/** Inflates a gzipped file in a separate thread, so that inflating and parsing overlap in a serial iteration. */
+struct gz_prefetch_t
+{
+    gz_prefetch_t (gzFile stream) : stream(stream), consumed(0), eof(false), stop(false)  {  start ();  }
+    ~gz_prefetch_t ()  {  finish ();  }
+
+    gzFile                  stream;
+    std::thread             thread;
+    std::mutex              mtx;
+    std::condition_variable notEmpty, notFull;
+    std::deque<string>      buffers;
+    u_int64_t               consumed;  // number of inflated bytes given to the parser
+    bool                    eof, stop;
+
+    void start ()
+    {
+        eof = stop = false;
+        thread = std::thread (&gz_prefetch_t::run, this);
+    }
+
+    void finish ()
+    {
+        std::unique_lock<std::mutex> lock (mtx);
+        stop = true;
+        lock.unlock();
+        notFull.notify_all();
+        if (thread.joinable())  { thread.join(); }
+    }
+
+    void run ()
+    {
+        while (true)
+        {
+            string buffer (BUFFER_SIZE, 0);
+            int nb = gzread (stream, &buffer[0], BUFFER_SIZE);
+            buffer.resize (std::max (nb, 0));
+
+            std::unique_lock<std::mutex> lock (mtx);
+            if (nb <= 0)  {  eof = true;  lock.unlock();  notEmpty.notify_all();  return;  }
+
+            notFull.wait (lock, [this] { return stop || buffers.size() < PREFETCH_QUEUE; });
+            if (stop)  { return; }
+            buffers.push_back (string());
+            buffers.back().swap (buffer);
+            lock.unlock();
+            notEmpty.notify_one();
+        }
+    }
+
+    /** Same semantics as gzread with a BUFFER_SIZE length. */
+    int read (unsigned char* buffer)
+    {
+        std::unique_lock<std::mutex> lock (mtx);
+        notEmpty.wait (lock, [this] { return eof || !buffers.empty(); });
+        if (buffers.empty())  { return 0; }
+
+        string data;
+        data.swap (buffers.front());
+        buffers.pop_front();
+        lock.unlock();
+        notFull.notify_one();
+
+        memcpy (buffer, data.data(), data.size());
+        consumed += data.size();
+        return data.size();
+    }
+
+    void rewind ()
+    {
+        finish ();
+        gzrewind (stream);
+        buffers.clear();
+        consumed = 0;
+        start ();
+    }
+};
+
 /********************************************************************************/
 // heavily inspired by kseq.h from Heng Li (https://github.com/attractivechaos/klib)
 typedef struct
 {
     gzFile stream;
+    gz_prefetch_t* prefetch; // for gzipped files
     unsigned char *buffer;
     int buffer_start, buffer_end;
     bool eof;
@@ -64,13 +247,16 @@ typedef struct
 
     void rewind ()
     {
-        gzrewind (stream);
+        if (prefetch)  { prefetch->rewind(); }  else  { gzrewind (stream); }
         last_char    = 0;
         eof          = 0;
         buffer_start = 0;
         buffer_end   = 0;
     }
 
+    /** Position in the uncompressed data. */
+    u_int64_t tell ()  {  return prefetch ? prefetch->consumed : gztell (stream);  }
+
 } buffered_file_t;
 
 /********************************************************************************/
@@ -170,13 +356,13 @@ void BankFasta::init ()
         /** Shortcut. */
         const char* fname = _filenames[i].c_str();
 
-        bool compressed = false;
+        bool compressed = is_gzip (fname);
         u_int64_t estimated_filesize;
 
-        if (strstr (fname, "gz") == (fname + strlen (fname) - 2))
-            compressed = true;
+        if (compressed && bgzf_indexed_size (fname, estimated_filesize))
+            ; // exact size, from the index of a BGZF file
 
-        if (compressed)
+        else if (compressed)
             // crude hack, based on Quip paper reporting compression ratio (~0.3).
             // gzseek(SEEK_END) isn't supported. need to read whole file otherwise :/
 
@@ -188,23 +374,6 @@ void BankFasta::init ()
     }
 }
 
-/*********************************************************************
-** METHOD  :
-** PURPOSE :
-** INPUT   :
-** OUTPUT  :
-** RETURN  :
-** REMARKS :
-*********************************************************************/
-void BankFasta::estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize)
-{
-    /** We create an iterator for the bank. */
-    BankFasta::Iterator it (*this, Iterator::NONE);
-
-    /** We delegate the computation to the iterator. */
-    it.estimate (number, totalSize, maxSize);
-}
-
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -301,9 +470,9 @@ void BankFasta::insert (const Sequence& item)
 ** RETURN  :
 ** REMARKS :
 *********************************************************************/
-BankFasta::Iterator::Iterator (BankFasta& ref, CommentMode_e commentMode)
-    : _ref(ref), _commentsMode(commentMode), _isDone(true), _isInitialized(false), _nIters(0),
-      index_file(0), buffered_file(0), buffered_strings(0), _index(0)
+BankFasta::Iterator::Iterator (BankFasta& ref, CommentMode_e commentMode, bool zeroCopy)
+    : _ref(ref), _commentsMode(commentMode), _zeroCopy(zeroCopy), _isDone(true), _isInitialized(false), _nIters(0),
+      index_file(0), buffered_file(0), buffered_strings(0), _index(0), chunked_input(0)
 {
     DEBUG (("Bank::Iterator::Iterator\n"));
 
@@ -374,6 +543,14 @@ void BankFasta::Iterator::next()
     else
     {
         _isDone = get_next_seq (_item->getData(), _item->_comment,_item->_quality, _commentsMode) == false;
+
+        /** In zero copy mode, the comment and quality are only built if asked for. */
+        if (_zeroCopy && !_isDone)
+        {
+            buffered_strings_t* bs = (buffered_strings_t*) buffered_strings;
+            _item->setCommentRef (bs->header->string,  bs->header->length);
+            _item->setQualityRef (bs->quality->string, bs->quality->length);
+        }
     }
     _item->setIndex (_index++);
     DEBUG (("Bank::Iterator::next  _isDone=%d\n", _isDone));
@@ -392,7 +569,7 @@ inline bool rebuffer (buffered_file_t *bf)
 {
     if (bf->eof) return false;
     bf->buffer_start = 0;
-    bf->buffer_end = gzread (bf->stream, bf->buffer, BUFFER_SIZE);
+    bf->buffer_end = bf->prefetch ? bf->prefetch->read (bf->buffer) : gzread (bf->stream, bf->buffer, BUFFER_SIZE);
     if (bf->buffer_end < BUFFER_SIZE) bf->eof = 1;
     if (bf->buffer_end == 0) return false;
     return true;
@@ -551,18 +728,16 @@ bool BankFasta::Iterator::get_next_seq_from_file (Vector<char>& data, string& co
             ; // read rest of quality
         bf->last_char = 0;
         
-        quality.assign (bs->quality->string, bs->quality->length);
+        if (mode != NONE && _zeroCopy == false)  {  quality.assign (bs->quality->string, bs->quality->length);  }
        // printf("%i  %i\n",bs->quality->length,bs->header->length);
     }
 
     /** We update the data of the sequence. */
-#if 1
-    data.set (bs->read->string, bs->read->length);
-#else
-    data.setRef (bs->read->string, bs->read->length);
-#endif
+    if (_zeroCopy)  {  data.setRef (bs->read->string, bs->read->length);  }
+    else            {  data.set    (bs->read->string, bs->read->length);  }
 
-    //if (comment.empty() == false)
+    /** In zero copy mode, the caller refers to the header buffer instead. */
+    if (mode != NONE && _zeroCopy == false)
     {
         comment.assign (bs->header->string, bs->header->length);
     }
@@ -664,6 +839,9 @@ void BankFasta::Iterator::init ()
             throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, fname);
 
         }
+
+        /** Gzipped files are inflated by another thread. */
+        if (is_gzip (fname))  {  (*bf)->prefetch = new gz_prefetch_t ((*bf)->stream);  }
     }
 
     index_file = 0; // initialize the get_next_seq iterator to the first file
@@ -685,6 +863,8 @@ void BankFasta::Iterator::init ()
 *********************************************************************/
 void BankFasta::Iterator::finalize ()
 {
+    finalizeChunks ();
+
     if (_isInitialized == false)  { return; }
 
     buffered_strings_t* bs = (buffered_strings_t*) buffered_strings;
@@ -697,6 +877,9 @@ void BankFasta::Iterator::finalize ()
 
         if (bf != 0)
         {
+            /** We stop the inflating thread. */
+            if (bf->prefetch != 0)  {  delete bf->prefetch;  bf->prefetch = 0; }
+
             /** We close the handle of the file. */
             if (bf->stream != NULL)  {  gzclose (bf->stream);  bf->stream = 0; }
 
@@ -742,6 +925,10 @@ void BankFasta::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u_i
     totalSize = 0;
     maxSize   = 0;
 
+    /** Only the sizes are needed, so the sequences don't need to be copied. */
+    bool zeroCopy = _zeroCopy;
+    _zeroCopy = true;
+
     number = 0;
     while (get_next_seq (data)  &&  number <= _ref.getEstimateThreshold())
     {
@@ -750,6 +937,8 @@ void BankFasta::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u_i
         totalSize += data.size ();
     }
 
+    _zeroCopy = zeroCopy;
+
     u_int64_t actualPosition = 0;
 
     /** We compute the aggregated size from the files having been read until we
@@ -758,7 +947,7 @@ void BankFasta::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u_i
     {
         buffered_file_t* current = (buffered_file_t *) buffered_file[i];
 
-        actualPosition += gztell (current->stream);
+        actualPosition += current->tell();
     }
 
     if (actualPosition > 0)
@@ -769,6 +958,975 @@ void BankFasta::Iterator::estimate (u_int64_t& number, u_int64_t& totalSize, u_i
     }
 }
 
+/********************************************************************************/
+// Chunked input: the file is split into chunks ending at record boundaries, so that several
+// threads can parse their own chunk at the same time.
+
+/** Returns the position following the next end of line (or 'end'). */
+static inline const char* next_line (const char* p, const char* end)
+{
+    const char* eol = (const char*) memchr (p, '\n', end - p);
+    return eol ? eol + 1 : end;
+}
+
+/** Returns the end of a line, without the line feed and a possible carriage return. */
+static inline const char* line_end (const char* p, const char* end)
+{
+    const char* eol = (const char*) memchr (p, '\n', end - p);
+    if (eol == 0)  { eol = end; }
+    if (eol > p && eol[-1] == '\r')  { eol--; }
+    return eol;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : find the first record starting at or after 'pos'
+** INPUT   :
+** OUTPUT  :
+** RETURN  : position of the record, 'size' if none
+** REMARKS : in FASTQ, a quality line may start with '@' too: such a line is
+**           a header only if the line two below starts with '+'
+*********************************************************************/
+static size_t next_record (const char* buffer, size_t size, size_t pos, bool fastq)
+{
+    const char* end = buffer + size;
+
+    if (fastq == false)
+    {
+        for (const char* p = buffer + pos; p < end; p++)
+        {
+            p = (const char*) memchr (p, '>', end - p);
+            if (p == 0)  { break; }
+            if (p == buffer || p[-1] == '\n')  { return p - buffer; }
+        }
+        return size;
+    }
+
+    /** We go to the beginning of a line. */
+    const char* line = pos > 0 ? next_line (buffer + pos - 1, end) : buffer;
+
+    while (line < end)
+    {
+        const char* l1 = next_line (line, end);
+        if (*line == '@')
+        {
+            const char* l2 = next_line (l1, end);
+            if (l2 < end && *l2 == '+')  { return line - buffer; }
+        }
+        line = l1;
+    }
+    return size;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : find the record following the one starting at 'pos'
+** INPUT   :
+** OUTPUT  :
+** RETURN  : position of the next record, 'size' if none
+** REMARKS : FASTQ records are expected to be made of 4 lines
+*********************************************************************/
+static size_t skip_record (const char* buffer, size_t size, size_t pos, bool fastq)
+{
+    if (fastq == false)  { return next_record (buffer, size, pos+1, false); }
+
+    const char* end  = buffer + size;
+    const char* next = buffer + pos;
+    for (size_t i=0; i<4; i++)  { next = next_line (next, end); }
+
+    if (next < end && *next != '@')  { return next_record (buffer, size, next - buffer, true); }
+    return next - buffer;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : parse the record buffer[begin,end) into 'seq'
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS : the sequence refers to the buffer, except for multi-line sequences
+*********************************************************************/
+static void parse_record (const char* begin, const char* end, bool fastq, BankFasta::Iterator::CommentMode_e mode, Sequence& seq, string& tmp)
+{
+    const char* header = begin + 1;
+    const char* line   = next_line (header, end);
+
+    if (mode == BankFasta::Iterator::FULL)
+    {
+        seq.setCommentRef (header, line_end (header, end) - header);
+    }
+    else if (mode == BankFasta::Iterator::IDONLY)
+    {
+        const char* p = header;
+        while (p < end && !isspace (*p))  { p++; }
+        seq.setCommentRef (header, p - header);
+    }
+
+    if (fastq)
+    {
+        const char* quality = next_line (next_line (line, end), end);
+
+        seq.getData().setRef ((char*)line, line_end (line, end) - line);
+        seq.setQualityRef (quality, line_end (quality, end) - quality);
+    }
+    /** Most of the time, the data is on a single line that can be referred to directly. */
+    else if (next_line (line, end) == end)
+    {
+        seq.getData().setRef ((char*)line, line_end (line, end) - line);
+    }
+    else
+    {
+        tmp.clear();
+        for (const char* p = line; p < end; p = next_line (p, end))  {  tmp.append (p, line_end (p, end) - p);  }
+        seq.getData().set ((char*)tmp.data(), tmp.size());
+    }
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : check the format of the beginning of a file
+** INPUT   :
+** OUTPUT  : fastq : true for FASTQ, false for FASTA
+** RETURN  : true if the records can be found from any place of the file, ie. FASTA,
+**           or FASTQ with 4 lines per record (checked on the first record)
+** REMARKS :
+*********************************************************************/
+static bool check_format (const char* start, size_t size, bool& fastq)
+{
+    const char* end = start + size;
+    const char* p   = start;
+    while (p < end && isspace (*p))  { p++; }
+
+    fastq = p < end && *p == '@';
+
+    if (p < end && *p == '>')  {  return true;  }
+
+    if (fastq)
+    {
+        const char* data    = next_line (p,       end);
+        const char* plus    = next_line (data,    end);
+        const char* quality = next_line (plus,    end);
+
+        return quality < end  &&  *plus == '+'  &&  (line_end (data, end) - data) == (line_end (quality, end) - quality);
+    }
+
+    return false;
+}
+
+/********************************************************************************/
+struct chunked_input_t
+{
+    chunked_input_t () : enabled(false), fastq(false), mapping(0), mappingSize(0), nbChunks(0), nextChunk(0),
+        stream(0), nbBlocks(0), eof(false), stop(false)
+    {
+        for (size_t i=0; i<CHUNK_RING; i++)  {  ringId[i] = 0;  ringCumul[i] = 0;  }
+    }
+
+    /** false if the input can't be split; the iteration is then serialized. */
+    bool enabled;
+    bool fastq;
+
+    /** Plain file: mapped in memory; chunk i is made of the records starting in [i*CHUNK_SIZE, (i+1)*CHUNK_SIZE) */
+    char*     mapping;
+    size_t    mappingSize;
+    u_int64_t nbChunks;
+    u_int64_t nextChunk;
+
+    /** BGZF file: mapped in memory too; chunk i is made of the records starting in the BGZF blocks
+     * [i*CHUNK_BGZF, (i+1)*CHUNK_BGZF), each thread inflating the blocks of its own chunk. */
+    std::vector<size_t> bgzf;  // offsets of the blocks, followed by the file size
+
+    /** Inflate the BGZF blocks [first,last) */
+    void inflateBgzf (z_stream& z, size_t first, size_t last, string& data)
+    {
+        for (size_t b=first; b<last; b++)  {  bgzf_inflate (z, (unsigned char*)mapping + bgzf[b], bgzf[b+1] - bgzf[b], data);  }
+    }
+
+    /** Other gzipped file: the decompression thread cuts the data into blocks ending at record boundaries. */
+    gzFile                  stream;
+    std::thread             decompressor;
+    std::mutex              mtx;
+    std::condition_variable notEmpty, notFull;
+    std::deque<string>      blocks;
+
+    /** Chunk data of each consumer (ie. vector given to getConcurrent) of a gzipped file. The sequences
+     * of a chunk refer to it, so it is kept until the consumer asks for its next chunk. */
+    std::map<const void*, string> chunks;
+
+    string& getChunkData (const void* consumer)
+    {
+        std::unique_lock<std::mutex> lock (mtx);
+        return chunks[consumer];
+    }
+    string                  carry;
+    u_int64_t               nbBlocks;
+    bool                    eof, stop;
+
+    /** Number of records up to the end of each chunk. Chunks publish it in order, so that
+     * each sequence gets the index it would have had in a serial iteration. */
+    volatile u_int64_t ringId    [CHUNK_RING];
+    volatile u_int64_t ringCumul [CHUNK_RING];
+
+    /** Get the next chunk to be parsed: the records starting in buffer[from,to) belong to it; the last one
+     * may extend up to buffer[size]. For a gzipped file, the chunk data is moved into 'data'.
+     * \return false if there is no more chunk */
+    bool getChunk (u_int64_t& id, const char*& buffer, size_t& size, size_t& from, size_t& to, string& data)
+    {
+        if (bgzf.empty() == false)
+        {
+            id = __sync_fetch_and_add (&nextChunk, 1);
+            if (id >= nbChunks)  { return false; }
+
+            size_t nbBgzf = bgzf.size() - 1;
+            size_t first  = id * CHUNK_BGZF;
+            size_t last   = std::min (first + CHUNK_BGZF, nbBgzf);
+
+            z_stream z;
+            memset (&z, 0, sizeof(z));
+            inflateInit2 (&z, -15);
+
+            /** We inflate the previous block too, in order to know whether the chunk begins with a new line. */
+            data.clear();
+            if (first > 0)  {  inflateBgzf (z, first-1, first, data);  }
+            from = data.size();
+            inflateBgzf (z, first, last, data);
+            to = data.size();
+
+            /** We inflate the next blocks until we find where the last record of the chunk ends.
+             * In FASTA, a record start doesn't depend on the following lines, so we don't need to look again at the data. */
+            for (size_t searched = to;  last < nbBgzf  &&  next_record (data.data(), data.size(), searched, fastq) == data.size();  last++)
+            {
+                if (fastq == false)  { searched = std::max (searched, data.size()); }
+                inflateBgzf (z, last, last+1, data);
+            }
+            inflateEnd (&z);
+
+            buffer = data.data();
+            size   = data.size();
+            return true;
+        }
+
+        if (mapping != 0)
+        {
+            id = __sync_fetch_and_add (&nextChunk, 1);
+            if (id >= nbChunks)  { return false; }
+
+            buffer = mapping;
+            size   = mappingSize;
+            from   = id * CHUNK_SIZE;
+            to     = std::min (from + CHUNK_SIZE, size);
+            return true;
+        }
+
+        std::unique_lock<std::mutex> lock (mtx);
+        notEmpty.wait (lock, [this] { return eof || !blocks.empty(); });
+        if (blocks.empty())  { return false; }
+
+        data.swap (blocks.front());
+        blocks.pop_front();
+        id = nbBlocks++;
+        lock.unlock();
+        notFull.notify_one();
+
+        buffer = data.data();
+        size   = to = data.size();
+        from   = 0;
+        return true;
+    }
+
+    /** Publish the number of records of a chunk, once the previous chunk did so.
+     * \return the index of the first record of the chunk */
+    u_int64_t publish (u_int64_t id, u_int64_t nb)
+    {
+        u_int64_t first = 0;
+        if (id > 0)
+        {
+            size_t previous = (id-1) % CHUNK_RING;
+            while (ringId[previous] != id)  {  std::this_thread::yield();  }
+            __sync_synchronize();
+            first = ringCumul[previous];
+        }
+        ringCumul[id % CHUNK_RING] = first + nb;
+        __sync_synchronize();
+        ringId[id % CHUNK_RING] = id + 1;
+        return first;
+    }
+
+    /** Main loop of the decompression thread. */
+    void decompress ()
+    {
+        string block;
+        block.swap (carry);
+
+        for (bool isEof = false; !isEof; )
+        {
+            /** We read until the block can be cut at a record starting after CHUNK_SIZE bytes. */
+            size_t cut = block.size();
+            for (size_t searched = CHUNK_SIZE; !isEof; )
+            {
+                if (block.size() > searched && (cut = next_record (block.data(), block.size(), searched, fastq)) < block.size())  { break; }
+                searched = std::max (searched, block.size());
+
+                size_t previous = block.size();
+                block.resize (previous + BUFFER_SIZE);
+                int nb = gzread (stream, &block[previous], BUFFER_SIZE);
+                block.resize (previous + std::max (nb, 0));
+                if (nb <= 0)  { isEof = true;  cut = block.size(); }
+            }
+
+            string next (block, cut);
+            block.resize (cut);
+
+            if (block.empty() == false)
+            {
+                std::unique_lock<std::mutex> lock (mtx);
+                notFull.wait (lock, [this] { return stop || blocks.size() < CHUNK_QUEUE; });
+                if (stop)  { return; }
+                blocks.push_back (string());
+                blocks.back().swap (block);
+                lock.unlock();
+                notEmpty.notify_one();
+            }
+            block.swap (next);
+        }
+
+        std::unique_lock<std::mutex> lock (mtx);
+        eof = true;
+        lock.unlock();
+        notEmpty.notify_all();
+    }
+};
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void BankFasta::Iterator::initChunks ()
+{
+    chunked_input_t* ci = new chunked_input_t;
+
+    const char* fname = _ref._filenames[0].c_str();
+
+    int fd = open (fname, O_RDONLY);
+    if (fd < 0)  {  delete ci;  throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, fname);  }
+
+    struct stat st;
+    if (fstat (fd, &st) == 0  &&  st.st_size > 0)
+    {
+        /** The mapping is writable (copy on write), since the iterated sequences refer to it. */
+        void* ptr = mmap (0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+        if (ptr != MAP_FAILED)
+        {
+            //chunks are mostly consumed in file order
+            madvise (ptr, st.st_size, MADV_SEQUENTIAL);
+
+            ci->mapping     = (char*) ptr;
+            ci->mappingSize = st.st_size;
+        }
+    }
+
+    //the mapping remains valid after the file descriptor is closed
+    close (fd);
+
+    const unsigned char* mapping = (const unsigned char*) ci->mapping;
+    bool compressed = ci->mappingSize >= 2  &&  mapping[0] == 0x1f  &&  mapping[1] == 0x8b;
+
+    const char* start = 0;
+    size_t      size  = 0;
+
+    if (compressed == false)
+    {
+        ci->nbChunks = (ci->mappingSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+        start = ci->mapping;
+        size  = ci->mappingSize;
+    }
+    else
+    {
+        /** We look for the BGZF blocks (the whole file must be made of them). */
+        for (size_t offset=0, blockSize=0;  offset < ci->mappingSize;  offset += blockSize)
+        {
+            blockSize = bgzf_block_size (mapping + offset, ci->mappingSize - offset);
+            if (blockSize == 0  ||  offset + blockSize > ci->mappingSize)  { ci->bgzf.clear();  break; }
+            ci->bgzf.push_back (offset);
+        }
+
+        if (ci->bgzf.empty() == false)
+        {
+            ci->bgzf.push_back (ci->mappingSize);
+            ci->nbChunks = (ci->bgzf.size() - 1 + CHUNK_BGZF - 1) / CHUNK_BGZF;
+        }
+        else
+        {
+            munmap (ci->mapping, ci->mappingSize);
+            ci->mapping     = 0;
+            ci->mappingSize = 0;
+        }
+    }
+
+    if (ci->bgzf.empty() == false)
+    {
+        /** We inflate the beginning of the file in order to check its format. */
+        z_stream z;
+        memset (&z, 0, sizeof(z));
+        inflateInit2 (&z, -15);
+        ci->inflateBgzf (z, 0, std::min ((size_t)CHUNK_BGZF, ci->bgzf.size() - 1), ci->carry);
+        inflateEnd (&z);
+
+        start = ci->carry.data();
+        size  = ci->carry.size();
+    }
+    else if (compressed  &&  (ci->stream = gzopen (fname, "r")) != 0)
+    {
+        /** We read the beginning of the file in order to check its format. */
+        ci->carry.resize (CHUNK_SIZE);
+        int nb = gzread (ci->stream, &ci->carry[0], CHUNK_SIZE);
+        ci->carry.resize (std::max (nb, 0));
+
+        start = ci->carry.data();
+        size  = ci->carry.size();
+    }
+
+    /** We check the format: FASTA, or FASTQ with 4 lines per record. */
+    ci->enabled = check_format (start, size, ci->fastq);
+
+    /** We launch the decompression thread. */
+    if (ci->enabled && ci->stream != 0)  {  ci->decompressor = std::thread (&chunked_input_t::decompress, ci);  }
+
+    /** BGZF blocks are inflated again by the threads that parse them. */
+    if (ci->bgzf.empty() == false)  {  string().swap (ci->carry);  }
+
+    __sync_synchronize();
+    chunked_input = ci;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void BankFasta::Iterator::finalizeChunks ()
+{
+    chunked_input_t* ci = (chunked_input_t*) chunked_input;
+    if (ci == 0)  { return; }
+
+    if (ci->decompressor.joinable())
+    {
+        std::unique_lock<std::mutex> lock (ci->mtx);
+        ci->stop = true;
+        lock.unlock();
+        ci->notFull.notify_all();
+        ci->decompressor.join();
+    }
+
+    if (ci->stream  != 0)  {  gzclose (ci->stream);  }
+    if (ci->mapping != 0)  {  munmap (ci->mapping, ci->mappingSize);  }
+
+    delete ci;
+    chunked_input = 0;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+bool BankFasta::Iterator::getConcurrent (std::vector<Sequence>& current, ISynchronizer& synchro)
+{
+    /** The first thread initializes the chunked input. */
+    if (chunked_input == 0)
+    {
+        LocalSynchronizer ls (&synchro);
+        if (chunked_input == 0)  { initChunks (); }
+    }
+
+    chunked_input_t* ci = (chunked_input_t*) chunked_input;
+
+    /** If the input can't be split, we iterate it in the default (serialized) way. */
+    if (ci->enabled == false)
+    {
+        LocalSynchronizer ls (&synchro);
+
+        /** 'get' fills several sequences at once, so they can't refer to the parsing buffers. */
+        bool zeroCopy = _zeroCopy;
+        _zeroCopy = false;
+        bool isRunning = get (current);
+        _zeroCopy = zeroCopy;
+        return isRunning;
+    }
+
+    u_int64_t   id;
+    const char* buffer;
+    size_t      size, from, to;
+    string      tmp;
+    string&     data = ci->getChunkData (&current);
+
+    if (ci->getChunk (id, buffer, size, from, to, data) == false)  {  current.clear();  return false;  }
+
+    /** We look for the records starting in the chunk; the last one may end after the chunk. */
+    vector<size_t> records;
+    size_t pos = next_record (buffer, size, from, ci->fastq);
+    while (pos < to)
+    {
+        records.push_back (pos);
+        pos = skip_record (buffer, size, pos, ci->fastq);
+    }
+    size_t nb = records.size();
+    records.push_back (pos);
+
+    /** Sequence objects can't be copied, so the vector must not be reallocated while not empty. */
+    if (nb > current.size())  {  current.clear();  }
+    current.resize (nb);
+
+    for (size_t i=0; i<nb; i++)
+    {
+        parse_record (buffer + records[i], buffer + records[i+1], ci->fastq, _commentsMode, current[i], tmp);
+    }
+
+    /** We set the indexes of the sequences. */
+    u_int64_t first = ci->publish (id, nb);
+    for (size_t i=0; i<nb; i++)  {  current[i].setIndex (first + i);  }
+
+    return true;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void BankFasta::Iterator::reset ()
+{
+    tools::dp::Iterator<Sequence>::reset ();
+
+    finalizeChunks ();
+}
+
+/********************************************************************************/
+// Estimation: the records of each file are measured in several windows evenly spaced in the file,
+// and extrapolated to the whole file; so huge files are estimated by reading a few MB only.
+
+#define SAMPLE_NB       32              // number of windows of a file
+#define SAMPLE_SIZE     (1024*1024)     // size of a window (compressed size for a BGZF file)
+#define BGZF_MAX_BLOCK  (64*1024)
+
+/** Measures of the records of a window. */
+struct sample_window_t
+{
+    sample_window_t () : nb(0), seq(0), span(0), max(0)  {}
+
+    u_int64_t nb;    // number of records starting in the window
+    u_int64_t seq;   // number of nucleotides in the window
+    u_int64_t span;  // number of bytes where 'nb' and 'seq' have been measured
+    u_int64_t max;   // size of the longest record starting in the window, whose end has been found
+};
+
+/** Estimation of the sequences information of a file. */
+struct sample_estimate_t
+{
+    sample_estimate_t () : number(0), totalSize(0), maxSize(0), error(0)  {}
+
+    u_int64_t number;
+    u_int64_t totalSize;
+    u_int64_t maxSize;
+    double    error;  // relative standard error on 'number': 0 if exact, negative if unknown
+};
+
+/** Size of the part of [begin,end) lying in [first,last). */
+static inline size_t overlap (const char* begin, const char* end, const char* first, const char* last)
+{
+    begin = std::max (begin, first);
+    end   = std::min (end,   last);
+    return end > begin ? end - begin : 0;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : measure the records of the window buffer[from,to)
+** INPUT   : buffer[0,from) is used for finding where the line or the record holding 'from' begins,
+**           buffer[to,size) for finding where the last records of the window end ; 'atEnd' tells
+**           whether the file ends at buffer[size]
+** OUTPUT  : w : measures of the window
+** RETURN  :
+** REMARKS : a line longer than SAMPLE_SIZE is supposed not to be a FASTA header
+*********************************************************************/
+static void sample_window (const char* buffer, size_t size, size_t from, size_t to, bool fastq, bool atEnd, sample_window_t& w)
+{
+    const char* end   = buffer + size;
+    const char* first = buffer + from;
+    const char* last  = buffer + to;
+
+    w = sample_window_t();
+
+    if (fastq)
+    {
+        /** We follow the records from the one holding 'from' (or the next one if it is too far). */
+        const char* record = buffer + next_record (buffer, size, from > SAMPLE_SIZE ? from - SAMPLE_SIZE : 0, true);
+
+        w.span = record < last ? last - std::max (record, first) : 0;
+
+        while (record < last)
+        {
+            const char* data = next_line (record, end);
+            const char* eol  = line_end  (data,   end);
+
+            w.seq += overlap (data, eol, first, last);
+
+            if (record >= first)
+            {
+                w.nb++;
+                if (eol < end || atEnd)  {  w.max = std::max (w.max, (u_int64_t) (eol - data));  }
+            }
+
+            record = buffer + skip_record (buffer, size, record - buffer, true);
+        }
+        return;
+    }
+
+    /** We look for the beginning of the line holding 'from'. */
+    const char* limit = from > SAMPLE_SIZE ? first - SAMPLE_SIZE : buffer;
+    const char* line  = first;
+    while (line > limit && line[-1] != '\n')  { line--; }
+
+    /** The line is a sequence one if it is too long for a header. */
+    bool isLong = line == limit  &&  limit != buffer;
+
+    const char* record = 0;   // record starting in the window whose size is being computed
+    u_int64_t   length = 0;
+
+    w.span = to - from;
+
+    for ( ; line < end; isLong = false)
+    {
+        const char* eol  = line_end  (line, end);
+        const char* next = next_line (line, end);
+
+        if (*line == '>' && isLong == false)
+        {
+            if (record != 0)  {  w.max = std::max (w.max, length);  record = 0;  }
+
+            if (line >= last)  { break; }
+
+            if (line >= first)  {  w.nb++;  record = line;  length = 0;  }
+        }
+        else
+        {
+            w.seq  += overlap (line, eol, first, last);
+            length += eol - line;
+        }
+
+        /** After the window, we only look for the end of its last record. */
+        if (next >= last && record == 0)  { break; }
+
+        line = next;
+    }
+
+    if (record != 0 && atEnd)  {  w.max = std::max (w.max, length);  }
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : extrapolate the measures of the windows to a whole file
+** INPUT   : size : size of the (uncompressed) file
+** OUTPUT  : e : estimation for the file
+** RETURN  :
+** REMARKS : the error is the one of a ratio estimator (records per byte), with finite population correction
+*********************************************************************/
+static void sample_extrapolate (const vector<sample_window_t>& windows, u_int64_t size, sample_estimate_t& e)
+{
+    double nb = 0, seq = 0, span = 0;
+    for (size_t i=0; i<windows.size(); i++)
+    {
+        nb   += windows[i].nb;
+        seq  += windows[i].seq;
+        span += windows[i].span;
+        e.maxSize = std::max (e.maxSize, windows[i].max);
+    }
+
+    if (span == 0)  {  e.error = -1;  return;  }
+
+    double ratio = nb / span;
+    e.number    = (u_int64_t) (ratio       * size + 0.5);
+    e.totalSize = (u_int64_t) (seq / span  * size + 0.5);
+
+    size_t N = windows.size();
+
+    /** The whole file has been measured. */
+    if (span >= size || nb == 0)  {  e.error = 0;  return;  }
+
+    if (N < 2)  {  e.error = -1;  return;  }
+
+    double sum2 = 0;
+    for (size_t i=0; i<N; i++)
+    {
+        double delta = windows[i].nb - ratio * windows[i].span;
+        sum2 += delta * delta;
+    }
+
+    double mean     = span / N;
+    double variance = (1 - span / size) * sum2 / (N * (N-1) * mean * mean);
+
+    e.error = std::sqrt (variance) / ratio;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : estimate a plain file from windows of SAMPLE_SIZE bytes
+** INPUT   : the file mapped in memory
+** OUTPUT  :
+** RETURN  : false if the format can't be sampled
+** REMARKS :
+*********************************************************************/
+static bool sample_plain (const char* mapping, size_t size, sample_estimate_t& e)
+{
+    bool fastq = false;
+    if (check_format (mapping, std::min (size, (size_t)SAMPLE_SIZE), fastq) == false)  { return false; }
+
+    /** A small file is read entirely. */
+    size_t nb  = size > (size_t)SAMPLE_NB * SAMPLE_SIZE ? SAMPLE_NB : 1;
+    size_t len = nb > 1 ? SAMPLE_SIZE : size;
+
+    vector<sample_window_t> windows (nb);
+    for (size_t i=0; i<nb; i++)
+    {
+        size_t from  = nb > 1 ? (u_int64_t)(size - len) * i / (nb - 1) : 0;
+        size_t limit = std::min (size, from + len + SAMPLE_SIZE);
+
+        sample_window (mapping, limit, from, from + len, fastq, limit == size, windows[i]);
+    }
+
+    sample_extrapolate (windows, size, e);
+    return true;
+}
+
+/** Offset of the first BGZF block starting at or after 'offset' ('size' if none). A block is recognized
+ * by its header, and by the header of the block following it. */
+static size_t bgzf_find_block (const unsigned char* mapping, size_t size, size_t offset)
+{
+    for (size_t o = offset;  o + 18 <= size;  o++)
+    {
+        const unsigned char* p = (const unsigned char*) memchr (mapping + o, 0x1f, size - o);
+        if (p == 0)  { break; }
+        o = p - mapping;
+
+        size_t blockSize = bgzf_block_size (p, size - o);
+        if (blockSize > 0  &&  o + blockSize <= size  &&
+            (o + blockSize == size  ||  bgzf_block_size (p + blockSize, size - o - blockSize) > 0))  { return o; }
+    }
+    return size;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : estimate a BGZF file from windows of SAMPLE_SIZE compressed bytes
+** INPUT   : the file mapped in memory
+** OUTPUT  :
+** RETURN  : false if the format can't be sampled
+** REMARKS : each window is made of the blocks starting in it; the uncompressed size of the file
+**           is known from its index, or extrapolated from the compression ratio of the windows
+*********************************************************************/
+static bool sample_bgzf (const string& filename, const unsigned char* mapping, size_t size, sample_estimate_t& e)
+{
+    size_t nb  = size > (size_t)SAMPLE_NB * SAMPLE_SIZE ? SAMPLE_NB : 1;
+    size_t len = nb > 1 ? SAMPLE_SIZE : size;
+
+    z_stream z;
+    memset (&z, 0, sizeof(z));
+    inflateInit2 (&z, -15);
+
+    bool fastq = false;
+    u_int64_t compressed = 0, uncompressed = 0;
+
+    vector<sample_window_t> windows (nb);
+    string data;
+
+    for (size_t i=0; i<nb; i++)
+    {
+        size_t from = nb > 1 ? (u_int64_t)(size - len) * i / (nb - 1) : 0;
+        size_t to   = from + len;
+
+        /** We find the first block of the window and the previous one (for knowing where the first line begins). */
+        size_t block    = bgzf_find_block (mapping, size, from > BGZF_MAX_BLOCK ? from - BGZF_MAX_BLOCK : 0);
+        size_t previous = size;
+        for (size_t blockSize = 1;  block < from  &&  blockSize > 0;  block += blockSize)
+        {
+            previous  = block;
+            blockSize = bgzf_block_size (mapping + block, size - block);
+        }
+        if (block < from || block > size)  {  inflateEnd (&z);  return false;  }
+
+        data.clear();
+        if (previous < size)  {  bgzf_inflate (z, mapping + previous, block - previous, data);  }
+        size_t begin = data.size();
+
+        /** We inflate the blocks starting in the window, then the following ones up to SAMPLE_SIZE bytes. */
+        size_t end = begin, blockSize = 0;
+        for ( ; block < size  &&  (block < to || data.size() < end + SAMPLE_SIZE);  block += blockSize)
+        {
+            blockSize = bgzf_block_size (mapping + block, size - block);
+            if (blockSize == 0 || block + blockSize > size)  {  inflateEnd (&z);  return false;  }
+
+            bgzf_inflate (z, mapping + block, blockSize, data);
+
+            if (block < to)  {  compressed += blockSize;  end = data.size();  }
+        }
+        uncompressed += end - begin;
+
+        if (i == 0  &&  check_format (data.data(), std::min (data.size(), (size_t)SAMPLE_SIZE), fastq) == false)  {  inflateEnd (&z);  return false;  }
+
+        sample_window (data.data(), data.size(), begin, end, fastq, block >= size, windows[i]);
+    }
+
+    inflateEnd (&z);
+
+    /** The uncompressed size of the file. */
+    u_int64_t total = uncompressed;
+    if (compressed < size  &&  bgzf_indexed_size (filename, total) == false)
+    {
+        total = compressed > 0 ? (u_int64_t) ((double)uncompressed * size / compressed) : 0;
+    }
+
+    sample_extrapolate (windows, total, e);
+    return true;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : estimate a gzipped file from its beginning
+** INPUT   : size : size of the compressed file
+** OUTPUT  :
+** RETURN  : false if the format can't be sampled
+** REMARKS : the members of a gzipped file can't be found from any place in it, so we extrapolate
+**           from the compressed size of the beginning that has been read.
+*********************************************************************/
+static bool sample_gzip (const string& filename, u_int64_t size, sample_estimate_t& e)
+{
+    gzFile stream = gzopen (filename.c_str(), "r");
+    if (stream == 0)  { return false; }
+
+    string data;
+    bool   atEnd = false;
+    while (atEnd == false  &&  data.size() < (size_t)SAMPLE_NB * SAMPLE_SIZE)
+    {
+        size_t previous = data.size();
+        data.resize (previous + BUFFER_SIZE);
+        int nb = gzread (stream, &data[previous], BUFFER_SIZE);
+        data.resize (previous + std::max (nb, 0));
+        if (nb <= 0)  { atEnd = true; }
+    }
+
+    /** Number of compressed bytes read so far. */
+    z_off_t consumed = gzoffset (stream);
+    gzclose (stream);
+
+    bool fastq = false;
+    if (check_format (data.data(), std::min (data.size(), (size_t)SAMPLE_SIZE), fastq) == false)  { return false; }
+
+    vector<sample_window_t> windows (1);
+    sample_window (data.data(), data.size(), 0, data.size(), fastq, atEnd, windows[0]);
+
+    u_int64_t total = data.size();
+    if (atEnd == false && consumed > 0)  {  total = (u_int64_t) ((double)data.size() * size / consumed);  }
+
+    sample_extrapolate (windows, total, e);
+    return true;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE : estimate the sequences information of one file
+** INPUT   :
+** OUTPUT  :
+** RETURN  : false if the file can't be sampled
+** REMARKS :
+*********************************************************************/
+static bool sample_file (const string& filename, sample_estimate_t& e)
+{
+    int fd = open (filename.c_str(), O_RDONLY);
+    if (fd < 0)  {  throw gatb::core::system::ExceptionErrno (STR_BANK_unable_open_file, filename.c_str());  }
+
+    struct stat st;
+    if (fstat (fd, &st) != 0)  {  close (fd);  return false;  }
+    if (st.st_size == 0)       {  close (fd);  return true;   }
+
+    void* ptr = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE | MAP_NORESERVE, fd, 0);
+    close (fd);
+    if (ptr == MAP_FAILED)  { return false; }
+
+    //only the windows are read
+    madvise (ptr, st.st_size, MADV_RANDOM);
+
+    const unsigned char* mapping = (const unsigned char*) ptr;
+    size_t size = st.st_size;
+
+    bool result;
+    if (size >= 2  &&  mapping[0] == 0x1f  &&  mapping[1] == 0x8b)
+    {
+        if (bgzf_block_size (mapping, size) > 0)  {  result = sample_bgzf (filename, mapping, size, e);  }
+        else                                      {  result = sample_gzip (filename, size, e);  }
+    }
+    else
+    {
+        result = sample_plain ((const char*) mapping, size, e);
+    }
+
+    munmap (ptr, st.st_size);
+    return result;
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS : the estimations of the files are independent, so their variances add up
+*********************************************************************/
+void BankFasta::estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize)
+{
+    number = totalSize = maxSize = 0;
+
+    double variance = 0;
+    bool   known    = true;
+
+    for (size_t i=0; i<nb_files; i++)
+    {
+        sample_estimate_t e;
+
+        if (sample_file (_filenames[i], e) == false)
+        {
+            /** The format can't be sampled (FASTQ with multi-line records for instance):
+             * we extrapolate from the first sequences of the bank. */
+            BankFasta::Iterator it (*this, Iterator::NONE);
+            it.estimate (number, totalSize, maxSize);
+            setEstimateError (-1);
+            return;
+        }
+
+        number    += e.number;
+        totalSize += e.totalSize;
+        maxSize    = std::max (maxSize, e.maxSize);
+
+        if (e.error < 0)  { known = false; }
+        variance += (e.error * e.number) * (e.error * e.number);
+    }
+
+    setEstimateError (known == false ? -1 : (number > 0 ? std::sqrt (variance) / number : 0));
+}
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -97,7 +97,14 @@ public:
     /** \copydoc IBank::getSize */
     u_int64_t getSize ()  { return filesizes; }
 
-    /** \copydoc IBank::estimate */
+    /** Give an estimation of sequences information in the bank. Each file is sampled at several
+     * evenly spaced places (the BGZF blocks of a BGZF file), so that huge files are estimated by reading
+     * a few MB only; other gzipped files are extrapolated from their beginning. Small files are read entirely,
+     * in which case the estimation is exact.
+     * \param[out] number : sequences number
+     * \param[out] totalSize : sequences size (in bytes)
+     * \param[out] maxSize : max size of the sampled sequences (in bytes)
+     */
     void estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize);
 
     static void setDataLineSize (size_t len) { _dataLineSize = len; }
@@ -148,8 +155,11 @@ public:
         /** Constructor.
          * \param[in] ref : the associated iterable instance.
          * \param[in] commentMode : kind of comments we want to retrieve
+         * \param[in] zeroCopy : if true, the data, comment and quality of the iterated sequence refer to the
+         * parsing buffers instead of being copied; they are then valid only until the next call to 'next'.
+         * Note that in this mode, several sequences can't be retrieved at once (see tools::dp::Iterator::get).
          */
-        Iterator (BankFasta& ref, CommentMode_e commentMode = FULL);
+        Iterator (BankFasta& ref, CommentMode_e commentMode = FULL, bool zeroCopy = false);
 
         /** Destructor */
         ~Iterator ();
@@ -166,6 +176,22 @@ public:
         /** \copydoc tools::dp::Iterator::item */
         Sequence& item ()     { return *_item; }
 
+        /** Retrieve some sequences for one of several threads sharing this iterator (see Dispatcher::iterate).
+         * The file is split into chunks ending at record boundaries, and each thread parses its own chunk
+         * without holding the synchronizer. Plain files are mapped in memory; the blocks of BGZF files are
+         * inflated by the threads parsing them; other gzipped files are decompressed by a dedicated thread.
+         * Sequences keep the same indexes as with the serial iteration.
+         * The data, comment and quality of the sequences refer to the chunk buffer (except for multi-line
+         * FASTA sequences); they are valid until the next call with the same vector.
+         * Multi-line FASTQ files are not split and are iterated in the default way.
+         * \param[in] current : vector to be filled with the sequences of one chunk
+         * \param[in] synchro : synchronizer shared by the threads using this iterator
+         * \return true if the iteration is not finished, false otherwise. */
+        bool getConcurrent (std::vector<Sequence>& current, system::ISynchronizer& synchro);
+
+        /** \copydoc tools::dp::Iterator::reset */
+        void reset ();
+
         /** Estimation of the sequences information */
         void estimate (u_int64_t& number, u_int64_t& totalSize, u_int64_t& maxSize);
 
@@ -177,6 +203,9 @@ public:
         /** Tells what kind of comments we want as a client of the iterator. */
         CommentMode_e  _commentsMode;
 
+        /** Tells whether the iterated sequence refers to the parsing buffers. */
+        bool _zeroCopy;
+
         /** Tells whether the iteration is finished or not. */
         bool _isDone;
 
@@ -204,6 +233,14 @@ public:
         bool get_next_seq_from_file (tools::misc::Vector<char>& data, std::string& comment, std::string& quality, int file_id, CommentMode_e mode);
 
         size_t _index;
+
+        void* chunked_input;   // chunked_input_t, used by getConcurrent
+
+        /** Initialization of the chunked input (done by the first thread calling getConcurrent). */
+        void initChunks ();
+
+        /** Release of the chunked input. */
+        void finalizeChunks ();
     };
 
 protected:
@@ -113,6 +113,9 @@ public:
     /** \copydoc AbstractBank::estimateSequencesSize */
     u_int64_t estimateSequencesSize ()  { return _ref->estimateSequencesSize(); }
 
+    /** \copydoc AbstractBank::getEstimateError */
+    double getEstimateError ()  { return _ref->getEstimateError(); }
+
     /** \copydoc AbstractBank::getEstimateThreshold */
     u_int64_t getEstimateThreshold ()  { return _ref->getEstimateThreshold(); }
 
@@ -108,6 +108,7 @@ public:
         number    = _sequences.size();
         totalSize = _totalSize;
         maxSize   = _maxSize;
+        setEstimateError (0);
     }
 
 protected:
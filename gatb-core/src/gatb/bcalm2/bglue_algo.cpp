@@ -106,94 +106,97 @@ void free_memory_vector(std::vector<T> &vec)
 }
 
 
-static 
-char rc /*cheap desambiguation compared to GraphUnitigs because TemplateSpecialization8 complains */(char s) {
-	if (s == 'A') return 'T';
-	else if (s == 'C') return 'G';
-	else if (s == 'G') return 'C';
-	else if (s == 'T') return 'A';
-	else if (s == 'a') return 't';
-	else if (s == 'c') return 'g';
-	else if (s == 'g') return 'c';
-	else if (s == 't') return 'a';
-	return 'X';
-}
-
+// manipulation of abundance vectors encoded as strings. recent addition (post-publication)
 
-static string rc(const string &s) {
-	string rcs = "";
-	for (signed int i = s.length() - 1; i >= 0; i--) {rcs += rc(((char)s[i]));}
-	return rcs;
+/* parses an abundance list, e.g. "3 4 5 ", appending the values to res (possibly in reverse order). 
+ * (was done with a stringstream, and reversing was quadratic. it was the bottleneck of glueing large unitigs) */
+static void parse_abundances(const string& list, vector<unsigned int>& res, bool reverse = false)
+{
+    size_t first = res.size();
+    const char* p = list.c_str();
+    while (true)
+    {
+        while (*p == ' ') p++;
+        if (*p < '0' || *p > '9')
+            break;
+        unsigned int a = 0;
+        while (*p >= '0' && *p <= '9')  { a = a * 10 + (*p - '0');  p++; }
+        res.push_back(a);
+    }
+    if (reverse)
+        std::reverse(res.begin() + first, res.end());
 }
 
-
-// manipulation of abundance vectors encoded as strings. recent addition (post-publication)
-
-static float get_mean_abundance(const string& list)
+static float get_mean_abundance(const vector<unsigned int>& list)
 {
     float mean_abundance=0;
-    int n=0;
-    std::stringstream stream(list);
-    while(1) {
-        int a;
-        stream >> a;
-        if(!stream)
-            break;
+    for (auto a : list)
         mean_abundance +=a;
-        n++;
-    }
-    return mean_abundance / (float)n;
+    return mean_abundance / (float)list.size();
 }
 
-static uint64_t get_sum_abundance(const string& list)
+static uint64_t get_sum_abundance(const vector<unsigned int>& list)
 {
     uint64_t sum_abundances=0;
-    std::stringstream stream(list);
-    while(1) {
-        int a;
-        stream >> a;
-        if(!stream)
-            break;
+    for (auto a : list)
         sum_abundances +=a;
-    }
     if (sum_abundances > 2000000000LL) std::cout << "warning, large abundance reached, may have printing problems" << std::endl; // maybe will disrupt optimizing the code of that function, but it's not that critical
     return sum_abundances;
 }
 
-
-static string reverse_abundances(const string& list)
+/* a partition's sequences, 2-bit packed in a flat buffer instead of one std::string per sequence.
+ * same encoding as Data::ASCII conversion in gatb (A=0, C=1, T=2, G=3), so that complement is xor 2 */
+class PackedSequences
 {
-    string rev="";
-    std::stringstream stream(list);
-    while(1) {
-        int a;
-        stream >> a;
-        if(!stream)
-            break;
-        rev = to_string(a) + " " + rev;
+    std::vector<uint64_t> data;   // 32 nucleotides per word
+    std::vector<uint64_t> starts; // position (in nucleotides) of each sequence, followed by the end of the last one
+
+    unsigned char at(uint64_t pos) const  {  return (data[pos >> 5] >> ((pos & 31) << 1)) & 3;  }
+
+public:
+    PackedSequences() : starts(1, 0) {}
+
+    void reserve(size_t nb_sequences, uint64_t nb_nucleotides)
+    {
+        starts.reserve(nb_sequences + 1);
+        data.reserve((nb_nucleotides + 31) / 32);
     }
-    return rev;
-}
 
-static string skip_first_abundance(const string& list)
-{
-    string res="";
-    std::stringstream stream(list);
-    bool skip = true;
-    while(1) {
-        int a;
-        stream >> a;
-        if(!stream)
-            break;
-        if (skip)
+    void push_back(const char* seq, size_t size)
+    {
+        uint64_t pos = starts.back();
+        data.resize((pos + size + 31) / 32, 0);
+        for (size_t i = 0; i < size; i++, pos++)
+            data[pos >> 5] |= (uint64_t)((seq[i] >> 1) & 3) << ((pos & 31) << 1);
+        starts.push_back(pos);
+    }
+
+    size_t size() const { return starts.size() - 1; }
+
+    size_t length(size_t i) const { return starts[i+1] - starts[i]; }
+
+    uint64_t nb_nucleotides() const { return starts.back(); }
+
+    /* appends the nucleotides [from, to) of the i-th sequence to res, or of its reverse complement */
+    void append(size_t i, bool revcomp, size_t from, size_t to, string& res) const
+    {
+        static const char nt[4] = {'A', 'C', 'T', 'G'};
+        size_t old_size = res.size();
+        res.resize(old_size + to - from);
+        char* out = &res[old_size];
+        if (revcomp)
+        {
+            uint64_t last = starts[i+1] - 1;
+            for (size_t p = from; p < to; p++)
+                *out++ = nt[at(last - p) ^ 2];
+        }
+        else
         {
-            skip = false;
-            continue;
+            for (size_t p = from; p < to; p++)
+                *out++ = nt[at(starts[i] + p)];
         }
-        res += to_string(a) + " ";
     }
-    return res;
-}
+};
 
 
 template<int SPAN>
@@ -384,44 +387,44 @@ static void determine_order_sequences(vector<vector<uint32_t>> &res, const vecto
 /* straightforward glueing of a chain
  * sequences should be ordered and in the right orientation
  * so, it' just a matter of chopping of the first kmer
+ * (sequences are decoded, and reverse-complemented if needed, directly into res_seq)
  */
-static void glue_sequences(vector<uint32_t> &chain, std::vector<std::string> &sequences, std::vector<std::string> &abundances, int kmerSize, string &res_seq, string &res_abundances)
+static void glue_sequences(vector<uint32_t> &chain, const PackedSequences &sequences, std::vector<std::string> &abundances, int kmerSize, string &res_seq, vector<unsigned int> &res_abundances)
 {
     bool debug=false;
 
-    string previous_kmer = "";
     unsigned int k = kmerSize;
+    vector<unsigned int> abs;
     
     if (debug) std::cout << "glueing new chain: ";
     for (auto it = chain.begin(); it != chain.end(); it++)
     {
         uint32_t idx = *it;
+        uint32_t i = no_rev_index(idx);
+        bool rev = is_rev_index(idx);
+        size_t length = sequences.length(i);
 
-        string seq = sequences[no_rev_index(idx)];
-        string abs = abundances[no_rev_index(idx)];
+        abs.clear();
+        parse_abundances(abundances[i], abs, rev);
 
-        if (is_rev_index(idx))
-        {
-            seq = rc(seq);
-            abs = reverse_abundances(abs);
-        }
-        
-        if (previous_kmer.size() == 0) // it's the first element in a chain
+        if (it == chain.begin()) // it's the first element in a chain
         {
-            res_seq += seq;
-            res_abundances += abs;
+            sequences.append(i, rev, 0, length, res_seq);
+            res_abundances.insert(res_abundances.end(), abs.begin(), abs.end());
         }
         else
         {
-            assert(seq.substr(0, k).compare(previous_kmer) == 0);
-            res_seq += seq.substr(k);
-            res_abundances += skip_first_abundance(abs);
+#ifndef NDEBUG
+            string kmer;
+            sequences.append(i, rev, 0, k, kmer);
+            assert(res_seq.compare(res_seq.size() - k, k, kmer) == 0);
+#endif
+            sequences.append(i, rev, k, length, res_seq);
+            if (abs.size() > 0)
+                res_abundances.insert(res_abundances.end(), abs.begin() + 1, abs.end());
         }
     
-        if (debug) std::cout << seq << " ";
-
-        previous_kmer = seq.substr(seq.size() - k);
-        assert(previous_kmer.size() == k);
+        if (debug) std::cout << res_seq << " ";
     }
      if (debug) std::cout << std::endl;
 }
@@ -433,6 +436,19 @@ static void output(const string &seq, gatb::core::debruijn::impl::BufferedFasta
     // BufferedFasta takes care of the flush
 }
 
+static void output(const string &seq, gatb::core::debruijn::impl::PipelinedFasta &out, const string comment = "")
+{
+    out.insert(seq, comment);
+    // PipelinedFasta hands full buffers to its writer thread
+}
+
+/* throughput since 'start', for logging each pass */
+static string throughput(uint64_t nb, const string& unit, chrono::system_clock::time_point start)
+{
+    double seconds = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now() - start).count() / 1000000.0;
+    return to_string_with_precision(nb / std::max(seconds, 0.000001) / 1000000.0) + " M" + unit + "/s";
+}
+
 
 
  // used to get top N elements of a vector
@@ -474,6 +490,7 @@ typedef uint64_t partition_t;
 template <int SPAN>
 void prepare_uf(std::string prefix, IBank *in, const int nb_threads, int& kmerSize, int pass, int nb_passes, uint64_t &nb_elts, uint64_t estimated_nb_glue_sequences)
 {
+    auto start_pass_t=chrono::system_clock::now();
   
     std::atomic<unsigned long> nb_marked_extremities, nb_unmarked_extremities; 
     nb_marked_extremities = 0; nb_unmarked_extremities = 0;
@@ -648,6 +665,7 @@ void prepare_uf(std::string prefix, IBank *in, const int nb_threads, int& kmerSi
     free_memory_vector(uf_hashes_vectors);
 
     logging("pass " + to_string(pass+1) + "/" + to_string(nb_passes) + ", " + std::to_string(nb_elts_pass) + " unique hashes written to disk, size " + to_string(nb_elts_pass* sizeof(partition_t) / 1024/1024) + " MB");
+    logging("pass " + to_string(pass+1) + "/" + to_string(nb_passes) + " throughput: " + throughput(estimated_nb_glue_sequences, " sequences", start_pass_t));
 
     nb_elts += nb_elts_pass;
 }
@@ -820,6 +838,7 @@ void bglue(Storage *storage,
     };
 
     //setDispatcher (new SerialDispatcher()); // force single thread
+    auto start_uf_t=chrono::system_clock::now();
     Dispatcher dispatcher (nb_threads);
     dispatcher.iterate (in->iterator(), createUF);
 
@@ -832,7 +851,7 @@ void bglue(Storage *storage,
 #endif
 
 
-    logging("UF constructed");
+    logging("UF constructed, throughput: " + throughput(nb_glue_sequences, " sequences", start_uf_t));
 
     if (debug_uf_stats) // for debugging
     {
@@ -873,12 +892,10 @@ void bglue(Storage *storage,
   
     // setup output file
     string output_prefix = prefix;
-    std::atomic<unsigned long> out_id; // identified for output sequences
-    out_id = 0;
-    BufferedFasta out (output_prefix, 100000);
+    PipelinedFasta out (output_prefix); // written by a background thread, which sets the ids of the output sequences
 
     auto get_UFclass = [&modelCanon, &ufkmers_vector, &hasher, &uf_mphf]
-        (const string &kmerBegin, const string &kmerEnd,
+        (const char* kmerBegin, const char* kmerEnd,
          bool lmark, bool rmark,
          typename ModelCanon::Kmer &kmmerBegin, typename ModelCanon::Kmer &kmmerEnd,  // those will be populated based on lmark and rmark
          bool &found_class)
@@ -888,14 +905,14 @@ void bglue(Storage *storage,
 
             if (lmark)
             {
-                kmmerBegin = modelCanon.codeSeed(kmerBegin.c_str(), Data::ASCII);
+                kmmerBegin = modelCanon.codeSeed(kmerBegin, Data::ASCII);
                 found_class = true;
                 ufclass = ufkmers_vector[uf_mphf.lookup(hasher(kmmerBegin))];
             }
 
             if (rmark)
             {
-                kmmerEnd = modelCanon.codeSeed(kmerEnd.c_str(), Data::ASCII);
+                kmmerEnd = modelCanon.codeSeed(kmerEnd, Data::ASCII);
 
                 if (found_class) // just do a small check
                 {
@@ -933,7 +950,7 @@ void bglue(Storage *storage,
     // partition the glue into many files, à la dsk
     auto partitionGlue = [k, &modelCanon /* crashes if copied!*/, \
         &get_UFclass, &gluePartitions,
-        &out, &outLock, &nb_seqs_in_partition, &out_id, nbGluePartitions]
+        &out, &outLock, &nb_seqs_in_partition, nbGluePartitions]
             (const Sequence& sequence)
     {
         const string &seq = sequence.toString();
@@ -942,8 +959,8 @@ void bglue(Storage *storage,
         bool lmark = comment[0] == '1';
         bool rmark = comment[1] == '1';
 
-        const string kmerBegin = seq.substr(0, k );
-        const string kmerEnd = seq.substr(seq.size() - k , k );
+        const char* kmerBegin = seq.c_str();
+        const char* kmerEnd = seq.c_str() + seq.size() - k;
 
         // make canonical kmer
         typename ModelCanon::Kmer kmmerBegin;
@@ -955,10 +972,11 @@ void bglue(Storage *storage,
 
         if (!found_class) // this one doesn't need to be glued
         {
-            const string abundances = comment.substr(3);
+            vector<unsigned int> abundances;
+            parse_abundances(comment.substr(3), abundances);
             float mean_abundance = get_mean_abundance(abundances);
             uint32_t sum_abundances = get_sum_abundance(abundances);
-            output(seq, out, std::to_string(out_id++) + " LN:i:" + to_string(seq.size()) + " KC:i:" + to_string(sum_abundances) + " KM:f:" + to_string_with_precision(mean_abundance)); 
+            output(seq, out, "LN:i:" + to_string(seq.size()) + " KC:i:" + to_string(sum_abundances) + " KM:f:" + to_string_with_precision(mean_abundance)); 
             // maybe could optimize by writing to disk using queues, if that's ever a bottleneck
             return;
         }
@@ -972,6 +990,7 @@ void bglue(Storage *storage,
     };
 
     logging("Disk partitioning of glue");
+    auto start_partitioning_t=chrono::system_clock::now();
     dispatcher.iterate (in->iterator(), partitionGlue); // multi-threaded
     /*// single-threaded version
      auto it = in->iterator();    
@@ -982,10 +1001,13 @@ void bglue(Storage *storage,
     for (int i = 0; i < nbGluePartitions; i++)
         delete gluePartitions[i]; // takes care of the final flush (this doesn't delete the file, just closes it)
     free_memory_vector(gluePartitions);
-    out.flush();
+    out.flush(); // the unitigs that need no glueing come before the glued ones
 
+    uint64_t nb_partitioned_bytes = 0;
+    for (int i = 0; i < nbGluePartitions; i++)
+        nb_partitioned_bytes += System::file().getSize(gluePartition_prefix + std::to_string(i));
 
-    logging("Done disk partitioning of glue");
+    logging("Done disk partitioning of glue, throughput: " + throughput(nb_glue_sequences, " sequences", start_partitioning_t) + ", " + throughput(nb_partitioned_bytes, "B written", start_partitioning_t));
 
     // get top10 largest glue partitions
     int top_n_glue_partition = std::min(10,nbGluePartitions);
@@ -1007,13 +1029,15 @@ void bglue(Storage *storage,
     }
 
     logging("Glueing partitions");
+    auto start_glue_t=chrono::system_clock::now();
+    std::atomic<uint64_t> nb_glued_nucleotides(0);
 
     // glue all partitions using a thread pool
     ThreadPool pool(nb_threads);
     for (int partition = 0; partition < nbGluePartitions; partition++)
     {
         auto glue_partition = [&modelCanon, &ufkmers, partition, &gluePartition_prefix, nbGluePartitions, &copy_nb_seqs_in_partition,
-        &get_UFclass, &out, &outLock, &out_id, kmerSize]( int thread_id)
+        &get_UFclass, &out, &outLock, &nb_glued_nucleotides, kmerSize]( int thread_id)
         {
             int k = kmerSize;
 
@@ -1032,20 +1056,26 @@ void bglue(Storage *storage,
             unordered_map<int, vector< markedSeq<SPAN> >> msInPart;
             uint64_t seq_index = 0;
 
+            // the partition is read only once: sequences are kept 2-bit packed, along with their comments (for abundances)
+            PackedSequences sequences;
+            vector<string> abundances;
+            sequences.reserve(copy_nb_seqs_in_partition[partition], System::file().getSize(partitionFile));
+            abundances.reserve(copy_nb_seqs_in_partition[partition]);
+
             for (it.first(); !it.isDone(); it.next()) // BankFasta
             {
-                const string seq = it->toString();
-                const string comment = it->getComment();
+                const char* seq = it->getDataBuffer();
+                size_t seq_size = it->getDataSize();
+                const string& comment = it->getComment();
 
-                const string kmerBegin = seq.substr(0, k );
-                const string kmerEnd = seq.substr(seq.size() - k , k );
+                const char* kmerBegin = seq;
+                const char* kmerEnd = seq + seq_size - k;
 
                 uint32_t ufclass = 0;
                 bool found_class = false;
 
                 bool lmark = comment[0] == '1';
                 bool rmark = comment[1] == '1';
-                const string abundances = comment.substr(3);
 
                 // todo speed improvement: get partition id from sequence header (so, save it previously)
 
@@ -1056,15 +1086,18 @@ void bglue(Storage *storage,
 
                 // compute kmer extremities if we have not already
                 if (!lmark)
-                    kmmerBegin = modelCanon.codeSeed(kmerBegin.c_str(), Data::ASCII);
+                    kmmerBegin = modelCanon.codeSeed(kmerBegin, Data::ASCII);
                 if (!rmark)
-                    kmmerEnd = modelCanon.codeSeed(kmerEnd.c_str(), Data::ASCII);
+                    kmmerEnd = modelCanon.codeSeed(kmerEnd, Data::ASCII);
 
                 markedSeq<SPAN> ms(seq_index, lmark, rmark, kmmerBegin.value(), kmmerEnd.value());
 
                 //if (ufclass == 38145) std::cout << " ufclass " << ufclass << " seq " << seq << " seq index " << seq_index << " " << lmark << rmark << " ks " << kmmerBegin.value() << " ke " << kmmerEnd.value() << std::endl; // debug specific partition
                 msInPart[ufclass].push_back(ms);
                 seq_index++;
+
+                sequences.push_back(seq, seq_size);
+                abundances.push_back(comment);
             }
 
             // now iterates all sequences in a partition to determine the order in which they're going to be glues (avoid intermediate gluing)
@@ -1080,29 +1113,25 @@ void bglue(Storage *storage,
 
             msInPart.clear();
             unordered_map<int,vector<markedSeq<SPAN>>>().swap(msInPart); // free msInPart
-            
-            vector<string> sequences;
-            vector<string> abundances;
-            sequences.reserve(copy_nb_seqs_in_partition[partition]);
-            abundances.reserve(copy_nb_seqs_in_partition[partition]);
-            
-            for (it.first(); !it.isDone(); it.next()) // BankFasta
-            {
-                const string seq = it->toString();
-                const string comment = it->getComment();
-                sequences.push_back(seq);
-                abundances.push_back(comment);
-            }
 
+            // glued sequences are formatted into a local block, handed to the writer thread once large enough
+            string block;
+            string seq;
+            vector<unsigned int> abs;
             for (auto itO = ordered_sequences_idxs.begin(); itO != ordered_sequences_idxs.end(); itO++)
             {
-                string seq, abs;
+                seq.clear(); abs.clear();
                 glue_sequences(*itO, sequences, abundances, kmerSize, seq, abs); // takes as input the indices of ordered sequences, and the markedSeq's themselves
 
                 float mean_abundance = get_mean_abundance(abs);
                 uint32_t sum_abundances = get_sum_abundance(abs);
-                output(seq, out, std::to_string(out_id++) + " LN:i:" + to_string(seq.size()) + " KC:i:" + to_string(sum_abundances) + " KM:f:" + to_string_with_precision(mean_abundance)); 
+                PipelinedFasta::format(block, seq, "LN:i:" + to_string(seq.size()) + " KC:i:" + to_string(sum_abundances) + " KM:f:" + to_string_with_precision(mean_abundance));
+                if (block.size() >= out.max_buffer)
+                    out.push(block);
             }
+            if (block.size() > 0)
+                out.push(block);
+            nb_glued_nucleotides += sequences.nb_nucleotides();
                 
             free_memory_vector(ordered_sequences_idxs);
 
@@ -1117,8 +1146,10 @@ void bglue(Storage *storage,
     }
 
     pool.join();
-   
-   out.flush(); // not sure if necessary
+
+    out.close(); // waits for the writer thread
+
+    logging("Done glueing partitions, throughput: " + throughput(nb_glued_nucleotides, " nt", start_glue_t) + ", " + throughput(out.nb_bytes_written, "B written", start_glue_t));
 
     logging("end");
 
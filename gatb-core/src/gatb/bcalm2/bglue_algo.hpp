@@ -29,6 +29,9 @@
 #include <vector>
 #include <string>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <queue>
 #include <gatb/tools/storage/impl/Storage.hpp>
 
 namespace gatb { namespace core { namespace debruijn { namespace impl  {
@@ -88,6 +91,140 @@ class BufferedFasta
         }
 };
 
+// same output as BufferedFasta, but the writes to disk are done by a background thread,
+// so threads that produce sequences never wait on the disk.
+// producers either insert() records one by one (buffered under a lock), or push() whole blocks of records they formatted themselves
+class PipelinedFasta
+{
+        std::mutex mtx;
+        std::condition_variable not_empty, not_full;
+        std::queue<std::string> blocks;
+        std::string buffer;
+        FILE* _insertHandle;
+        std::thread writer;
+        bool finished;
+        unsigned long nb_records;
+
+        /* records are numbered here, in the order of the file, since the position of a unitig is its id
+         * (in link_tigs and GraphUnitigs), whichever thread formatted it */
+        void write_block(const std::string &block)
+        {
+            std::string id;
+            size_t pos = 0;
+            while (pos < block.size())
+            {
+                size_t end = block.find('\n', block.find('\n', pos) + 1) + 1; // a header line, then a sequence line
+                id = ">" + std::to_string(nb_records++) + " ";
+                if (fwrite (id.data(), 1, id.size(), _insertHandle) != id.size() ||
+                    fwrite (block.data() + pos + 1, 1, end - pos - 1, _insertHandle) != end - pos - 1)
+                    {  std::cout << "couldn't write " << block.size() << " bytes to output fasta" << std::endl; exit(1);  }
+                nb_bytes_written += id.size() + end - pos - 1;
+                pos = end;
+            }
+        }
+
+        void write_blocks()
+        {
+            while (true)
+            {
+                std::string block;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    not_empty.wait(lock, [this] { return finished || !blocks.empty(); });
+                    if (blocks.empty())
+                        return;
+                    block.swap(blocks.front());
+                    blocks.pop();
+                }
+                not_full.notify_all();
+
+                write_block(block);
+            }
+        }
+
+    public:
+        unsigned long max_buffer;
+        size_t max_blocks; // blocks waiting to be written; producers wait beyond that, to bound memory
+        std::atomic<unsigned long> nb_bytes_written;
+
+        PipelinedFasta(const std::string filename, unsigned long given_max_buffer = 1000000, size_t given_max_blocks = 16) : finished(false), nb_records(0), max_buffer(given_max_buffer), max_blocks(given_max_blocks)
+        {
+            nb_bytes_written = 0;
+            _insertHandle = fopen (filename.c_str(), "w");
+            if (!_insertHandle) { std::cout << "error opening " << filename << " for writing." << std::endl; exit(1);}
+            buffer.reserve(max_buffer+1000/*security*/);
+            writer = std::thread(&PipelinedFasta::write_blocks, this);
+        }
+
+        ~PipelinedFasta()
+        {
+            close();
+        }
+
+        /* the comment doesn't hold the id of the sequence, which is set when the record is written */
+        static void format(std::string &block, const std::string &seq, const std::string &comment)
+        {
+            block += ">";  block += comment;  block += "\n";
+            block += seq;  block += "\n";
+        }
+
+        void insert(const std::string &seq, const std::string &comment)
+        {
+            std::string full;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                format(buffer, seq, comment);
+                if (buffer.size() < max_buffer)
+                    return;
+                full.swap(buffer);
+                buffer.reserve(max_buffer+1000);
+            }
+            push(full);
+        }
+
+        /* hands a block of formatted records to the writer thread; block is emptied */
+        void push(std::string &block)
+        {
+            if (block.empty())
+                return;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                not_full.wait(lock, [this] { return blocks.size() < max_blocks; });
+                blocks.push(std::string());
+                blocks.back().swap(block);
+            }
+            not_empty.notify_one();
+        }
+
+        /* hands the records inserted so far to the writer thread, so that they're written before the blocks pushed next */
+        void flush()
+        {
+            std::string full;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                full.swap(buffer);
+                buffer.reserve(max_buffer+1000);
+            }
+            push(full);
+        }
+
+        /* writes the remaining records and waits for the writer thread to finish */
+        void close()
+        {
+            if (!_insertHandle)
+                return;
+            push(buffer);
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                finished = true;
+            }
+            not_empty.notify_one();
+            writer.join();
+            fclose(_insertHandle);
+            _insertHandle = 0;
+        }
+};
+
 // not using BankFasta because I suspect that it does some funky memory fragmentation. so this one is unbuffered
 class UnbufferedFastaIterator 
 {
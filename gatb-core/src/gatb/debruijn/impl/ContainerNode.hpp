@@ -30,6 +30,7 @@
 
 #include <gatb/debruijn/api/IContainerNode.hpp>
 #include <cstdarg>
+#include <algorithm>
 
 /********************************************************************************/
 namespace gatb      {
@@ -73,6 +74,13 @@ public:
     /** \copydoc IContainerNode::contains */
     bool contains (const Item& item)  {  return (_bloom->contains(item) && !_falsePositives->contains(item));  }
 
+    /** \copydoc Container::containsBatch */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        _bloom->containsBatch (items, nb, result);
+        for (size_t i=0; i<nb; i++)  {  if (result[i])  {  result[i] = !_falsePositives->contains(items[i]);  }  }
+    }
+
 protected:
 
     tools::collections::Container<Item>* _bloom;
@@ -99,6 +107,9 @@ public:
 
     /** \copydoc IContainerNode::contains */
     bool contains (const Item& item)  {  return (this->_bloom)->contains(item);  }
+
+    /** \copydoc Container::containsBatch */
+    void containsBatch (const Item* items, size_t nb, bool* result)  {  (this->_bloom)->containsBatch (items, nb, result);  }
 };
 
 /********************************************************************************/
@@ -150,6 +161,32 @@ public:
     /** \copydoc IContainerNode::contains */
     bool contains (const Item& item)  {  return (_bloom->contains(item) && ! containsCFP(item));  }
 
+    /** \copydoc Container::containsBatch
+     * The items found in the first Bloom filter are then asked in one batch to the second one. */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        _bloom->containsBatch (items, nb, result);
+
+        for (size_t start=0; start<nb; start+=BATCH_SIZE)
+        {
+            size_t n = std::min (nb-start, BATCH_SIZE);
+
+            Item   candidates[BATCH_SIZE];
+            size_t indexes   [BATCH_SIZE];
+            bool   inBloom2  [BATCH_SIZE];
+            size_t nbCandidates = 0;
+
+            for (size_t i=start; i<start+n; i++)  {  if (result[i])  {  indexes[nbCandidates] = i;  candidates[nbCandidates++] = items[i];  }  }
+
+            _bloom2->containsBatch (candidates, nbCandidates, inBloom2);
+
+            for (size_t i=0; i<nbCandidates; i++)
+            {
+                if (inBloom2[i])  {  result[indexes[i]] = ! containsCFP (candidates[i], true);  }
+            }
+        }
+    }
+
 private:
 
     tools::collections::Container<Item>* _bloom;
@@ -169,10 +206,15 @@ private:
 
     std::vector<tools::collections::Container<Item>*> _cfpArray;
 
-    /** */
-    bool containsCFP (const Item& item)
+    /** Number of items asked at once to the second Bloom filter by containsBatch. */
+    static const size_t BATCH_SIZE = 16;
+
+    /** Tells whether an item is a critical false positive.
+     * \param[in] item : the item to test
+     * \param[in] inBloom2 : true if the item is already known to be in the second Bloom filter */
+    bool containsCFP (const Item& item, bool inBloom2 = false)
     {
-        if (_bloom2->contains(item))
+        if (inBloom2 || _bloom2->contains(item))
         {
             if (!_bloom3->contains(item))
                 return true;
@@ -230,6 +230,7 @@ void configure_visitor<Node,Edge,GraphDataVariant>::operator() (GraphData<span>&
         data.setAbundance (mphf_algo.getAbundanceMap());
         data.setNodeState (mphf_algo.getNodeStateMap());
         data.setAdjacency (mphf_algo.getAdjacencyMap());
+        data.setNodeRecord(mphf_algo.getNodeRecordMap());
     }
 }
 
@@ -364,6 +365,12 @@ void build_visitor_solid<Node,Edge,GraphDataVariant>::operator() (GraphData<span
 
     ConfigurationAlgorithm<span> configAlgo (bank, props);
     configAlgo.getInput()->add (0, STR_STORAGE_TYPE, std::to_string(graph._storageMode) );
+
+    /** A Bloom filter filled during the counting is charged to the counting memory. */
+    bool bloomCount = graph._bloomKind != BLOOM_NONE && props->get(STR_BLOOM_COUNT) && props->getInt(STR_BLOOM_COUNT) != 0;
+    float bloomBits = bloomCount ? DebloomAlgorithm<span>::getNbBitsPerKmer (kmerSize, graph._debloomKind) : 0;
+    if (bloomCount)  {  configAlgo.getInput()->add (0, STR_BLOOM_COUNT_BITS, Stringify::format ("%f", bloomBits));  }
+
     graph.executeAlgorithm (configAlgo, & graph.getStorage(), props, graph._info);
     Configuration config = configAlgo.getConfiguration();
     graph.setState(GraphTemplate<Node, Edge, GraphDataVariant>::STATE_CONFIGURATION_DONE);
@@ -395,18 +402,32 @@ void build_visitor_solid<Node,Edge,GraphDataVariant>::operator() (GraphData<span
     /************************************************************/
     DEBUG ((cout << "build_visitor : SortingCountAlgorithm BEGIN\n"));
 
+    /** We may fill the Bloom filter while counting; the Bloom step will then have nothing left to do. */
+    ICountProcessor<span>* bloomProcessor = 0;
+    if (bloomCount)
+    {
+        bloomProcessor = new CountProcessorBloom<span> (
+                mainStorage->getGroup("bloom"),
+                kmerSize,
+                bloomBits,
+                graph._bloomKind
+                );
+    }
+
     /** We create a DSK instance and execute it. */
     SortingCountAlgorithm<span> sortingCount (
             bank,
             config,
             new Repartitor(minimizersGroup),
-            SortingCountAlgorithm<span>::getDefaultProcessorVector (config, props, solidStorage, mainStorage),
+            SortingCountAlgorithm<span>::getDefaultProcessorVector (config, props, solidStorage, mainStorage, bloomProcessor),
             props
             );
 
     graph.executeAlgorithm (sortingCount, solidStorage, props, graph._info);
     graph.setState(GraphTemplate<Node, Edge, GraphDataVariant>::STATE_SORTING_COUNT_DONE);
 
+    if (bloomProcessor != 0)  {  graph.setState(GraphTemplate<Node, Edge, GraphDataVariant>::STATE_BLOOM_DONE);  }
+
     Partition<Count>* solidCounts = & dskGroup.getPartition<Count> ("solid");
 
     /** We configure the variant. */
@@ -487,13 +508,14 @@ void build_visitor_postsolid<Node,Edge,GraphDataVariant>::operator() (GraphData<
                 solidKmers,
                 props->get(STR_NB_CORES)   ? props->getInt(STR_NB_CORES)   : 0, 
                 // TODO enhancement: also pass the MAX_MEMORY parameter to enable or disable fast mode depending on it
-                true  /* build=true, load=false */
-
+                true,  /* build=true, load=false */
+                props
                 );
         graph.executeAlgorithm (mphf_algo, & graph.getStorage(), props, graph._info);
         data.setAbundance(mphf_algo.getAbundanceMap());
         data.setNodeState(mphf_algo.getNodeStateMap());
         data.setAdjacency(mphf_algo.getAdjacencyMap());
+        data.setNodeRecord(mphf_algo.getNodeRecordMap());
         graph.setState(GraphTemplate<Node, Edge, GraphDataVariant>::STATE_MPHF_DONE);
 
         DEBUG ((cout << "build_visitor : MPHFAlgorithm END\n"));
@@ -641,6 +663,7 @@ IOptionsParser* GraphTemplate<Node, Edge, GraphDataVariant>::getOptionsParser (b
     /** We add children parser to it (kmer count, bloom/debloom, branching). */
     parser->push_back (SortingCountAlgorithm<>::getOptionsParser(includeMandatory));
     parser->push_back (DebloomAlgorithm<>::getOptionsParser());
+    parser->push_back (MPHFAlgorithm<>::getOptionsParser());
     parser->push_back (BranchingAlgorithm<>::getOptionsParser());
 
     /** We create a "general options" parser. */
@@ -1129,6 +1152,65 @@ size_t GraphTemplate<Node, Edge, GraphDataVariant>::degree (Node& node, Directio
 template<typename Node, typename Edge, typename GraphDataVariant>
 void GraphTemplate<Node, Edge, GraphDataVariant>::degree (Node& node, size_t &in, size_t &out) const  {  countNeighbors(node, in, out);  } 
 
+/*********************************************************************
+** METHOD  :
+** PURPOSE : computes the canonical forms of the successors (DIR_OUTCOMING) then of the predecessors
+**           (DIR_INCOMING) of a kmer, in nucleotide order, and asks the graph data for all of them at once
+** INPUT   : data, graine (kmer in the strand of the node), direction
+** OUTPUT  : neighbors (at most 8 kmers), isForward (strand of each neighbor), found (presence of each neighbor)
+** RETURN  : number of neighbors asked for (4 or 8)
+** REMARKS : the batch query lets the Bloom filter overlap the cache misses of the neighbors
+*********************************************************************/
+template<size_t span>
+size_t containsNeighbors (
+    const GraphData<span>& data,
+    const typename Kmer<span>::Type& graine,
+    Direction direction,
+    typename Kmer<span>::Type* neighbors,
+    bool* isForward,
+    bool* found
+)
+{
+    typedef typename Kmer<span>::Type Type;
+
+    size_t      kmerSize = data._model->getKmerSize();
+    const Type& mask     = data._model->getKmerMax();
+
+    size_t nb = 0;
+
+    if (direction & DIR_OUTCOMING)
+    {
+        for (u_int64_t nt=0; nt<4; nt++, nb++)
+        {
+            Type forward = ( (graine << 2 )  + nt) & mask;
+            Type reverse = revcomp (forward, kmerSize);
+
+            isForward[nb] = forward < reverse;
+            neighbors[nb] = isForward[nb] ? forward : reverse;
+        }
+    }
+
+    if (direction & DIR_INCOMING)
+    {
+        /** IMPORTANT !!! Since we have hugely shift the nt value, we make sure to use a long enough integer. */
+        for (u_int64_t nt=0; nt<4; nt++, nb++)
+        {
+            Type single_nt;
+            single_nt.setVal(nt);
+            single_nt <<=  ((kmerSize-1)*2);
+            Type forward = ((graine >> 2 )  + single_nt ) & mask; /* previous kmer */
+            Type reverse = revcomp (forward, kmerSize);
+
+            isForward[nb] = forward < reverse;
+            neighbors[nb] = isForward[nb] ? forward : reverse;
+        }
+    }
+
+    data.containsBatch (neighbors, nb, found);
+
+    return nb;
+}
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -1175,7 +1257,7 @@ struct getItems_visitor : public boost::static_visitor<GraphVector<Item> >    {
             unsigned long hashIndex = getNodeIndex<span>(data, source);
 			if(hashIndex == ULLONG_MAX) return itemsAdj;
 
-            unsigned char &value = (*(data._adjacency)).at(hashIndex);
+            unsigned char &value = data.adjacencyAt (hashIndex);
 
             bool forwardStrand = (source.strand == STRAND_FORWARD);
 
@@ -1273,69 +1355,24 @@ struct getItems_visitor : public boost::static_visitor<GraphVector<Item> >    {
             return itemsAdj;
         }
 
-        /* else, run classical neighbor queries using the data.contains() operation (bloom filters behind the scenes) */
+        /* else, run classical neighbor queries using the data.containsBatch() operation (bloom filters behind the scenes) */
+        Type neighbors[8];
+        bool isForward[8];
+        bool found    [8];
 
-        if (direction & DIR_OUTCOMING)
-        {
-            for (u_int64_t nt=0; nt<4; nt++)
-            {
-                typename Node::Value dest_value;
-                Type forward = ( (graine << 2 )  + nt) & mask;
-                Type reverse = revcomp (forward, kmerSize);
+        size_t nbNeighbors = containsNeighbors<span> (data, graine, direction, neighbors, isForward, found);
 
-                if (forward < reverse)
-                {
-                    if (data.contains (forward))
-                    {
-                        dest_value = forward;
-                        if (debug) std::cout << "kmer  "<< sourceVal << " found OUT FWD nt=" << nt << std::endl;
-                        fct (items, idx++, source.kmer, source.strand, dest_value, STRAND_FORWARD, (Nucleotide)nt, DIR_OUTCOMING);
-                    }
-                }
-                else
-                {
-                    if (data.contains (reverse))
-                    {
-                        dest_value = reverse;
-                        if (debug) std::cout << "found OUT REV nt=" << nt << std::endl;
-                        fct (items, idx++, source.kmer, source.strand, dest_value, STRAND_REVCOMP, (Nucleotide)nt, DIR_OUTCOMING);
-                    }
-                }
-            }
-        }
-
-        if (direction & DIR_INCOMING)
+        for (size_t i=0; i<nbNeighbors; i++)
         {
-            /** IMPORTANT !!! Since we have hugely shift the nt value, we make sure to use a long enough integer. */
-            for (u_int64_t nt=0; nt<4; nt++)
-            {
-                Type single_nt;
-                single_nt.setVal(nt);
-                single_nt <<=  ((kmerSize-1)*2);
-                typename Node::Value dest_value;
-                Type forward = ((graine >> 2 )  + single_nt ) & mask; /* previous kmer */
-                Type reverse = revcomp (forward, kmerSize);
+            if (!found[i])  { continue; }
 
-                if (forward < reverse)
-                {
-                    if (data.contains (forward))
-                    {
-                        dest_value = forward;
-                        if (debug) std::cout << "found INC FWD nt=" << nt << std::endl;
-                        // It used to be that "nt" was source[0] (in forward strand) and reverse(source[k-1]) in reverse, but i think it was wrong, so i changed it. TODO: delete this line if neighbors(..,DIR_INCOMING) causes no trouble for anyone, as it is now.
-                        fct (items, idx++, source.kmer, source.strand, dest_value, STRAND_FORWARD, (Nucleotide)nt, DIR_INCOMING);
-                    }
-                }
-                else
-                {
-                    if (data.contains (reverse))
-                    {
-                        dest_value = reverse;
-                        if (debug) std::cout << "found INC REV nt=" << nt << std::endl;
-                        fct (items, idx++, source.kmer, source.strand, dest_value, STRAND_REVCOMP, (Nucleotide)nt, DIR_INCOMING);
-                    }
-                }
-            }
+            /* successors come first when both directions are asked for */
+            Direction dest_dir = ((direction & DIR_OUTCOMING) && i<4) ? DIR_OUTCOMING : DIR_INCOMING;
+            typename Node::Value dest_value;
+            dest_value = neighbors[i];
+
+            if (debug) std::cout << "kmer  "<< sourceVal << " found " << (dest_dir==DIR_OUTCOMING ? "OUT" : "INC") << " " << (isForward[i] ? "FWD" : "REV") << " nt=" << i%4 << std::endl;
+            fct (items, idx++, source.kmer, source.strand, dest_value, isForward[i] ? STRAND_FORWARD : STRAND_REVCOMP, (Nucleotide)(i%4), dest_dir);
         }
 
         /** We update the size of the container according to the number of found items. */
@@ -1427,7 +1464,7 @@ struct countNeighbors_visitor : public boost::static_visitor<void>    {
             unsigned long hashIndex = getNodeIndex<span>(data, source);
 			if(hashIndex == ULLONG_MAX) return; // node was not found in the mphf 
 
-            unsigned char &value = (*(data._adjacency)).at(hashIndex);
+            unsigned char &value = data.adjacencyAt (hashIndex);
 
             bool forwardStrand = (source.strand == STRAND_FORWARD);
 
@@ -1445,7 +1482,7 @@ struct countNeighbors_visitor : public boost::static_visitor<void>    {
             return;
         }
 
-        /* else, run classical neighbor queries using the data.contains() operation (bloom filters behind the scenes) */
+        /* else, run classical neighbor queries using the data.containsBatch() operation (bloom filters behind the scenes) */
 
         /** Shortcut. */
         typedef typename Kmer<span>::Type Type;
@@ -1455,64 +1492,23 @@ struct countNeighbors_visitor : public boost::static_visitor<void>    {
 
         /** Shortcuts. */
         size_t      kmerSize = data._model->getKmerSize();
-        const Type& mask     = data._model->getKmerMax();
-
 
         /* the kmer we're extending may be actually a revcomp sequence in the bidirected debruijn graph node */
         Type graine = ((source.strand == STRAND_FORWARD) ?  sourceVal :  revcomp (sourceVal, kmerSize) );
-        /* TODO opt: in some cases we may skip computing graine, e.g. whenever there are no neighbors */
 
+        Type neighbors[8];
+        bool isForward[8];
+        bool found    [8];
 
-        if (direction & DIR_OUTCOMING)
-        {
-            for (u_int64_t nt=0; nt<4; nt++)
-            {
-                Type forward = ( (graine << 2 )  + nt) & mask;
-                Type reverse = revcomp (forward, kmerSize);
+        size_t nbNeighbors = containsNeighbors<span> (data, graine, direction, neighbors, isForward, found);
 
-                if (forward < reverse)
-                {
-                    if (data.contains (forward))
-                    {
-                        outdegree++;
-                    }
-                }
-                else
-                {
-                    if (data.contains (reverse))
-                    {
-                        outdegree++;
-                    }
-                }
-            }
-        }
-
-        if (direction & DIR_INCOMING)
+        for (size_t i=0; i<nbNeighbors; i++)
         {
-            /** IMPORTANT !!! Since we have hugely shift the nt value, we make sure to use a long enough integer. */
-            for (u_int64_t nt=0; nt<4; nt++)
-            {
-                Type single_nt;
-                single_nt.setVal(nt);
-                single_nt <<=  ((kmerSize-1)*2);
-                Type forward = ((graine >> 2 )  + single_nt ) & mask; /* previous kmer */
-                Type reverse = revcomp (forward, kmerSize);
+            if (!found[i])  { continue; }
 
-                if (forward < reverse)
-                {
-                    if (data.contains (forward))
-                    {
-                        indegree++;
-                    }
-                }
-                else
-                {
-                    if (data.contains (reverse))
-                    {
-                        indegree++;
-                    }
-                }
-            }
+            /* successors come first when both directions are asked for */
+            if ((direction & DIR_OUTCOMING) && i<4)  { outdegree++; }
+            else                                     { indegree++;  }
         }
     }
 };
@@ -1890,7 +1886,7 @@ struct getItem_visitor : public boost::static_visitor<Item>    {
             unsigned long hashIndex = getNodeIndex<span>(data, source);
 			if(hashIndex == ULLONG_MAX) {exists = false; return itemAdj;} // node was not found in the mphf 
 
-            unsigned char &value = (*(data._adjacency)).at(hashIndex);
+            unsigned char &value = data.adjacencyAt (hashIndex);
 
             bool forwardStrand = (source.strand == STRAND_FORWARD);
 
@@ -3223,6 +3219,37 @@ unsigned long getNodeIndex (const GraphData<span>& data, Node_in& node)
     return hashIndex;
 }
 
+/* same as getNodeIndex for several nodes: the nodes whose index is not cached yet are
+ * given to the MPHF by batches, so that their memory accesses overlap */
+template<size_t span, typename Node_in>
+void getNodeIndexes (const GraphData<span>& data, Node_in* nodes, size_t nb, unsigned long* indexes)
+{
+    typedef typename Kmer<span>::Type  Type;
+
+    static const size_t BATCH_SIZE = 64;
+    Type      keys  [BATCH_SIZE];
+    size_t    which [BATCH_SIZE];
+    u_int64_t codes [BATCH_SIZE];
+
+    for (size_t start=0; start<nb; start+=BATCH_SIZE)
+    {
+        size_t end = std::min (nb, start+BATCH_SIZE);
+        size_t nbKeys = 0;
+
+        for (size_t i=start; i<end; i++)
+        {
+            if (nodes[i].mphfIndex != 0)  {  indexes[i] = nodes[i].mphfIndex;  continue;  }
+
+            keys [nbKeys]   = nodes[i].template getKmer<Type>();
+            which[nbKeys++] = i;
+        }
+
+        (*(data._abundance)).lookup (keys, nbKeys, codes);
+
+        for (size_t k=0; k<nbKeys; k++)  {  nodes[which[k]].mphfIndex = indexes[which[k]] = codes[k];  }
+    }
+}
+
 
 /* this whole visitor pattern thing in the GraphTemplate<Node, Edge, GraphDataVariant>..
   it is used to support querying the right graph variant (the one that corresponds to the adequate kmer size)
@@ -3239,9 +3266,7 @@ struct queryAbundance_visitor : public boost::static_visitor<int>    {
         unsigned long hashIndex = getNodeIndex<span>(data, node);
     	if(hashIndex == ULLONG_MAX) return 0; // node was not found in the mphf 
 
-        unsigned char value = (*(data._abundance)).at(hashIndex);
-
-        return value;
+        return data.abundanceAt (hashIndex);
     }
 };
 
@@ -3252,6 +3277,33 @@ int GraphTemplate<Node, Edge, GraphDataVariant>::queryAbundance (Node& node) con
     return boost::apply_visitor (queryAbundance_visitor<Node, Edge, GraphDataVariant>(node),  *(GraphDataVariant*)_variant);
 }
 
+template<typename Node, typename Edge, typename GraphDataVariant> 
+struct queryAbundanceBatch_visitor : public boost::static_visitor<int>    {
+
+    Node* nodes;  size_t nb;  int* abundances;
+
+    queryAbundanceBatch_visitor (Node* nodes, size_t nb, int* abundances) : nodes(nodes), nb(nb), abundances(abundances) {}
+
+    template<size_t span>  int operator() (const GraphData<span>& data) const
+    {
+        std::vector<unsigned long> indexes (nb);
+        getNodeIndexes<span> (data, nodes, nb, indexes.data());
+
+        for (size_t i=0; i<nb; i++)
+        {
+            abundances[i] = indexes[i] == ULLONG_MAX ? 0 : data.abundanceAt (indexes[i]); // 0 if the node was not found in the mphf
+        }
+        return 0;
+    }
+};
+
+/** */
+template<typename Node, typename Edge, typename GraphDataVariant> 
+void GraphTemplate<Node, Edge, GraphDataVariant>::queryAbundance (Node* nodes, size_t nb, int* abundances) const
+{
+    boost::apply_visitor (queryAbundanceBatch_visitor<Node, Edge, GraphDataVariant>(nodes, nb, abundances),  *(GraphDataVariant*)_variant);
+}
+
 /* 
 / a node state, using the MPHF, is either:
 / 0: unmarked (normal state)
@@ -3272,14 +3324,7 @@ struct queryNodeState_visitor : public boost::static_visitor<int>    {
         unsigned long hashIndex = getNodeIndex<span>(data, node);
     	if(hashIndex == ULLONG_MAX) return 0; // node was not found in the mphf 
 
-        unsigned char value = (*(data._nodestate)).at(hashIndex / 2);
-
-        if (hashIndex % 2 == 1)
-            value >>= 4;
-
-        value &= 0xF;
-
-        return value;
+        return data.nodeStateAt (hashIndex);
     }
 };
 
@@ -3306,20 +3351,7 @@ struct setNodeState_visitor : public boost::static_visitor<int>    {
         unsigned long hashIndex = getNodeIndex<span>(data, node);
     	if(hashIndex == ULLONG_MAX) return 0; // node was not found in the mphf 
 
-        unsigned char &value = (*(data._nodestate)).at(hashIndex / 2);
-
-        int maskedState = state & 0xF;
-
-        if (hashIndex % 2 == 1)
-        {
-            value &= 0xF;
-            value |= (maskedState << 4);
-        }
-        else
-        {
-            value &= 0xF0;
-            value |= maskedState;
-        }
+        data.setNodeStateAt (hashIndex, state);
 
         return 0;
     }
@@ -3339,7 +3371,14 @@ struct resetNodeState_visitor : public boost::static_visitor<int>    {
 
     template<size_t span> int operator() (const GraphData<span>& data) const
     {
-        (*(data._nodestate)).clearData();
+        if (data._noderecord != NULL)
+        {
+            for (unsigned long i = 0; i < data._noderecord->size(); i++)  {  data._noderecord->at(i).state = 0;  }
+        }
+        else
+        {
+            (*(data._nodestate)).clearData();
+        }
         return 0;
     }
 };
@@ -3359,6 +3398,7 @@ struct disableNodeState_visitor : public boost::static_visitor<int>    {
     template<size_t span> int operator() (GraphData<span>& data) const
     {
         data._nodestate = NULL;
+        data._nodestateDisabled = true;
         return 0;
     }
 };
@@ -3405,6 +3445,31 @@ unsigned long GraphTemplate<Node, Edge, GraphDataVariant>::nodeMPHFIndex(Node& n
     return boost::apply_visitor (nodeMPHFIndex_visitor<Node, Edge, GraphDataVariant>(node),  *(GraphDataVariant*)_variant);
 }
 
+template<typename Node, typename Edge, typename GraphDataVariant> 
+struct nodeMPHFIndexBatch_visitor : public boost::static_visitor<int>    {
+
+    Node* nodes;  size_t nb;  unsigned long* indexes;
+
+    nodeMPHFIndexBatch_visitor (Node* nodes, size_t nb, unsigned long* indexes) : nodes(nodes), nb(nb), indexes(indexes) {}
+
+    template<size_t span> int operator() (const GraphData<span>& data)  const
+    {
+        getNodeIndexes<span> (data, nodes, nb, indexes);
+        return 0;
+    }
+};
+
+template<typename Node, typename Edge, typename GraphDataVariant> 
+void GraphTemplate<Node, Edge, GraphDataVariant>::nodeMPHFIndex(Node* nodes, size_t nb, unsigned long* indexes) const 
+{
+    if (!checkState(GraphTemplate<Node, Edge, GraphDataVariant>::STATE_MPHF_DONE))
+    {
+        for (size_t i=0; i<nb; i++)  {  indexes[i] = 0;  }
+        return;
+    }
+    boost::apply_visitor (nodeMPHFIndexBatch_visitor<Node, Edge, GraphDataVariant>(nodes, nb, indexes),  *(GraphDataVariant*)_variant);
+}
+
 /* debug function, only for profiling */
 template<typename Node, typename Edge, typename GraphDataVariant> 
 struct nodeMPHFIndex_visitorDummy : public boost::static_visitor<unsigned long>    {
@@ -3451,10 +3516,10 @@ struct getAdjacency_visitor : public boost::static_visitor<unsigned char&>    {
     	if(hashIndex == ULLONG_MAX) 
         { // node was not found in the mphf: complain a return a dummy value
             std::cout << "getAdjacency called for node not in MPHF" << std::endl; 
-            return (*(data._adjacency)).at(0);
+            return data.adjacencyAt (0);
         }
 
-        unsigned char &value = (*(data._adjacency)).at(hashIndex);
+        unsigned char &value = data.adjacencyAt (hashIndex);
         //std::cout << "hashIndex " << hashIndex << " value " << (int)value << std::endl;;
 
         return value;
@@ -3467,6 +3532,8 @@ struct allocateAdjacency_visitor : public boost::static_visitor<void>    {
 
     template<size_t span> void operator() (const GraphData<span>& data) const
     {
+        if (data._noderecord != NULL)  {  return;  } // the node records already hold the adjacency
+
         data._adjacency->useHashFrom(data._abundance); // use abundancemap's MPHF, and allocate 8 bits per element for the adjacency map
     }
 };
@@ -3606,7 +3673,7 @@ void GraphTemplate<Node, Edge, GraphDataVariant>::deleteNode (Node& node) const
                             std::cout << "Error while deleting node " <<  this->toString(node) << ": neighbor" << ((neighbor.strand==STRAND_REVCOMP) ? "(r)":"")<<" " << this->toString(neighbor) << " --(nt=" << nt << ")--> neigh_of_neigh"  << ((neigh_of_neigh.strand==STRAND_REVCOMP) ? "(r)":"")<< " " << this->toString(neigh_of_neigh) << " and dir :" << (dir == DIR_INCOMING ? "incoming": "outcoming") << ", value " << (int)value << std::endl;
                             exit(1);
                         }
-                        value ^= (bit << shift);
+                        __sync_fetch_and_xor (&value, (unsigned char) (bit << shift)); // neighbors may be deleted concurrently
                         
                         deleted = true;
                     }
@@ -3695,18 +3762,23 @@ bool GraphTemplate<Node, Edge, GraphDataVariant>::debugCompareNeighborhoods(Node
 
 // TODO: it makes sense someday to introduce a graph._nbCore parameter, because this function, simplify() and precomputeAdjacency() all want it
 template<typename Node, typename Edge, typename GraphDataVariant>
-void GraphTemplate<Node, Edge, GraphDataVariant>::deleteNodesByIndex(vector<bool> &bitmap, int nbCores, gatb::core::system::ISynchronizer* synchro) const
+void GraphTemplate<Node, Edge, GraphDataVariant>::deleteNodesByIndex(const vector<u_int64_t>& bitmap, int nbCores, gatb::core::system::ISynchronizer* synchro) const
 {
     GraphIterator<Node> itNode = this->iterator();
     Dispatcher dispatcher (nbCores); 
 
+    /* deleteNode() updates node states and neighbors adjacency with atomic operations,
+     * only the cache of non simple nodes (a map) still needs to be protected */
+    bool _cacheNonSimpleNodes = getState() & GraphTemplate<Node, Edge, GraphDataVariant>::STATE_NONSIMPLE_CACHE;
+    if (!_cacheNonSimpleNodes)
+        synchro = NULL;
+
     dispatcher.iterate (itNode, [&] (Node& node)        {
 
         unsigned long i = this->nodeMPHFIndex(node); 
 
-        if (bitmap[i])
+        if ((bitmap[i >> 6] >> (i & 63)) & 1)
         {
-            // make this deletion atomic with respect to other node deletions
             if (synchro)
                 synchro->lock();
 
@@ -899,6 +899,13 @@ public:
      * \return the abundance */
     int queryAbundance (Node& node) const;
 
+    /** Return the abundances of several nodes; the perfect hash function is queried for all the
+     * nodes at once, which is faster than one query per node.
+     * \param[in] nodes : the nodes
+     * \param[in] nb : number of nodes
+     * \param[out] abundances : the abundance of each node (nb values) */
+    void queryAbundance (Node* nodes, size_t nb, int* abundances) const;
+
     /** Return the state of a node by querying the perfect hash function. A node state is either normal, marked, or deleted.
      * \param[in] node : the node or a node index (unsigned long) from the MPHF
      * \return the abundance */
@@ -909,7 +916,11 @@ public:
 
     // deleted nodes, related to NodeState above
     void deleteNode (Node& node) const;
-    void deleteNodesByIndex(std::vector<bool> &bitmap, int nbCores = 1, gatb::core::system::ISynchronizer* synchro=NULL) const;
+    /** Delete in parallel the nodes whose MPHF index is set in a bitmap.
+     * \param[in] bitmap : one bit per node, packed in 64 bits words
+     * \param[in] nbCores : number of cores used for the deletion
+     * \param[in] synchro : only needed to protect the cache of non simple nodes, if any */
+    void deleteNodesByIndex(const std::vector<u_int64_t>& bitmap, int nbCores = 1, gatb::core::system::ISynchronizer* synchro=NULL) const;
     bool isNodeDeleted(Node& node) const;
 
     // a direct query to the MPHF data strcuture
@@ -923,6 +934,9 @@ public:
      */
     unsigned long nodeMPHFIndex(Node& node) const;
 
+    /* same as above for several nodes, the MPHF being queried for all the nodes at once */
+    void nodeMPHFIndex(Node* nodes, size_t nb, unsigned long* indexes) const;
+
 
     unsigned long nodeMPHFIndexDummy(Node& node) const; // debug function, for profiling only
 
@@ -1177,10 +1191,11 @@ struct GraphData
     typedef typename gatb::core::kmer::impl::MPHFAlgorithm<span>::AbundanceMap   AbundanceMap;
     typedef typename gatb::core::kmer::impl::MPHFAlgorithm<span>::NodeStateMap   NodeStateMap;
     typedef typename gatb::core::kmer::impl::MPHFAlgorithm<span>::AdjacencyMap   AdjacencyMap;
+    typedef typename gatb::core::kmer::impl::MPHFAlgorithm<span>::NodeRecordMap  NodeRecordMap;
     typedef typename std::unordered_map<Type, std::pair<char,std::string>, NodeHasher<Type> > NodeCacheMap; // rudimentary for now
 
     /** Constructor. */
-    GraphData () : _model(0), _solid(0), _container(0), _branching(0), _abundance(0), _nodestate(0), _adjacency(0), _nodecache(0) {}
+    GraphData () : _model(0), _solid(0), _container(0), _branching(0), _abundance(0), _nodestate(0), _adjacency(0), _noderecord(0), _nodestateDisabled(false), _nodecache(0) {}
 
     /** Destructor. */
     ~GraphData ()
@@ -1192,11 +1207,12 @@ struct GraphData
         setAbundance (0);
         setNodeState (0);
         setAdjacency (0);
+        setNodeRecord(0);
         setNodeCache (0);
     }
 
     /** Constructor (copy). */
-    GraphData (const GraphData& d) : _model(0), _solid(0), _container(0), _branching(0), _abundance(0), _nodestate(0), _adjacency(0), _nodecache(0)
+    GraphData (const GraphData& d) : _model(0), _solid(0), _container(0), _branching(0), _abundance(0), _nodestate(0), _adjacency(0), _noderecord(0), _nodestateDisabled(false), _nodecache(0)
     {
         setModel     (d._model);
         setSolid     (d._solid);
@@ -1205,7 +1221,9 @@ struct GraphData
         setAbundance (d._abundance);
         setNodeState (d._nodestate);
         setAdjacency (d._adjacency);
+        setNodeRecord(d._noderecord);
         setNodeCache (d._nodecache);
+        _nodestateDisabled = d._nodestateDisabled;
     }
 
     /** Assignment operator. */
@@ -1220,7 +1238,9 @@ struct GraphData
             setAbundance (d._abundance);
             setNodeState (d._nodestate);
             setAdjacency (d._adjacency);
+            setNodeRecord(d._noderecord);
             setNodeCache (d._nodecache);
+            _nodestateDisabled = d._nodestateDisabled;
         }
         return *this;
     }
@@ -1233,6 +1253,8 @@ struct GraphData
     AbundanceMap*         _abundance;
     NodeStateMap*         _nodestate;
     AdjacencyMap*         _adjacency;
+    NodeRecordMap*        _noderecord; // fused layout: abundance, node state and adjacency of a node in one record (0 if not used)
+    bool                  _nodestateDisabled;
     NodeCacheMap*         _nodecache; // so, nodecache also records branching node, but also more stuff. i'm keeping _branching for historical reasons.
 
     /** Setters. */
@@ -1243,6 +1265,7 @@ struct GraphData
     void setAbundance   (AbundanceMap*          abundance)  { SP_SETATTR (abundance); }
     void setNodeState   (NodeStateMap*          nodestate)  { SP_SETATTR (nodestate); }
     void setAdjacency   (AdjacencyMap*          adjacency)  { SP_SETATTR (adjacency); }
+    void setNodeRecord  (NodeRecordMap*         noderecord) { SP_SETATTR (noderecord); }
     void setNodeCache   (NodeCacheMap*          nodecache)  { _nodecache = nodecache; /* would like to do "SP_SETATTR (nodecache)" but nodecache is an unordered_map, not some type that derives from a smartpointer. so one day, address this. I'm not sure if it's important though. Anyway I'm phasing out NodeCache in favor of GraphUnitigs. */; }
 
     /** Shortcut. */
@@ -1253,22 +1276,68 @@ struct GraphData
         if (!res)
             return false;
 
+        return !isDeleted (item);
+    }
+
+    /** Shortcut for several items: the container is asked for all of them at once,
+     * so that the memory accesses of the queries overlap. */
+    void containsBatch (const Type* items, size_t nb, bool* result)  const  {
+
+        _container->containsBatch (items, nb, result);
+
+        for (size_t i=0; i<nb; i++)  {  if (result[i])  {  result[i] = !isDeleted (items[i]);  }  }
+    }
+
+    /** Tells whether a kmer of the container is to be ignored: deleted from the graph, or unknown to the node state MPHF. */
+    bool isDeleted (const Type& item)  const  {
+
         /* check if kmer is deleted*/
-        // this is duplicated code from queryNodeState.
         // NOTE: this does a MPHF query for each bloom contains that answer true. costly!
-        if (_nodestate != NULL)
+        if (_nodestate != NULL || (_noderecord != NULL && !_nodestateDisabled))
         {
-            unsigned long hashIndex = ((_nodestate))->getCode(item);
-			if(hashIndex == ULLONG_MAX) return false;
-            unsigned char value = ((_nodestate))->at(hashIndex / 2);
-            if ((hashIndex % 2) == 1)
-                value >>= 4;
-            value &= 0xF;
-            if (((value >> 1) & 1) == 1) 
-                return false;
+            unsigned long hashIndex = ((_abundance))->getCode(item);
+			if(hashIndex == ULLONG_MAX) return true;
+            if (((nodeStateAt (hashIndex) >> 1) & 1) == 1) 
+                return true;
         }
 
-        return true;
+        return false;
+    }
+
+    /** Values of a node given its MPHF index, either from the separate maps or from the node records. */
+    int abundanceAt (unsigned long hashIndex)  const  {
+        return _noderecord != NULL ? _noderecord->at(hashIndex).abundance : _abundance->at(hashIndex);
+    }
+
+    int nodeStateAt (unsigned long hashIndex)  const  {
+
+        if (_noderecord != NULL)  {  return _noderecord->at(hashIndex).state & 0xF;  }
+
+        unsigned char value = _nodestate->at(hashIndex / 2);
+        if ((hashIndex % 2) == 1)
+            value >>= 4;
+        return value & 0xF;
+    }
+
+    void setNodeStateAt (unsigned long hashIndex, int state)  const  {
+
+        int maskedState = state & 0xF;
+
+        if (_noderecord != NULL)  {  _noderecord->at(hashIndex).state = maskedState;  return;  }
+
+        /* two node states share a byte; update our half with a CAS, since nodes can be deleted concurrently */
+        unsigned char &value = _nodestate->at(hashIndex / 2);
+        int shift = (hashIndex % 2 == 1) ? 4 : 0;
+        unsigned char oldValue, newValue;
+        do
+        {
+            oldValue = value;
+            newValue = (oldValue & ~(0xF << shift)) | (maskedState << shift);
+        }  while (!__sync_bool_compare_and_swap (&value, oldValue, newValue));
+    }
+
+    unsigned char& adjacencyAt (unsigned long hashIndex)  const  {
+        return _noderecord != NULL ? _noderecord->at(hashIndex).adjacency : _adjacency->at(hashIndex);
     }
 };
 
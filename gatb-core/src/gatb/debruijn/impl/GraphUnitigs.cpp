@@ -1174,7 +1174,7 @@ void GraphUnitigsTemplate<span>::cacheNonSimpleNodes(unsigned int nbCores, bool
 }
  
 template<size_t span>
-void GraphUnitigsTemplate<span>::deleteNodesByIndex(vector<bool> &bitmap, int nbCores, gatb::core::system::ISynchronizer* synchro) const
+void GraphUnitigsTemplate<span>::deleteNodesByIndex(const vector<u_int64_t>& bitmap, int nbCores, gatb::core::system::ISynchronizer* synchro) const
 {
     std::cout << "deleteNodesByIndex called, shouldn't be." << std::endl; 
     exit(1);
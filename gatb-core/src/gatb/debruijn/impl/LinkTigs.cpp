@@ -1,17 +1,23 @@
 #include <gatb/tools/misc/impl/Progress.hpp>
 #include <gatb/tools/misc/impl/Stringify.hpp>
+#include <gatb/tools/designpattern/impl/Command.hpp>
 #include <gatb/system/impl/System.hpp>
 #include <gatb/bank/impl/Bank.hpp>
 #include <gatb/bank/impl/Banks.hpp>
 #include <gatb/bank/impl/BankHelpers.hpp>
 #include <gatb/bcalm2/logging.hpp>
+#include <gatb/bcalm2/ThreadPool.h>
 #include <gatb/debruijn/impl/ExtremityInfo.hpp>
 #include <gatb/debruijn/impl/LinkTigs.hpp>
 #include <gatb/kmer/impl/Model.hpp> // for revcomp_4NT
+#include <gatb/tools/collections/impl/BagFile.hpp>
+#include <gatb/tools/collections/impl/BagCache.hpp>
+#include <gatb/tools/collections/impl/IteratorFile.hpp>
 
+#include <algorithm>
 #include <queue>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 
 using namespace std;
@@ -22,6 +28,9 @@ using namespace gatb::core::debruijn::impl;
 using namespace gatb::core::kmer;
 using namespace gatb::core::kmer::impl;
 
+using namespace gatb::core::tools::collections::impl;
+using namespace gatb::core::tools::dp;
+using namespace gatb::core::tools::dp::impl;
 using namespace gatb::core::tools::misc;
 using namespace gatb::core::tools::misc::impl;
 using namespace gatb::core::system;
@@ -29,32 +38,94 @@ using namespace gatb::core::system::impl;
 
 namespace gatb { namespace core { namespace debruijn { namespace impl  {
 
-    static constexpr int nb_passes = 8;
-    static void write_final_output(const string& unitigs_filename, bool verbose, BankFasta* out, uint64_t &nb_unitigs);
-    static bool get_link_from_file(std::ifstream& input, std::string &link, uint64_t &unitig_id);
+    /* an extremity (k-1)-mer of a unitig, in canonical form, along with its packed ExtremityInfo */
+    template<typename Type>
+    struct LinkTigsExtremity
+    {
+        Type     kmer;
+        uint64_t packed;
+
+        LinkTigsExtremity (const Type& kmer, uint64_t packed) : kmer(kmer), packed(packed) {}
+
+        /* extremities of a same (k-1)-mer are ordered by unitig, then begin before end,
+         * so that links are written in unitigs order */
+        bool operator< (const LinkTigsExtremity& other) const
+        {
+            if (kmer != other.kmer)  { return kmer < other.kmer; }
+            if ((packed >> 2) != (other.packed >> 2))  { return (packed >> 2) < (other.packed >> 2); }
+            return (packed & 1) < (other.packed & 1);
+        }
+    };
+
+    /* a link found for a unitig extremity, as a binary record:
+     *   extremity : (unitig << 1) | (1 if the link leaves from the unitig end, i.e. a "L:+" link)
+     *   link      : (next unitig << 3) | (next unitig extremity << 2) | (second link of a palindrome << 1) | (1 if next unitig is "-")
+     */
+    struct LinkTigsLink
+    {
+        uint64_t extremity;
+        uint64_t link;
+
+        LinkTigsLink () : extremity(0), link(0) {}
+        LinkTigsLink (uint64_t extremity, uint64_t link) : extremity(extremity), link(link) {}
+
+        bool operator<  (const LinkTigsLink& other) const { return extremity < other.extremity || (extremity == other.extremity && link < other.link); }
+        bool operator>  (const LinkTigsLink& other) const { return other < *this; }
+    };
 
-/* this procedure finds the overlaps between unitigs, using a hash table of all extremity (k-1)-mers
+    template<typename Type>
+    static void join_extremities_partition(const int kmerSize, std::vector<LinkTigsLink>& links, std::vector<LinkTigsExtremity<Type> >& extremities);
+
+    template<size_t span>
+    static void link_tigs_pass(const string& unitigs_filename, const int kmerSize, const int nb_threads, const int pass, const int nb_passes);
+
+    static void write_final_output(const string& unitigs_filename, const int kmerSize, BankFasta* out, const int nb_passes, uint64_t &nb_unitigs);
+
+    static string links_filename (const string& unitigs_filename, int pass)  { return unitigs_filename + ".links." + to_string(pass); }
+
+/* this procedure finds the overlaps between unitigs, using all extremity (k-1)-mers
  * I guess it's like AdjList in ABySS. It's also like contigs_to_fastg in MEGAHIT.
- * 
- * could be optimized by keeping edges during the BCALM step and tracking kmers in unitigs, but it's not the case for now, because would need to modify ograph 
  *
- * it uses the disk to store the links for extremities until they're merged into the final unitigs file. 
+ * could be optimized by keeping edges during the BCALM step and tracking kmers in unitigs, but it's not the case for now, because would need to modify ograph
  *
- * so the memory usage is just that of the hash tables that record kmers, not of the links
+ * the extremities are split into passes (by hash of the (k-1)-mer), so that the memory of a pass fits in max_memory.
+ * each pass works in two steps:
+ *  1) a (multi-threaded) pass over the unitigs records each extremity (k-1)-mer of the pass as a binary
+ *     (kmer, unitig, extremity) record, in a partition given by the hash of the kmer
+ *  2) each partition is sorted and joined independently (thread pool): extremities sharing the same
+ *     (k-1)-mer produce binary link records. they are sorted by unitig and written to the links file of the pass
+ * then a single pass over the unitigs merges the links files of all passes and writes the indexed unitigs.
+ *
+ * so the memory usage is that of the extremities records and of the binary links of a single pass
  */
 template<size_t span>
-void link_tigs(string unitigs_filename, int kmerSize, int nb_threads, uint64_t &nb_unitigs, bool verbose)
+void link_tigs(string unitigs_filename, int kmerSize, int nb_threads, uint64_t &nb_unitigs, bool verbose, uint64_t max_memory)
 {
+    typedef typename kmer::impl::Kmer<span>::Type Type;
+
     bcalm_logging = verbose;
     BankFasta* out = new BankFasta(unitigs_filename+".indexed");
     if (kmerSize < 4) { std::cout << "error, recent optimizations (specifically link_unitigs) don't support k<5 for now" << std::endl; exit(1); }
     logging("Finding links between unitigs");
 
+    if (nb_threads < 1)  { nb_threads = 1; }
+    if (max_memory == 0)  { max_memory = System::info().getMemoryProject(); }
+    if (max_memory == 0)  { max_memory = 1; }
+
+    /* a unitig takes at least k characters of the unitigs file, which bounds the number of extremities.
+     * we count two links per extremity, on average. */
+    u_int64_t nb_extremities_max = 2 * (System::file().getSize (unitigs_filename) / kmerSize + 1);
+    u_int64_t nb_bytes           = nb_extremities_max * (sizeof(LinkTigsExtremity<Type>) + 2*sizeof(LinkTigsLink));
+    int nb_passes = (int) std::min ((u_int64_t)1024, (nb_bytes + max_memory*MBYTE - 1) / (max_memory*MBYTE));
+    if (nb_passes < 1)  { nb_passes = 1; }
+
+    logging("linking in " + to_string(nb_passes) + " pass(es) for " + to_string(max_memory) + " MB");
+
     for (int pass = 0; pass < nb_passes; pass++)
-        link_unitigs_pass<span>(unitigs_filename, verbose, pass, kmerSize);
+        link_tigs_pass<span> (unitigs_filename, kmerSize, nb_threads, pass, nb_passes);
+
+    write_final_output(unitigs_filename, kmerSize, out, nb_passes, nb_unitigs);
 
-    write_final_output(unitigs_filename, verbose, out, nb_unitigs);
-   
     delete out;
     system::impl::System::file().remove (unitigs_filename);
     system::impl::System::file().rename (unitigs_filename+".indexed", unitigs_filename);
@@ -63,90 +134,195 @@ void link_tigs(string unitigs_filename, int kmerSize, int nb_threads, uint64_t &
 }
 
 
-/*
- * takes all the prefix.links.* files, sorted by unitigs.
- * do a n-way merge to gather the links for each unitig in unitig order
- * (single-threaded)
+/* finds the links of the extremities whose (k-1)-mer belongs to the given pass,
+ * and writes them, sorted by unitig extremity, to the links file of the pass.
  */
+template<size_t span>
+static void link_tigs_pass(const string& unitigs_filename, const int kmerSize, const int nb_threads, const int pass, const int nb_passes)
+{
+    typedef typename kmer::impl::Kmer<span>::ModelCanonical Model;
+    typedef typename kmer::impl::Kmer<span>::Type           Type;
+    typedef LinkTigsExtremity<Type>                         Extremity;
 
+    const int nb_partitions = std::max (16, 4 * nb_threads);
 
-static void write_final_output(const string& unitigs_filename, bool verbose, BankFasta* out, uint64_t &nb_unitigs)
-{
-    logging("gathering links from disk");
-    std::ifstream* inputLinks[nb_passes];
+    Model modelKminusOne(kmerSize - 1); // it's canonical (defined in the .hpp file)
+
+    /* step 1: record the extremities of the pass. each thread fills its own partitions */
+    ThreadObject<vector<vector<Extremity> > > extremitiesPerThread = vector<vector<Extremity> > (nb_partitions);
 
-    bitset<nb_passes> finished;
-    typedef std::tuple<uint64_t /*unitig id*/, int /*pass*/, std::string /*links */> pq_elt_t;
-    priority_queue<pq_elt_t, vector<pq_elt_t>, std::greater<pq_elt_t> > pq;
-    
     BankFasta inputBank (unitigs_filename);
-    BankFasta::Iterator itSeq (inputBank);
-    itSeq.first(); 
-    string cur_links, seq, comment;
-    seq = itSeq->toString();
-    comment = itSeq->getComment();
- 
-    for (int pass = 0; pass < nb_passes; pass++)
+    Dispatcher dispatcher (nb_threads);
+
+    dispatcher.iterate (inputBank.iterator(), [&] (const Sequence& sequence)
+    {
+        vector<vector<Extremity> >& partitions = extremitiesPerThread();
+
+        const char* seq  = sequence.getDataBuffer();
+        size_t      size = sequence.getDataSize();
+        uint64_t    utig = sequence.getIndex();
+
+        // which() tells whether the canonical kmer is the forward one; we record rc otherwise
+        typename Model::Kmer kmerBegin = modelKminusOne.codeSeed (seq, Data::ASCII);
+        u_int64_t hashBegin = hash1 (kmerBegin.value());
+        if ((int)(hashBegin % nb_passes) == pass)
+        {
+            ExtremityInfo eBegin (utig, !kmerBegin.which(), UNITIG_BEGIN);
+            partitions[(hashBegin / nb_passes) % nb_partitions].push_back (Extremity (kmerBegin.value(), eBegin.pack()));
+        }
+
+        typename Model::Kmer kmerEnd = modelKminusOne.codeSeed (seq + size - (kmerSize-1), Data::ASCII);
+        u_int64_t hashEnd = hash1 (kmerEnd.value());
+        if ((int)(hashEnd % nb_passes) == pass)
+        {
+            ExtremityInfo eEnd (utig, !kmerEnd.which(), UNITIG_END);
+            partitions[(hashEnd / nb_passes) % nb_partitions].push_back (Extremity (kmerEnd.value(), eEnd.pack()));
+        }
+        // there is no UNITIG_BOTH here because we're taking (k-1)-mers.
+    });
+
+    uint64_t nb_extremities = 0;
+    extremitiesPerThread.foreach ([&] (const vector<vector<Extremity> >& partitions)
+    {
+        for (size_t p = 0; p < partitions.size(); p++)  { nb_extremities += partitions[p].size(); }
+    });
+    logging("pass " + to_string(pass) + " step 1 (" + to_string(nb_extremities) + " extremities in " + to_string(nb_partitions) + " partitions)");
+
+    /* step 2: join the extremities of each partition */
+    vector<vector<LinkTigsLink> > links (nb_partitions);
+
+    ThreadPool pool (nb_threads);
+    for (int partition = 0; partition < nb_partitions; partition++)
+    {
+        auto join_partition = [&extremitiesPerThread, &links, partition, kmerSize] (int thread_id)
+        {
+            vector<Extremity> extremities;
+            for (size_t t = 0; t < extremitiesPerThread.size(); t++)
+            {
+                vector<Extremity>& local = extremitiesPerThread[t][partition];
+                extremities.insert (extremities.end(), local.begin(), local.end());
+                vector<Extremity>().swap (local);
+            }
+
+            join_extremities_partition<Type> (kmerSize, links[partition], extremities);
+        };
+        pool.enqueue (join_partition);
+    }
+    pool.join();
+
+    /* the sorted links of the partitions are merged into the links file of the pass */
+    typedef std::pair<LinkTigsLink, size_t /*partition*/> pq_elt_t;
+    struct pq_greater { bool operator() (const pq_elt_t& a, const pq_elt_t& b) const { return a.first > b.first; } };
+    priority_queue<pq_elt_t, vector<pq_elt_t>, pq_greater> pq;
+
+    vector<size_t> positions (nb_partitions, 0);
+    for (int partition = 0; partition < nb_partitions; partition++)
     {
-        string link; uint64_t unitig;
-        inputLinks[pass] = new std::ifstream(unitigs_filename+ ".links." + to_string(pass));
-        // prime the pq with the first element in the file
-        if (get_link_from_file(*inputLinks[pass], link, unitig))
-            pq.emplace(make_tuple(unitig, pass, link));
+        if (links[partition].size() > 0)
+            pq.push (make_pair (links[partition][0], partition));
+    }
+
+    string filename = links_filename (unitigs_filename, pass);
+    System::file().remove (filename);
+    BagCache<LinkTigsLink> linksBag (new BagFile<LinkTigsLink> (filename), 8*1024);
+
+    uint64_t nb_links = 0;
+    while (pq.size() > 0)
+    {
+        size_t partition = pq.top().second;
+        linksBag.insert (pq.top().first);
+        pq.pop();
+        nb_links++;
+
+        if (++positions[partition] < links[partition].size())
+            pq.push (make_pair (links[partition][positions[partition]], partition));
         else
-            finished[pass] = true;
+            std::vector<LinkTigsLink>().swap (links[partition]);
     }
+    linksBag.flush();
+
+    logging("pass " + to_string(pass) + " step 2 (" + to_string(nb_links) + " links)");
+}
 
-    uint64_t last_unitig = 0;
-    nb_unitigs = 0; // passed variable
 
-    // nb_passes-way merge sort
-    while ((!finished.all()) || pq.size() > 0)
+/* sorts the extremities of a partition, then for each extremity, finds the other extremities
+ * with the same (k-1)-mer that can follow it. links are returned sorted by unitig extremity.
+ */
+template<typename Type>
+static void join_extremities_partition(const int kmerSize, std::vector<LinkTigsLink>& links, std::vector<LinkTigsExtremity<Type> >& extremities)
+{
+    std::sort (extremities.begin(), extremities.end());
+
+    for (size_t first = 0; first < extremities.size(); )
     {
-        pq_elt_t cur = pq.top(); pq.pop();
-        int pass = get<1>(cur);
-        uint64_t unitig = get<0>(cur);
+        size_t last = first + 1;
+        while (last < extremities.size() && extremities[last].kmer == extremities[first].kmer)  { last++; }
+
+        // treat special palindromic kmer cases
+        bool nevermindOrientation = (((kmerSize - 1) % 2) == 0) && (revcomp (extremities[first].kmer, kmerSize - 1) == extremities[first].kmer);
 
-        if (unitig != last_unitig)
+        for (size_t i = first; i < last; i++)
         {
-            Sequence s (Data::ASCII);
-            s.getData().setRef ((char*)seq.c_str(), seq.size());
-            s._comment = comment + " " + cur_links;
-            out->insert(s);
-            
-            cur_links = "";
-            nb_unitigs++;
-            last_unitig = unitig;
-            itSeq.next();
-            seq = itSeq->toString();
-            comment = itSeq->getComment();
+            ExtremityInfo e (extremities[i].packed);
+            bool sameOrientation = !e.rc;
+
+            for (size_t j = first; j < last; j++)
+            {
+                ExtremityInfo e_other (extremities[j].packed);
+                bool valid, minus;
+
+                if (e.pos == UNITIG_BEGIN)
+                {
+                    // in-neighbors. what we want are these four cases:
+                    //  ------[end same orientation] -> [begin same orientation]----
+                    //  [begin diff orientation]---- -> [begin same orientation]----
+                    //  ------[end diff orientation] -> [begin diff orientation]----
+                    //  [begin same orientation]---- -> [begin diff orientation]----
+                    valid = (((sameOrientation)  &&  (e_other.pos == UNITIG_END  ) && (e_other.rc == false)) ||
+                            ((sameOrientation)   &&  (e_other.pos == UNITIG_BEGIN) && (e_other.rc == true)) ||
+                            ((!sameOrientation)  &&  (e_other.pos == UNITIG_END  ) && (e_other.rc == true)) ||
+                            ((!sameOrientation)  &&  (e_other.pos == UNITIG_BEGIN) && (e_other.rc == false)));
+
+                    bool rc = e_other.rc ^ (!sameOrientation);
+                    minus = !rc; /* invert-reverse because of incoming orientation. it's very subtle and i'm still not sure i got it right */
+                }
+                else
+                {
+                    // out-neighbors. what we want are these four cases:
+                    //  ------[end same orientation] -> [begin same orientation]----
+                    //  ------[end same orientation] -> ------[end diff orientation]
+                    //  ------[end diff orientation] -> [begin diff orientation]----
+                    //  ------[end diff orientation] -> ------[end same orientation]
+                    valid = (((sameOrientation)  &&  (e_other.pos == UNITIG_BEGIN) && (e_other.rc == false)) ||
+                            ((sameOrientation)   &&  (e_other.pos == UNITIG_END  ) && (e_other.rc == true)) ||
+                            ((!sameOrientation)  &&  (e_other.pos == UNITIG_BEGIN) && (e_other.rc == true)) ||
+                            ((!sameOrientation)  &&  (e_other.pos == UNITIG_END  ) && (e_other.rc == false)));
+
+                    bool rc = e_other.rc ^ (!sameOrientation);
+                    minus = rc; /* logically this is going to be opposite of the incoming case */
+                }
+
+                if (!(valid || nevermindOrientation))  { continue; }
+
+                if (nevermindOrientation && (e_other.unitig == e.unitig)) continue; // don't consider the same extremity
+
+                uint64_t extremity = (e.unitig << 1) | (e.pos == UNITIG_END ? 1 : 0);
+                uint64_t link      = (e_other.unitig << 3) | ((e_other.pos == UNITIG_END ? 1 : 0) << 2);
+
+                links.push_back (LinkTigsLink (extremity, link | (minus ? 1 : 0)));
+
+                /* in that case, there is also another link with the reverse direction*/
+                if (nevermindOrientation)
+                    links.push_back (LinkTigsLink (extremity, link | 2 | (minus ? 0 : 1)));
+            }
         }
-            
-        cur_links += get<2>(cur);
-        //if (unitig < 10)  std::cout << " popped " << pass << " " << unitig << " " << cur_links << std::endl; // debug
-
-        // read next entry in the inputLinks[pass] file that we just popped
-        if (finished[pass])
-            continue;
-        string link;
-        if (get_link_from_file(*inputLinks[pass], link, unitig))
-            pq.emplace(make_tuple(unitig, pass, link));
-        else
-            finished[pass] = true;
 
+        first = last;
     }
-    // write the last element
-    Sequence s (Data::ASCII);
-    s.getData().setRef ((char*)seq.c_str(), seq.size());
-    s._comment = comment + " " + cur_links;
-    out->insert(s);
-    nb_unitigs++;
 
-    for (int pass = 0; pass < nb_passes; pass++)
-    {
-        system::impl::System::file().remove (unitigs_filename + ".links." + to_string(pass));
-        delete inputLinks[pass];
-    }
+    std::vector<LinkTigsExtremity<Type> >().swap (extremities);
+
+    std::sort (links.begin(), links.end());
 }
 
 
@@ -160,214 +336,88 @@ static inline int nt2int(char nt)
     return 0;
 }
 
-/* that code doesn't support more than 8 passes*/
-static int normalized_smallmer(const unsigned char c1, const unsigned char c2, const unsigned char c3, const unsigned char c4)
+/* former link_tigs went through 8 passes, chosen by the first two and last two nucleotides of each extremity,
+ * and wrote the links of a unitig in the order of the passes of its extremities (begin first if they're equal).
+ * we keep that order so that the unitigs file doesn't change. */
+static constexpr int links_order_passes = 8;
+
+static int links_order_pass(const char* seq, int kmerSize)
 {
-    unsigned char smallmer = (nt2int(c1)<<6) + (nt2int(c2)<<4) + (nt2int(c3)<<2) + nt2int(c4);
+    unsigned char smallmer = (nt2int(seq[0])<<6) + (nt2int(seq[1])<<4) + (nt2int(seq[kmerSize-1-1-1])<<2) + nt2int(seq[kmerSize-1-1]);
     const unsigned char rev = revcomp_4NT[smallmer];
     if (rev < smallmer)
         smallmer = rev;
-    return smallmer;
+    return smallmer % links_order_passes;
 }
 
-static bool
-is_in_pass (const std::string &seq, int pass, Unitig_pos p, int kmerSize) // TODO this is so un-even. should do more proper hashing..
+/*
+ * merges the sorted links files of all passes (n-way merge on binary records)
+ * to write each unitig with its links, in unitig order. the unitigs file is read only once.
+ */
+static void write_final_output(const string& unitigs_filename, const int kmerSize, BankFasta* out, const int nb_passes, uint64_t &nb_unitigs)
 {
-    int e = 0;
-    if (p == UNITIG_END)
-        e = seq.size()-(kmerSize-1);
-    // x = 0123456789
-    // k = 5, k-1=4
-    // seq.size()-1-(k-1) = 10-4 = 6
-    return (normalized_smallmer(seq[e],seq[e+1],seq[e+kmerSize-1-1-1],seq[e+kmerSize-1-1]) % nb_passes) == pass;
-}
+    logging("writing unitigs with their links");
 
-/* returns true if it has read an element, false otherwise */
-static bool get_link_from_file(std::ifstream& input, std::string &link, uint64_t &unitig_id)
-{
-    string line;
-    if (std::getline(input, line))
-    {
-        unitig_id = stoull(line);
-    }
-    else
-        return false;
-    if (std::getline(input, link))
+    typedef std::pair<LinkTigsLink, int /*pass*/> pq_elt_t;
+    struct pq_greater { bool operator() (const pq_elt_t& a, const pq_elt_t& b) const { return a.first > b.first; } };
+    priority_queue<pq_elt_t, vector<pq_elt_t>, pq_greater> pq;
+
+    vector<IteratorFile<LinkTigsLink>*> inputLinks (nb_passes);
+    for (int pass = 0; pass < nb_passes; pass++)
     {
+        inputLinks[pass] = new IteratorFile<LinkTigsLink> (links_filename (unitigs_filename, pass));
+        inputLinks[pass]->first();
+        if (!inputLinks[pass]->isDone())
+            pq.push (make_pair (inputLinks[pass]->item(), pass));
     }
-    else
-        return false;
-    return true;
-}
-
-
-static void record_links(uint64_t utig_id, int pass, const string &link, std::ofstream &links_file)
-{
-    // maybe do a buffered thing here but it's not clear if it is bottleneck. in CAMI-medium it took 6 mins without if i don't write the links_file and 8 mins if i do..
-    links_file << to_string(utig_id) << "\n";
-    links_file << link << "\n";
-}
-
-
-template<size_t span>
-void link_unitigs_pass(const string unitigs_filename, bool verbose, const int pass, const int kmerSize)
-{
-    typedef typename kmer::impl::Kmer<span>::ModelCanonical Model;
-    typedef typename kmer::impl::Kmer<span>::Type           Type;
-
-    bool debug = false;
 
     BankFasta inputBank (unitigs_filename);
     BankFasta::Iterator itSeq (inputBank);
-    uint64_t utig_counter = 0;
-    
-    Model modelKminusOne(kmerSize - 1); // it's canonical (defined in the .hpp file)
-    
-    typedef typename std::unordered_map<Type, std::vector<uint64_t>> NodeLinksMap;
-
-    NodeLinksMap utigs_links_map;
-
-    logging("step 1 pass " + to_string(pass));
-
-    // this is the memory-limiting step, but can be lowered with larger nb_pass
-    for (itSeq.first(); !itSeq.isDone(); itSeq.next()) 
-    {
-        const string& seq = itSeq->toString();
-        if (debug) std::cout << "unitig: " << seq << std::endl;
-
-        if (is_in_pass(seq, pass, UNITIG_BEGIN, kmerSize))
-        { 
-            if (debug) std::cout << "pass " << pass << " examining beginning" << std::endl;
-            typename Model::Kmer kmerBegin = modelKminusOne.codeSeed(seq.substr(0, kmerSize-1).c_str(), Data::ASCII);
-            bool beginInSameOrientation = modelKminusOne.toString(kmerBegin.value()) == seq.substr(0,kmerSize-1);
-            ExtremityInfo eBegin(utig_counter, !beginInSameOrientation /* because we record rc*/, UNITIG_BEGIN);
-            utigs_links_map[kmerBegin.value()].push_back(eBegin.pack());
-        }
-        if (is_in_pass(seq, pass, UNITIG_END, kmerSize))
-        {
-            if (debug) std::cout << "pass " << pass << " examining end" << std::endl;
-            typename Model::Kmer kmerEnd = modelKminusOne.codeSeed(seq.substr(seq.size() - kmerSize+1).c_str(), Data::ASCII);
-            bool endInSameOrientation = modelKminusOne.toString(kmerEnd.value()) == seq.substr(seq.size() - kmerSize+1);
-            ExtremityInfo eEnd(  utig_counter, !endInSameOrientation,                             UNITIG_END);
-            utigs_links_map[kmerEnd.value()].push_back(eEnd.pack());
-            // there is no UNITIG_BOTH here because we're taking (k-1)-mers.
-        }
-        utig_counter++;
-    }
 
-    std::ofstream links_file(unitigs_filename+".links." +to_string(pass));
-
-    uint64_t nb_hashed_entries = 0;
-    for (auto v : utigs_links_map)
-        nb_hashed_entries += v.second.size(); 
-    logging("step 2 (" + to_string(utigs_links_map.size()) + "kmers/" + to_string(nb_hashed_entries) + "extremities)");
+    nb_unitigs = 0; // passed variable
+    string in_links, out_links;
 
-    utig_counter = 0;
-    for (itSeq.first(); !itSeq.isDone(); itSeq.next()) 
+    for (itSeq.first(); !itSeq.isDone(); itSeq.next())
     {
-        const string& seq = itSeq->toString();
-        
-        if (debug) std::cout << "unitig: " << seq << std::endl;
- 
-        if (is_in_pass(seq, pass, UNITIG_BEGIN, kmerSize))
-        {
-            if (debug) std::cout << "pass " << pass << " examining beginning" << std::endl;
-            typename Model::Kmer kmerBegin = modelKminusOne.codeSeed(seq.substr(0, kmerSize-1).c_str(), Data::ASCII);
-            bool beginInSameOrientation =  modelKminusOne.toString(kmerBegin.value()) == seq.substr(0,kmerSize-1); // that could be optimized, revcomp was already computed during codeSeed
-            // treat special palindromic kmer cases
-            bool nevermindInOrientation = false;
-            if (((kmerSize - 1) % 2) == 0) 
-                if (kmerBegin.isPalindrome()) nevermindInOrientation = true;
-
-            string in_links = " "; // necessary placeholder to indicate we have links for that unitig
-
-            // in-neighbors
-            for (auto in_packed : utigs_links_map[kmerBegin.value()])
-            {
-                ExtremityInfo e_in(in_packed);
-
-                if (debug) std::cout << "extremity " << modelKminusOne.toString(kmerBegin.value()) << " ";
-                if (debug) std::cout << "potential in-neighbor: " << e_in.toString() << " beginSameOrientation " << beginInSameOrientation;
-
-                // what we want are these four cases:
-                //  ------[end same orientation] -> [begin same orientation]----
-                //  [begin diff orientation]---- -> [begin same orientation]----
-                //  ------[end diff orientation] -> [begin diff orientation]----
-                //  [begin same orientation]---- -> [begin diff orientation]----
-                if ((((beginInSameOrientation)  &&  (e_in.pos == UNITIG_END  ) && (e_in.rc == false)) ||
-                            ((beginInSameOrientation) &&  (e_in.pos == UNITIG_BEGIN) && (e_in.rc == true)) ||
-                            (((!beginInSameOrientation)) && (e_in.pos == UNITIG_END  ) && (e_in.rc == true)) ||
-                            (((!beginInSameOrientation)) && (e_in.pos == UNITIG_BEGIN) && (e_in.rc == false)))
-                        || nevermindInOrientation)
-                {
-                    if (nevermindInOrientation && (e_in.unitig == utig_counter)) continue; // don't consider the same extremity
-
-                    // this was for when i was wanting to save space while storing links in memory. now storing on disk
-                    //LinkInfo li(e_in.unitig, e_in.rc ^ beginInSameOrientation);
-                    //incoming[utig_number].push_back(li.pack());
-                    bool rc = e_in.rc ^ (!beginInSameOrientation);
-                    in_links += "L:-:" + to_string(e_in.unitig) + ":" + (rc?"+":"-") + " "; /* invert-reverse because of incoming orientation. it's very subtle and i'm still not sure i got it right */
-                    if (nevermindInOrientation)
-                       in_links += "L:-:" + to_string(e_in.unitig) + ":" + ((!rc)?"+":"-") + " "; /* in that case, there is also another link with the reverse direction*/
-
-                    if (debug) std::cout << " [valid] ";
-                }
-                if (debug) std::cout << std::endl;
-            }
-            
-            record_links(utig_counter, pass, in_links, links_file);
-        }
+        uint64_t unitig = nb_unitigs;
 
+        // the placeholders are necessary to indicate we have links for that unitig
+        in_links  = " ";
+        out_links = " ";
 
-        if (is_in_pass(seq, pass, UNITIG_END, kmerSize))
+        while (pq.size() > 0 && (pq.top().first.extremity >> 1) == unitig)
         {
-            if (debug) std::cout << "pass " << pass << " examining end" << std::endl;
-            typename Model::Kmer kmerEnd = modelKminusOne.codeSeed(seq.substr(seq.size() - kmerSize+1).c_str(), Data::ASCII);
-            bool endInSameOrientation =  modelKminusOne.toString(kmerEnd.value()) == seq.substr(seq.size() - kmerSize+1);
+            const LinkTigsLink& cur = pq.top().first;
+            int pass = pq.top().second;
 
-            bool nevermindOutOrientation = false;
-            if (((kmerSize - 1) % 2) == 0) 
-                if (kmerEnd.isPalindrome())   nevermindOutOrientation = true;
+            bool outcoming = cur.extremity & 1;
+            (outcoming ? out_links : in_links) += string(outcoming ? "L:+:" : "L:-:") + to_string(cur.link >> 3) + ((cur.link & 1) ? ":- " : ":+ ");
 
-            string out_links = " "; // necessary placeholder to indicate we have links for that unitig
+            pq.pop();
 
-            // out-neighbors
-            for (auto out_packed : utigs_links_map[kmerEnd.value()])
-            {
-                ExtremityInfo e_out(out_packed);
-
-                if (debug) std::cout << "extremity " << modelKminusOne.toString(kmerEnd.value()) << " ";
-                if (debug) std::cout << "potential out-neighbor: " << e_out.toString();
-
-                // what we want are these four cases:
-                //  ------[end same orientation] -> [begin same orientation]----
-                //  ------[end same orientation] -> ------[end diff orientation]
-                //  ------[end diff orientation] -> [begin diff orientation]----
-                //  ------[end diff orientation] -> ------[end same orientation]
-                if ((((endInSameOrientation) && (e_out.pos == UNITIG_BEGIN) && (e_out.rc == false)) ||
-                            ((endInSameOrientation) && (e_out.pos == UNITIG_END  ) && (e_out.rc == true)) ||
-                            (((!endInSameOrientation)) && (e_out.pos == UNITIG_BEGIN) && (e_out.rc == true)) ||
-                            (((!endInSameOrientation)) && (e_out.pos == UNITIG_END  ) && (e_out.rc == false)))
-                        ||nevermindOutOrientation)
-                {
-                    if (nevermindOutOrientation && (e_out.unitig == utig_counter)) continue; // don't consider the same extremity
+            // read next entry in the pass that we just popped
+            inputLinks[pass]->next();
+            if (!inputLinks[pass]->isDone())
+                pq.push (make_pair (inputLinks[pass]->item(), pass));
+        }
 
-                    //LinkInfo li(e_out.unitig, e_out.rc ^ endInSameOrientation);
-                    //outcoming[utig_number].push_back(li.pack());
-                    bool rc = e_out.rc ^ (!endInSameOrientation);
-                    out_links += "L:+:" + to_string(e_out.unitig) + ":" + (rc?"-":"+") + " "; /* logically this is going to be opposite of the line above */ 
+        const char* seq  = itSeq->getDataBuffer();
+        size_t      size = itSeq->getDataSize();
+        bool endFirst = links_order_pass (seq + size - (kmerSize-1), kmerSize) < links_order_pass (seq, kmerSize);
 
-                    if (nevermindOutOrientation)
-                        out_links += "L:+:" + to_string(e_out.unitig) + ":" + ((!rc)?"-":"+") + " "; /* in that case, there is also another link with the reverse direction*/
+        Sequence s (Data::ASCII);
+        s.getData().setRef (itSeq->getDataBuffer(), itSeq->getDataSize());
+        s._comment = itSeq->getComment() + " " + (endFirst ? out_links + in_links : in_links + out_links);
+        out->insert(s);
 
-                    if (debug) std::cout << " [valid] ";
-                }
-                if (debug) std::cout << std::endl;
-            }
-            record_links(utig_counter, pass, out_links, links_file);
-        }
+        nb_unitigs++;
+    }
+    out->flush();
 
-        utig_counter++;
+    for (int pass = 0; pass < nb_passes; pass++)
+    {
+        delete inputLinks[pass];
+        system::impl::System::file().remove (links_filename (unitigs_filename, pass));
     }
 }
 
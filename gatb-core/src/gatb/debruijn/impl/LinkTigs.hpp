@@ -29,11 +29,9 @@
 namespace gatb { namespace core { namespace debruijn { namespace impl  {
 
 
+    /* max_memory is in MBytes (0 for the memory of the machine); it sets the number of passes over the extremities */
     template<size_t SPAN>
-    void link_tigs( std::string prefix, int kmerSize, int nb_threads, uint64_t &nb_unitigs, bool verbose);
-
-    template<size_t span>
-    void link_unitigs_pass(const std::string unitigs_filename, bool verbose, const int pass, const int kmerSize);
+    void link_tigs( std::string prefix, int kmerSize, int nb_threads, uint64_t &nb_unitigs, bool verbose, uint64_t max_memory = 0);
     
 }}}}
 
@@ -42,40 +42,25 @@ class NodesDeleter
 
     public:
         uint64_t nbNodes;
-        std::vector<bool> nodesToDelete; // don't delete while parallel traversal, do it afterwards
-        std::set<Node> setNodesToDelete; 
+        std::vector<u_int64_t> nodesToDelete; // don't delete while parallel traversal, do it afterwards. one bit per node, indexed by the MPHF
+        uint64_t nbNodesToDelete;
+        std::set<Node> setNodesToDelete; // only for graphs whose nodes aren't indexed by a MPHF (GraphUnitigs)
         Graph &  _graph;
         int _nbCores;
         bool _verbose;
-        bool useList, onlyListMethod;
-        unsigned long explicitLimit;
+        bool onlyListMethod;
         system::ISynchronizer* synchro;
 
-    NodesDeleter(Graph&  graph, uint64_t nbNodes, int nbCores, bool verbose=true) : nbNodes(nbNodes), _graph(graph), _nbCores(nbCores), _verbose(verbose)
+    NodesDeleter(Graph&  graph, uint64_t nbNodes, int nbCores, bool verbose=true) : nbNodes(nbNodes), nbNodesToDelete(0), _graph(graph), _nbCores(nbCores), _verbose(verbose)
     {
-        nodesToDelete.resize(nbNodes); // number of graph nodes // (!) this will alloc 1 bit per kmer.
-        for (unsigned long i = 0; i < nbNodes; i++)
-            nodesToDelete[i] = false;
-
-        /* use explicit set of nodes as long as we don't have more than 10 M nodes ok? 
-         * else resort to bit array
-         * 10M nodes, assuming 128 bytes per nodes (generous), is 1 gig.
-         * for k=21 it's actually closer to 24 bytes per node.
-         * so, WARNING: enabling this feature uses more memory. 
-         * todo: someday, introduce a --fast parameter that uses a bit more memory but does optimizations like this
-         */
-        //std::cout << "sizeof node: " << sizeof(Node) << std::endl;
-        useList = true;
+        /* 1 bit per kmer. Bits are set with atomic operations, so that threads marking
+         * nodes during a parallel traversal never wait for each other.
+         * (this replaces a std::set of nodes, which could use GBs on large graphs, and a lock) */
+        nodesToDelete.resize((nbNodes + 63) / 64, 0);
+
         onlyListMethod = false;
-          
-        // compute a fair amount of nodes that can be kept of memory
-        // (before, was only 10M)
-        explicitLimit = std::max((uint64_t)(nbNodes / 100), (uint64_t)10000000); 
-        // for bacteria it's 10M
-        // for human it's roughly 20M
-        // for spruce it's roughly 300M
-  
-        // set insertions aren't thread safe, so let's use a synchronizer
+
+        // set insertions aren't thread safe, so let's use a synchronizer (list method, and cache of non simple nodes in the graph)
         synchro = system::impl::System::thread().newSynchronizer();
     }
 
@@ -83,12 +68,12 @@ class NodesDeleter
 
     bool get(uint64_t index)
     {
-        return nodesToDelete[index];
+        return (nodesToDelete[index >> 6] >> (index & 63)) & 1;
     }
     
     bool get(Node &node)
     {
-        if (useList)
+        if (onlyListMethod)
         {
             return (setNodesToDelete.find(node) != setNodesToDelete.end());
         }
@@ -101,28 +86,25 @@ class NodesDeleter
 
     void markToDelete(Node &node)
     {
-        if (!onlyListMethod)
-        {
-            unsigned long index =_graph.nodeMPHFIndex(node);
-            nodesToDelete[index] = true;
-        }
-
-        if (useList)
+        if (onlyListMethod)
         {
             synchro->lock();
             setNodesToDelete.insert(node);
             synchro->unlock();
+            return;
         }
 
-        if ((!onlyListMethod) && (setNodesToDelete.size() > explicitLimit))
-            useList = false;
+        unsigned long index =_graph.nodeMPHFIndex(node);
+        u_int64_t mask = (u_int64_t)1 << (index & 63);
 
+        if ((__sync_fetch_and_or (&nodesToDelete[index >> 6], mask) & mask) == 0)
+            __sync_fetch_and_add (&nbNodesToDelete, 1);
     }
 
    // TODO speed: tell graph whenever all the neighbors of a node will be deleted too, that way, don't need to update their adjacency! 
     void flush()
     {
-        if (useList)
+        if (onlyListMethod)
         {
             if (_verbose)
                 std::cout << "NodesDeleter mem usage prior to flush: " << (setNodesToDelete.size() * sizeof(Node)) / 1024 / 1024 << " MB" << std::endl;
@@ -135,7 +117,11 @@ class NodesDeleter
         }
         else
         {
-            _graph.deleteNodesByIndex(nodesToDelete, _nbCores, synchro);
+            if (_verbose)
+                std::cout << "NodesDeleter: " << nbNodesToDelete << " nodes to delete, bitmap of " << (nodesToDelete.size() * sizeof(u_int64_t)) / 1024 / 1024 << " MB" << std::endl;
+
+            if (nbNodesToDelete > 0)
+                _graph.deleteNodesByIndex(nodesToDelete, _nbCores, synchro);
         }
     }
 
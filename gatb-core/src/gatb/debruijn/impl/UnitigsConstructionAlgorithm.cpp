@@ -102,6 +102,8 @@ void UnitigsConstructionAlgorithm<span>::execute ()
     int minimizer_type =
         getInput()->getInt(STR_MINIMIZER_TYPE);
     bool verbose = getInput()->getInt(STR_VERBOSE);
+    u_int64_t max_memory =
+        getInput()->get(STR_MAX_MEMORY) ? getInput()->getInt(STR_MAX_MEMORY) : 0;
     
     unsigned int nbThreads = this->getDispatcher()->getExecutionUnitsNumber();
     if ((unsigned int)nb_threads > nbThreads)
@@ -109,7 +111,7 @@ void UnitigsConstructionAlgorithm<span>::execute ()
 
     if (do_bcalm) bcalm2<span>(&_storage, unitigs_filename, kmerSize, abundance, minimizerSize, nbThreads, minimizer_type, verbose); 
     if (do_bglue) bglue<span> (&_storage, unitigs_filename, kmerSize,                           nbThreads,                 verbose);
-    if (do_links) link_tigs<span>(unitigs_filename, kmerSize, nbThreads, nb_unitigs, verbose);
+    if (do_links) link_tigs<span>(unitigs_filename, kmerSize, nbThreads, nb_unitigs, verbose, max_memory);
 
     /** We gather some statistics. */
     // nb_unitigs will be used in GraphUnitigs
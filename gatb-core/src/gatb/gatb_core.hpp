@@ -41,6 +41,7 @@
 #include <gatb/tools/collections/impl/BloomGroup.hpp>
 #include <gatb/tools/collections/impl/ContainerSet.hpp>
 #include <gatb/tools/collections/impl/Hash16.hpp>
+#include <gatb/tools/collections/impl/HashCounter.hpp>
 #include <gatb/tools/collections/impl/IteratorFile.hpp>
 #include <gatb/tools/collections/impl/OAHash.hpp>
 #include <gatb/tools/collections/impl/IterableHelpers.hpp>
@@ -78,7 +78,7 @@ public:
      * \param[in] bloomSize : the size (in bits) of the Bloom filter to be created
      * \param[in] nbHash : number of hash functions of the Bloom filter.
      * \param[in] ksize : the kmer size is needed
-     * \param[in] bloomKind : kind of Bloom filter to be created
+     * \param[in] bloomKind : kind of Bloom filter to be created (any kind of BloomFactory, 'blocked' included)
      * \param[in] nbCores : number of cores to be used for the iteration of items to be inserted
      * \param[in] min_abundance : if >0, only kmers having abundance greater than that threshold are inserted into the Bloom filter.
      *                            otherwise all items are inserted.
@@ -120,7 +120,7 @@ public:
         if (stats != 0)
         {
             //stats->add (0, "bloom");
-            stats->add (0, "size",    "%lld", _bloomSize);
+            stats->add (0, "size",    "%lld", bloom->getBitSize());
             stats->add (0, "nb_hash", "%d",   _nbHash);
         }
 
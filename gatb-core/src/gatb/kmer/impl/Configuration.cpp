@@ -70,8 +70,12 @@ Properties Configuration::getProperties() const
 	
     result.add (1, "available_space",   "%ld", _available_space);
     result.add (1, "sequence_number",   "%ld", _estimateSeqNb);
+    if (_estimateSeqError >= 0)  {  result.add (1, "sequence_number_error", "%.2f%%", 100 * _estimateSeqError);  }
+    else                         {  result.add (1, "sequence_number_error", "unknown");  }
     result.add (1, "sequence_volume",   "%ld", _estimateSeqTotalSize / system::MBYTE);
     result.add (1, "kmers_number",      "%ld", _kmersNb);
+    result.add (1, "kmers_distinct_ratio", "%.3f", _kmersDistinctRatio);
+    result.add (1, "solid_kmers_estimate", "%ld", _solidKmersEstimate);
     result.add (1, "kmers_volume",      "%ld", _volume);
     result.add (1, "max_disk_space",    "%ld", _max_disk_space);
     result.add (1, "max_memory",        "%ld", _max_memory);
@@ -81,6 +85,14 @@ Properties Configuration::getProperties() const
     result.add (1, "nb_cores",          "%d",  _nbCores);
     result.add (1, "minimizer_type",    "%s",  (_minimizerType == 0) ? "lexicographic (kmc2 heuristic)" : "frequency");
     result.add (1, "repartition_type",  "%s",  (_repartitionType == 0) ? "unordered" : "ordered");
+    result.add (1, "sort_kind",         "%s",  toString(_sortKind).c_str());
+    result.add (1, "nb_dump_ranges",    "%d",  _nbDumpRanges);
+    result.add (1, "superk_mmap",       "%d",  _superkMmap);
+    result.add (1, "superk_readahead",  "%d",  _superkReadahead);
+    result.add (1, "superk_compress",   "%d",  _superkCompress);
+    result.add (1, "superk_in_memory",  "%d",  _superkInMemory);
+    result.add (1, "superk_arena_memory", "%d", _superkArenaMemory);
+    result.add (1, "bloom_count_memory", "%d", _bloomCountMemory);
 
     result.add (1, "nb_cores_per_partition",     "%d",  _nbCores_per_partition);
     result.add (1, "nb_partitions_in_parallel",  "%d",  _nb_partitions_in_parallel);
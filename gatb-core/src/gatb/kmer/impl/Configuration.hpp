@@ -42,11 +42,12 @@ public:
     /** */
     Configuration ()
     : _kmerSize(0), _minim_size(0), _repartitionType(0), _minimizerType(0),
-      _solidityKind(tools::misc::KMER_SOLIDITY_SUM),
+      _solidityKind(tools::misc::KMER_SOLIDITY_SUM), _sortKind(tools::misc::KMER_SORT_DEFAULT), _nbDumpRanges(0),
+      _superkMmap(false), _superkReadahead(false), _superkCompress(0), _superkMemory(1), _superkInMemory(false), _superkArenaMemory(0), _bloomCountBits(0),
       _max_disk_space(0), _max_memory(0),
       _nbCores(0), _nb_partitions_in_parallel(0), _abundanceUserNb(0), _storage_type(tools::storage::impl::STORAGE_HDF5) ,
       _isComputed(false), _nbCores_per_partition(0),
-      _estimateSeqNb(0), _estimateSeqTotalSize(0), _estimateSeqMaxSize(0),
+      _estimateSeqNb(0), _estimateSeqTotalSize(0), _estimateSeqMaxSize(0), _estimateSeqError(-1), _kmersDistinctRatio(0), _solidKmersEstimate(0), _bloomCountMemory(0),
       _available_space(0), _volume(0), _kmersNb(0), _nb_passes(0), _nb_partitions(0), _nb_bits_per_kmer(0), _nb_banks(0) {}
 
     /****************************************/
@@ -60,6 +61,20 @@ public:
 
     tools::misc::KmerSolidityKind _solidityKind;
 
+    tools::misc::KmerSortKind _sortKind;
+
+    size_t      _nbDumpRanges;
+
+    bool        _superkMmap;
+    bool        _superkReadahead;
+    size_t      _superkCompress;
+    size_t      _superkMemory;
+    bool        _superkInMemory;
+    u_int32_t   _superkArenaMemory;  // MBytes kept for the in memory partitions, not available for counting
+
+    /** Bits per solid kmer of a Bloom filter filled during the counting (0 for none), see CountProcessorBloom. */
+    float       _bloomCountBits;
+
     u_int64_t   _max_disk_space;
     u_int32_t   _max_memory;
 
@@ -86,6 +101,16 @@ public:
     u_int64_t   _estimateSeqTotalSize;
     u_int64_t   _estimateSeqMaxSize;
 
+    /** Relative standard error of _estimateSeqNb (negative if unknown) and ratio of distinct kmers
+     * in the first kmers of the bank. They are not saved in the storage. */
+    double      _estimateSeqError;
+    double      _kmersDistinctRatio;
+
+    /** Upper bound of the number of solid kmers, and memory (in MBytes) kept for the Bloom filter
+     * filled during the counting. They are not saved in the storage either. */
+    u_int64_t   _solidKmersEstimate;
+    u_int32_t   _bloomCountMemory;
+
     u_int64_t   _available_space;
     u_int64_t   _volume;
     u_int64_t   _kmersNb;
@@ -105,6 +130,10 @@ public:
     /****************************************/
     tools::misc::impl::Properties getProperties() const;
 
+    /** Memory (in MBytes) left for counting the partitions, ie. the max memory without the in memory
+     * partitions and the Bloom filter filled during the counting. */
+    u_int64_t getCountingMemory() const  {  return _max_memory - _superkArenaMemory - _bloomCountMemory;  }
+
     /** Load config properties from a storage object.
      * \param[in] group : group where the repartition table has to be loaded */
     void load (tools::storage::impl::Group& group);
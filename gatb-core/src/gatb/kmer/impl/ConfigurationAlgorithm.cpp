@@ -22,7 +22,7 @@
 #include <gatb/tools/collections/impl/OAHash.hpp>
 #include <gatb/tools/misc/api/StringsRepository.hpp>
 #include <gatb/tools/misc/impl/Tokenizer.hpp>
-#include <gatb/kmer/impl/LinearCounter.hpp>
+#include <gatb/kmer/impl/HyperLogLog.hpp>
 
 #include <cmath>
 
@@ -52,6 +52,9 @@ using namespace gatb::core::tools::misc::impl;
 
 #define DEBUG(a)  //printf a
 
+/** Number of kmers used for estimating the ratio of distinct kmers. */
+#define DISTINCT_KMERS_SAMPLE  (4*1000*1000)
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -61,119 +64,48 @@ using namespace gatb::core::tools::misc::impl;
 ** REMARKS :
 *********************************************************************/
 
-// estimated the number of distinct kmers in a dataset
-// wrapper around a Linear Counter. Adapted from Kmergenie code.
-// why not a hyperloglog? it seems that the transition from the 32bit-hash initial implementation to 64bits, and supporting billions of elements, is nontrivial, so i didn't bother
-// probably deserves to be in its own file
+// estimates the ratio of distinct kmers in the first kmers of a dataset, with a HyperLogLog counter
 template<size_t span>
 class EstimateNbDistinctKmers
 {
 public:
 
     /** Shortcut. */
-    typedef typename Kmer<span>::Type  Type;
-    typedef typename Kmer<span>::ModelDirect     ModelDirect;
-    typedef typename Kmer<span>::ModelCanonical  ModelCanonical;
-#ifdef NONCANONICAL 
-    typedef typename Kmer<span>::template ModelMinimizer <ModelDirect>   Model;
+#ifdef NONCANONICAL
+    typedef typename Kmer<span>::ModelDirect     Model;
 #else
-    typedef typename Kmer<span>::template ModelMinimizer <ModelCanonical>   Model;
+    typedef typename Kmer<span>::ModelCanonical  Model;
 #endif
-    typedef typename Model::Kmer                        KmerType;
+    typedef typename Model::Kmer                 KmerType;
 
-    /** */
-    void estimate()
-    {
-        nb_distinct_kmers =(unsigned long)( (float)(linearCounter->count( )) * ((float)nbKmersTotal / (float)nbProcessedKmers)); // dubious linear extrapolation, that's all I got
-
-        abs_error = abs((long)(nb_distinct_kmers-previous_nb_distinct_kmers));
-
-        previous_nb_distinct_kmers = nb_distinct_kmers;
-    }
+    EstimateNbDistinctKmers (Model& model) : model(model), nbKmers(0)  {}
 
     /** */
     void operator() (Sequence& sequence)
     {
-        /** We build the kmers from the current sequence. */
-        if (model.build (sequence.getData(), kmers) == false)  {  throw "reached EOF"; return; }
-
-        /** We loop over the kmers. */
-        for (size_t i=0; i<kmers.size(); i++)
-        {
-            linearCounter->add((kmers[i].value()));
-
-
-            // heuristics to stop early, i found that it's inaccurate with low coverage (e.g. on dsk/test/FiftyK.fastq)
-            /*
-            if (nbProcessedReads % eval_every_N_reads == 0 )
-            {
-
-                // let's see if the estimation converges..
-                // the following stopping condition will grossly over-estimate the number of distinct kmers
-                // but I expect the correct result to be in the same order of magnitude
-                // and better to overestimate than underestimate (for both dsk and kmergenie)
-                   estimate();
-                   bool debug = true;
-                   if (debug)
-                       printf("linear estimator at %ld kmers, number of distinct kmers estimated now: %ld, abs error: %ld\n",nbProcessedKmers, nb_distinct_kmers, abs_error);
-                   if (abs_error < previous_nb_distinct_kmers/20) // 5% error
-                   {
-                       throw "LinearCounter converged"; // well, "converged" is a big word
-                       return;
-                   }
-                   if (!linearCounter->is_accurate())
-                   {
-                   printf("LinearCounter is inaccurate";
-                   return;
-                   }
-
-            }*/
+        /** We build the kmers from the current sequence (none if it is shorter than k). */
+        if (model.build (sequence.getData(), kmers) == false)  { return; }
 
-        }
-        nbProcessedKmers += kmers.size();
-        nbProcessedReads++;
-        //if (nbProcessedReads % 100000 == 0) printf("nb: %ld\n",nbProcessedReads);
+        for (size_t i=0; i<kmers.size(); i++)  {  counter.add (kmers[i].value());  }
 
-        // disabled progress
-        //if (nbCurProgressKmers > 500000)   {  _progress.inc (nbCurProgressKmers);  nbCurProgressKmers = 0;  }
+        nbKmers += kmers.size();
     }
 
-    EstimateNbDistinctKmers (Model& model, u_int32_t max_memory, unsigned long nb_kmers_total, tools::dp::IteratorListener* progress)
-        : model(model),  eval_every_N_reads(10000000),   nbKmersTotal(nb_kmers_total),
-        nbProcessedKmers(0), nbCurProgressKmers(0), previous_nb_distinct_kmers(0), nbProcessedReads(0), abs_error(0)
-        //, _progress  (progress,System::thread().newSynchronizer())
-    {
-        unsigned long size_linearCounter; // (in bits)
-        /* let's set it to just use half of all memory available at most, ok? this isn't very robust for huge dataset, so to be tested*/
-        /* if it's a tiny dataset, let's set it to total number of kmers */
-        size_linearCounter = std::min( nb_kmers_total, (unsigned long) (max_memory*8*1024*1024/2) );
-        linearCounter =  new LinearCounter<span>(size_linearCounter);
-    }
+    /** \return the number of kmers given to the counter. */
+    u_int64_t getNbKmers () const  { return nbKmers; }
 
-    unsigned long getEstimation()
-    {
-        estimate();
-        // soo.. if it's not accurate, let's assume we have a hugeload of kmers, and let's be safe, we return the total number of kmers
-        if (!linearCounter->is_accurate())
-        {
-            cout << "Warning: linear counter was not accurate, returning worst-case estimation of number of distinct kmers";
-            return nbKmersTotal;
-        }
-        return nb_distinct_kmers;
-    }
+    /** \return the ratio of distinct kmers among the kmers given to the counter. */
+    double getRatio () const  {  return nbKmers > 0 ? std::min (1.0, (double)counter.count() / nbKmers) : 0;  }
+
+    /** \return the relative standard error of the ratio. */
+    double getError () const  {  return counter.getError();  }
 
 private:
 
-    /** Local resources. */
-    Model&    model;
-    unsigned long nbProcessedReads, nbProcessedKmers;
-    unsigned long nbCurProgressKmers;
-    unsigned long nbKmersTotal;
-    unsigned long abs_error;
-    vector<KmerType> kmers;
-    LinearCounter<span> *linearCounter;
-    int eval_every_N_reads;
-    unsigned long previous_nb_distinct_kmers, nb_distinct_kmers;
+    Model&            model;
+    vector<KmerType>  kmers;
+    HyperLogLog<span> counter;
+    u_int64_t         nbKmers;
 };
 
 
@@ -199,6 +131,15 @@ ConfigurationAlgorithm<span>::ConfigurationAlgorithm (bank::IBank* bank, IProper
 
     parse (input->getStr (STR_SOLIDITY_KIND), _config._solidityKind);
 
+    if (input->get(STR_SORT_KIND))  {  parse (input->getStr (STR_SORT_KIND), _config._sortKind);  }
+
+    _config._nbDumpRanges       = input->get(STR_DUMP_SPLIT) ? input->getInt(STR_DUMP_SPLIT) : 0;
+    _config._superkMmap         = input->get(STR_SUPERK_MMAP)      ? input->getInt(STR_SUPERK_MMAP)      != 0 : false;
+    _config._superkReadahead    = input->get(STR_SUPERK_READAHEAD) ? input->getInt(STR_SUPERK_READAHEAD) != 0 : false;
+    _config._superkCompress     = input->get(STR_SUPERK_COMPRESS)  ? std::min (input->getInt(STR_SUPERK_COMPRESS), (int64_t)9) : 0;
+    _config._superkMemory       = input->get(STR_SUPERK_MEMORY)    ? input->getInt(STR_SUPERK_MEMORY) : 1;
+    _config._bloomCountBits     = input->get(STR_BLOOM_COUNT_BITS) ? input->getDouble(STR_BLOOM_COUNT_BITS) : 0;
+
     _config._max_disk_space     = input->getInt (STR_MAX_DISK);
     _config._max_memory         = input->getInt (STR_MAX_MEMORY);
     _config._nbCores            = input->get(STR_NB_CORES) ? input->getInt(STR_NB_CORES) : 0;
@@ -252,6 +193,7 @@ void ConfigurationAlgorithm<span>::execute ()
 
     /** We get some information about the bank. */
     _bank->estimate (_config._estimateSeqNb, _config._estimateSeqTotalSize, _config._estimateSeqMaxSize);
+    _config._estimateSeqError = _bank->getEstimateError();
 
     /** We get the number of sub banks. */
     _config._nb_banks = _bank->getCompositionNb();
@@ -351,51 +293,80 @@ void ConfigurationAlgorithm<span>::execute ()
         max_open_files /= 3; // will need to open twice in STORAGE_FILE instead of HDF5, so this adjustment is needed. needs to be fixed later by putting partitions inside the same file. but i'd rather not do it in the current messy collection/group/partition hdf5-inspired system. overall, that's a FIXME
     }
 
-#if 0
-    /* disabled by default; this was an experiment */
-    float est_volume_distinct_ratio;
-    if (_flagEstimateNbDistinctKmers)
-    {
-        /* we estimate the volume of distinct kmers vs total number of kmers.
-         * we store it in the variable "est_volume_distinct_ratio"
-         * to compute it, we need a linear counter, let's call it now */
+    double distinctRatioMax = 1;
 
+    /** We estimate the ratio of distinct kmers on the first kmers of the bank. It is an upper bound of
+     * the ratio of the whole bank (a kmer is more likely to be seen again in more data), so it only
+     * bounds the number of solid kmers and doesn't change the partitions sizing. */
+    {
         TIME_INFO (getTimeInfo(), "estimate_distinct_kmers");
-        Iterator<Sequence>* itSeq = _bank->iterator();
+
+        tools::dp::Iterator<Sequence>* itSeq = _bank->iterator();
         LOCAL (itSeq);
 
-        //_progress->setMessage (progressFormat0); // not touching progress here anymore
-        Model model (_kmerSize, _minim_size);
-        EstimateNbDistinctKmers<span> estimate_nb_distinct_kmers_function(model, _max_memory, kmersNb, _progress);
+        typename EstimateNbDistinctKmers<span>::Model model (_config._kmerSize);
+        EstimateNbDistinctKmers<span> estimateDistinct (model);
 
-        /** We launch the iteration of the sequences iterator with the created functors. */
-        try {
-            itSeq->iterate (estimate_nb_distinct_kmers_function);
+        for (itSeq->first(); !itSeq->isDone() && estimateDistinct.getNbKmers() < DISTINCT_KMERS_SAMPLE; itSeq->next())
+        {
+            estimateDistinct (itSeq->item());
         }
-        catch (const char* except)
+
+        _config._kmersDistinctRatio = estimateDistinct.getRatio();
+        distinctRatioMax            = std::min (1.0, _config._kmersDistinctRatio * (1 + 3*estimateDistinct.getError()));
+    }
+
+    /** A solid kmer is distinct and seen at least 'abundance min' times (the smallest one of the banks, 'auto' taken as 1).
+     * The distinct kmers are bounded with 3 standard errors above their estimate. */
+    {
+        CountNumber abundanceMin = 0;
+        for (size_t i=0; i<_config._abundance.size(); i++)
         {
+            CountNumber current = std::max ((CountNumber)1, _config._abundance[i].getBegin());
+            abundanceMin = (i==0) ? current : std::min (abundanceMin, current);
+        }
+        if (abundanceMin == 0)  { abundanceMin = 1; }
 
+        _config._solidKmersEstimate = _config._kmersNb / abundanceMin;
+        if (_config._kmersDistinctRatio > 0)
+        {
+            _config._solidKmersEstimate = std::min (_config._solidKmersEstimate, (u_int64_t) (_config._kmersNb * distinctRatioMax) + 1);
         }
-        _estimatedDistinctKmerNb = estimate_nb_distinct_kmers_function.getEstimation();
-        est_volume_distinct_ratio = (float) _estimatedDistinctKmerNb / (float)kmersNb;
-        //est_volume_distinct_ratio = 1; // for debug
-        /* est_volume_distinct_ratio == 1 mean that we guarantee worst case the memory usage,
-           the value mean that, on average, a k-mer will be seen 'est_volume_distinct_ratio' times */
-        // if wrongly estimated, the error 'OAHash: max rehashes..' can happen
-        printf ("LinearCounter done, estimated %ld number of distinct kmers, ratio to total number of kmers: %.2f\n", (long)_estimatedDistinctKmerNb, est_volume_distinct_ratio);
     }
-#endif
+
+    /** A Bloom filter filled during the counting takes its memory from the counting, but leaves it at least 1/4 of it. */
+    u_int64_t bloom_memory = _config._bloomCountBits > 0 ? (u_int64_t) (_config._solidKmersEstimate * _config._bloomCountBits / 8 / MBYTE) + 1 : 0;
+    _config._bloomCountMemory = std::min (bloom_memory, (u_int64_t)_config._max_memory*3/4);
+
+    /** The superkmers partitions can be kept in memory instead of temporary files : on demand when a single pass
+     * is needed and they use at most half of the memory left by the Bloom filter (mode 1), or whenever they use at
+     * most 3/4 of it (mode 2).
+     * The arenas of one pass are charged twice their volume, since their capacity is doubled when they grow.
+     * The memory used for counting is reduced accordingly. */
+    u_int64_t volume_superk = _config._volume/4 + 1;  // same estimate as for the disk space, in MBytes
+    u_int64_t arena_memory  = 2 * (volume_superk / _config._nb_passes + 1);
+
+    u_int64_t memory_left   = _config._max_memory - _config._bloomCountMemory;
+
+    _config._superkInMemory =
+        (_config._superkMemory==1 && _config._nb_passes==1 && arena_memory <= memory_left/2) ||
+        (_config._superkMemory==2 && arena_memory <= memory_left*3/4);
+
+    _config._superkArenaMemory = _config._superkInMemory ? arena_memory : 0;
+
+    u_int64_t memory_counting = _config.getCountingMemory();
+
     u_int64_t volume_per_pass;
     do  {
 
         assert (_config._nb_passes > 0);
         volume_per_pass = volume_minim / _config._nb_passes;
 
-        assert (_config._max_memory > 0);
+        assert (memory_counting > 0);
         //printf("volume_per_pass %lli  _nbCores %zu _max_memory %i \n",volume_per_pass, _nbCores,_max_memory);
 
         // _nb_partitions  = ( (volume_per_pass*_nbCores) / _max_memory ) + 1;
-        _config._nb_partitions  = ( ( volume_per_pass* _config._nb_partitions_in_parallel) / _config._max_memory ) + 1;
+        _config._nb_partitions  = ( ( volume_per_pass* _config._nb_partitions_in_parallel) / memory_counting ) + 1;
 
         //printf("nb passes  %i  (nb part %i / %zu)\n",_nb_passes,_nb_partitions,max_open_files);
         //_nb_partitions = max_open_files; break;
@@ -442,7 +413,7 @@ void ConfigurationAlgorithm<span>::execute ()
         _config._nb_cached_items_per_core_per_part *= 2;
         memoryUsageCachedItems = 1LL * _config._nb_cached_items_per_core_per_part *_config._nb_partitions * _config._nbCores * sizeof(Type); 
     }
-    while (memoryUsageCachedItems < _config._max_memory * MBYTE / 10);
+    while (memoryUsageCachedItems < _config.getCountingMemory() * MBYTE / 10);
         
     DEBUG (("ConfigurationAlgorithm<span>::execute  _config._nb_cached_items_per_core_per_part : %zu ; total memory usage of cached items : %lld MB \n",
         _config._nb_cached_items_per_core_per_part, memoryUsageCachedItems / MBYTE
@@ -28,6 +28,7 @@
 #include <gatb/kmer/impl/CountProcessorDump.hpp>
 #include <gatb/kmer/impl/CountProcessorSolidity.hpp>
 #include <gatb/kmer/impl/CountProcessorCutoff.hpp>
+#include <gatb/kmer/impl/CountProcessorBloom.hpp>
 
 /********************************************************************************/
 
@@ -0,0 +1,200 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  INRIA
+ *   Authors: R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+
+#ifndef _COUNT_PROCESSOR_BLOOM_HPP_
+#define _COUNT_PROCESSOR_BLOOM_HPP_
+
+/********************************************************************************/
+
+#include <gatb/kmer/impl/Model.hpp>
+#include <gatb/kmer/impl/CountProcessorAbstract.hpp>
+#include <gatb/tools/collections/impl/Bloom.hpp>
+#include <gatb/tools/storage/impl/Storage.hpp>
+#include <gatb/tools/storage/impl/StorageTools.hpp>
+#include <gatb/tools/misc/api/Enums.hpp>
+#include <math.h>
+
+/********************************************************************************/
+namespace gatb      {
+namespace core      {
+namespace kmer      {
+namespace impl      {
+/********************************************************************************/
+
+/** The CountProcessorBloom implementation inserts kmers into a Bloom filter while
+ * the partitions are counted, so the Bloom filter is available as soon as the counting
+ * ends, without iterating the solid kmers once more (see BloomAlgorithm).
+ *
+ * All the clones share the same Bloom filter; this is safe since all the Bloom filters
+ * provided by BloomFactory set their bits with atomic operations.
+ *
+ * The number of solid kmers is not known before the counting, so the Bloom filter size
+ * is computed from an upper bound: a solid kmer occurs at least 'abundance min' times,
+ * so there are at most (number of kmers / abundance min) of them. The Bloom filter may
+ * therefore be bigger than the one built by BloomAlgorithm, with less false positives.
+ * An explicit estimation of the number of solid kmers can be given instead.
+ *
+ * At the end, the Bloom filter is saved in the provided group, in the same way as
+ * BloomAlgorithm does, so the debloom step can load it.
+ *
+ * The CountProcessorBloom implementation is likely to be used in a CountProcessorChain,
+ * like this : solidity -> dump -> bloom.
+ */
+template<size_t span=KMER_DEFAULT_SPAN>
+class CountProcessorBloom : public CountProcessorAbstract<span>
+{
+public:
+
+    /** Shortcuts. */
+    typedef typename Kmer<span>::Type Type;
+
+    /** Constructor
+     * \param[in] group : group where the Bloom filter is saved at the end of the counting
+     * \param[in] kmerSize : kmer size
+     * \param[in] nbitsPerKmer : number of bits per solid kmer in the Bloom filter
+     * \param[in] bloomKind : kind of the Bloom filter
+     * \param[in] nbKmersEstimate : number of solid kmers; if 0, the upper bound of the configuration is used
+     * \param[in] bloom : Bloom filter shared by the clones */
+    CountProcessorBloom (
+        tools::storage::impl::Group&                  group,
+        size_t                                        kmerSize,
+        float                                         nbitsPerKmer,
+        tools::misc::BloomKind                        bloomKind,
+        u_int64_t                                     nbKmersEstimate = 0,
+        tools::collections::impl::IBloom<Type>*       bloom = 0
+    )
+        : CountProcessorAbstract<span>("bloom"), _group(group), _kmerSize(kmerSize), _nbitsPerKmer(nbitsPerKmer),
+          _bloomKind(bloomKind), _nbKmersEstimate(nbKmersEstimate), _bloom(0), _nbInserted(0)
+    {
+        setBloom (bloom);
+    }
+
+    /** Destructor */
+    virtual ~CountProcessorBloom ()  {  setBloom (0);  }
+
+    /********************************************************************/
+    /*   METHODS CALLED ON THE PROTOTYPE INSTANCE (in the main thread). */
+    /********************************************************************/
+
+    /** \copydoc ICountProcessor<span>::begin */
+    void begin (const Configuration& config)
+    {
+        u_int64_t nbKmers = _nbKmersEstimate;
+
+        /** The configuration bounds the number of solid kmers by the number of distinct kmers (estimated on
+         * the first kmers of the bank) and by the number of kmers divided by the abundance min. */
+        if (nbKmers == 0)  {  nbKmers = config._solidKmersEstimate;  }
+
+        u_int64_t bloomSize = (u_int64_t) (nbKmers * _nbitsPerKmer);
+        size_t    nbHash    = (int)floorf (0.7*_nbitsPerKmer);
+
+        if (bloomSize == 0)  { bloomSize = 1000; }
+
+        setBloom (tools::collections::impl::BloomFactory::singleton().createBloom<Type> (_bloomKind, bloomSize, nbHash, _kmerSize));
+    }
+
+    /** \copydoc ICountProcessor<span>::end */
+    void end ()
+    {
+        /** We save the bloom. */
+        tools::storage::impl::StorageTools::singleton().saveBloom<Type> (_group, "bloom", _bloom, _kmerSize);
+
+        /** We save the kind in the storage. */
+        _group.addProperty ("kind", toString(_bloomKind));
+    }
+
+    /** \copydoc ICountProcessor<span>::clones */
+    CountProcessorAbstract<span>* clone ()
+    {
+        /** Note : we share the Bloom filter for all the clones. */
+        return new CountProcessorBloom (_group, _kmerSize, _nbitsPerKmer, _bloomKind, _nbKmersEstimate, _bloom);
+    }
+
+    /** \copydoc ICountProcessor<span>::finishClones */
+    void finishClones (std::vector<ICountProcessor<span>*>& clones)
+    {
+        for (size_t i=0; i<clones.size(); i++)
+        {
+            /** We have to recover type information. */
+            if (CountProcessorBloom* clone = dynamic_cast<CountProcessorBloom*> (clones[i]))
+            {
+                this->_nbInserted += clone->_nbInserted;
+            }
+        }
+    }
+
+    /********************************************************************/
+    /*   METHODS CALLED ON ONE CLONED INSTANCE (in a separate thread).  */
+    /********************************************************************/
+
+    /** \copydoc ICountProcessor<span>::process */
+    bool process (size_t partId, const Type& kmer, const CountVector& count, CountNumber sum)
+    {
+        _bloom->insert (kmer);
+        _nbInserted ++;
+        return true;
+    }
+
+    /*****************************************************************/
+    /*                          MISCELLANEOUS.                       */
+    /*****************************************************************/
+
+    /** \copydoc ICountProcessor<span>::getProperties */
+    tools::misc::impl::Properties getProperties() const
+    {
+        tools::misc::impl::Properties result;
+
+        result.add (0, "bloom");
+        result.add (1, "kind",           "%s",  toString(_bloomKind));
+        result.add (1, "bitsize",        "%ld", _bloom ? _bloom->getBitSize() : 0);
+        result.add (1, "nb_hash",        "%d",  _bloom ? _bloom->getNbHash()  : 0);
+        result.add (1, "nbits_per_kmer", "%f",  _nbitsPerKmer);
+        result.add (1, "nb_inserted",    "%ld", _nbInserted);
+
+        return result;
+    }
+
+    /** Get the Bloom filter filled during the counting.
+     * \return the Bloom filter */
+    tools::collections::impl::IBloom<Type>* getBloom ()  { return _bloom; }
+
+private:
+
+    tools::storage::impl::Group& _group;
+
+    size_t _kmerSize;
+
+    float _nbitsPerKmer;
+
+    tools::misc::BloomKind _bloomKind;
+
+    u_int64_t _nbKmersEstimate;
+
+    tools::collections::impl::IBloom<Type>* _bloom;
+    void setBloom (tools::collections::impl::IBloom<Type>* bloom)  { SP_SETATTR(bloom); }
+
+    u_int64_t _nbInserted;
+};
+
+/********************************************************************************/
+} } } } /* end of namespaces. */
+/********************************************************************************/
+
+#endif /* _COUNT_PROCESSOR_BLOOM_HPP_ */
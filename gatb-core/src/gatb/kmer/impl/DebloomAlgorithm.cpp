@@ -39,9 +39,11 @@
 #include <gatb/tools/misc/impl/Progress.hpp>
 #include <gatb/tools/misc/impl/Property.hpp>
 #include <gatb/tools/misc/impl/TimeInfo.hpp>
+#include <gatb/tools/misc/impl/Stringify.hpp>
 
 #include <iostream>
 #include <map>
+#include <queue>
 #include <math.h>
 
 #include <gatb/tools/math/Integer.hpp>
@@ -181,9 +183,10 @@ IOptionsParser* DebloomAlgorithm<span>::getOptionsParser ()
 {
     IOptionsParser* parser = new OptionsParser ("bloom");
 
-    parser->push_back (new OptionOneParam (STR_BLOOM_TYPE,        "bloom type ('basic', 'cache', 'neighbor')",false, "neighbor"));
+    parser->push_back (new OptionOneParam (STR_BLOOM_TYPE,        "bloom type ('basic', 'cache', 'neighbor', 'blocked')",false, "neighbor"));
     parser->push_back (new OptionOneParam (STR_DEBLOOM_TYPE,      "debloom type ('none', 'original' or 'cascading')", false, "cascading"));
     parser->push_back (new OptionOneParam (STR_DEBLOOM_IMPL,      "debloom impl ('basic', 'minimizer')",      false, "minimizer"));
+    parser->push_back (new OptionOneParam (STR_BLOOM_COUNT,       "fill the bloom during kmer counting (bigger bloom, no pass over solid kmers)", false, "0"));
 
     return parser;
 }
@@ -462,6 +465,13 @@ IBloom <typename Kmer<span>::Type>* DebloomAlgorithm<span>::createBloom (
 
 /*********************************************************************/
 
+/** Comparator of the sorted runs merged into the final cFP set (smallest values first). */
+template <typename T>
+struct CompareRuns
+{
+    bool operator() (const T& a, const T& b)  {  return ! (*(a.first) < *(b.first));  }
+};
+
 template<size_t span>
 void DebloomAlgorithm<span>::createCFP (
     Collection<Type>*  criticalCollection,
@@ -497,6 +507,9 @@ void DebloomAlgorithm<span>::createCFP (
             LOCAL (itTask);
             itTask->first ();
 
+            /** Number of kmers asked at once to the Bloom filters. */
+            const size_t BATCH_SIZE = 16;
+
             /** We force a specific bloom here for having not too much false positives. */
             tools::misc::BloomKind  bloomKind = BLOOM_CACHE;
 
@@ -522,50 +535,142 @@ void DebloomAlgorithm<span>::createCFP (
             LOCAL (bloom4);
 
             // **** Insert the false positives in B2 ****
-            getDispatcher()->iterate (criticalCollection->iterator(), [&] (const Type& t) {
-                bloom2->insert (t);
-            });
+            {
+                TIME_INFO (getTimeInfo(), "cascading_bloom2");
+
+                getDispatcher()->iterate (criticalCollection->iterator(), [&] (const Type& t) {
+                    bloom2->insert (t);
+                });
+            }
             itTask->next();
 
-            //  **** Insert false positives in B3 and write T2
-            string T2name = System::file().getTemporaryFilename("t2_kmers");
-            Collection<Type>* T2File = new CollectionFile<Type> (T2name);  LOCAL (T2File);
+            /** The solid kmers partitions are processed independently, one partition at a time per thread:
+             * the T2 kmers (solid kmers found in B2) of the pth partition are written in the pth T2 file,
+             * then the ones found in B4 are kept in the pth run. So only the final cFP items are in memory. */
+            size_t nbPartitions = _solidIterable->size();
+            vector< vector<Type> > runs (nbPartitions);
 
-            /** We need to protect the T2File against concurrent accesses, we use a ThreadObject for this. */
-            ThreadObject<BagCache<Type> > T2Cache = BagCache<Type> (T2File, 8*1024, System::thread().newSynchronizer());
+            string T2name = System::file().getTemporaryFilename("t2_kmers");
+            vector<string> T2names (nbPartitions);
+            for (size_t p=0; p<nbPartitions; p++)  {  T2names[p] = Stringify::format ("%s.%d", T2name.c_str(), p);  }
 
-            getDispatcher()->iterate (_solidIterable->iterator(), [&] (const Count& t)
+            //  **** Insert false positives in B3 and build T2
             {
-                if (bloom2->contains(t.value))
+                TIME_INFO (getTimeInfo(), "cascading_bloom3");
+
+                getDispatcher()->iterate (new Range<int>::Iterator (0,nbPartitions-1), [&] (int p)
                 {
-                    T2Cache().insert (t.value);
-                    bloom3->insert (t.value);
-                }
-            });
+                    Iterator<Count>* itKmers = (*_solidIterable)[p].iterator();  LOCAL (itKmers);
+
+                    BagCache<Type> T2Cache (new BagFile<Type> (T2names[p]), 8*1024);
 
-            /** We have to flush each bag cache used during iteration. */
-            for (size_t i=0; i<T2Cache.size(); i++)  { T2Cache[i].flush(); }
+                    Type kmers [BATCH_SIZE];
+                    bool found [BATCH_SIZE];
+                    size_t nb = 0;
+
+                    for (itKmers->first(); ; itKmers->next())
+                    {
+                        bool done = itKmers->isDone();
+                        if (!done)  {  kmers[nb++] = itKmers->item().value;  }
+
+                        if (nb == BATCH_SIZE || (done && nb > 0))
+                        {
+                            bloom2->containsBatch (kmers, nb, found);
+                            for (size_t i=0; i<nb; i++)  {  if (found[i])  {  T2Cache.insert (kmers[i]);  bloom3->insert (kmers[i]);  }  }
+                            nb = 0;
+                        }
+
+                        if (done)  { break; }
+                    }
+
+                    T2Cache.flush();
+                }, 1);
+            }
             itTask->next();
 
             // **** Insert false positives in B4 (we could write T3, but it's not necessary)
-            getDispatcher()->iterate (criticalCollection->iterator(), [&] (const Type& t) {
-                if (bloom3->contains(t)) {
-                    bloom4->insert (t);
-                }
-            });
+            {
+                TIME_INFO (getTimeInfo(), "cascading_bloom4");
+
+                getDispatcher()->iterate (criticalCollection->iterator(), [&] (const Type& t) {
+                    if (bloom3->contains(t)) {
+                        bloom4->insert (t);
+                    }
+                });
+            }
             itTask->next();
 
-            /** We build the final cfp set. */
-            vector<Type> cfpItems;
-            Iterator<Type>* T2It = T2File->iterator(); LOCAL(T2It);
-            for (T2It->first(); !T2It->isDone(); T2It->next())
+            /** Each run keeps the T2 kmers of its file found in B4 and is sorted by its thread. */
             {
-                if (bloom4->contains(T2It->item()))  {  cfpItems.push_back (T2It->item());  }
+                TIME_INFO (getTimeInfo(), "cascading_runs");
+
+                getDispatcher()->iterate (new Range<int>::Iterator (0,nbPartitions-1), [&] (int p)
+                {
+                    vector<Type>& run = runs[p];
+
+                    {
+                        IteratorFile<Type> itT2 (T2names[p]);
+
+                        Type kmers [BATCH_SIZE];
+                        bool found [BATCH_SIZE];
+                        size_t nb = 0;
+
+                        for (itT2.first(); ; itT2.next())
+                        {
+                            bool done = itT2.isDone();
+                            if (!done)  {  kmers[nb++] = itT2.item();  }
+
+                            if (nb == BATCH_SIZE || (done && nb > 0))
+                            {
+                                bloom4->containsBatch (kmers, nb, found);
+                                for (size_t i=0; i<nb; i++)  {  if (found[i])  {  run.push_back (kmers[i]);  }  }
+                                nb = 0;
+                            }
+
+                            if (done)  { break; }
+                        }
+                    }
+
+                    System::file().remove (T2names[p]);
+
+                    std::sort (run.begin(), run.end());
+                }, 1);
             }
-            std::sort (cfpItems.begin(), cfpItems.end());
 
-            finalCriticalCollection->insert (cfpItems.data(), cfpItems.size());
-            finalCriticalCollection->flush ();
+            /** We build the final cfp set by merging the sorted runs. */
+            vector<Type> cfpItems;
+            {
+                TIME_INFO (getTimeInfo(), "cascading_merge");
+
+                typedef typename vector<Type>::iterator RunIterator;
+                typedef pair<RunIterator,RunIterator>    RunIteratorPair;
+
+                size_t nbItems = 0;
+                priority_queue <RunIteratorPair, vector<RunIteratorPair>, CompareRuns<RunIteratorPair> > pq;
+                for (size_t p=0; p<nbPartitions; p++)
+                {
+                    nbItems += runs[p].size();
+                    if (runs[p].empty() == false)  {  pq.push (make_pair (runs[p].begin(), runs[p].end()));  }
+                }
+
+                cfpItems.reserve (nbItems);
+
+                while (!pq.empty())
+                {
+                    RunIteratorPair it = pq.top();
+                    pq.pop();
+
+                    cfpItems.push_back (*it.first);
+
+                    ++(it.first); if (it.first != it.second)  {  pq.push (it); }
+                }
+
+                /** We don't need the runs anymore. */
+                vector< vector<Type> >().swap (runs);
+
+                finalCriticalCollection->insert (cfpItems.data(), cfpItems.size());
+                finalCriticalCollection->flush ();
+            }
             itTask->next();
             itTask->isDone(); // force to finish progress dump
 
@@ -583,9 +688,6 @@ void DebloomAlgorithm<span>::createCFP (
             props->add (1, "bloom4", "%ld", bloom4->getBitSize());
             props->add (1, "set",    "%ld", 8*cfpItems.size()*sizeof(Type));
 
-            /** We remove the two temporary files. */
-            System::file().remove (T2name);
-
             break;
         }
 
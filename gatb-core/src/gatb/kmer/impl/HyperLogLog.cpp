@@ -0,0 +1,135 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  INRIA
+ *   Authors: R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include "HyperLogLog.hpp"
+#include <gatb/system/api/Exception.hpp>
+#include <cmath>
+
+using namespace std;
+
+using namespace gatb::core::tools::math;
+
+/********************************************************************************/
+namespace gatb          {
+namespace core          {
+namespace kmer          {
+namespace impl          {
+/********************************************************************************/
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+template<size_t span>
+HyperLogLog<span>::HyperLogLog (size_t precision)
+    : _precision (precision)
+{
+    if (precision < 4 || precision > 18)  {  throw system::Exception ("HyperLogLog: bad precision %d", (int)precision);  }
+
+    _registers.resize ((size_t)1 << precision, 0);
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS : the rank is the position of the first set bit after the register bits
+*********************************************************************/
+template<size_t span>
+void HyperLogLog<span>::add (const Type& kmer)
+{
+    u_int64_t h = hash1 (kmer, 0);
+
+    size_t    idx  = h >> (64 - _precision);
+    u_int64_t rest = h << _precision;
+
+    u_int8_t rank = rest == 0 ? 64 - _precision + 1 : __builtin_clzll (rest) + 1;
+
+    if (rank > _registers[idx])  {  _registers[idx] = rank;  }
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+template<size_t span>
+void HyperLogLog<span>::merge (const HyperLogLog& other)
+{
+    if (other._precision != _precision)  {  throw system::Exception ("HyperLogLog: can't merge counters of different precisions");  }
+
+    for (size_t i=0; i<_registers.size(); i++)  {  _registers[i] = std::max (_registers[i], other._registers[i]);  }
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS : small cardinalities are estimated by linear counting on the empty registers;
+**           no large range correction is needed with a 64 bits hash
+*********************************************************************/
+template<size_t span>
+u_int64_t HyperLogLog<span>::count () const
+{
+    double m = _registers.size();
+
+    double sum   = 0;
+    size_t zeros = 0;
+    for (size_t i=0; i<_registers.size(); i++)
+    {
+        sum += ldexp (1.0, -(int)_registers[i]);
+        if (_registers[i] == 0)  { zeros++; }
+    }
+
+    double alpha    = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+
+    if (estimate <= 2.5 * m  &&  zeros > 0)  {  estimate = m * log (m / zeros);  }
+
+    return (u_int64_t) (estimate + 0.5);
+}
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+template<size_t span>
+double HyperLogLog<span>::getError () const
+{
+    return 1.04 / sqrt ((double)_registers.size());
+}
+
+/********************************************************************************/
+} } } } /* end of namespaces. */
+/********************************************************************************/
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  INRIA
+ *   Authors: R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+/** \file HyperLogLog.hpp
+ *  \brief HyperLogLog counter of distinct kmers
+ */
+
+#ifndef _GATB_CORE_KMER_IMPL_HYPERLOGLOG_HPP_
+#define _GATB_CORE_KMER_IMPL_HYPERLOGLOG_HPP_
+
+/********************************************************************************/
+
+#include <gatb/kmer/impl/Model.hpp>
+
+#include <vector>
+
+/********************************************************************************/
+namespace gatb      {
+namespace core      {
+namespace kmer      {
+namespace impl      {
+/********************************************************************************/
+
+/** \brief Estimation of the number of distinct kmers
+ *
+ * The kmers are hashed on 64 bits: the first 'precision' bits select a register, which keeps the
+ * maximal rank of the first set bit in the remaining ones (Flajolet et al., 2007). Contrary to a
+ * linear counter, the memory doesn't depend on the number of kmers (2^precision bytes) and the
+ * relative error is 1.04/sqrt(2^precision), ie. 0.8% with the default precision.
+ */
+template<size_t span=KMER_DEFAULT_SPAN> class HyperLogLog
+{
+public:
+
+    /** Shortcuts. */
+    typedef typename Kmer<span>::Type  Type;
+
+    /** Constructor.
+     * \param[in] precision : number of bits of the hash selecting a register (between 4 and 18) */
+    HyperLogLog (size_t precision = 14);
+
+    /** Add a kmer to the counter.
+     * \param[in] kmer : the kmer to be added */
+    void add (const Type& kmer);
+
+    /** Add the kmers of another counter having the same precision (for instance filled by another thread).
+     * \param[in] other : the counter to be merged */
+    void merge (const HyperLogLog& other);
+
+    /** \return the estimated number of distinct kmers added to the counter */
+    u_int64_t count () const;
+
+    /** \return the relative standard error of the estimation */
+    double getError () const;
+
+private:
+
+    size_t                 _precision;
+    std::vector<u_int8_t>  _registers;
+};
+
+/********************************************************************************/
+} } } } /* end of namespaces. */
+/********************************************************************************/
+
+#endif /* _GATB_CORE_KMER_IMPL_HYPERLOGLOG_HPP_ */
@@ -21,6 +21,7 @@
 #include <gatb/system/impl/System.hpp>
 #include <gatb/tools/misc/impl/Progress.hpp>
 #include <gatb/tools/misc/impl/TimeInfo.hpp>
+#include <gatb/tools/collections/impl/IterableHelpers.hpp>
 
 #include <iostream>
 #include <limits>
@@ -70,6 +71,10 @@ static const char* messages[] = {
 template<size_t span, typename Abundance_t, typename NodeState_t>
 const Abundance_t MPHFAlgorithm<span,Abundance_t,NodeState_t>::MAX_ABUNDANCE = std::numeric_limits<Abundance_t>::max();
 
+/** Adaptor for reading the kmers of a partition of counts. */
+template<size_t span>
+struct MPHFCount2Type  {  typename Kmer<span>::Type& operator() (typename Kmer<span>::Count& c)  { return c.value; }  };
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -89,8 +94,23 @@ MPHFAlgorithm<span,Abundance_t,NodeState_t>::MPHFAlgorithm (
     IProperties*        options
 )
     :  Algorithm("mphf", nbCores, options), _group(group), _name(name), _buildOrLoad(buildOrLoad),
-       _dataSize(0), _nb_abundances_above_precision(0), _solidCounts(0), _solidKmers(0), _abundanceMap(0), _nodeStateMap(0), _adjacencyMap(0), _progress(0)
+       _dataSize(0), _nb_abundances_above_precision(0), _mphfKind(MPHF_BASIC), _gamma(3.0), _nbParts(0), _fused(false), _interleaved(false),
+       _solidCounts(0), _solidKmers(0), _abundanceMap(0), _nodeStateMap(0), _adjacencyMap(0), _nodeRecordMap(0), _progress(0)
 {
+    /** We get the construction parameters. */
+    if (getInput()->get(STR_MPHF_TYPE))   {  parse (getInput()->getStr(STR_MPHF_TYPE), _mphfKind);  }
+    if (getInput()->get(STR_MPHF_GAMMA))  {  _gamma   = getInput()->getDouble (STR_MPHF_GAMMA);     }
+    if (getInput()->get(STR_MPHF_PARTS))  {  _nbParts = getInput()->getInt    (STR_MPHF_PARTS);     }
+    if (getInput()->get(STR_MPHF_FUSED))  {  _fused   = getInput()->getInt    (STR_MPHF_FUSED) != 0;  }
+    if (getInput()->get(STR_MPHF_INTERLEAVED))  {  _interleaved = getInput()->getInt (STR_MPHF_INTERLEAVED) != 0;  }
+
+    /** In case of load, we use the layouts chosen at build time. */
+    if (buildOrLoad == false)
+    {
+        _fused       = atoi (_group.getProperty ("mphf_fused").c_str())       != 0;
+        _interleaved = atoi (_group.getProperty ("mphf_interleaved").c_str()) != 0;
+    }
+
     /** We keep a reference on the solid kmers. */
     setSolidCounts (solidCounts);
 
@@ -101,6 +121,7 @@ MPHFAlgorithm<span,Abundance_t,NodeState_t>::MPHFAlgorithm (
     setAbundanceMap (new AbundanceMap());
     setNodeStateMap (new NodeStateMap());
     setAdjacencyMap (new AdjacencyMap());
+    if (_fused)  {  setNodeRecordMap (new NodeRecordMap());  }
 
     /** In case of load, we load the mphf and populate right now. */
     if (buildOrLoad == false)
@@ -108,6 +129,7 @@ MPHFAlgorithm<span,Abundance_t,NodeState_t>::MPHFAlgorithm (
         /** We load the hash object from the dedicated storage group. */
         {   TIME_INFO (getTimeInfo(), "load");
             _abundanceMap->load (_group, _name);
+            _abundanceMap->setInterleaved (_interleaved);
         }
 
         /** We populate the abundance hash table. */
@@ -135,9 +157,32 @@ MPHFAlgorithm<span,Abundance_t,NodeState_t>::~MPHFAlgorithm ()
     setAbundanceMap(0);
     setNodeStateMap(0);
     setAdjacencyMap(0);
+    setNodeRecordMap(0);
     setProgress    (0);
 }
 
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+template<size_t span, typename Abundance_t, typename NodeState_t>
+IOptionsParser* MPHFAlgorithm<span,Abundance_t,NodeState_t>::getOptionsParser ()
+{
+    IOptionsParser* parser = new OptionsParser ("mphf");
+
+    parser->push_back (new OptionOneParam (STR_MPHF_TYPE,   "mphf construction ('basic' or 'partitioned')",        false, "basic"));
+    parser->push_back (new OptionOneParam (STR_MPHF_GAMMA,  "mphf gamma (bigger is faster to build, but bigger)",  false, "3"));
+    parser->push_back (new OptionOneParam (STR_MPHF_PARTS,  "number of parts of a partitioned mphf (0 for auto)",  false, "0"));
+    parser->push_back (new OptionOneParam (STR_MPHF_FUSED,  "store abundance, node state and adjacency of a node together (1) or apart (0)",  false, "0"));
+    parser->push_back (new OptionOneParam (STR_MPHF_INTERLEAVED, "store the mphf ranks with the bits they count (1) or apart (0)",    false, "0"));
+
+    return parser;
+}
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -168,14 +213,49 @@ void MPHFAlgorithm<span,Abundance_t,NodeState_t>::execute ()
 
         /** We build the hash. */
         {   TIME_INFO (getTimeInfo(), "build");
-            _abundanceMap->build (*_solidKmers, nbThreads, _progress);
+
+            if (_mphfKind == MPHF_PARTITIONED)
+            {
+                /** We read the solid kmers partition by partition when we can. */
+                std::vector<Iterable<Type>*> sources;
+                if (Partition<Count>* solidPartition = dynamic_cast<Partition<Count>*> (_solidCounts))
+                {
+                    for (size_t i=0; i<solidPartition->size(); i++)
+                    {
+                        sources.push_back (new IterableAdaptor<Count,Type,MPHFCount2Type<span> > ((*solidPartition)[i]));
+                    }
+                }
+                else
+                {
+                    sources.push_back (_solidKmers);
+                }
+                for (size_t i=0; i<sources.size(); i++)  {  sources[i]->use();  }
+
+                size_t    nbParts   = _nbParts > 0 ? _nbParts : std::max ((size_t)nbThreads, sources.size());
+                u_int64_t maxMemory = getInput()->get(STR_MAX_MEMORY) ? getInput()->getInt(STR_MAX_MEMORY) : 0;
+
+                tools::dp::IteratorListener* progress = createIteratorListener (nbParts, messages[1]);  LOCAL (progress);
+
+                _abundanceMap->buildPartitioned (sources, nbParts, nbThreads, _gamma, maxMemory, progress);
+
+                for (size_t i=0; i<sources.size(); i++)  {  sources[i]->forget();  }
+            }
+            else
+            {
+                _abundanceMap->build (*_solidKmers, nbThreads, _progress, _gamma);
+            }
         }
 
         /** We save the hash object in the dedicated storage group. */
         {   TIME_INFO (getTimeInfo(), "save");
             _dataSize = _abundanceMap->save (_group, _name);
+            _group.addProperty ("mphf_fused",       _fused       ? "1" : "0");
+            _group.addProperty ("mphf_interleaved", _interleaved ? "1" : "0");
         }
 
+        /** The layout is set once saved, since the saved data use the default layout. */
+        _abundanceMap->setInterleaved (_interleaved);
+
         /** We populate the hash table. */
         populate ();
         
@@ -195,6 +275,8 @@ void MPHFAlgorithm<span,Abundance_t,NodeState_t>::execute ()
 template<size_t span,typename Abundance_t, typename NodeState_t>
 float MPHFAlgorithm<span,Abundance_t,NodeState_t>::getNbBitsPerKmer () const
 {
+    if (_fused)  {  return sizeof(NodeRecord)*8;  }
+
     float nbitsPerKmer = sizeof(Abundance_t)*8 + sizeof(NodeState_t) * 4 + sizeof(Adjacency_t) * 8 ;
     return nbitsPerKmer;
 }
@@ -204,6 +286,9 @@ float MPHFAlgorithm<span,Abundance_t,NodeState_t>::getNbBitsPerKmer () const
 template<size_t span,typename Abundance_t,typename NodeState_t>
 void MPHFAlgorithm<span,Abundance_t,NodeState_t>::initNodeStates()
 {
+    /** The node states of the records are cleared at allocation time (see populate). */
+    if (_fused)  {  return;  }
+
     _nodeStateMap->useHashFrom(_abundanceMap, 2); // use abundancemap's MPHF, and allocate n/2 bytes
 }
 
@@ -231,6 +316,13 @@ void MPHFAlgorithm<span,Abundance_t,NodeState_t>::populate ()
     itKmers->addObserver (_progress);
     LOCAL (itKmers);
 
+    /** In the fused layout, the records replace the values of the abundance map. */
+    if (_fused)
+    {
+        _nodeRecordMap->useHashFrom (_abundanceMap);
+        _abundanceMap->freeData ();
+    }
+
     // TODO parallize that
 
     // set counts and at the same time, test the mphf
@@ -254,7 +346,8 @@ void MPHFAlgorithm<span,Abundance_t,NodeState_t>::populate ()
         }
 
         /** We set the abundance of the current kmer. */
-        _abundanceMap->at (h) = abundance;
+        if (_fused)  {  _nodeRecordMap->at (h).abundance = abundance;  }
+        else         {  _abundanceMap->at  (h)           = abundance;  }
 
         nb_iterated ++;
     }
@@ -271,6 +364,21 @@ void MPHFAlgorithm<span,Abundance_t,NodeState_t>::populate ()
 
     /** We gather some statistics. */
     getInfo()->add (1, "stats");
+    getInfo()->add (2, "kind",                  "%s",   toString (_abundanceMap->getHash().getNbParts() > 0 ? MPHF_PARTITIONED : MPHF_BASIC).c_str());
+    if (_abundanceMap->getHash().getNbParts() > 0)
+    {
+        getInfo()->add (2, "nb_parts",          "%ld",  _abundanceMap->getHash().getNbParts());
+    }
+    if (_buildOrLoad == true)
+    {
+        getInfo()->add (2, "gamma",             "%.2f", _abundanceMap->getHash().getGamma());
+        if (_abundanceMap->getHash().getNbParts() > 0)
+        {
+            getInfo()->add (2, "nb_rounds",     "%ld",  _abundanceMap->getHash().getNbRounds());
+        }
+    }
+    getInfo()->add (2, "layout",                "%s",   _fused ? "fused" : "separate");
+    getInfo()->add (2, "ranks",                 "%s",   _abundanceMap->getHash().isInterleaved() ? "interleaved" : "separate");
     getInfo()->add (2, "nb_keys",               "%ld",  _abundanceMap->size());
     getInfo()->add (2, "data_size",             "%ld",  _dataSize);
     getInfo()->add (2, "bits_per_key",          "%.3f", (float)(_dataSize*8)/(float)_abundanceMap->size());
@@ -301,7 +409,7 @@ void MPHFAlgorithm<span,Abundance_t,NodeState_t>::check ()
         Count& count = itKmers->item();
 
         /** We get the current abundance. */
-        Abundance_t abundance = (*_abundanceMap)[count.value];
+        Abundance_t abundance = _fused ? (*_nodeRecordMap)[count.value].abundance : (*_abundanceMap)[count.value];
 
         // sanity check (thank god i wrote this, was useful for spruce)
         if (abundance!=count.abundance && abundance<MAX_ABUNDANCE)  
@@ -25,6 +25,8 @@
 #include <gatb/kmer/impl/Model.hpp>
 #include <gatb/tools/misc/impl/Algorithm.hpp>
 #include <gatb/tools/misc/impl/Progress.hpp>
+#include <gatb/tools/misc/api/Enums.hpp>
+#include <gatb/tools/misc/impl/OptionsParser.hpp>
 #include <gatb/tools/collections/api/Iterable.hpp>
 #include <gatb/tools/collections/impl/MapMPHF.hpp>
 #include <gatb/tools/storage/impl/Storage.hpp>
@@ -72,6 +74,19 @@ namespace impl      {
  * the abundance information through the Kmer<span>::Count type. That's why we need to use
  * 2 Iterable instances, one of type Kmer<span>::Count and one of type Kmer<span>::Type.
  *
+ * The MPHF may be built as a partitioned function (option -mphf partitioned): the keys are split
+ * into parts by hash value, each part having its own (smaller) function. If the solid counts are
+ * provided as a Partition, each thread reads whole solid partitions and builds whole parts of the
+ * function, in as many rounds over the solid kmers as needed to keep the keys within -max-memory.
+ *
+ * The values of the nodes may also be stored in a fused layout (option -mphf-fused 1): instead of
+ * separate maps for the abundance, the node state and the adjacency, a single array of NodeRecord
+ * is indexed by the MPHF, so that the values of a node are read with a single memory access. In this
+ * case, the abundance map only holds the hash function and getNodeRecordMap returns the records.
+ *
+ * The bit arrays of the MPHF may use an interleaved layout (option -mphf-interleaved 1), where the
+ * rank of each block of bits is stored with the block; a lookup then reads fewer cache lines.
+ *
  * Some statistics about the MPHF building are gathered and put into the Properties 'info'.
  */
 template<size_t span=KMER_DEFAULT_SPAN, typename Abundance_t=u_int8_t, typename NodeState_t=u_int8_t>
@@ -96,6 +111,18 @@ public:
     typedef u_int8_t Adjacency_t;
     typedef tools::collections::impl::MapMPHF<Type,Adjacency_t>  AdjacencyMap;
 
+    /** Values of a node in the fused layout. Unlike the node state map, the state is not packed
+     * with the state of the next node. */
+    struct NodeRecord
+    {
+        Abundance_t abundance;
+        NodeState_t state;
+        Adjacency_t adjacency;
+    };
+
+    /** We define the type of the hash table of couples [kmer/node record]. */
+    typedef tools::collections::impl::MapMPHF<Type,NodeRecord>  NodeRecordMap;
+
 
     /** Constructor.
      * \param[in] group : storage group where to save the MPHF once built
@@ -103,7 +130,7 @@ public:
      * \param[in] solidCounts : iterable on couples [kmers/abundance]
      * \param[in] solidKmers  : iterable on kmers
      * \param[in] buildOrLoad : true for build/save the MPHF, false for load only
-     * \param[in] options : extra options for configuration (may be empty) */
+     * \param[in] options : extra options for configuration (may be empty), see getOptionsParser */
     MPHFAlgorithm (
         tools::storage::impl::Group&          group,
         const std::string&                    name,
@@ -117,6 +144,10 @@ public:
     /** Destructor. */
     ~MPHFAlgorithm ();
 
+    /** Get an option parser for the MPHF parameters. Dynamic allocation, so must be released when no more used.
+     * \return an instance of IOptionsParser. */
+    static tools::misc::IOptionsParser* getOptionsParser ();
+
     /** Implementation of the Algorithm::execute method. */
     void execute ();
 
@@ -132,6 +163,10 @@ public:
     NodeStateMap* getNodeStateMap () const  { return _nodeStateMap; }
     NodeStateMap* getAdjacencyMap () const  { return _adjacencyMap; }
 
+    /** Accessor to the node records (fused layout only).
+     * \return the records map instance, 0 if the values are held in separate maps. */
+    NodeRecordMap* getNodeRecordMap () const  { return _nodeRecordMap; }
+
 private:
 
     tools::storage::impl::Group& _group;
@@ -140,6 +175,13 @@ private:
     size_t                       _dataSize;
     size_t                       _nb_abundances_above_precision;
 
+    /** MPHF construction parameters. */
+    tools::misc::MPHFKind        _mphfKind;
+    double                       _gamma;
+    size_t                       _nbParts;
+    bool                         _fused;
+    bool                         _interleaved;
+
     /** Iterable on the couples [kmer,abundance] */
     tools::collections::Iterable<Count>* _solidCounts;
     void setSolidCounts (tools::collections::Iterable<Count>* solidCounts)  {  SP_SETATTR(solidCounts); }
@@ -152,9 +194,11 @@ private:
     AbundanceMap* _abundanceMap;
     NodeStateMap* _nodeStateMap;
     AdjacencyMap* _adjacencyMap;
+    NodeRecordMap* _nodeRecordMap;
     void setAbundanceMap (AbundanceMap* abundanceMap)  { SP_SETATTR(abundanceMap); }
     void setNodeStateMap (NodeStateMap* nodeStateMap)  { SP_SETATTR(nodeStateMap); }
     void setAdjacencyMap (AdjacencyMap* adjacencyMap)  { SP_SETATTR(adjacencyMap); }
+    void setNodeRecordMap (NodeRecordMap* nodeRecordMap)  { SP_SETATTR(nodeRecordMap); }
 
     /** Set the abundance for each entry in the hash table. */
     void populate ();
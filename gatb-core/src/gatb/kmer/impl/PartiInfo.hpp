@@ -78,6 +78,25 @@ public:
         _nbk_per_radix_per_part[x][radix][numpart]+=val; // contains number of kx mer per part per radix per x
     }
 
+    /** Add a processing time (in ms) to a partition.
+     * \param[in] numpart : the partition
+     * \param[in] val : the time to be added */
+    inline void incTime (int numpart, u_int64_t val)
+    {
+        __sync_fetch_and_add (_time_per_parti + numpart, val);
+    }
+
+    /** Add the size of the superkmers file of a partition for one pass. These sizes are kept
+     * by clear(), so they sum the files of all the passes.
+     * \param[in] numpart : the partition
+     * \param[in] raw : size (in bytes) of the superkmers blocks before compression
+     * \param[in] stored : size (in bytes) actually written on disk */
+    inline void addBytes (int numpart, u_int64_t raw, u_int64_t stored)
+    {
+        __sync_fetch_and_add (_raw_bytes_per_parti    + numpart, raw);
+        __sync_fetch_and_add (_stored_bytes_per_parti + numpart, stored);
+    }
+
     /** */
     PartiInfo& operator+=  (const PartiInfo& other)
     {
@@ -95,6 +114,9 @@ public:
 
             __sync_fetch_and_add (_nb_kmers_per_parti  + np, other.getNbKmer      (np));
             __sync_fetch_and_add (_nb_kxmers_per_parti + np, other.getNbSuperKmer (np));
+            __sync_fetch_and_add (_time_per_parti      + np, other.getTime        (np));
+            __sync_fetch_and_add (_raw_bytes_per_parti    + np, other.getRawBytes    (np));
+            __sync_fetch_and_add (_stored_bytes_per_parti + np, other.getStoredBytes (np));
         }
 
         for (u_int64_t ii=0; ii< _num_mm_bins; ii++)
@@ -117,6 +139,48 @@ public:
         return _nb_kmers_per_parti[numpart];
     }
 
+    /** Get the processing time (in ms) of a partition. */
+    inline  u_int64_t getTime(int numpart) const
+    {
+        return _time_per_parti[numpart];
+    }
+
+    /** Get the processing time (in ms) of the slowest partition. */
+    inline  u_int64_t getMaxTime() const
+    {
+        u_int64_t result = 0;
+        for (int np=0; np<_nbpart; np++)  {  result = std::max (result, _time_per_parti[np]);  }
+        return result;
+    }
+
+    /** Get the mean processing time (in ms) of the partitions. */
+    inline  u_int64_t getMeanTime() const
+    {
+        u_int64_t result = 0;
+        for (int np=0; np<_nbpart; np++)  {  result += _time_per_parti[np];  }
+        return _nbpart > 0 ? result / _nbpart : 0;
+    }
+
+    /** Get the size (in bytes) of the superkmers of a partition, before compression. */
+    inline  u_int64_t getRawBytes(int numpart) const
+    {
+        return _raw_bytes_per_parti[numpart];
+    }
+
+    /** Get the size (in bytes) of the superkmers file of a partition. */
+    inline  u_int64_t getStoredBytes(int numpart) const
+    {
+        return _stored_bytes_per_parti[numpart];
+    }
+
+    /** Get the compression ratio (raw size / stored size) of the superkmers files, 1 if not compressed. */
+    inline  double getCompressionRatio() const
+    {
+        u_int64_t raw = 0, stored = 0;
+        for (int np=0; np<_nbpart; np++)  {  raw += _raw_bytes_per_parti[np];  stored += _stored_bytes_per_parti[np];  }
+        return stored > 0 ? (double)raw / (double)stored : 1.0;
+    }
+
     /** Get nbk in bin radix of parti numpart */
     inline  u_int64_t getNbKmer(int numpart, int radix, int xx) const
     {
@@ -156,11 +220,12 @@ public:
         return _kxmer_per_mmer_bin[numbin];
     }
 
-    /** */
+    /** Reset the information of the current pass (the files sizes given by addBytes are kept). */
     void clear()
     {
         memset (_nb_kmers_per_parti,  0, _nbpart      * sizeof(u_int64_t));
         memset (_nb_kxmers_per_parti, 0, _nbpart      * sizeof(u_int64_t));
+        memset (_time_per_parti,      0, _nbpart      * sizeof(u_int64_t));
         memset (_superk_per_mmer_bin, 0, _num_mm_bins * sizeof(u_int64_t));
         memset (_kmer_per_mmer_bin,   0, _num_mm_bins * sizeof(u_int64_t));
         memset (_kxmer_per_mmer_bin,  0, _num_mm_bins * sizeof(u_int64_t));
@@ -187,6 +252,17 @@ public:
 
         for (int np=0; np<_nbpart; np++)  {  printf("Parti[%i]= %lli\n",np,this->getNbSuperKmer(np));  }
 
+        printf("------------------------\n");
+        printf("Time (ms) per parti\n");
+
+        for (int np=0; np<_nbpart; np++)  {  printf("Parti[%i]= %lli\n",np,this->getTime(np));  }
+
+        printf("------------------------\n");
+        printf("Bytes (raw / stored) per parti\n");
+
+        for (int np=0; np<_nbpart; np++)  {  printf("Parti[%i]= %lli  %lli\n",np,this->getRawBytes(np),this->getStoredBytes(np));  }
+        printf("Compression ratio : %.2f\n",this->getCompressionRatio());
+
         //			printf("----------------------------\n");
         //			printf("Nb kmers per parti per radix\n");
         //
@@ -231,6 +307,9 @@ public:
 		_nb_kmer_total =0;
         _nb_kmers_per_parti  = (u_int64_t*) CALLOC (nbpart, sizeof(u_int64_t));
         _nb_kxmers_per_parti = (u_int64_t*) CALLOC (nbpart, sizeof(u_int64_t));
+        _time_per_parti      = (u_int64_t*) CALLOC (nbpart, sizeof(u_int64_t));
+        _raw_bytes_per_parti    = (u_int64_t*) CALLOC (nbpart, sizeof(u_int64_t));
+        _stored_bytes_per_parti = (u_int64_t*) CALLOC (nbpart, sizeof(u_int64_t));
         _num_mm_bins =   1 << (2*_mm);
         _superk_per_mmer_bin = (u_int64_t*) CALLOC (_num_mm_bins, sizeof(u_int64_t));
         _kmer_per_mmer_bin   = (u_int64_t*) CALLOC (_num_mm_bins, sizeof(u_int64_t));
@@ -257,6 +336,9 @@ public:
 		
         _nb_kmers_per_parti  = (u_int64_t*) CALLOC (_nbpart,      sizeof(u_int64_t));
         _nb_kxmers_per_parti = (u_int64_t*) CALLOC (_nbpart,      sizeof(u_int64_t));
+        _time_per_parti      = (u_int64_t*) CALLOC (_nbpart,      sizeof(u_int64_t));
+        _raw_bytes_per_parti    = (u_int64_t*) CALLOC (_nbpart,   sizeof(u_int64_t));
+        _stored_bytes_per_parti = (u_int64_t*) CALLOC (_nbpart,   sizeof(u_int64_t));
         _superk_per_mmer_bin = (u_int64_t*) CALLOC (_num_mm_bins, sizeof(u_int64_t));
         _kmer_per_mmer_bin   = (u_int64_t*) CALLOC (_num_mm_bins, sizeof(u_int64_t));
         _kxmer_per_mmer_bin  = (u_int64_t*) CALLOC (_num_mm_bins, sizeof(u_int64_t));
@@ -278,6 +360,9 @@ public:
     {
         FREE (_nb_kmers_per_parti);
         FREE (_nb_kxmers_per_parti);
+        FREE (_time_per_parti);
+        FREE (_raw_bytes_per_parti);
+        FREE (_stored_bytes_per_parti);
         FREE (_superk_per_mmer_bin);
         FREE (_kmer_per_mmer_bin);
         FREE (_kxmer_per_mmer_bin);
@@ -291,6 +376,9 @@ private:
 
     u_int64_t* _nb_kmers_per_parti;
     u_int64_t* _nb_kxmers_per_parti; //now used to store number of kxmers per parti
+    u_int64_t* _time_per_parti;      //processing time (ms) of each parti during fillsolid
+    u_int64_t* _raw_bytes_per_parti;    //size of the superkmers file of each parti, before compression
+    u_int64_t* _stored_bytes_per_parti; //size of the superkmers file of each parti, as written
     u_int64_t* _superk_per_mmer_bin;
 	u_int64_t  _nb_superk_total;
 	u_int64_t  _nb_kmer_total;
@@ -18,10 +18,15 @@
 *****************************************************************************/
 
 #include <gatb/kmer/impl/PartitionsCommand.hpp>
+#include <gatb/kmer/impl/SuperKmerDecoder.hpp>
 #include <gatb/tools/collections/impl/OAHash.hpp>
-#include <gatb/tools/collections/impl/Hash16.hpp>
+#include <gatb/tools/collections/impl/HashCounter.hpp>
 #include <gatb/tools/misc/impl/Stringify.hpp>
+#include <gatb/tools/misc/impl/RadixSort.hpp>
 
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 using namespace std;
 
@@ -47,6 +52,9 @@ namespace gatb  {  namespace core  {   namespace kmer  {   namespace impl {
 
 #define IX(x,rad) ((rad)+(256)*(x))
 
+/** Min number of kmers buffered for one range of a split dump (see PartitionsByVectorCommand::executeDump). */
+#define DUMP_BUFFER_MIN  (64*1024)
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -309,6 +317,111 @@ PartitionsByHashCommand<span>:: PartitionsByHashCommand (
 	};
 	
 	
+/*********************************************************************
+** METHOD  :
+** PURPOSE : dump the sorted content of a hash table into a file and clear the table
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS : the file is read back by TempCountFileMerger
+*********************************************************************/
+template<size_t span>
+void dumpSortedCounts (HashCounter<typename Kmer<span>::Type>& hash, size_t nbBytes, const std::string& fname)
+{
+	typedef tools::misc::Abundance<typename Kmer<span>::Type> abundance_t;
+
+	BagFile<abundance_t> * bagf = new BagFile<abundance_t>(fname); LOCAL(bagf);
+	Bag<abundance_t> * currentbag =  new BagCache<abundance_t> (  bagf, 10000 ); LOCAL(currentbag);
+
+	u_int64_t nbItems = hash.sort (nbBytes);
+
+	for (u_int64_t i=0; i<nbItems; i++)
+	{
+		currentbag->insert( abundance_t(hash.getKey(i),hash.getValue(i)) );
+	}
+
+	currentbag->flush();
+	hash.clear();
+}
+
+/********************************************************************************/
+/** Command decoding superkmer blocks of a partition and counting their kmers in a hash table.
+ * Several instances may share the same partition: the blocks are then dispatched between them
+ * by SuperKmerBinFiles::readBlock, and each instance has its own table and sub part files. */
+template<size_t span>
+class HashFillCommand : public gatb::core::tools::dp::ICommand, public system::SmartPointer
+{
+public:
+	typedef typename Kmer<span>::Type  Type;
+
+	/** Constructor.
+	 * \param[in] superKstorage : the superkmers partitions files
+	 * \param[in] parti : the partition to be read
+	 * \param[in] kmerSize : kmer size
+	 * \param[in] hash : the hash table to be filled
+	 * \param[out] tmpCountFileNames : names of the files where the table has been dumped when full
+	 * \param[in] tid : identifier of the command, used for the sub part files names */
+	HashFillCommand (tools::storage::impl::SuperKmerBinFiles* superKstorage, int parti, size_t kmerSize,
+					 HashCounter<Type>& hash, std::vector<string>& tmpCountFileNames, size_t tid)
+		: _superKstorage(superKstorage), _parti_num(parti), _kmerSize(kmerSize),
+		  _hash(hash), _tmpCountFileNames(tmpCountFileNames), _tid(tid)  {}
+
+	/** */
+	void execute ()
+	{
+		/** Number of significant bytes of the kmers for sorting the hash table. */
+		size_t nbBytes = std::min (sizeof(Type), (size_t)(2*_kmerSize + 7) / 8);
+
+		SuperKmerDecoder<span> decoder (_kmerSize);
+
+		int _fileId = this->_parti_num;
+		unsigned char * _buffer = 0 ;
+		unsigned int _buffer_size = 0;
+
+		unsigned int nb_bytes_read;
+		unsigned char * _block;
+		while(this->_superKstorage->nextBlock(&_block, &_buffer, &_buffer_size, &nb_bytes_read, _fileId))
+		{
+			const u_int8_t* ptr = _block;
+
+			while(ptr < (_block+nb_bytes_read)) //decode whole block
+			{
+				/** We get the canonical kmers of the superkmer; ptr then points to the next superkmer. */
+				size_t nbK;
+				const Type* kmers = decoder.decodeCanonical (ptr, _block+nb_bytes_read, nbK);
+
+				for (size_t ii=0; ii<nbK; ii++)
+				{
+					/** If the hash table is full, we dump it to disk and resume with the emptied table;
+					 * at the end we merge-sort all the dumped files with the content of the table. */
+					if (_hash.isFull())
+					{
+						std::string fname = this->_superKstorage->getFileName(this->_parti_num) + Stringify::format ("_subpart_%i_%i", _tid, _tmpCountFileNames.size()) ;
+						_tmpCountFileNames.push_back(fname);
+						dumpSortedCounts<span> (_hash, nbBytes, fname);
+					}
+
+					/** We insert the kmer into the hash. */
+					_hash.insert(kmers[ii]);
+				}
+			}
+
+			this->_superKstorage->releaseBlock(_block, nb_bytes_read, _fileId);
+		}
+
+		if(_buffer!=0)
+			free(_buffer);
+	}
+
+private:
+	tools::storage::impl::SuperKmerBinFiles* _superKstorage;
+	int                  _parti_num;
+	size_t               _kmerSize;
+	HashCounter<Type>&   _hash;
+	std::vector<string>& _tmpCountFileNames;
+	size_t               _tid;
+};
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
@@ -320,367 +433,200 @@ PartitionsByHashCommand<span>:: PartitionsByHashCommand (
 template<size_t span>
 void PartitionsByHashCommand<span>:: execute ()
 {
-	typedef typename tools::collections::impl::Hash16<Type>::cell cell_t;
-
+	u_int64_t t0 = System::time().getTimeStamp();
 
 	this->_superKstorage->openFile("r",this->_parti_num);
-	
+
 	this->_processor->beginPart (this->_pass_num, this->_parti_num, this->_cacheSize, this->getName());
-	
+
 	CounterBuilder solidCounter;
-		
-	/** We need a map for storing part of solid kmers. */
-	//OAHash<Type> hash (_hashMemory);
-	
-	Hash16<Type> hash16 (_hashMemory/MBYTE); // now use hash 16 to ensure always finish. needs more ram than OAHash but seems faster
-	
-	/** We directly fill the vector from the current partition file. */
-	
-	//Iterator<Type>* it = this->_partition.iterator();  LOCAL(it);
-	
-	// If the partition holds kmers (and not superkmers), it would be :
-	//      for (it->first(); !it->isDone(); it->next())   {  hash.increment (it->item());  }
-	
-	DEBUG (("PartitionsByHashCommand::execute:  fillsolid parti num %i  by oahash --- mem %llu  MB\n",
+
+	DEBUG (("PartitionsByHashCommand::execute:  fillsolid parti num %i  by hash --- mem %llu  MB\n",
 			this->_parti_num,_hashMemory/MBYTE
 ));
-	
-	//with decompactage
-	//superk
-	int ks = this->_kmerSize;
-	Type un; un.setVal(1);
-	//size_t _shift_val = Type::getSize() -8;
-	Type kmerMask = (un << (ks*2)) - un;
-	size_t shift = 2*(ks-1);
-	
-	Type _seedk;
-	
-	int _fileId = this->_parti_num;
-	unsigned char * _buffer = 0 ;
-	unsigned int _buffer_size = 0;
-	
-	
+
 	typedef tools::misc::Abundance<Type> abundance_t;
-	std::vector<string> _tmpCountFileNames;
-	
-	unsigned int nb_bytes_read;
-	while(this->_superKstorage->readBlock(&_buffer, &_buffer_size, &nb_bytes_read, _fileId))
-	{
-		unsigned char * ptr = _buffer;
-		u_int8_t nbK; //number of kmers in the superkmer
-		u_int8_t newbyte=0;
-		
-		while(ptr < (_buffer+nb_bytes_read)) //decode whole block
-		{
-			//decode a superkmer
-			nbK = *ptr; ptr++;
-			//int nb_bytes_superk = (this->_kmerSize + nbK -1 +3) /4  ;
-			
-			int rem_size = this->_kmerSize;
-			
-			Type Tnewbyte;
-			int nbr=0;
-			_seedk.setVal(0);
-			while(rem_size>=4)
-			{
-				newbyte = *ptr ; ptr++;
-				Tnewbyte.setVal(newbyte);
-				_seedk =  _seedk  |  (Tnewbyte  << (8*nbr)) ;
-				rem_size -= 4; nbr++;
-			}
-			
-			int uid = 4; //uid = nb nt used in current newbyte
-			
-			//reste du seed kmer
-			if(rem_size>0)
-			{
-				newbyte = *ptr ; ptr++;
-				Tnewbyte.setVal(newbyte);
-				
-				_seedk = ( _seedk  |  (Tnewbyte  << (8*nbr)) ) ;
-				uid = rem_size;
-			}
-			_seedk = _seedk & kmerMask;
-			
-			
-			
-			u_int8_t rem = nbK;
-			Type temp = _seedk;
-			Type rev_temp = revcomp(temp,this->_kmerSize);
-			Type newnt ;
-			Type mink;
-			
-			
-			//iterate over kmers of this superk
-			for (int ii=0; ii< nbK; ii++,rem--)
-			{
-				
-#ifdef NONCANONICAL
-				mink = temp;
-#else
-				mink = std::min (rev_temp, temp);
-#endif
-				
-				
-				/** We insert the kmer into the hash. */
-				hash16.insert(mink);
-				
-				
-				if(rem < 2) break; //no more kmers in this superkmer, the last one has just been eaten
-				
-				////////now decode next kmer of this superkmer ///////
-				
-				if(uid>=4) //read next byte
-				{
-					newbyte = *ptr ; ptr++;
-					Tnewbyte.setVal(newbyte);
-					uid =0;
-				}
-				
-				newnt = (Tnewbyte >> (2*uid))& 3; uid++;
-				temp = ((temp << 2 ) |  newnt   ) & kmerMask;
-				
-				newnt.setVal(comp_NT[newnt.getVal()]) ;
-				rev_temp = ((rev_temp >> 2 ) |  (newnt << shift) ) & kmerMask;
-			}
-			
-			//now go to next superk of this block, ptr should point to beginning of next superk
-		}
-		
-		//check if hashtable is getting too big : in that case dump it disk and resume with the emptied hashtable
-		//at the end merge-sort all the dumped files with the content of hash table
-		if(hash16.getByteSize() > _hashMemory) // to be improved (can be slightly larger than maxmemory by a block size)
-		//if(_tmpCountFileNames.size()<20) //force  dumps for testing
-		{
-			//printf("splitting into subparts %lli KB / %lli KB  parti %i subpart %i \n",hash16.getByteSize()/1024,_hashMemory/1024 ,this->_parti_num,_tmpCountFiles.size()  );
-			//dump partial count to disk file
-			
-			
-			Iterator < cell_t >* itKmerAbundancePartial = hash16.iterator(true);
-			LOCAL (itKmerAbundancePartial);
 
-			
-			std::string fname = this->_superKstorage->getFileName(this->_parti_num) + Stringify::format ("_subpart_%i", _tmpCountFileNames.size()) ;
-			_tmpCountFileNames.push_back(fname);
-			
-			BagFile<abundance_t> * bagf = new BagFile<abundance_t>(fname); LOCAL(bagf);
-			Bag<abundance_t> * currentbag =  new BagCache<abundance_t> (  bagf, 10000 ); LOCAL(currentbag);
-			
-			
-			for (itKmerAbundancePartial->first(); !itKmerAbundancePartial->isDone(); itKmerAbundancePartial->next())
-			{
-				cell_t & cell = itKmerAbundancePartial->item();
-				currentbag->insert( abundance_t(cell.graine,cell.val) );
-			}
-	
-			currentbag->flush();			
-			hash16.clear();
-		}
+	size_t nbBytes = std::min (sizeof(Type), (size_t)(2*this->_kmerSize + 7) / 8);
+
+	/** We need a map for storing part of solid kmers. If several cores are given to this partition
+	 * (a big partition processed alone), the superkmer blocks are dispatched between several
+	 * threads, each one counting in its own hash table (sharing the memory). The sorted tables
+	 * and their sub part files are then merged below, as the sub parts of a single table would be. */
+	size_t nbThreads = std::max (this->_nbCores, (size_t)1);
+
+	vector<HashCounter<Type>*>  hashes;
+	vector< vector<string> >    tmpFileNames (nbThreads);
+
+	vector<ICommand*> cmds;
+	for (size_t tid=0; tid<nbThreads; tid++)
+	{
+		// dumped to disk when full, so it always finishes within the memory budget
+		hashes.push_back (new HashCounter<Type> (_hashMemory / nbThreads));
+		cmds.push_back (new HashFillCommand<span> (this->_superKstorage, this->_parti_num, this->_kmerSize, *hashes[tid], tmpFileNames[tid], tid));
 	}
-	
-	if(_buffer!=0)
-		free(_buffer);
-	
+
+	if (nbThreads > 1)  {  Dispatcher(nbThreads).dispatchCommands (cmds, 0);  }
+	else                {  SerialDispatcher().dispatchCommands (cmds, 0);     }
+
+	std::vector<string> _tmpCountFileNames;
+	for (size_t tid=0; tid<nbThreads; tid++)  {  _tmpCountFileNames.insert (_tmpCountFileNames.end(), tmpFileNames[tid].begin(), tmpFileNames[tid].end());  }
 
 	/** We loop over the solid kmers map.
 	 * NOTE !!! we want the items to be sorted by kmer values (see finalize part of debloom). */
-	//Iterator < Abundance<Type> >* itKmerAbundance = hash.iterator(true);
-	//shortcut
-	Iterator < cell_t >* itKmerAbundance = hash16.iterator(true);
-	LOCAL (itKmerAbundance);
-	
-	
+	vector<u_int64_t> nbHashItems (nbThreads);
+	for (size_t tid=0; tid<nbThreads; tid++)  {  nbHashItems[tid] = hashes[tid]->sort (nbBytes);  }
+
 	//now merge sort over current hash and over the sorted _tmpCountFiles
 	// : simple merge sort of n sorted iterators
-	
-	if(_tmpCountFileNames.size()!=0)
+
+	if(_tmpCountFileNames.size()!=0 || nbThreads > 1)
 	{
-		
+
 		TempCountFileMerger<span> tempCountFileMerger (10,10);
 		//will merge by chunk of 10 files at a time, until reach less than 10 files
 		_tmpCountFileNames = tempCountFileMerger.mergeFiles(_tmpCountFileNames);
-		//then will use code below to merge remaining files with the contents of the hash table
+		//then will use code below to merge remaining files with the contents of the hash tables
 
 		std::vector<Iterator<abundance_t>*> _tmpCountIterators;
 
 		//how to make sure there are not too many subpart files ?  and that we'll not reach the max open files limit ?
 		//we *could* merge  only some of them at a time ..  todo ?  --> done with TempCountFileMerger above
-		for(int ii=0; ii< _tmpCountFileNames.size(); ii++)
+		for(size_t ii=0; ii< _tmpCountFileNames.size(); ii++)
 		{
 			std::string fname = _tmpCountFileNames[ii];
 			_tmpCountIterators.push_back( new IteratorFile<abundance_t> (fname)  );
 		}
-	
-		// Note (guillaume) : code below is ugly because I have to manage itKmerAbundance (iterator over cell_t)
-		// and _tmpCountIterators (iterators over abundance_t) differently since they have different types
-		// I would have liked to transform  Iterator<cell_t>  to an Iterator<abundance_t>   with the following adaptor :
-		//
-		// 		struct cell2AbAdaptor  {  abundance_t operator() (cell_t& c)  { return abundance_t(c.graine,c.val) ; }  };
-		//Iterator<abundance_t>*   hashAbundance  = new IteratorAdaptor<cell_t,abundance_t,cell2AbAdaptor> (itKmerAbundance);
-	    //	but it turns out to be impossible because of the return by reference of the   item()  function.
-		//  Another solution would be to dump contents of hash to a file then read it, but inefficient
-		//  So, ugly code it is.  (see all the if(best_p==-1) below)
-		
-		
+
+		// The sorted content of the hash tables is read by index (hashIdx) while the
+		// _tmpCountIterators are iterators over abundance_t, so they are managed differently:
+		// in the priority queue, the ids lower than nbThreads are hash tables, the following
+		// ones are the _tmpCountIterators
+
 		//setup the priority queue for merge sorting
 		typedef std::pair< int , Type> ptcf; //  id pointer , kmer value
 		struct ptcfcomp { bool operator() (ptcf l,ptcf r) { return ((r.second) < (l.second)); } } ;
 		std::priority_queue< ptcf, std::vector<ptcf>,ptcfcomp > pq;
 
 		//// init all iterators  ////
-		itKmerAbundance->first();
-		for(int ii=0; ii< _tmpCountIterators.size(); ii++)
+		vector<u_int64_t> hashIdx (nbThreads, 0);
+		for(size_t ii=0; ii< _tmpCountIterators.size(); ii++)
 		{
 			_tmpCountIterators[ii]->first();
 		}
-		
+
 		//////   init pq ////
 
-		if(!itKmerAbundance->isDone())
+		for(size_t ii=0; ii< nbThreads; ii++)
 		{
-			pq.push(ptcf(-1,itKmerAbundance->item().graine) ); // -1  will mean in the  itKmerAbundance
+			if(hashIdx[ii] < nbHashItems[ii])  {  pq.push(ptcf(ii,hashes[ii]->getKey(hashIdx[ii])) );  }
 		}
-		
-		for(int ii=0; ii< _tmpCountIterators.size(); ii++)
+
+		for(size_t ii=0; ii< _tmpCountIterators.size(); ii++)
 		{
 			if( ! _tmpCountIterators[ii]->isDone())  {
 				abundance_t &ab = _tmpCountIterators[ii]->item();
-				pq.push(ptcf(ii,ab.value) );
+				pq.push(ptcf(nbThreads+ii,ab.value) );
 			}
 		}
-		
+
 		ptcf best_elem;
 		int best_p;
 		int current_ab = 0;
 		int previous_ab = 0;
 		Type current_kmer,previous_kmer;
-		
-	
+		bool first = true;
+
 	    //now merge the n sorted iterators and merge their kmer counts.
-		if(pq.size() != 0)
+		while (pq.size() != 0)
 		{
-			//get first pointer
+			//get  first pointer
 			best_elem = pq.top() ; pq.pop();
 			best_p = best_elem.first;
-			if(best_p==-1)
-			{
-				previous_ab = itKmerAbundance->item().val;
-			}
-			else
-			{
-				previous_ab = _tmpCountIterators[best_p]->item().abundance;
-			}
-			
-			previous_kmer = best_elem.second;
+			current_kmer = best_elem.second;
 
 			//go forward in this list
-
-			if(best_p==-1)
+			if(best_p < (int)nbThreads)
 			{
-				itKmerAbundance->next();
-				if (! itKmerAbundance->isDone())
+				current_ab = hashes[best_p]->getValue(hashIdx[best_p]);
+				hashIdx[best_p]++;
+				if (hashIdx[best_p] < nbHashItems[best_p])
 				{
-					pq.push(ptcf(-1,itKmerAbundance->item().graine) );
+					pq.push(ptcf(best_p,hashes[best_p]->getKey(hashIdx[best_p])) );
 				}
 			}
 			else
 			{
-				_tmpCountIterators[best_p]->next();
-				if (! _tmpCountIterators[best_p]->isDone())
+				Iterator<abundance_t>* it = _tmpCountIterators[best_p-nbThreads];
+				current_ab = it->item().abundance;
+				it->next();
+				if (! it->isDone())
 				{
-					pq.push(ptcf( best_p,_tmpCountIterators[best_p]->item().value) );
+					pq.push(ptcf( best_p,it->item().value) );
 				}
 			}
-			
-			while (pq.size() != 0)
-			{
-				
-				//get  first pointer
-				best_elem = pq.top() ; pq.pop();
-				best_p = best_elem.first;
-				
-				if(best_p==-1)
-				{
-					current_ab = itKmerAbundance->item().val;
-				}
-				else
-				{
-					current_ab = _tmpCountIterators[best_p]->item().abundance;
-				}
-				current_kmer = best_elem.second;
-				
-				//go forward in this list
-				if(best_p==-1)
-				{
-					itKmerAbundance->next();
-					if (! itKmerAbundance->isDone())
-					{
-						pq.push(ptcf(-1,itKmerAbundance->item().graine) );
-					}
-				}
-				else
-				{
-					_tmpCountIterators[best_p]->next();
-					if (! _tmpCountIterators[best_p]->isDone())
-					{
-						pq.push(ptcf( best_p,_tmpCountIterators[best_p]->item().value) );
-					}
-				}
 
-				if(current_kmer != previous_kmer)
-				{
-					//output previous kmer
-					solidCounter.set (previous_ab);
-					this->insert (previous_kmer, solidCounter);
-					previous_kmer = current_kmer;
-					previous_ab = current_ab;
-				}
-				else
-				{
-					//merge counter
-					previous_ab += current_ab;
-				}
-				
+			if(first)
+			{
+				previous_kmer = current_kmer;
+				previous_ab = current_ab;
+				first = false;
 			}
+			else if(current_kmer != previous_kmer)
+			{
+				//output previous kmer
+				solidCounter.set (previous_ab);
+				this->insert (previous_kmer, solidCounter);
+				previous_kmer = current_kmer;
+				previous_ab = current_ab;
+			}
+			else
+			{
+				//merge counter
+				previous_ab += current_ab;
+			}
+		}
 
-			//output last one
+		//output last one
+		if(!first)
+		{
 			solidCounter.set (previous_ab);
 			this->insert (previous_kmer, solidCounter);
 		}
-		
 
 		//cleanup
-		for(int ii=0; ii< _tmpCountIterators.size(); ii++)
+		for(size_t ii=0; ii< _tmpCountIterators.size(); ii++)
 		{
 			delete _tmpCountIterators[ii];
 		}
-		
-		
+
+
 		//erase sub files
-		for(int ii=0; ii< _tmpCountFileNames.size(); ii++)
+		for(size_t ii=0; ii< _tmpCountFileNames.size(); ii++)
 		{
 			std::string fname = _tmpCountFileNames[ii];
 			system::impl::System::file().remove(fname);
 		}
-		
+
 	}
 	else // in that case no merging needed, just iterate the hash table and output kmer counts
 	{
-		for (itKmerAbundance->first(); !itKmerAbundance->isDone(); itKmerAbundance->next())
+		for (u_int64_t hashIdx=0; hashIdx < nbHashItems[0]; hashIdx++)
 		{
-			
-			cell_t & cell = itKmerAbundance->item();
-			solidCounter.set (cell.val);
-			this->insert (cell.graine, solidCounter);
+			solidCounter.set (hashes[0]->getValue(hashIdx));
+			this->insert (hashes[0]->getKey(hashIdx), solidCounter);
 		}
 	}
 
-	
+	for (size_t tid=0; tid<nbThreads; tid++)  {  delete hashes[tid];  }
+
 	this->_superKstorage->closeFile(this->_parti_num);
-	
+
 	this->_progress->inc (this->_pInfo.getNbKmer(this->_parti_num) ); // this->_pInfo->getNbKmer(this->_parti_num)  kmers.size()
-	
+
 	this->_processor->endPart (this->_pass_num, this->_parti_num);
+
+	this->_pInfo.incTime (this->_parti_num, System::time().getTimeStamp() - t0);
 };
 
 /*********************************************************************
@@ -882,10 +828,15 @@ PartitionsByVectorCommand<span>:: PartitionsByVectorCommand (
     size_t              kmerSize,
     MemAllocator&       pool,
     vector<size_t>&     offsets,
-	tools::storage::impl::SuperKmerBinFiles* 		superKstorage
+	tools::storage::impl::SuperKmerBinFiles* 		superKstorage,
+    KmerSortKind        sortKind,
+    size_t              nbDumpRanges,
+    u_int64_t           dumpMemory
 )
     : PartitionsCommand<span> ( processor, cacheSize,  progress, timeInfo, pInfo, passi, parti,nbCores,kmerSize,pool,superKstorage),
-        _radix_kmers (0), _bankIdMatrix(0), _radix_sizes(0), _r_idx(0), _nbItemsPerBankPerPart(offsets)
+        _radix_kmers (0), _bankIdMatrix(0), _radix_sizes(0), _r_idx(0), _sortKind(sortKind), _nbDumpRanges(nbDumpRanges),
+        _dumpMemory(dumpMemory),
+        _nbItemsPerBankPerPart(offsets)
 {
     _dispatcher = new Dispatcher (this->_nbCores);
 }
@@ -915,6 +866,8 @@ PartitionsByVectorCommand<span>:: ~PartitionsByVectorCommand ()
 template<size_t span>
 void PartitionsByVectorCommand<span>::execute ()
 {
+    u_int64_t t0 = System::time().getTimeStamp();
+
     this->_processor->beginPart (this->_pass_num, this->_parti_num, this->_cacheSize, this->getName());
 
     /** We check that we got something. */
@@ -945,6 +898,8 @@ void PartitionsByVectorCommand<span>::execute ()
     this->_progress->inc (this->_pInfo.getNbKmer(this->_parti_num) );
 
     this->_processor->endPart (this->_pass_num, this->_parti_num);
+
+    this->_pInfo.incTime (this->_parti_num, System::time().getTimeStamp() - t0);
 };
 
 	
@@ -974,186 +929,124 @@ public:
 	
 	void execute ()
 	{
+		SuperKmerDecoder<span> decoder (_kmerSize);
+
 		unsigned int nb_bytes_read;
-		while(_superKstorage->readBlock(&_buffer, &_buffer_size, &nb_bytes_read, _fileId))
+		unsigned char * block;
+		while(_superKstorage->nextBlock(&block, &_buffer, &_buffer_size, &nb_bytes_read, _fileId))
 		{
 			//decode block and iterate through its superkmers
-			unsigned char * ptr = _buffer;
-			u_int8_t nbK; //number of kmers in the superkmer
-			int nbsuperkmer_read =0;
-			u_int8_t newbyte=0;
+			const u_int8_t* ptr = block;
 
-			while(ptr < (_buffer+nb_bytes_read)) //decode whole block
+			while(ptr < (block+nb_bytes_read)) //decode whole block
 			{
-				//decode a superkmer
-				nbK = *ptr; ptr++;
-				//int nb_bytes_superk = (_kmerSize + nbK -1 +3) /4  ;
-				
-				int rem_size = _kmerSize;
+				//decode a superkmer : forward and revcomp of all its kmers, ptr then points to the next superkmer
+				size_t nbK;
+				const Type* forward = decoder.decode (ptr, block+nb_bytes_read, nbK);
+				const Type* reverse = decoder.getReverse ();
 
-				Type Tnewbyte;
-				int nbr=0;
-				_seedk.setVal(0);
-				while(rem_size>=4)
-				{
-					newbyte = *ptr ; ptr++;
-					Tnewbyte.setVal(newbyte);
+				if (nbK == 0)  { continue; }
 
-					
-					_seedk =  _seedk  |  (Tnewbyte  << (8*nbr)) ;
-					rem_size -= 4; nbr++;
-				}
-				
-				int uid = 4; //uid = nb nt used in current newbyte
-				
-				//reste du seed kmer
-				if(rem_size>0)
-				{
-					newbyte = *ptr ; ptr++;
-					Tnewbyte.setVal(newbyte);
+				///////////////////////// now parse kx-mers ////////////////////////////////
 
-					_seedk = ( _seedk  |  (Tnewbyte  << (8*nbr)) ) ;
-					uid = rem_size;
-				}
-				_seedk = _seedk & _kmerMask;
-							  
+				Type temp = forward[0];
+				Type rev_temp = reverse[0];
+				Type mink, prev_mink; prev_mink.setVal(0);
+				uint64_t idx;
 
-				//std::string pt = _seedk.toString(_kmerSize);
-				//printf("seedk \n%s \n",pt.c_str());
-				
-				///////////////////////// seedk should be ready here , now parse kx-mers ////////////////////////////////
-						  
-						  u_int8_t rem = nbK;
-						  Type temp = _seedk;
-						  Type rev_temp = revcomp(temp,_kmerSize);
-						  Type newnt ;
-						  Type mink, prev_mink; prev_mink.setVal(0);
-						  uint64_t idx;
-						  
 #ifdef NONCANONICAL
-						  bool prev_which = true;
+				bool prev_which = true;
 #else
-						  bool prev_which =  (temp < rev_temp );
+				bool prev_which =  (temp < rev_temp );
 #endif
-						  
-						  int kx_size = -1; //next loop start at ii=0, first kmer will put it at 0
-						  Type radix_kxmer_forward =  (temp & _mask_radix) >> ((_kmerSize - 4)*2);
-						  Type  first_revk, kinsert,radix_kxmer;
-						  first_revk.setVal(0);
-						  
-						  if(!prev_which) first_revk = rev_temp;
-						  
-						  u_int8_t rid;
-						  
-						  for (int ii=0; ii< nbK; ii++,rem--)
-						  {
+
+				int kx_size = -1; //next loop start at ii=0, first kmer will put it at 0
+				Type radix_kxmer_forward =  (temp & _mask_radix) >> ((_kmerSize - 4)*2);
+				Type  first_revk, kinsert,radix_kxmer;
+				first_revk.setVal(0);
+
+				if(!prev_which) first_revk = rev_temp;
+
+				u_int8_t rid;
+
+				for (size_t ii=0; ii< nbK; ii++)
+				{
+					temp     = forward[ii];
+					rev_temp = reverse[ii];
+
 #ifdef NONCANONICAL
-							  bool which = true;
-							  mink = temp;
+					bool which = true;
+					mink = temp;
 #else
-							  bool which =  (temp < rev_temp );
-							  mink = which ? temp : rev_temp;
+					bool which =  (temp < rev_temp );
+					mink = which ? temp : rev_temp;
 #endif
-							  
-							  if (which != prev_which || kx_size >= _kx) // kxmer_size = 1
-							  {
-								  //output kxmer size kx_size,radix_kxmer
-								  //kx mer is composed of superKp[ii-1] superKp[ii-2] .. superKp[ii-n] with nb elems  n  == kxmer_size +1  (un seul kmer ==k+0)
-								  
-								  if(prev_which)
-								  {
-									  radix_kxmer = radix_kxmer_forward;
-									  kinsert = prev_mink;
-								  }
-								  else // si revcomp, le radix du kxmer est le debut du dernier kmer
-								  {
-									  //previous mink
-									  radix_kxmer =  (prev_mink & _mask_radix) >> _shift_radix;
-									  kinsert = first_revk;
-								  }
-								  
-								  //record kxmer
-								  rid = radix_kxmer.getVal();
-								  //idx = _r_idx[IX(kx_size,rid)]++;
-								  idx = __sync_fetch_and_add( _r_idx +  IX(kx_size,rid) ,1); // si le sync fetch est couteux, faire un mini buffer par thread
-								  
-								  _radix_kmers [IX(kx_size,rid)][ idx] = kinsert << ((4-kx_size)*2);  //[kx_size][rid]
-								  if (_bankIdMatrix)  { _bankIdMatrix[IX(kx_size,rid)][ idx] = _bankId; }
-								  
-								  radix_kxmer_forward =  (mink & _mask_radix) >> _shift_radix;
-								  kx_size =0;
-								  
-								  if(!which) first_revk = rev_temp;
-							  }
-							  else
-							  {
-								  kx_size++;
-							  }
-							  
-							  prev_which = which ;
-							  prev_mink = mink;
-							  
-							  if(rem < 2) break; //no more kmers in this superkmer, the last one has just been eaten
-							  
-							  //////////////////////////////now decode next kmer of this superkmer //////////////////////////////////////////////
-							  
-							  if(uid>=4) //read next byte
-							  {
-								  newbyte = *ptr ; ptr++;
-								  Tnewbyte.setVal(newbyte);
-								  uid =0;
-							  }
-
-							  newnt = (Tnewbyte >> (2*uid))& 3; uid++;
-							
-							  temp = ((temp << 2 ) |  newnt   ) & _kmerMask;
-							  
-							  newnt.setVal(comp_NT[newnt.getVal()]) ;
-							  rev_temp = ((rev_temp >> 2 ) |  (newnt << _shift) ) & _kmerMask;
-							  
-							  ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-						  }
-						  
-						  //record last kxmer prev_mink et monk ?
-						  if(prev_which)
-						  {
-							  radix_kxmer = radix_kxmer_forward;
-							  kinsert = prev_mink;
-						  }
-						  else // si revcomp, le radix du kxmer est le debut du dernier kmer
-						  {
-							  //previous mink
-							  radix_kxmer =  (prev_mink & _mask_radix) >> _shift_radix;
-							  kinsert = first_revk;
-						  }
-						  
-						  //record kxmer
-						  rid = radix_kxmer.getVal();
-						  //idx = _r_idx[IX(kx_size,rid)]++;
-						  idx = __sync_fetch_and_add( _r_idx +  IX(kx_size,rid) ,1); // si le sync fetch est couteux, faire un mini buffer par thread
-
-						  
-						  _radix_kmers [IX(kx_size,rid)][ idx] = kinsert << ((4-kx_size)*2);   // [kx_size][rid]
-						  //cout << "went okay " << idx << endl;
-						  
-						  if (_bankIdMatrix)  { _bankIdMatrix[IX(kx_size,rid)][ idx] = _bankId; }
-
-						  
-						  
-
-						  //////////////////////////////////////////////////////////
-				//ptr+=nb_bytes_superk;
-						  
-				//now go to next superk of this block, ptr should point to beginning of next superk
-				nbsuperkmer_read++;
-				/////////
+
+					if (which != prev_which || kx_size >= _kx) // kxmer_size = 1
+					{
+						//output kxmer size kx_size,radix_kxmer
+						//kx mer is composed of superKp[ii-1] superKp[ii-2] .. superKp[ii-n] with nb elems  n  == kxmer_size +1  (un seul kmer ==k+0)
+
+						if(prev_which)
+						{
+							radix_kxmer = radix_kxmer_forward;
+							kinsert = prev_mink;
+						}
+						else // si revcomp, le radix du kxmer est le debut du dernier kmer
+						{
+							//previous mink
+							radix_kxmer =  (prev_mink & _mask_radix) >> _shift_radix;
+							kinsert = first_revk;
+						}
+
+						//record kxmer
+						rid = radix_kxmer.getVal();
+						idx = __sync_fetch_and_add( _r_idx +  IX(kx_size,rid) ,1); // si le sync fetch est couteux, faire un mini buffer par thread
+
+						_radix_kmers [IX(kx_size,rid)][ idx] = kinsert << ((4-kx_size)*2);  //[kx_size][rid]
+						if (_bankIdMatrix)  { _bankIdMatrix[IX(kx_size,rid)][ idx] = _bankId; }
+
+						radix_kxmer_forward =  (mink & _mask_radix) >> _shift_radix;
+						kx_size =0;
+
+						if(!which) first_revk = rev_temp;
+					}
+					else
+					{
+						kx_size++;
+					}
+
+					prev_which = which ;
+					prev_mink = mink;
+				}
+
+				//record last kxmer prev_mink et monk ?
+				if(prev_which)
+				{
+					radix_kxmer = radix_kxmer_forward;
+					kinsert = prev_mink;
+				}
+				else // si revcomp, le radix du kxmer est le debut du dernier kmer
+				{
+					//previous mink
+					radix_kxmer =  (prev_mink & _mask_radix) >> _shift_radix;
+					kinsert = first_revk;
+				}
+
+				//record kxmer
+				rid = radix_kxmer.getVal();
+				idx = __sync_fetch_and_add( _r_idx +  IX(kx_size,rid) ,1); // si le sync fetch est couteux, faire un mini buffer par thread
+
+				_radix_kmers [IX(kx_size,rid)][ idx] = kinsert << ((4-kx_size)*2);   // [kx_size][rid]
+
+				if (_bankIdMatrix)  { _bankIdMatrix[IX(kx_size,rid)][ idx] = _bankId; }
+
+				//now go to next superk of this block, ptr already points to beginning of next superk
 			}
-			
-			//printf("nb superk in this block %i parti %i\n",nbsuperkmer_read,_fileId);
 
-			
+			_superKstorage->releaseBlock(block, nb_bytes_read, _fileId);
 		}
-		
+
 		if(_buffer!=0)
 			free(_buffer);
 	}
@@ -1329,60 +1222,81 @@ class SortCommand : public gatb::core::tools::dp::ICommand, public system::Smart
 public:
     typedef typename Kmer<span>::Type  Type;
 
-    /** Constructor. */
-    SortCommand (Type** kmervec, bank::BankIdType** bankIdMatrix, int begin, int end, uint64_t* radix_sizes)
-        : _deb(begin), _fin(end), _radix_kmers(kmervec), _bankIdMatrix(bankIdMatrix), _radix_sizes(radix_sizes) {}
+    /** Constructor.
+     * \param[in] kmervec : the (KX+1)*256 radix buckets
+     * \param[in] bankIdMatrix : the bank ids of the buckets (may be null)
+     * \param[in] radix_sizes : number of items of each bucket
+     * \param[in] tasks : indexes of the buckets to be sorted, shared by all the commands
+     * \param[in] nextTask : index of the next task to be processed, shared by all the commands
+     * \param[out] busyTime : time spent by this command in sorting buckets */
+    SortCommand (Type** kmervec, bank::BankIdType** bankIdMatrix, uint64_t* radix_sizes,
+                 const vector<int>& tasks, size_t& nextTask, u_int32_t& busyTime,
+                 KmerSortKind sortKind=KMER_SORT_STD, size_t nbBytes=sizeof(Type))
+        : _radix_kmers(kmervec), _bankIdMatrix(bankIdMatrix), _radix_sizes(radix_sizes),
+          _tasks(tasks), _nextTask(nextTask), _busyTime(busyTime), _sortKind(sortKind), _nbBytes(nbBytes) {}
 
     /** */
     void execute ()
     {
-        vector<size_t> idx;
-        vector<Tmp>    tmp;
+        u_int32_t t0 = System::time().getTimeStamp();
 
-        for (int ii=_deb; ii <=_fin; ii++)
+        /** We take the tasks one after another; since they are sorted by decreasing size, the
+         * threads that got small buckets go on with the remaining ones while the big ones are
+         * still being sorted. */
+        for (size_t t = __sync_fetch_and_add (&_nextTask, 1); t < _tasks.size(); t = __sync_fetch_and_add (&_nextTask, 1))
         {
-            if (_radix_sizes[ii] > 0)
-            {
-                /** Shortcuts. */
-                Type* kmers = _radix_kmers  [ii];
-
-                if (_bankIdMatrix)
-                {
-                    /** NOT OPTIMAL AT ALL... in particular we have to use 'idx' and 'tmp' vectors
-                     * which may use (a lot of ?) memory. */
-
-                    /** Shortcut. */
-                    bank::BankIdType* banksId = _bankIdMatrix [ii];
-
-                    /** NOTE: we sort the indexes, not the items. */
-                    idx.resize (_radix_sizes[ii]);
-                    for (size_t i=0; i<idx.size(); i++)  { idx[i]=i; }
-
-                    std::sort (idx.begin(), idx.end(), Cmp(kmers));
-
-                    /** Now, we have to reorder the two provided vectors with the same order. */
-                    tmp.resize (idx.size());
-                    for (size_t i=0; i<idx.size(); i++)
-                    {
-                        tmp[i].kmer = kmers  [idx[i]];
-                        tmp[i].id   = banksId[idx[i]];
-                    }
-                    for (size_t i=0; i<idx.size(); i++)
-                    {
-                        kmers  [i] = tmp[i].kmer;
-                        banksId[i] = tmp[i].id;
-                    }
-                }
-                else
-                {
-                    std::sort (&kmers[0] , &kmers[ _radix_sizes[ii]]);
-                }
-            }
+            sort (_tasks[t]);
         }
+
+        _busyTime = System::time().getTimeStamp() - t0;
     }
 
 private :
 
+    /** */
+    void sort (int ii)
+    {
+        /** Shortcuts. */
+        Type* kmers = _radix_kmers  [ii];
+
+        if (_sortKind != KMER_SORT_STD)
+        {
+            /** The radix sort moves the kmers and their bank ids in the same pass. */
+            RadixSort<Type,bank::BankIdType>::sort (kmers, _bankIdMatrix ? _bankIdMatrix[ii] : 0, _radix_sizes[ii], _nbBytes);
+        }
+        else if (_bankIdMatrix)
+        {
+            /** NOT OPTIMAL AT ALL... in particular we have to use 'idx' and 'tmp' vectors
+             * which may use (a lot of ?) memory. */
+
+            /** Shortcut. */
+            bank::BankIdType* banksId = _bankIdMatrix [ii];
+
+            /** NOTE: we sort the indexes, not the items. */
+            _idx.resize (_radix_sizes[ii]);
+            for (size_t i=0; i<_idx.size(); i++)  { _idx[i]=i; }
+
+            std::sort (_idx.begin(), _idx.end(), Cmp(kmers));
+
+            /** Now, we have to reorder the two provided vectors with the same order. */
+            _tmp.resize (_idx.size());
+            for (size_t i=0; i<_idx.size(); i++)
+            {
+                _tmp[i].kmer = kmers  [_idx[i]];
+                _tmp[i].id   = banksId[_idx[i]];
+            }
+            for (size_t i=0; i<_idx.size(); i++)
+            {
+                kmers  [i] = _tmp[i].kmer;
+                banksId[i] = _tmp[i].id;
+            }
+        }
+        else
+        {
+            std::sort (&kmers[0] , &kmers[ _radix_sizes[ii]]);
+        }
+    }
+
     struct Tmp { Type kmer;  bank::BankIdType id;};
 
     struct Cmp
@@ -1392,11 +1306,25 @@ private :
         bool operator() (size_t a, size_t b)  { return _kmers[a] < _kmers[b]; }
     };
 
-    int        _deb;
-    int        _fin;
     Type**     _radix_kmers;
     bank::BankIdType** _bankIdMatrix;
     uint64_t*  _radix_sizes;
+    const vector<int>& _tasks;
+    size_t&    _nextTask;
+    u_int32_t& _busyTime;
+    KmerSortKind _sortKind;
+    size_t     _nbBytes;
+
+    vector<size_t> _idx;
+    vector<Tmp>    _tmp;
+};
+
+/** Comparator putting the biggest radix buckets first. */
+struct SortTaskCmp
+{
+    uint64_t* _radix_sizes;
+    SortTaskCmp (uint64_t* radix_sizes) : _radix_sizes(radix_sizes) {}
+    bool operator() (int a, int b)  { return _radix_sizes[a] > _radix_sizes[b]; }
 };
 
 /*********************************************************************
@@ -1412,32 +1340,43 @@ void PartitionsByVectorCommand<span>::executeSort ()
 {
     TIME_INFO (this->_timeInfo, "2.sort");
 
-    vector<ICommand*> cmds;
+    u_int32_t t0 = System::time().getTimeStamp();
 
-    int nwork = 256 / this->_nbCores;
+    /** Number of significant bytes of the stored kxmers: a kmer is stored with 2*(4-x) extra
+     * bits on its right and its 8 bits radix on its left (see SuperKReader). */
+    size_t nbBytes = std::min (sizeof(Type), (2*this->_kmerSize + 8 + 7) / 8);
 
-    for (size_t xx=0; xx < (KX+1); xx++)
-    {
-        cmds.clear();
+    /** Minimizer skew makes the buckets sizes very uneven, so we don't split them statically
+     * between the threads. Instead, the non empty buckets of all the KX levels are put into
+     * a single list sorted by decreasing size, and each thread takes the next bucket as soon
+     * as it is done with its current one. Only one dispatch is needed for all the levels. */
+    vector<int> tasks;
+    for (int ii=0; ii < 256*(int)(KX+1); ii++)  {  if (_radix_sizes[ii] > 1)  { tasks.push_back (ii); }  }
 
-        //fill cmd work vector
-        for (size_t tid=0; tid < this->_nbCores; tid++)
-        {
-            int deb = 0 + tid * nwork;
-            int fin = (tid+1) * nwork -1; // thread will do inclusive range [begin -- end ]
-            if(tid == this->_nbCores-1)  { fin = 255; }
-
-            // mettre dans le  SortCommand le master radix_kmers et range a traiter
-            cmds.push_back (new SortCommand<span> (
-                _radix_kmers+ IX(xx,0),
-                (_bankIdMatrix ? _bankIdMatrix+ IX(xx,0) : 0),
-                deb, fin,
-                _radix_sizes + IX(xx,0)
-            ));
-        }
+    std::sort (tasks.begin(), tasks.end(), SortTaskCmp(_radix_sizes));
+
+    size_t            nextTask = 0;
+    vector<u_int32_t> busyTimes (this->_nbCores, 0);
 
-        _dispatcher->dispatchCommands (cmds, 0);
+    vector<ICommand*> cmds;
+    for (size_t tid=0; tid < this->_nbCores; tid++)
+    {
+        cmds.push_back (new SortCommand<span> (
+            _radix_kmers, _bankIdMatrix, _radix_sizes,
+            tasks, nextTask, busyTimes[tid],
+            _sortKind, nbBytes
+        ));
     }
+
+    _dispatcher->dispatchCommands (cmds, 0);
+
+    /** We report the mean busy and idle times of the threads. */
+    u_int32_t wall = System::time().getTimeStamp() - t0;
+    u_int64_t busy = 0;
+    for (size_t tid=0; tid < busyTimes.size(); tid++)  {  busy += std::min (busyTimes[tid], wall);  }
+
+    this->_timeInfo.add ("2.sort.busy", busy / this->_nbCores);
+    this->_timeInfo.add ("2.sort.idle", (wall*this->_nbCores - busy) / this->_nbCores);
 }
 
 /*********************************************************************
@@ -1474,9 +1413,7 @@ public:
         _kmerMask = (un << (_kmerSize*2)) - un;
 
         _shift_size = ( (4 - _prefix_size) *2) ;
-        _radixMask.setVal(_idx_radix) ;
-        _radixMask = _radixMask << ((_kmerSize-4)*2);
-        _radixMask = _radixMask  << (2*_prefix_size)  ;
+        updateRadixMask ();
 
         if (bankIdMatrix) { _bankIdMatrix = bankIdMatrix + IX(x_size,0); }
     }
@@ -1492,22 +1429,59 @@ public:
             _idx_radix++;
             _cur_idx = 0;
             //update radix mask does not happen often
-            _radixMask.setVal(_idx_radix) ;
-            _radixMask = _radixMask << ((_kmerSize-4)*2);
-            _radixMask = _radixMask  << (2*_prefix_size)  ;
+            updateRadixMask ();
         }
 
         return (_idx_radix <= _high_radix);
     }
 
+    /** Move the pointer just before the first value greater or equal to the provided one,
+     * so that the next call to 'next' returns this value.
+     * \param[in] lower : the lower bound of the values to be iterated. */
+    void seek (const Type& lower)
+    {
+        for (_idx_radix = _low_radix; _idx_radix <= _high_radix; _idx_radix++)
+        {
+            uint64_t nb = _radix_sizes[_idx_radix];
+
+            updateRadixMask ();
+
+            /** The values are increasing along the radix, so we can skip a full radix by looking at its last value. */
+            if (nb == 0 || valueAt(nb-1) < lower)  { continue; }
+
+            uint64_t lo = 0, hi = nb-1;
+            while (lo < hi)
+            {
+                uint64_t mid = (lo + hi) / 2;
+                if (valueAt(mid) < lower)  { lo = mid + 1; }  else  { hi = mid; }
+            }
+
+            _cur_idx = (int64_t)lo - 1;
+            return;
+        }
+
+        _cur_idx = -1;
+    }
+
     /** */
-    inline Type    value   () const  {  return ( ((_kxmers[_idx_radix][_cur_idx]) >> _shift_size)  |  _radixMask  ) & _kmerMask ;  }
+    inline Type    value   () const  {  return valueAt (_cur_idx);  }
 
     /** */
     inline bank::BankIdType getBankId () const  {  return _bankIdMatrix ? _bankIdMatrix [_idx_radix][_cur_idx] : 0;  }
 
 private :
 
+    /** */
+    inline Type valueAt (uint64_t idx) const  {  return ( ((_kxmers[_idx_radix][idx]) >> _shift_size)  |  _radixMask  ) & _kmerMask ;  }
+
+    /** */
+    inline void updateRadixMask ()
+    {
+        _radixMask.setVal(_idx_radix) ;
+        _radixMask = _radixMask << ((_kmerSize-4)*2);
+        _radixMask = _radixMask  << (2*_prefix_size)  ;
+    }
+
     Type**      _kxmers;
     bank::BankIdType**  _bankIdMatrix;
     uint64_t*   _radix_sizes;
@@ -1526,219 +1500,459 @@ private :
 
 /*********************************************************************
 ** METHOD  :
-** PURPOSE :
+** PURPOSE : create the pointers on the 'virtual' sorted arrays of kmers
 ** INPUT   :
 ** OUTPUT  :
 ** RETURN  :
-** REMARKS :
+** REMARKS : a kxmer of size x holds x+1 kmers; the kmer at offset p (prefix p)
+**           takes 2p bits of the radix, so each radix range sharing the same
+**           8-2p lowest bits is a sorted array of kmers:
+**           1 pointer for k0, 1+4 for k1, 1+4+16 for k2 ... 453 in total for k4.
 *********************************************************************/
-
 template<size_t span>
-void PartitionsByVectorCommand<span>::executeDump ()
+void buildKxmerPointers (
+    vector<KxmerPointer<span>*>&   pointers,
+    typename Kmer<span>::Type**    radix_kmers,
+    uint64_t*                      radix_sizes,
+    bank::BankIdType**             bankIdMatrix,
+    size_t                         kmerSize,
+    size_t                         KX
+)
 {
-    TIME_INFO (this->_timeInfo, "3.dump");
+    for (size_t xx=0; xx<=KX; xx++)
+    {
+        for (size_t prefix=0; prefix<=xx; prefix++)
+        {
+            int nbRanges = 1 << (2*prefix);
+            int width    = 256 / nbRanges;
 
-    int nbkxpointers = 453; //6 for k1 mer, 27 for k2mer, 112 for k3mer  453 for k4mer
-    vector< KxmerPointer<span>*> vec_pointer (nbkxpointers);
-    int best_p;
+            for (int ii=0; ii<nbRanges; ii++)
+            {
+                pointers.push_back (new KxmerPointer<span> (
+                    radix_kmers + IX(xx,0), prefix, xx, ii*width, (ii+1)*width-1, kmerSize, radix_sizes + IX(xx,0), bankIdMatrix
+                ));
+            }
+        }
+    }
+}
 
-    std::priority_queue< kxp, std::vector<kxp>,kxpcomp > pq;
+/********************************************************************************/
+/** \brief Tournament (loser tree) merge of the sorted KxmerPointer streams.
+ *
+ * Each internal node of the tree keeps the loser of the match between its two
+ * children, the overall winner being kept apart. Advancing the winner stream
+ * then costs only one comparison per level (log2 of the number of streams)
+ * against the stored losers, instead of the pop/push of a binary heap.
+ *
+ * The current value of each stream is cached so the shift/mask of KxmerPointer::value
+ * is done once per kmer. A stream is exhausted when it has no more items or
+ * when it reaches the (optional) upper bound.
+ */
+template<size_t span>
+class KxmerMerger
+{
+public:
+    typedef typename Kmer<span>::Type  Type;
 
-    size_t nbBanks = _nbItemsPerBankPerPart.size();
-    if (nbBanks == 0) nbBanks = 1;
+    /** Constructor.
+     * \param[in] pointers : the sorted streams to be merged (already positioned with 'seek' if needed)
+     * \param[in] upper : if not null, values greater or equal to this one are not iterated. */
+    KxmerMerger (vector<KxmerPointer<span>*>& pointers, const Type* upper=0)
+        : _pointers(pointers), _upper(upper), _size(1)
+    {
+        while (_size < _pointers.size())  { _size *= 2; }
 
-    CounterBuilder solidCounter (nbBanks);
+        _values.resize (_size);
+        _alive.resize  (_size, 0);
+        _tree.resize   (_size);
+
+        for (size_t i=0; i<_pointers.size(); i++)  {  advance (i);  }
 
-    Type previous_kmer ;
+        /** We build the tree bottom up, keeping the winners of each level in a temporary vector. */
+        vector<size_t> winners (2*_size);
+        for (size_t i=0; i<_size; i++)  { winners[_size+i] = i; }
 
-    //init the pointers to the 6 arrays
-    int pidx =0;
+        for (size_t node=_size-1; node>0; node--)
+        {
+            size_t a = winners[2*node];
+            size_t b = winners[2*node+1];
+            if (less(a,b))  { winners[node] = a;  _tree[node] = b; }
+            else            { winners[node] = b;  _tree[node] = a; }
+        }
 
-    ////////////////////////////////////////////////
-    ////-------------k0 pointers-----------/////////
-    ////////////////////////////////////////////////
+        _tree[0] = winners[1];
+    }
 
-    vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(0,0) ,0,0,0,255,this->_kmerSize, _radix_sizes + IX(0,0), _bankIdMatrix); // vec, prefix size, kxsize , radix min, radix max ,ksize
+    /** \return true if all the streams are exhausted. */
+    inline bool finished () const  {  return _alive[_tree[0]] == 0;  }
 
-    ////////////////////////////////////////////////
-    ////-------------k1 pointers-----------/////////
-    ////////////////////////////////////////////////
+    /** \return the current smallest value. */
+    inline const Type& value () const  {  return _values[_tree[0]];  }
 
-    //prefix0
-    vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(1,0) ,0,1,0,255,this->_kmerSize, _radix_sizes + IX(1, 0), _bankIdMatrix);
-    int lowr = 0;
-    int maxr = 63;
+    /** \return the bank id of the current smallest value. */
+    inline bank::BankIdType getBankId () const  {  return _pointers[_tree[0]]->getBankId();  }
 
-    //prefix1
-    for(unsigned int ii=0; ii<4; ii++)
+    /** Go to the next smallest value. */
+    inline void next ()
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(1,0) ,1,1,lowr,maxr,this->_kmerSize, _radix_sizes + IX(1, 0), _bankIdMatrix);
-        lowr += 64;
-        maxr += 64;
-    }
+        size_t winner = _tree[0];
 
-    ////////////////////////////////////////////////
-    ////-------------k2 pointers-----------/////////
-    ////////////////////////////////////////////////
+        advance (winner);
 
-    //prefix0
-    vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(2,0),0,2,0,255,this->_kmerSize, _radix_sizes + IX(2, 0), _bankIdMatrix);
+        /** We replay the matches from the leaf of the winner up to the root. */
+        for (size_t node = (winner + _size) / 2; node > 0; node /= 2)
+        {
+            if (less (_tree[node], winner))  {  std::swap (_tree[node], winner);  }
+        }
 
-    //prefix1
-    lowr = 0; maxr = 63;
-    for(unsigned int ii=0; ii<4; ii++)
+        _tree[0] = winner;
+    }
+
+private:
+
+    /** */
+    inline void advance (size_t i)
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(2,0),1,2,lowr,maxr,this->_kmerSize, _radix_sizes + IX(2, 0), _bankIdMatrix);
-        lowr += 64;
-        maxr += 64;
+        if (_pointers[i]->next())
+        {
+            _values[i] = _pointers[i]->value();
+            _alive [i] = _upper==0 || _values[i] < *_upper;
+        }
+        else  {  _alive[i] = 0;  }
     }
 
-    //prefix2
-    lowr = 0; maxr = 15;
-    for(unsigned int ii=0; ii<16; ii++)
+    /** */
+    inline bool less (size_t a, size_t b) const
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(2,0),2,2,lowr,maxr,this->_kmerSize, _radix_sizes + IX(2, 0), _bankIdMatrix);
-        lowr += 16;
-        maxr += 16;
+        return _alive[a] && (!_alive[b] || _values[a] < _values[b]);
     }
 
-    ////////////////////////////////////////////////
-    ////-------------k3 pointers-----------/////////
-    ////////////////////////////////////////////////
+    vector<KxmerPointer<span>*>& _pointers;
+    const Type*       _upper;
+    size_t            _size;
+    vector<Type>      _values;
+    vector<u_int8_t>  _alive;
+    vector<size_t>    _tree;
+};
 
-    //prefix0
-    vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(3,0),0,3,0,255,this->_kmerSize, _radix_sizes + IX(3, 0), _bankIdMatrix);
+/*********************************************************************
+** METHOD  :
+** PURPOSE : merge-scan all 'virtual' arrays and give each distinct kmer with its counts to a functor
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+template<size_t span, typename Functor>
+void mergeKxmers (vector<KxmerPointer<span>*>& pointers, const typename Kmer<span>::Type* upper, size_t nbBanks, Functor& fct)
+{
+    typedef typename Kmer<span>::Type  Type;
 
-    //prefix1
-    lowr = 0; maxr = 63;
-    for(unsigned int ii=0; ii<4; ii++)
-    {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(3,0),1,3,lowr,maxr,this->_kmerSize, _radix_sizes + IX(3, 0), _bankIdMatrix);
-        lowr += 64;
-        maxr += 64;
-    }
+    KxmerMerger<span> merger (pointers, upper);
+
+    // everything empty, no kmer at all
+    if (merger.finished())  { return; }
+
+    CounterBuilder solidCounter (nbBanks);
 
-    //prefix2
-    lowr = 0; maxr = 15;
-    for(unsigned int ii=0; ii<16; ii++)
+    Type previous_kmer = merger.value();
+    solidCounter.init (merger.getBankId());
+
+    for (merger.next(); !merger.finished(); merger.next())
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(3,0),2,3,lowr,maxr,this->_kmerSize, _radix_sizes + IX(3, 0), _bankIdMatrix);
-        lowr += 16;
-        maxr += 16;
+        if (merger.value() != previous_kmer)
+        {
+            //if diff, this is the end of this kmer
+            fct (previous_kmer, solidCounter);
+
+            previous_kmer = merger.value();
+            solidCounter.init (merger.getBankId());
+        }
+        else
+        {
+            solidCounter.increase (merger.getBankId());
+        }
     }
 
-    //prefix3
-    lowr = 0; maxr = 3;
-    for(unsigned int ii=0; ii<64; ii++)
+    //last elem
+    fct (previous_kmer, solidCounter);
+}
+
+/** Functor giving the merged kmers directly to the count processor. */
+template<size_t span>
+struct DumpProcessFunctor
+{
+    ICountProcessor<span>* processor;
+    int                    partId;
+
+    DumpProcessFunctor (ICountProcessor<span>* processor, int partId) : processor(processor), partId(partId) {}
+
+    void operator() (const typename Kmer<span>::Type& kmer, const CounterBuilder& counter)
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(3,0),3,3,lowr,maxr,this->_kmerSize, _radix_sizes + IX(3, 0), _bankIdMatrix);
-        lowr += 4;
-        maxr += 4;
+        processor->process (partId, kmer, counter.get());
     }
+};
 
-    ////////////////////////////////////////////////
-    ////-------------k4 pointers-----------/////////
-    ////////////////////////////////////////////////
+/** Bounded buffer receiving the merged kmers of one range, when the dump is split between threads.
+ * The merging thread blocks when the buffer is full, until the ranges before it have been given to
+ * the count processor; so the buffers hold at most 'capacity' kmers whatever the size of the range. */
+template<size_t span>
+class DumpRangeBuffer
+{
+public:
+
+    typedef typename Kmer<span>::Type  Type;
 
-    //prefix0
-    vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(4,0),0,4,0,255,this->_kmerSize, _radix_sizes + IX(4, 0), _bankIdMatrix);
+    /** Constructor.
+     * \param[in] nbBanks : number of counts per kmer
+     * \param[in] capacity : max number of kmers held by the buffer */
+    DumpRangeBuffer (size_t nbBanks, size_t capacity)
+        : _nbBanks(nbBanks), _chunkSize(std::max ((size_t)1, capacity/4)), _done(false), _cancelled(false)  {}
 
-    //prefix1
-    lowr = 0; maxr = 63;
-    for(unsigned int ii=0; ii<4; ii++)
+    /** Called by the merging thread for each kmer of the range. */
+    void operator() (const Type& kmer, const CounterBuilder& counter)
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(4,0),1,4,lowr,maxr,this->_kmerSize, _radix_sizes + IX(4, 0), _bankIdMatrix);
-        lowr += 64;
-        maxr += 64;
+        _current.kmers.push_back (kmer);
+        for (size_t i=0; i<counter.size(); i++)  { _current.counts.push_back (counter[i]); }
+
+        if (_current.kmers.size() >= _chunkSize)  { push (); }
     }
 
-    //prefix2
-    lowr = 0; maxr = 15;
-    for(unsigned int ii=0; ii<16; ii++)
+    /** Called by the merging thread at the end of the range. */
+    void finish ()
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(4,0),2,4,lowr,maxr,this->_kmerSize, _radix_sizes + IX(4, 0), _bankIdMatrix);
-        lowr += 16;
-        maxr += 16;
+        if (_current.kmers.empty() == false)  { push (); }
+
+        std::unique_lock<std::mutex> lock (_mutex);
+        _done = true;
+        _notEmpty.notify_all();
     }
 
-    //prefix3
-    lowr = 0; maxr = 3;
-    for(unsigned int ii=0; ii<64; ii++)
+    /** Release the merging thread if the kmers won't be read (the count processor failed). */
+    void cancel ()
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(4,0),3,4,lowr,maxr,this->_kmerSize, _radix_sizes + IX(4, 0), _bankIdMatrix);
-        lowr += 4;
-        maxr += 4;
+        std::unique_lock<std::mutex> lock (_mutex);
+        _cancelled = true;
+        _notFull.notify_all();
     }
 
-    //prefix4
-    lowr = 0; maxr = 0;
-    for(unsigned int ii=0; ii<256; ii++)
+    /** Give the kmers of the range to a functor, as soon as they are merged.
+     * \param[in] fct : functor called with each kmer and its counts */
+    template<typename Functor> void drain (Functor& fct)
     {
-        vec_pointer[pidx++] = new KxmerPointer<span> (_radix_kmers+ IX(4,0),4,4,lowr,maxr,this->_kmerSize, _radix_sizes + IX(4, 0), _bankIdMatrix);
-        lowr += 1;
-        maxr += 1;
+        CounterBuilder counter (_nbBanks);
+
+        for (Chunk chunk; pop (chunk); )
+        {
+            for (size_t j=0; j<chunk.kmers.size(); j++)
+            {
+                for (size_t b=0; b<_nbBanks; b++)  {  counter.set (chunk.counts[j*_nbBanks+b], b);  }
+                fct (chunk.kmers[j], counter);
+            }
+        }
     }
 
-    //fill the  priority queue with the first elems
-    for (int ii=0; ii<nbkxpointers; ii++)
+private:
+
+    struct Chunk
+    {
+        vector<Type>         kmers;
+        vector<CountNumber>  counts;
+        void swap (Chunk& other)  {  kmers.swap (other.kmers);  counts.swap (other.counts);  }
+    };
+
+    /** At most 2 chunks wait in the queue, besides the ones being filled and read. */
+    void push ()
     {
-        if(vec_pointer[ii]->next())  {  pq.push(kxp(ii,vec_pointer[ii]->value()));  }
+        std::unique_lock<std::mutex> lock (_mutex);
+        _notFull.wait (lock, [this] { return _cancelled || _chunks.size() < 2; });
+
+        if (_cancelled == false)
+        {
+            _chunks.push_back (Chunk());
+            _chunks.back().swap (_current);
+            _notEmpty.notify_one();
+        }
+        _current.kmers.clear();
+        _current.counts.clear();
     }
 
-    if (pq.size() != 0) // everything empty, no kmer at all
+    bool pop (Chunk& chunk)
     {
-        //get first pointer
-        best_p = pq.top().first ; pq.pop();
+        std::unique_lock<std::mutex> lock (_mutex);
+        _notEmpty.wait (lock, [this] { return _done || _chunks.empty() == false; });
+        if (_chunks.empty())  { return false; }
+
+        chunk.swap (_chunks.front());
+        _chunks.pop_front();
+        _notFull.notify_one();
+        return true;
+    }
+
+    size_t                  _nbBanks;
+    size_t                  _chunkSize;
+    Chunk                   _current;
+    std::deque<Chunk>       _chunks;
+    std::mutex              _mutex;
+    std::condition_variable _notEmpty, _notFull;
+    bool                    _done, _cancelled;
+};
 
-        previous_kmer = vec_pointer[best_p]->value();
+/********************************************************************************/
+/** Command merging the kmers of one prefix range [lower,upper[ of the partition. The first range is
+ * given directly to the count processor, followed by the other ranges as their threads merge them
+ * into their buffers. */
+template<size_t span>
+class DumpRangeCommand : public gatb::core::tools::dp::ICommand, public system::SmartPointer
+{
+public:
+    typedef typename Kmer<span>::Type  Type;
 
-        solidCounter.init (vec_pointer[best_p]->getBankId());
+    /** Constructor.
+     * \param[in] lower : first kmer value of the range (null for no lower bound)
+     * \param[in] upper : end of the range (null for no upper bound)
+     * \param[in] buffer : buffer receiving the kmers of the range (null for the first range)
+     * \param[in] processor : functor giving the kmers to the count processor (first range only)
+     * \param[in] following : buffers of the ranges following the first one */
+    DumpRangeCommand (Type** radix_kmers, uint64_t* radix_sizes, bank::BankIdType** bankIdMatrix,
+                      size_t kmerSize, size_t KX, size_t nbBanks, const Type* lower, const Type* upper,
+                      DumpRangeBuffer<span>* buffer, DumpProcessFunctor<span>* processor, vector<DumpRangeBuffer<span>*>* following)
+        : _radix_kmers(radix_kmers), _radix_sizes(radix_sizes), _bankIdMatrix(bankIdMatrix),
+          _kmerSize(kmerSize), _KX(KX), _nbBanks(nbBanks), _lower(lower), _upper(upper),
+          _buffer(buffer), _processor(processor), _following(following)  {}
 
-        //merge-scan all 'virtual' arrays and output counts
-        while (1)
-        {
-            //go forward in this array or in new array if reaches end of this one
-            if (! vec_pointer[best_p]->next())
-            {
-                //reaches end of one array
-                if(pq.size() == 0) break; //everything done
+    /** */
+    void execute ()
+    {
+        vector<KxmerPointer<span>*> pointers;
+        buildKxmerPointers<span> (pointers, _radix_kmers, _radix_sizes, _bankIdMatrix, _kmerSize, _KX);
 
-                //otherwise get new best
-                best_p = pq.top().first ; pq.pop();
-            }
+        if (_lower)  {  for (size_t i=0; i<pointers.size(); i++)  {  pointers[i]->seek (*_lower);  }  }
 
-            if (vec_pointer[best_p]->value() != previous_kmer )
+        try
+        {
+            if (_buffer != 0)
             {
-                //if diff, changes to new array, get new min pointer
-                pq.push(kxp(best_p,vec_pointer[best_p]->value())); //push new val of this pointer in pq, will be counted later
-
-                best_p = pq.top().first ; pq.pop();
-
-                //if new best is diff, this is the end of this kmer
-                if(vec_pointer[best_p]->value()!=previous_kmer )
-                {
-                    this->insert (previous_kmer, solidCounter);
-
-                    solidCounter.init (vec_pointer[best_p]->getBankId());
-                    previous_kmer = vec_pointer[best_p]->value();
-                }
-                else
-                {
-                    solidCounter.increase (vec_pointer[best_p]->getBankId());
-                }
+                mergeKxmers<span> (pointers, _upper, _nbBanks, *_buffer);
+                _buffer->finish ();
             }
             else
             {
-                solidCounter.increase (vec_pointer[best_p]->getBankId());
+                mergeKxmers<span> (pointers, _upper, _nbBanks, *_processor);
+                for (size_t i=0; i<_following->size(); i++)  {  (*_following)[i]->drain (*_processor);  }
             }
         }
+        catch (...)
+        {
+            /** The other threads must not wait for us. */
+            if (_buffer != 0)  {  _buffer->finish ();  }
+            else               {  for (size_t i=0; i<_following->size(); i++)  {  (*_following)[i]->cancel ();  }  }
+
+            for (size_t i=0; i<pointers.size(); i++)  {  delete pointers[i];  }
+            throw;
+        }
+
+        for (size_t i=0; i<pointers.size(); i++)  {  delete pointers[i];  }
+    }
+
+private:
+    Type**             _radix_kmers;
+    uint64_t*          _radix_sizes;
+    bank::BankIdType** _bankIdMatrix;
+    size_t             _kmerSize;
+    size_t             _KX;
+    size_t             _nbBanks;
+    const Type*        _lower;
+    const Type*        _upper;
+    DumpRangeBuffer<span>*           _buffer;
+    DumpProcessFunctor<span>*        _processor;
+    vector<DumpRangeBuffer<span>*>*  _following;
+};
+
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+
+template<size_t span>
+void PartitionsByVectorCommand<span>::executeDump ()
+{
+    TIME_INFO (this->_timeInfo, "3.dump");
+
+    size_t nbBanks = _nbItemsPerBankPerPart.size();
+    if (nbBanks == 0) nbBanks = 1;
+
+    size_t nbRanges = std::min (_nbDumpRanges, this->_nbCores);
+
+    if (nbRanges <= 1 || this->_kmerSize < 4)
+    {
+        vector<KxmerPointer<span>*> pointers;
+        buildKxmerPointers<span> (pointers, _radix_kmers, _radix_sizes, _bankIdMatrix, this->_kmerSize, KX);
+
+        DumpProcessFunctor<span> fct (this->_processor, this->_parti_num);
+        mergeKxmers<span> (pointers, 0, nbBanks, fct);
+
+        /** Cleanup. */
+        for (size_t ii=0; ii<pointers.size(); ii++)  {  delete pointers[ii];  }
+        return;
+    }
+
+    /** We split the kmers space according to the first 4 nucleotides of the kmers. The ranges
+     * are balanced with the radix sizes, which is only an approximation of the number of
+     * kmers having a given prefix, but a cheap one. */
+    u_int64_t total = 0;
+    vector<u_int64_t> weights (256, 0);
+    for (size_t xx=0; xx<=KX; xx++)  {  for (size_t rr=0; rr<256; rr++)  {  weights[rr] += _radix_sizes[IX(xx,rr)];  total += _radix_sizes[IX(xx,rr)];  }  }
+
+    vector<Type> bounds;
+    u_int64_t acc = 0;
+    for (size_t rr=0; rr<256 && bounds.size()+1 < nbRanges; rr++)
+    {
+        if (acc >= (bounds.size()+1) * total / nbRanges)
+        {
+            Type b;  b.setVal (rr);
+            bounds.push_back (b << (2*this->_kmerSize - 8));
+        }
+        acc += weights[rr];
+    }
+
+    /** The first range is given directly to the count processor; each other range is merged in its
+     * own thread into a bounded buffer, read once the ranges before it are done. The buffers share the
+     * memory left to the partition for its dump, so the processor receives the same kmers sequence than
+     * with a single merge without holding the whole ranges in memory. */
+    size_t    itemSize = sizeof(Type) + nbBanks*sizeof(CountNumber);
+    u_int64_t capacity = std::max ((u_int64_t)DUMP_BUFFER_MIN, _dumpMemory / (std::max ((size_t)1, bounds.size()) * itemSize));
 
-        //last elem
-        this->insert (previous_kmer, solidCounter);
+    vector<DumpRangeBuffer<span>*> buffers;
+    for (size_t i=0; i<bounds.size(); i++)  {  buffers.push_back (new DumpRangeBuffer<span> (nbBanks, capacity));  }
+
+    DumpProcessFunctor<span> fct (this->_processor, this->_parti_num);
+
+    vector<ICommand*> cmds;
+    for (size_t i=0; i<=bounds.size(); i++)
+    {
+        cmds.push_back (new DumpRangeCommand<span> (
+            _radix_kmers, _radix_sizes, _bankIdMatrix, this->_kmerSize, KX, nbBanks,
+            i==0 ? 0 : &bounds[i-1],
+            i==bounds.size() ? 0 : &bounds[i],
+            i==0 ? 0 : buffers[i-1],
+            &fct,
+            &buffers
+        ));
+    }
+
+    try  {  _dispatcher->dispatchCommands (cmds, 0);  }
+    catch (...)
+    {
+        for (size_t i=0; i<buffers.size(); i++)  {  delete buffers[i];  }
+        throw;
     }
 
-    /** Cleanup. */
-    for (int ii=0; ii<nbkxpointers; ii++)  {  delete vec_pointer[ii];  }
+    for (size_t i=0; i<buffers.size(); i++)  {  delete buffers[i];  }
 }
 
 /********************************************************************************/
@@ -205,12 +205,6 @@ public:
 
     static const size_t KX = 4 ;
 
-private:
-    //used for the priority queue
-    typedef std::pair<int, Type> kxp; //id pointer in vec_pointer , value
-    struct kxpcomp { bool operator() (kxp l,kxp r) { return ((r.second) < (l.second)); } } ;
-
-public:
     /** Constructor. */
     PartitionsByVectorCommand (
        // gatb::core::tools::collections::Iterable<Type>& partition,
@@ -225,8 +219,10 @@ public:
         size_t                                          kmerSize,
         gatb::core::tools::misc::impl::MemAllocator&    pool,
         std::vector<size_t>&                            offsets,
-		tools::storage::impl::SuperKmerBinFiles* 		superKstorage
-
+		tools::storage::impl::SuperKmerBinFiles* 		superKstorage,
+        tools::misc::KmerSortKind                       sortKind = tools::misc::KMER_SORT_DEFAULT,
+        size_t                                          nbDumpRanges = 0,
+        u_int64_t                                       dumpMemory = 0
     );
 
     /** Destructor. */
@@ -247,6 +243,10 @@ private:
 
     tools::dp::IDispatcher* _dispatcher;
 
+    tools::misc::KmerSortKind _sortKind;
+    size_t                    _nbDumpRanges;
+    u_int64_t                 _dumpMemory;    // memory (in bytes) for buffering the ranges of a split dump
+
 	void executeRead   ();
     void executeSort   ();
     void executeDump   ();
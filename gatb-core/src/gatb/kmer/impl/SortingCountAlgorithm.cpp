@@ -227,6 +227,12 @@ IOptionsParser* SortingCountAlgorithm<span>::getOptionsParser (bool mandatory)
     devParser->push_back (new OptionOneParam (STR_MINIMIZER_TYPE,    "minimizer type (0=lexi, 1=freq)",                false, "0"));
     devParser->push_back (new OptionOneParam (STR_MINIMIZER_SIZE,    "size of a minimizer",                            false, "10"));
     devParser->push_back (new OptionOneParam (STR_REPARTITION_TYPE,  "minimizer repartition (0=unordered, 1=ordered)", false, "0"));
+    devParser->push_back (new OptionOneParam (STR_SORT_KIND,         "sort of kmers partitions (std, radix)",          false, "radix"));
+    devParser->push_back (new OptionOneParam (STR_DUMP_SPLIT,        "nb of kmer ranges dumped in parallel per partition (0 for none)", false, "0"));
+    devParser->push_back (new OptionOneParam (STR_SUPERK_MMAP,       "read superkmers partitions through memory mapping (0/1)", false, "0"));
+    devParser->push_back (new OptionOneParam (STR_SUPERK_READAHEAD,  "read ahead the superkmers partitions of the next group (0/1)", false, "0"));
+    devParser->push_back (new OptionOneParam (STR_SUPERK_MEMORY,     "keep the superkmers partitions in memory instead of temporary files (0 never, 1 for a single pass within half the memory, 2 within 3/4 of the memory)", false, "1"));
+    devParser->push_back (new OptionOneParam (STR_SUPERK_COMPRESS,   "compression level of the superkmers partitions blocks (0 for none, 1 fastest to 9)", false, "0"));
     parser->push_back (devParser);
 
     return parser;
@@ -260,7 +266,8 @@ template<size_t span>
 ICountProcessor<span>* SortingCountAlgorithm<span>::getDefaultProcessor (
     tools::misc::IProperties*       params,
     tools::storage::impl::Storage*  dskStorage,
-    tools::storage::impl::Storage*  otherStorage
+    tools::storage::impl::Storage*  otherStorage,
+    CountProcessor*                 solidProcessor
 )
 {
     CountProcessor* result = 0;
@@ -273,6 +280,7 @@ ICountProcessor<span>* SortingCountAlgorithm<span>::getDefaultProcessor (
      *      1) histogram
      *      2) solidity filter
      *      3) if solidity filter passed, dump to file system
+     *      4) if provided, the processor for solid kmers (a Bloom filter fill for instance)
      */
     result = new CountProcessorChain<span> (
 
@@ -288,6 +296,7 @@ ICountProcessor<span>* SortingCountAlgorithm<span>::getDefaultProcessor (
             dskStorage->getGroup("dsk"),
             params->getInt(STR_KMER_SIZE)
         ),
+        solidProcessor,
         NULL
     );
 
@@ -348,12 +357,13 @@ vector<ICountProcessor<span>*> SortingCountAlgorithm<span>::getDefaultProcessorV
     Configuration&  config,
     IProperties*    params,
     Storage*        dskStorage,
-    Storage*        otherStorage
+    Storage*        otherStorage,
+    CountProcessor* solidProcessor
 )
 {
     vector<ICountProcessor<span>*> result;
 
-    ICountProcessor<span>* dskProcessor = getDefaultProcessor (params, dskStorage, otherStorage);
+    ICountProcessor<span>* dskProcessor = getDefaultProcessor (params, dskStorage, otherStorage, solidProcessor);
 
     /** Now, we define the vector of count processors to be given to the SortingCountAlgorithm.
      * The choice depends on the presence of "auto" min abundance in the configuration. */
@@ -621,6 +631,7 @@ void SortingCountAlgorithm<span>::execute ()
 	getInfo()->add (3, "tmp file biggest (MB)","%lld",biggesttmp/1024LL/1024LL);
 	getInfo()->add (3, "tmp file smallest (MB)","%lld",smallesttmp/1024LL/1024LL);
 	getInfo()->add (3, "tmp file mean (MB)","%.1f",meantmp/1024LL/1024LL);
+	getInfo()->add (3, "compression ratio","%.2f",pInfo.getCompressionRatio());
 
     /** We dump information about count processors. */
     if (_processors.size()==1)  {  getInfo()->add (2, _processors[0]->getProperties()); }
@@ -815,7 +826,9 @@ void SortingCountAlgorithm<span>::fillPartitions (size_t pass, Iterator<Sequence
 		_superKstorage =0;
 	}
 	
-	_superKstorage = new SuperKmerBinFiles(_tmpStorageName_superK,"superKparts", _config._nb_partitions) ;
+	_superKstorage = new SuperKmerBinFiles(_tmpStorageName_superK,"superKparts", _config._nb_partitions, _config._superkInMemory) ;
+	_superKstorage->setMappedRead (_config._superkMmap);
+	_superKstorage->setCompression (_config._superkCompress);
 	
     /** We update the message of the progress bar. */
     _progress->setMessage (Stringify::format(progressFormat1, pass+1, _config._nb_passes));
@@ -881,9 +894,13 @@ void SortingCountAlgorithm<span>::fillPartitions (size_t pass, Iterator<Sequence
     }
 	
 
-	_superKstorage->flushFiles();
 	_superKstorage->closeFiles();
 
+	/** We keep the size of the partitions files, with and without compression. */
+	for (size_t p=0; p<_config._nb_partitions; p++)
+	{
+		pInfo.addBytes (p, _superKstorage->getRawFileSize(p), _superKstorage->getFileSize(p));
+	}
 
 }
 
@@ -905,7 +922,7 @@ std::vector<size_t> SortingCountAlgorithm<span>::getNbCoresList (PartiInfo<5>& p
         u_int64_t ram_total = 0;
         size_t i=0;
         for (i=0; i< _config._nb_partitions_in_parallel && p<_config._nb_partitions
-            && (ram_total ==0  || ((ram_total+(pInfo.getNbSuperKmer(p)*getSizeofPerItem()))  <= _config._max_memory*MBYTE)) ; i++, p++)
+            && (ram_total ==0  || ((ram_total+(pInfo.getNbSuperKmer(p)*getSizeofPerItem()))  <= _config.getCountingMemory()*MBYTE)) ; i++, p++)
         {
             ram_total += pInfo.getNbSuperKmer(p)*getSizeofPerItem();
         }
@@ -939,6 +956,10 @@ void SortingCountAlgorithm<span>::fillSolidKmers (size_t pass, PartiInfo<5>& pIn
         /** We notify the count processor about the end of the pass. */
         _processors[i]->endPass (pass);
     }
+
+    /** We keep track of the slowest partition of the pass, compared to the mean one. */
+    getTimeInfo().add ("fill_solid_kmers_part_max",  pInfo.getMaxTime());
+    getTimeInfo().add ("fill_solid_kmers_part_mean", pInfo.getMeanTime());
 }
 
 /*********************************************************************
@@ -979,8 +1000,9 @@ void SortingCountAlgorithm<span>::fillSolidKmers_aux (ICountProcessor<span>* pro
         assert (currentNbCores > 0);
 
         /** We correct the number of memory per map according to the max allowed memory.
-         * Note that _max_memory has initially been divided by the user provided cores number. */
-        u_int64_t mem = (_config._max_memory*MBYTE)/currentNbCores;
+         * Note that _max_memory has initially been divided by the user provided cores number, and that
+         * the in memory superkmers partitions (if any) are not available for counting. */
+        u_int64_t mem = (_config.getCountingMemory()*MBYTE)/currentNbCores;
 
         /** We need to cache the solid kmers partitions.
          *  NOTE : it is important to save solid kmers by big chunks (ie cache size) in each partition.
@@ -992,6 +1014,20 @@ void SortingCountAlgorithm<span>::fillSolidKmers_aux (ICountProcessor<span>* pro
          */
         size_t cacheSize = std::min ((u_int64_t)(200*1000), mem/(50*sizeof(Count)));
 
+        /** When the group holds fewer partitions than the number of partitions processed in parallel
+         * (typically one big partition that can't share the memory with others), the idle cores are
+         * given to the partitions of the group, which then split their counting between several threads. */
+        size_t nbCoresPerPart = std::max (_config._nbCores_per_partition, _config._nbCores / currentNbCores);
+        size_t nbDumpRanges   = nbCoresPerPart > _config._nbCores_per_partition ?
+            std::max (_config._nbDumpRanges, nbCoresPerPart) : _config._nbDumpRanges;
+
+        /** A split dump buffers the merged kmers of its ranges; these buffers share the memory
+         * not taken by the partitions of the group. */
+        u_int64_t groupMemory = 0;
+        for (size_t j=0; j<currentNbCores; j++)  {  groupMemory += pInfo.getNbSuperKmer(p+j)*getSizeofPerItem();  }
+        u_int64_t dumpMemory = groupMemory < _config.getCountingMemory()*MBYTE ?
+            (_config.getCountingMemory()*MBYTE - groupMemory) / currentNbCores : 0;
+
         DEBUG (("SortingCountAlgorithm::fillSolidKmers:  mem=%d  computing %zu partitions simultaneously , parti : ",
             mem/MBYTE, currentNbCores
         ));
@@ -1025,19 +1061,19 @@ void SortingCountAlgorithm<span>::fillSolidKmers_aux (ICountProcessor<span>* pro
             //still use hash if by vector would be too large even with single part at a time
 			//I thought it was not possible to have memoryPartition > _max_memory  && currentNbCores>1 , but inf fact it is possible when
 			// some partitions are of size 0 (see getNbCoresList)
-			if ( ((memoryPartition > mem && currentNbCores==1) || ( memoryPartition > (_config._max_memory*MBYTE) ) )  && !forceVector)
+			if ( ((memoryPartition > mem && currentNbCores==1) || ( memoryPartition > (_config.getCountingMemory()*MBYTE) ) )  && !forceVector)
             {
                 if (pool.getCapacity() != 0)  {  pool.reserve(0);  }
 
                 // also allow to use mem pool for oahash ? ou pas la peine
                 cmd = new PartitionsByHashCommand<span>   (
                      processorClone, cacheSize, _progress, _fillTimeInfo,
-                    pInfo, pass, p, _config._nbCores_per_partition, _config._kmerSize, pool, mem,_superKstorage
+                    pInfo, pass, p, nbCoresPerPart, _config._kmerSize, pool, mem,_superKstorage
                 );
             }
             else
             {
-                u_int64_t memoryPoolSize = _config._max_memory*MBYTE;
+                u_int64_t memoryPoolSize = _config.getCountingMemory()*MBYTE;
 
                 /** In case of forcing sorted vector (multiple banks counting for instance), we may have a
                  * partition bigger than the max memory. */
@@ -1073,7 +1109,7 @@ void SortingCountAlgorithm<span>::fillSolidKmers_aux (ICountProcessor<span>* pro
                                 );
                             }
                             else
-                                cout << "Warning: memory was initially restricted to " << _config._max_memory << " MB, but we actually need to allocate " << memoryPoolSize / MBYTE << " MB due to a partition with " << pInfo.getNbSuperKmer(p) << " superkmers." << endl;
+                                cout << "Warning: memory was initially restricted to " << _config.getCountingMemory() << " MB, but we actually need to allocate " << memoryPoolSize / MBYTE << " MB due to a partition with " << pInfo.getNbSuperKmer(p) << " superkmers." << endl;
                         }
                     }
                 }
@@ -1106,7 +1142,8 @@ void SortingCountAlgorithm<span>::fillSolidKmers_aux (ICountProcessor<span>* pro
 
                 cmd = new PartitionsByVectorCommand<span> (
                      processorClone, cacheSize, _progress, _fillTimeInfo,
-                    pInfo, pass, p, _config._nbCores_per_partition, _config._kmerSize, pool, nbItemsPerBankPerPart,_superKstorage
+                    pInfo, pass, p, nbCoresPerPart, _config._kmerSize, pool, nbItemsPerBankPerPart,_superKstorage,
+                    _config._sortKind, nbDumpRanges, dumpMemory
                 );
             }
 
@@ -1116,6 +1153,12 @@ void SortingCountAlgorithm<span>::fillSolidKmers_aux (ICountProcessor<span>* pro
 
         DEBUG (("\n"));
 
+        /** While the current group is counted, the system can load the partitions of the next group. */
+        if (_config._superkReadahead && i+1 < coreList.size())
+        {
+            for (size_t q=p; q<p+coreList[i+1] && q<_config._nb_partitions; q++)  {  _superKstorage->prefetchFile (q);  }
+        }
+
         /** We launch the commands through a dispatcher. */
         getDispatcher()->dispatchCommands (cmds, 0);
 
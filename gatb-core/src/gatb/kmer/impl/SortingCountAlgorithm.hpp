@@ -128,25 +128,29 @@ public:
      * \param[in] params : used for configuring the processor
      * \param[in] dskStorage : storage for dumping [kmer,count] couples
      * \param[in] otherStorage : used for histogram for instance
+     * \param[in] solidProcessor : if not null, called for each solid kmer after the dump (see CountProcessorBloom)
      * \return a CountProcessor instance
      */
     static CountProcessor* getDefaultProcessor (
         tools::misc::IProperties*       params,
         tools::storage::impl::Storage*  dskStorage,
-        tools::storage::impl::Storage*  otherStorage = 0
+        tools::storage::impl::Storage*  otherStorage   = 0,
+        CountProcessor*                 solidProcessor = 0
     );
 
     /** Creates a vector holding the default CountProcessor configuration
      * \param[in] params : used for configuring the processor
      * \param[in] dskStorage : storage for dumping [kmer,count] couples
      * \param[in] otherStorage : used for histogram for instance
+     * \param[in] solidProcessor : if not null, called for each solid kmer after the dump (see CountProcessorBloom)
      * \return a vector of CountProcessor instances
      */
     static std::vector<ICountProcessor<span>*> getDefaultProcessorVector (
         Configuration&                  config,
         tools::misc::IProperties*       params,
         tools::storage::impl::Storage*  dskStorage,
-        tools::storage::impl::Storage*  otherStorage = 0
+        tools::storage::impl::Storage*  otherStorage   = 0,
+        CountProcessor*                 solidProcessor = 0
     );
 
     /** Process the kmers counting. It is mainly composed of a loop over the passes, and for each pass :
@@ -0,0 +1,386 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  INRIA
+ *   Authors: R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+/** \file SuperKmerDecoder.hpp
+ *  \brief Decoding of the superkmers stored in the superkmers partitions files
+ */
+
+#ifndef _GATB_CORE_KMER_IMPL_SUPER_KMER_DECODER_HPP_
+#define _GATB_CORE_KMER_IMPL_SUPER_KMER_DECODER_HPP_
+
+/********************************************************************************/
+
+#include <gatb/kmer/impl/Model.hpp>
+
+#include <algorithm>
+#include <string.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/********************************************************************************/
+namespace gatb      {
+namespace core      {
+namespace kmer      {
+namespace impl      {
+/********************************************************************************/
+
+/** \brief Kernel computing the kmers of a packed superkmer.
+ *
+ * The packed superkmer is a stream of nucleotides (4 per byte, the first one in the low bits):
+ * the first kmerSize nucleotides give the seed kmer (ie. the kmer value in little endian), then
+ * each following nucleotide is shifted into the previous kmer for getting the next one.
+ *
+ * This generic version relies on the LargeInt operators, the nucleotides being shifted one by one.
+ */
+template<typename Type> struct SuperKmerKernel
+{
+    /** Compute the forward and reverse complement kmers of a superkmer.
+     * \param[in] bytes : the packed nucleotides, followed by at least 8 readable bytes
+     * \param[in] kmerSize : kmer size
+     * \param[in] nbKmers : number of kmers of the superkmer
+     * \param[in] kmerMask : mask of the 2*kmerSize low bits
+     * \param[in] nt : the 4 nucleotides as Type
+     * \param[in] compNt : the complement of the 4 nucleotides, shifted to the highest nucleotide of a kmer
+     * \param[out] forward : the forward kmers
+     * \param[out] reverse : the reverse complement kmers */
+    static void decode (const u_int8_t* bytes, size_t kmerSize, size_t nbKmers, const Type& kmerMask,
+        const Type* nt, const Type* compNt, Type* forward, Type* reverse)
+    {
+        Type f = seed (bytes, kmerSize) & kmerMask;
+        Type r = revcomp (f, kmerSize);
+
+        forward[0] = f;
+        reverse[0] = r;
+
+        for (size_t m=1; m<nbKmers; m++)
+        {
+            size_t   pos = kmerSize + m - 1;
+            u_int8_t e   = (bytes[pos>>2] >> (2*(pos&3))) & 3;
+
+            f = ((f << 2) | nt[e]) & kmerMask;
+            r = (r >> 2) | compNt[e];
+            forward[m] = f;
+            reverse[m] = r;
+        }
+    }
+
+    /** Compute the canonical kmers of a superkmer, ie. the min of the forward and reverse complement kmers.
+     * The parameters are the same as for 'decode', the forward and reverse arrays being used as buffers.
+     * \return the canonical kmers (one of the two buffers) */
+    static const Type* decodeCanonical (const u_int8_t* bytes, size_t kmerSize, size_t nbKmers, const Type& kmerMask,
+        const Type* nt, const Type* compNt, Type* forward, Type* reverse)
+    {
+        /** The min is computed in the decoding loop, which saves a pass on the (large) kmers. */
+        Type f = seed (bytes, kmerSize) & kmerMask;
+        Type r = revcomp (f, kmerSize);
+
+        forward[0] = std::min (f, r);
+
+        for (size_t m=1; m<nbKmers; m++)
+        {
+            size_t   pos = kmerSize + m - 1;
+            u_int8_t e   = (bytes[pos>>2] >> (2*(pos&3))) & 3;
+
+            f = ((f << 2) | nt[e]) & kmerMask;
+            r = (r >> 2) | compNt[e];
+            forward[m] = std::min (f, r);
+        }
+        return forward;
+    }
+
+private:
+
+    /** Read the first kmerSize nucleotides as a little endian value (not masked). */
+    static Type seed (const u_int8_t* bytes, size_t kmerSize)
+    {
+        Type result;  result.setVal(0);
+
+        for (size_t i=0; i<(kmerSize+3)/4; i+=8)
+        {
+            u_int64_t word;  memcpy (&word, bytes+i, sizeof(word));
+            Type tmp;  tmp.setVal (word);
+            result = result | (tmp << (8*i));
+        }
+        return result;
+    }
+};
+
+/** \brief Kernel computing the kmers of a packed superkmer, for kmers fitting in 64 bits.
+ *
+ * The kmers are handled as u_int64_t and the last ones are kept in registers. With AVX2,
+ * 4 consecutive kmers are computed at once: the kmer m+4 is the kmer m shifted by the 4
+ * nucleotides preceding it in the stream. These 4 nucleotides are read directly from the
+ * packed bytes; their order is reversed with the revcomp_4NT table (whose complement is
+ * undone by a xor).
+ */
+template<> struct SuperKmerKernel<tools::math::LargeInt<1> >
+{
+    typedef tools::math::LargeInt<1> Type;
+
+    static void decode (const u_int8_t* bytes, size_t kmerSize, size_t nbKmers, const Type& kmerMask,
+        const Type* nt, const Type* compNt, Type* forward, Type* reverse)
+    {
+        u_int64_t* fwd  = (u_int64_t*) forward;
+        u_int64_t* rev  = (u_int64_t*) reverse;
+        u_int64_t  mask = kmerMask.getVal();
+        u_int64_t  seed;  memcpy (&seed, bytes, sizeof(seed));
+
+        forward[0].setVal (seed & mask);
+        reverse[0] = revcomp (forward[0], kmerSize);
+
+        size_t m = 1;
+
+#if defined(__AVX2__)
+        if (kmerSize >= 4 && nbKmers >= 8)  {  m = decode4 (bytes, kmerSize, nbKmers, mask, fwd, rev);  }
+#endif
+
+        /** The last kmers are kept in registers (the output arrays may alias for the compiler). */
+        u_int64_t f = fwd[m-1],  r = rev[m-1],  revShift = 2*(kmerSize-1);
+
+        for ( ; m<nbKmers; m++)
+        {
+            size_t    pos = kmerSize + m - 1;
+            u_int64_t e   = (bytes[pos>>2] >> (2*(pos&3))) & 3;
+
+            f = ((f << 2) | e) & mask;
+            r = (r >> 2) | ((e^2) << revShift);
+            fwd[m] = f;
+            rev[m] = r;
+        }
+    }
+
+    static const Type* decodeCanonical (const u_int8_t* bytes, size_t kmerSize, size_t nbKmers, const Type& kmerMask,
+        const Type* nt, const Type* compNt, Type* forward, Type* reverse)
+    {
+#if defined(__AVX2__)
+        decode (bytes, kmerSize, nbKmers, kmerMask, nt, compNt, forward, reverse);
+
+        /** The min is computed in a second pass, by 4 lanes too; it is stored in the forward array.
+         * There is no unsigned 64 bits comparison: we flip the sign bits before a signed one. */
+        u_int64_t*       fwd  = (u_int64_t*) forward;
+        const u_int64_t* rev  = (const u_int64_t*) reverse;
+        const __m256i    sign = _mm256_set1_epi64x ((long long) 0x8000000000000000ULL);
+        size_t m = 0;
+
+        for ( ; m+4<=nbKmers; m+=4)
+        {
+            __m256i f  = _mm256_loadu_si256 ((const __m256i*) (fwd+m));
+            __m256i r  = _mm256_loadu_si256 ((const __m256i*) (rev+m));
+            __m256i gt = _mm256_cmpgt_epi64 (_mm256_xor_si256 (f,sign), _mm256_xor_si256 (r,sign));
+            _mm256_storeu_si256 ((__m256i*) (fwd+m), _mm256_blendv_epi8 (f, r, gt));
+        }
+        for ( ; m<nbKmers; m++)  {  fwd[m] = std::min (fwd[m], rev[m]);  }
+#else
+        /** Without AVX2, a single scalar pass computing the min is the fastest. */
+        u_int64_t* out  = (u_int64_t*) forward;
+        u_int64_t  mask = kmerMask.getVal();
+        u_int64_t  seed;  memcpy (&seed, bytes, sizeof(seed));
+
+        forward[0].setVal (seed & mask);
+        u_int64_t f = out[0],  r = revcomp (forward[0], kmerSize).getVal(),  revShift = 2*(kmerSize-1);
+        out[0] = std::min (f, r);
+
+        for (size_t m=1; m<nbKmers; m++)
+        {
+            size_t    pos = kmerSize + m - 1;
+            u_int64_t e   = (bytes[pos>>2] >> (2*(pos&3))) & 3;
+
+            f = ((f << 2) | e) & mask;
+            r = (r >> 2) | ((e^2) << revShift);
+            out[m] = std::min (f, r);
+        }
+#endif
+        return forward;
+    }
+
+private:
+
+#if defined(__AVX2__)
+    /** Compute the kmers 1..nbKmers-1 by 4 lanes; the first 3 ones are computed in scalar.
+     * \return the index of the first kmer not computed. */
+    static size_t decode4 (const u_int8_t* bytes, size_t kmerSize, size_t nbKmers, u_int64_t mask, u_int64_t* fwd, u_int64_t* rev)
+    {
+        const u_int64_t revShift = 2*(kmerSize-1);
+
+        for (size_t m=1; m<4; m++)
+        {
+            size_t    pos = kmerSize + m - 1;
+            u_int64_t e   = (bytes[pos>>2] >> (2*(pos&3))) & 3;
+            fwd[m] = ((fwd[m-1] << 2) | e) & mask;
+            rev[m] = (rev[m-1] >> 2) | ((e^2) << revShift);
+        }
+
+        const __m256i vmask  = _mm256_set1_epi64x (mask);
+        const __m256i vcomp  = _mm256_set1_epi64x (0xAA);
+        const __m256i vbyte  = _mm256_set1_epi64x (0xFF);
+        const __m128i vshift = _mm_cvtsi32_si128 (2*kmerSize-8);
+        const __m256i lanes  = _mm256_set_epi64x (6, 4, 2, 0);
+
+        __m256i f = _mm256_loadu_si256 ((const __m256i*) fwd);
+        __m256i r = _mm256_loadu_si256 ((const __m256i*) rev);
+
+        size_t m = 4;
+        for ( ; m+4<=nbKmers; m+=4)
+        {
+            /** The 4 nucleotides preceding the kmer m+j start at the nucleotide pos+j of the stream. */
+            size_t    pos = kmerSize + m - 4;
+            u_int32_t word;  memcpy (&word, bytes + (pos>>2), sizeof(word));
+            u_int64_t x   = word >> (2*(pos&3));
+
+            __m256i raw = _mm256_and_si256 (_mm256_srlv_epi64 (_mm256_set1_epi64x (x), lanes), vbyte);
+            __m256i win = _mm256_set_epi64x (
+                revcomp_4NT[(x>>6)&0xFF] ^ 0xAA, revcomp_4NT[(x>>4)&0xFF] ^ 0xAA,
+                revcomp_4NT[(x>>2)&0xFF] ^ 0xAA, revcomp_4NT[(x>>0)&0xFF] ^ 0xAA
+            );
+
+            f = _mm256_and_si256 (_mm256_or_si256 (_mm256_slli_epi64 (f, 8), win), vmask);
+            r = _mm256_or_si256  (_mm256_srli_epi64 (r, 8), _mm256_sll_epi64 (_mm256_xor_si256 (raw, vcomp), vshift));
+
+            _mm256_storeu_si256 ((__m256i*) (fwd+m), f);
+            _mm256_storeu_si256 ((__m256i*) (rev+m), r);
+        }
+        return m;
+    }
+#endif
+};
+
+/********************************************************************************/
+
+/** \brief Decoder of the superkmers of a partition block.
+ *
+ * A block of the SuperKmerBinFiles is a list of superkmers, each one being a byte holding its
+ * number of kmers followed by its packed nucleotides. The decoder turns one superkmer into
+ * arrays of kmers, which are then consumed by the counting commands (hash or vector based).
+ *
+ * An instance holds its own buffers, so it must not be shared between threads.
+ *
+ * Sample of use:
+ * \code
+ *   SuperKmerDecoder<span> decoder (kmerSize);
+ *   for (const u_int8_t* ptr=block; ptr<block+size; )
+ *   {
+ *       size_t nbKmers;
+ *       const Type* kmers = decoder.decodeCanonical (ptr, block+size, nbKmers);
+ *       for (size_t i=0; i<nbKmers; i++)  {  ... kmers[i] ... }
+ *   }
+ * \endcode
+ */
+template<size_t span> class SuperKmerDecoder
+{
+public:
+
+    /** Shortcuts. */
+    typedef typename Kmer<span>::Type  Type;
+
+    /** Max number of kmers of a superkmer (stored in one byte). */
+    static const size_t MAX_NB_KMERS = 255;
+
+    /** Constructor.
+     * \param[in] kmerSize : kmer size */
+    SuperKmerDecoder (size_t kmerSize) : _kmerSize(kmerSize)
+    {
+        Type un;  un.setVal(1);
+        _kmerMask = (un << (kmerSize*2)) - un;
+
+        for (size_t i=0; i<4; i++)
+        {
+            _nt[i].setVal (i);
+            _compNt[i].setVal (comp_NT[i]);
+            _compNt[i] = _compNt[i] << (2*(kmerSize-1));
+        }
+
+        memset (_bytes, 0, sizeof(_bytes));
+    }
+
+    /** Decode one superkmer into its forward and reverse complement kmers.
+     * \param[in,out] ptr : beginning of the superkmer, then beginning of the next one
+     * \param[in] end : end of the block holding the superkmer
+     * \param[out] nbKmers : number of kmers of the superkmer
+     * \return the forward kmers, the reverse complement ones being given by 'getReverse' */
+    const Type* decode (const u_int8_t*& ptr, const u_int8_t* end, size_t& nbKmers)
+    {
+        const u_int8_t* bytes = load (ptr, end, nbKmers);
+
+        SuperKmerKernel<Type>::decode (bytes, _kmerSize, nbKmers, _kmerMask, _nt, _compNt, _forward, _reverse);
+
+        return _forward;
+    }
+
+    /** Decode one superkmer into its canonical kmers (or forward kmers if NONCANONICAL is set).
+     * \param[in,out] ptr : beginning of the superkmer, then beginning of the next one
+     * \param[in] end : end of the block holding the superkmer
+     * \param[out] nbKmers : number of kmers of the superkmer
+     * \return the kmers */
+    const Type* decodeCanonical (const u_int8_t*& ptr, const u_int8_t* end, size_t& nbKmers)
+    {
+#ifndef NONCANONICAL
+        const u_int8_t* bytes = load (ptr, end, nbKmers);
+        return SuperKmerKernel<Type>::decodeCanonical (bytes, _kmerSize, nbKmers, _kmerMask, _nt, _compNt, _forward, _reverse);
+#else
+        return decode (ptr, end, nbKmers);
+#endif
+    }
+
+    /** Get the reverse complement kmers of the last superkmer decoded by 'decode'.
+     * \return the kmers. */
+    const Type* getReverse () const  { return _reverse; }
+
+private:
+
+    /** Get the packed nucleotides of a superkmer and move the pointer to the next superkmer.
+     * The kernels read words, so the nucleotides are copied into a padded buffer when the
+     * superkmer is too close to the end of the block. */
+    const u_int8_t* load (const u_int8_t*& ptr, const u_int8_t* end, size_t& nbKmers)
+    {
+        nbKmers = *ptr;  ptr++;
+
+        size_t nbBytes = (_kmerSize + std::max (nbKmers, (size_t)1) - 1 + 3) / 4;
+
+        const u_int8_t* bytes = ptr;
+        ptr += nbBytes;
+
+        if (ptr + PADDING > end)
+        {
+            memcpy (_bytes, bytes, nbBytes);
+            memset (_bytes + nbBytes, 0, PADDING);
+            bytes = _bytes;
+        }
+
+        return bytes;
+    }
+
+    static const size_t PADDING = 8;
+
+    size_t _kmerSize;
+    Type   _kmerMask;
+    Type   _nt[4];
+    Type   _compNt[4];
+
+    u_int8_t _bytes [(span + MAX_NB_KMERS + 3)/4 + PADDING];
+    Type     _forward [MAX_NB_KMERS+1];
+    Type     _reverse [MAX_NB_KMERS+1];
+};
+
+/********************************************************************************/
+} } } } /* end of namespaces. */
+/********************************************************************************/
+
+#endif /* _GATB_CORE_KMER_IMPL_SUPER_KMER_DECODER_HPP_ */
@@ -31,6 +31,7 @@
 /********************************************************************************/
 
 #include <gatb/system/api/ISmartPointer.hpp>
+#include <stddef.h>
 
 /********************************************************************************/
 namespace gatb          {
@@ -53,6 +54,16 @@ public:
     /** Tells whether an item exists or not
      * \return true if the item exists, false otherwise */
     virtual bool contains (const Item& item) = 0;
+
+    /** Tells whether several items exist or not. Implementations may override this method
+     * in order to overlap the memory accesses of the different queries.
+     * \param[in] items : items to test
+     * \param[in] nb : number of items
+     * \param[out] result : presence of each item (nb booleans) */
+    virtual void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        for (size_t i=0; i<nb; i++)  {  result[i] = contains (items[i]);  }
+    }
 };
 
 /********************************************************************************/
@@ -35,6 +35,14 @@
 #include <gatb/system/api/types.hpp>
 #include <gatb/tools/misc/api/Enums.hpp>
 #include <bitset>
+#include <stdlib.h>
+
+/** The blocked Bloom filter tests its bits with AVX2 or AVX-512 when the CPU supports them (checked at runtime),
+ * whatever the instruction set the library is built for. */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define GATB_BLOOM_BLOCKED_SIMD 1
+#include <immintrin.h>
+#endif
 
 /********************************************************************************/
 namespace gatb          {
@@ -139,6 +147,15 @@ public:
      */
 	virtual bool contains (const Item& item) = 0;
 
+    /** Tells whether several items are in the Bloom filter.
+     * The memory locations of all the items are computed and prefetched before
+     * the first item is tested, so the cache misses of the different queries overlap.
+     * \param[in] items : items to test.
+     * \param[in] nb : number of items.
+     * \param[out] result : presence or not of each item (nb booleans)
+     */
+    virtual void containsBatch (const Item* items, size_t nb, bool* result) = 0;
+
     /** Tells whether the 4 neighbors of the given item are in the Bloom filter.
      * The 4 neighbors are computed from the given item by adding successively
      * nucleotides 'A', 'C', 'T' and 'G'
@@ -165,6 +182,11 @@ public:
     /** Return the number of 1's in the Bloom (nibble by nibble)
      * \return the weight of the Bloom filter */
     virtual unsigned long  weight () = 0;
+
+protected:
+
+    /** Number of items whose memory locations are prefetched at once by containsBatch. */
+    static const size_t BATCH_SIZE = 16;
 };
 
 /********************************************************************************/
@@ -233,6 +255,31 @@ public:
         return true;
     }
 
+    /** \copydoc IBloom::containsBatch.
+     * Only the first bit of each item is prefetched, the other bits are tested as in contains. */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        u_int64_t h0 [IBloom<Item>::BATCH_SIZE];
+
+        for (size_t start=0; start<nb; start+=IBloom<Item>::BATCH_SIZE)
+        {
+            size_t n = std::min (nb-start, IBloom<Item>::BATCH_SIZE);
+
+            for (size_t i=0; i<n; i++)
+            {
+                h0[i] = getPosition (items[start+i], 0);
+                __builtin_prefetch (&(blooma [h0[i] >> 3]), 0, 3);
+            }
+
+            for (size_t i=0; i<n; i++)
+            {
+                bool found = hasBit (h0[i]);
+                for (size_t j=1; found && j<n_hash_func; j++)  {  found = hasBit (getPosition (items[start+i], j));  }
+                result[start+i] = found;
+            }
+        }
+    }
+
     /** \copydoc IBloom::contains4. */
 	virtual std::bitset<4> contains4 (const Item& item, bool right)
     {   throw system::ExceptionNotImplemented ();  }
@@ -262,6 +309,12 @@ protected:
     u_int64_t tai;
     u_int64_t nchar;
     bool      isSizePowOf2;
+
+    /** Position of the bit given by the ith hash function. */
+    u_int64_t getPosition (const Item& item, size_t i)  {  return isSizePowOf2 ? (_hash (item,i) & tai) : (_hash (item,i) % tai);  }
+
+    /** Tells whether the bit at the given position is set. */
+    bool hasBit (u_int64_t h) const  {  return (blooma[h >> 3] & bit_mask[h & 7]) != 0;  }
 };
 
 /********************************************************************************/
@@ -363,6 +416,9 @@ public:
     /** \copydoc IBloom::contains */
     bool contains (const Item& item) { return false; }
 
+    /** \copydoc IBloom::containsBatch */
+    void containsBatch (const Item* items, size_t nb, bool* result)  {  for (size_t i=0; i<nb; i++)  { result[i] = false; }  }
+
     /** \copydoc IBloom::insert */
     void insert (const Item& item) {}
 
@@ -488,6 +544,31 @@ public:
         }
         return true;
     }
+
+    /** \copydoc IBloom::containsBatch.
+     * All the bits of an item are in the block following its first bit, which is prefetched. */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        u_int64_t h0 [IBloom<Item>::BATCH_SIZE];
+
+        for (size_t start=0; start<nb; start+=IBloom<Item>::BATCH_SIZE)
+        {
+            size_t n = std::min (nb-start, IBloom<Item>::BATCH_SIZE);
+
+            for (size_t i=0; i<n; i++)
+            {
+                h0[i] = this->_hash (items[start+i],0) % _reduced_tai;
+                __builtin_prefetch (&(this->blooma [h0[i] >> 3]), 0, 3);
+            }
+
+            for (size_t i=0; i<n; i++)
+            {
+                bool found = this->hasBit (h0[i]);
+                for (size_t j=1; found && j<this->n_hash_func; j++)  {  found = this->hasBit (h0[i] + (simplehash16 (items[start+i], j) & _mask_block));  }
+                result[start+i] = found;
+            }
+        }
+    }
     
     /** \copydoc IBloom::weight*/
     unsigned long weight()
@@ -596,30 +677,10 @@ public:
     /** \copydoc Container::contains. */
     bool contains (const Item& item)
     {
-        u_int64_t racine;
-
-        Item suffix = item & 3 ;
-        Item prefix = (item & _prefmask)  >> ((_kmerSize-2)*2);
-        prefix += suffix;
-        prefix = prefix  & 15 ;
-
-        u_int64_t pref_val = cano2[prefix.getVal()]; //get canonical of pref+suffix
-
-        Item hashpart = ( item >> 2 ) & _maskkm2 ;  // delete 1 nt at each side
-        Item rev =  revcomp(hashpart,_kmerSize-2);
-        if(rev<hashpart) hashpart = rev; //transform to canonical
-
-        // Item km = item;
-        // rev =  revcomp(km,_kmerSize);
-        // if(rev < km) km = rev; //transform to canonical
-
         u_int64_t tab_keys [20];
-        u_int64_t h0;
 
-        racine = ((this->_hash (hashpart,0) ) % this->_reduced_tai) ;
-        //h0 = racine + (this->_hash (km,0)  & this->_mask_block);
-        h0 = racine + (pref_val  );
-        //printf("h0 %llu\n",h0);
+        Item hashpart;
+        u_int64_t h0 = getFirstPosition (item, hashpart);
 
         __builtin_prefetch(&(this->blooma [h0 >> 3] ), 0, 3); //preparing for read
 
@@ -641,6 +702,31 @@ public:
         return true;
     }
 
+    /** \copydoc IBloom::containsBatch. */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        u_int64_t h0       [IBloom<Item>::BATCH_SIZE];
+        Item      hashparts[IBloom<Item>::BATCH_SIZE];
+
+        for (size_t start=0; start<nb; start+=IBloom<Item>::BATCH_SIZE)
+        {
+            size_t n = std::min (nb-start, IBloom<Item>::BATCH_SIZE);
+
+            for (size_t i=0; i<n; i++)
+            {
+                h0[i] = getFirstPosition (items[start+i], hashparts[i]);
+                __builtin_prefetch (&(this->blooma [h0[i] >> 3]), 0, 3);
+            }
+
+            for (size_t i=0; i<n; i++)
+            {
+                bool found = this->hasBit (h0[i]);
+                for (size_t j=1; found && j<this->n_hash_func; j++)  {  found = this->hasBit (h0[i] + (simplehash16 (hashparts[i], j) & this->_mask_block));  }
+                result[start+i] = found;
+            }
+        }
+    }
+
     /** \copydoc IBloom::contains4*/
     std::bitset<4> contains4 (const Item& item, bool right)
     {
@@ -815,6 +901,25 @@ private:
     Item _prefmask;
     Item _kmerMask;
     size_t _kmerSize;
+
+    /** Computes the first bit position of an item and the canonical middle part
+     * (kmer without its first and last nucleotides) giving its other bits. */
+    u_int64_t getFirstPosition (const Item& item, Item& hashpart)
+    {
+        Item suffix = item & 3 ;
+        Item prefix = (item & _prefmask)  >> ((_kmerSize-2)*2);
+        prefix += suffix;
+        prefix = prefix  & 15 ;
+
+        u_int64_t pref_val = cano2[prefix.getVal()]; //get canonical of pref+suffix
+
+        hashpart = ( item >> 2 ) & _maskkm2 ;  // delete 1 nt at each side
+        Item rev =  revcomp(hashpart,_kmerSize-2);
+        if(rev<hashpart) hashpart = rev; //transform to canonical
+
+        u_int64_t racine = ((this->_hash (hashpart,0) ) % this->_reduced_tai) ;
+        return racine + pref_val;
+    }
 };
     
 /********************************************************************************/
@@ -992,6 +1097,14 @@ public:
         return true;
     }
 
+    /** \copydoc IBloom::containsBatch.
+     * The items are tested in order: contains keeps the hash codes of the last middle part,
+     * which are shared by the neighbors of a kmer. */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        for (size_t i=0; i<nb; i++)  {  result[i] = contains (items[i]);  }
+    }
+
     /** \copydoc IBloom::contains4*/
     std::bitset<4> contains4 (const Item& item, bool right)
     {
@@ -1234,6 +1347,291 @@ private:
 	
 /********************************************************************************/
 
+/** \brief Bloom filter implementation with register blocking
+ *
+ * Each item is mapped to a single block of 64 bytes (one cache line), seen as 16 words
+ * of 32 bits. The k hash functions set one bit in k consecutive words (modulo 16) of the
+ * block, the first word and the bit positions being given by a hash code of the item
+ * (the bit of the ith word is given by the product of the hash code by the ith salt).
+ *
+ * A query costs at most one cache miss, and the k bits are tested at once: the mask of
+ * the item is built in SIMD registers (AVX-512 or AVX2 when available) and compared to
+ * the block without any early exit; the scalar version only visits the k words. An insert
+ * is one atomic OR per word.
+ *
+ * The false positive rate is slightly higher than the one of a basic Bloom filter of
+ * the same size, and at most 16 hash functions can be used.
+ *
+ * Items are supposed to be canonical kmers, the neighbors tested by contains4 and
+ * contains8 are thus made canonical before being looked up.
+ */
+template <typename Item> class BloomBlocked : public IBloom<Item>
+{
+public:
+
+    /** Constructor.
+     * \param[in] tai_bloom : size (in bits) of the bloom filter, rounded up to a multiple of the block size.
+     * \param[in] kmersize : kmer size (used for neighbors queries)
+     * \param[in] nbHash : number of hash functions to use (at most 16) */
+    BloomBlocked (u_int64_t tai_bloom, size_t kmersize, size_t nbHash = 8)
+        : _hash(1), n_hash_func (std::max ((size_t)1, std::min (nbHash, (size_t)NB_WORDS))), blooma(0), _nbBlocks(0), _kmerSize(kmersize), _simd(getSimd())
+    {
+        static const u_int32_t salts[NB_WORDS] =
+        {
+            0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+            0x9e3779b1U, 0x85ebca6bU, 0xc2b2ae35U, 0x27d4eb2fU, 0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U
+        };
+
+        _nbBlocks = std::max ((u_int64_t)1, (tai_bloom + BLOCK_NBITS - 1) / BLOCK_NBITS);
+
+        /** The block index is computed from 32 bits of the hash code. */
+        if (_nbBlocks >> 32)  {  throw system::Exception ("blocked Bloom filter too big (%lld bits)", tai_bloom);  }
+
+        void* ptr = 0;
+        if (posix_memalign (&ptr, BLOCK_SIZE, _nbBlocks*BLOCK_SIZE) != 0)  {  throw system::Exception ("no memory for Bloom filter of %lld bits", tai_bloom);  }
+        blooma = (u_int8_t*) ptr;
+        system::impl::System::memory().memset (blooma, 0, _nbBlocks*BLOCK_SIZE);
+
+        for (size_t i=0; i<NB_WORDS; i++)  {  _salts[i] = salts[i];  }
+
+        Item un;
+        un.setVal(1);
+        _kmerMask = (un << (_kmerSize*2)) - un;
+    }
+
+    /** Destructor. */
+    virtual ~BloomBlocked ()  {  free (blooma);  }
+
+    /** \copydoc Bag::insert. */
+    void insert (const Item& item)
+    {
+        u_int64_t h = _hash (item, 0);
+        u_int32_t* block = getBlock (h);
+
+        u_int32_t h32   = (u_int32_t) h;
+        u_int32_t start = (h >> 32) & (NB_WORDS-1);
+
+        for (size_t j=0; j<n_hash_func; j++)
+        {
+            size_t    i   = (start + j) & (NB_WORDS-1);
+            u_int32_t bit = 1U << ((h32 * _salts[i]) >> 27);
+
+            /** We avoid to write (and invalidate the cache line for other threads) if the bit is already set. */
+            if ((block[i] & bit) == 0)  {  __sync_fetch_and_or (block + i, bit);  }
+        }
+    }
+
+    /** \copydoc Bag::flush */
+    void flush ()  {}
+
+    /** \copydoc Container::contains. */
+    bool contains (const Item& item)  {  return containsHash (_hash (item, 0));  }
+
+    /** \copydoc IBloom::containsBatch. */
+    void containsBatch (const Item* items, size_t nb, bool* result)
+    {
+        u_int64_t h [IBloom<Item>::BATCH_SIZE];
+
+        for (size_t start=0; start<nb; start+=IBloom<Item>::BATCH_SIZE)
+        {
+            size_t n = std::min (nb-start, IBloom<Item>::BATCH_SIZE);
+
+            for (size_t i=0; i<n; i++)
+            {
+                h[i] = _hash (items[start+i], 0);
+                __builtin_prefetch (getBlock (h[i]), 0, 3);
+            }
+
+            for (size_t i=0; i<n; i++)  {  result[start+i] = containsHash (h[i]);  }
+        }
+    }
+
+    /** \copydoc IBloom::contains4. */
+    std::bitset<4> contains4 (const Item& item, bool right)
+    {
+        Item neighbors[4];
+        getNeighbors (item, right, neighbors);
+
+        /** The 4 blocks are likely in different cache lines : they are asked for in one batch. */
+        bool found[4];
+        containsBatch (neighbors, 4, found);
+
+        std::bitset<4> resu;
+        for (size_t i=0; i<4; i++)  {  resu.set (i, found[i]);  }
+        return resu;
+    }
+
+    /** \copydoc IBloom::contains8. */
+    std::bitset<8> contains8 (const Item& item)
+    {
+        Item neighbors[8];
+        getNeighbors (item, true,  neighbors);
+        getNeighbors (item, false, neighbors+4);
+
+        bool found[8];
+        containsBatch (neighbors, 8, found);
+
+        std::bitset<8> result;
+        for (size_t i=0; i<8; i++)  {  result.set (i, found[i]);  }
+        return result;
+    }
+
+    /** \copydoc IBloom::getArray. */
+    u_int8_t*& getArray    ()  { return blooma; }
+
+    /** \copydoc IBloom::getSize. */
+    u_int64_t  getSize     ()  { return _nbBlocks*BLOCK_SIZE;  }
+
+    /** \copydoc IBloom::getBitSize. */
+    u_int64_t  getBitSize  ()  { return _nbBlocks*BLOCK_NBITS; }
+
+    /** \copydoc IBloom::getNbHash */
+    size_t     getNbHash   () const { return n_hash_func; }
+
+    /** \copydoc IBloom::getName*/
+    std::string  getName () const { return "blocked"; }
+
+    /** \copydoc IBloom::weight */
+    unsigned long weight()
+    {
+        unsigned long weight = 0;
+        const u_int64_t* words = (const u_int64_t*) blooma;
+        for (u_int64_t i=0; i<_nbBlocks*BLOCK_SIZE/sizeof(u_int64_t); i++)  {  weight += __builtin_popcountll (words[i]);  }
+        return weight;
+    }
+
+    /** Instruction sets that test the bits of a block with one mask compare. */
+    enum Simd_e { SIMD_NONE, SIMD_AVX2, SIMD_AVX512 };
+
+    /** Best instruction set supported by the CPU, used by containsHash. */
+    static Simd_e getSimd ()
+    {
+        static const Simd_e simd = detectSimd();
+        return simd;
+    }
+
+    /** Tests the bits of an item, given its hash code. */
+    bool containsHash (u_int64_t h) const  {  return containsHash (h, _simd);  }
+
+    /** Tests the bits of an item, given its hash code, with an instruction set supported by the CPU (see getSimd). */
+    bool containsHash (u_int64_t h, Simd_e simd) const
+    {
+#ifdef GATB_BLOOM_BLOCKED_SIMD
+        if (simd == SIMD_AVX512)  {  return containsHashAVX512 (h);  }
+        if (simd == SIMD_AVX2)    {  return containsHashAVX2   (h);  }
+#endif
+        /** Without SIMD, only the k words of the mask are visited. */
+        const u_int32_t* block = getBlock (h);
+
+        u_int32_t h32   = (u_int32_t) h;
+        u_int32_t start = (h >> 32) & (NB_WORDS-1);
+
+        for (size_t j=0; j<n_hash_func; j++)
+        {
+            size_t i = (start + j) & (NB_WORDS-1);
+            if ((block[i] & (1U << ((h32 * _salts[i]) >> 27))) == 0)  {  return false;  }
+        }
+        return true;
+    }
+
+private:
+
+    static Simd_e detectSimd ()
+    {
+#ifdef GATB_BLOOM_BLOCKED_SIMD
+        __builtin_cpu_init ();
+        if (__builtin_cpu_supports ("avx512f"))  {  return SIMD_AVX512;  }
+        if (__builtin_cpu_supports ("avx2"))     {  return SIMD_AVX2;    }
+#endif
+        return SIMD_NONE;
+    }
+
+#ifdef GATB_BLOOM_BLOCKED_SIMD
+    /** The k bits of the block are tested at once: lanes getting a bit are those with (lane - start) % 16 < k */
+    __attribute__ ((target ("avx512f"))) bool containsHashAVX512 (u_int64_t h) const
+    {
+        const u_int32_t* block = getBlock (h);
+
+        __m512i   lanes   = _mm512_and_si512 (_mm512_sub_epi32 (_mm512_setr_epi32 (0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15), _mm512_set1_epi32 ((h >> 32) & (NB_WORDS-1))), _mm512_set1_epi32 (NB_WORDS-1));
+        __mmask16 enabled = _mm512_cmplt_epi32_mask (lanes, _mm512_set1_epi32 (n_hash_func));
+        __m512i   mask    = _mm512_maskz_sllv_epi32 (enabled, _mm512_set1_epi32 (1),
+            _mm512_srli_epi32 (_mm512_mullo_epi32 (_mm512_set1_epi32 ((u_int32_t)h), _mm512_loadu_si512 (_salts)), 27)
+        );
+        __m512i missing = _mm512_andnot_si512 (_mm512_load_si512 (block), mask);
+        return _mm512_test_epi32_mask (missing, missing) == 0;
+    }
+
+    /** Same as containsHashAVX512, on the two halves of the block. */
+    __attribute__ ((target ("avx2"))) bool containsHashAVX2 (u_int64_t h) const
+    {
+        const u_int32_t* block = getBlock (h);
+
+        __m256i hh    = _mm256_set1_epi32 ((u_int32_t)h);
+        __m256i one   = _mm256_set1_epi32 (1);
+        __m256i start = _mm256_set1_epi32 ((h >> 32) & (NB_WORDS-1));
+        __m256i last  = _mm256_set1_epi32 (NB_WORDS-1);
+        __m256i k     = _mm256_set1_epi32 (n_hash_func);
+
+        __m256i enabled0 = _mm256_cmpgt_epi32 (k, _mm256_and_si256 (_mm256_sub_epi32 (_mm256_setr_epi32 (0,1,2,3,4,5,6,7),        start), last));
+        __m256i enabled1 = _mm256_cmpgt_epi32 (k, _mm256_and_si256 (_mm256_sub_epi32 (_mm256_setr_epi32 (8,9,10,11,12,13,14,15), start), last));
+
+        __m256i mask0 = _mm256_and_si256 (
+            _mm256_sllv_epi32 (one, _mm256_srli_epi32 (_mm256_mullo_epi32 (hh, _mm256_loadu_si256 ((const __m256i*) (_salts  ))), 27)),
+            enabled0
+        );
+        __m256i mask1 = _mm256_and_si256 (
+            _mm256_sllv_epi32 (one, _mm256_srli_epi32 (_mm256_mullo_epi32 (hh, _mm256_loadu_si256 ((const __m256i*) (_salts+8))), 27)),
+            enabled1
+        );
+        __m256i missing = _mm256_or_si256 (
+            _mm256_andnot_si256 (_mm256_load_si256 ((const __m256i*) (block  )), mask0),
+            _mm256_andnot_si256 (_mm256_load_si256 ((const __m256i*) (block+8)), mask1)
+        );
+        return _mm256_testz_si256 (missing, missing);
+    }
+#endif
+
+    static const size_t BLOCK_SIZE  = 64;
+    static const size_t BLOCK_NBITS = 8*BLOCK_SIZE;
+    static const size_t NB_WORDS    = BLOCK_SIZE / sizeof(u_int32_t);
+
+    HashFunctors<Item> _hash;
+    size_t n_hash_func;
+
+    u_int8_t* blooma;
+    u_int64_t _nbBlocks;
+
+    u_int32_t _salts [NB_WORDS];
+
+    size_t _kmerSize;
+    Item   _kmerMask;
+
+    Simd_e _simd;
+
+    /** Canonical forms of the 4 successors (right) or predecessors (left) of a kmer, in nucleotide order. */
+    void getNeighbors (const Item& item, bool right, Item* neighbors) const
+    {
+        for (size_t nt=0; nt<4; nt++)
+        {
+            Item n;  n.setVal(nt);
+
+            if (right)  {  n = ((item << 2) & _kmerMask) + n;            }
+            else        {  n = (item >> 2) + (n << ((_kmerSize-1)*2));  }
+
+            Item rev = revcomp (n, _kmerSize);
+            neighbors[nt] = rev < n ? rev : n;
+        }
+    }
+
+    /** The block is chosen from the upper 32 bits of the hash code (multiply-shift instead of modulo). */
+    u_int32_t* getBlock (u_int64_t h) const
+    {
+        return (u_int32_t*) (blooma + (((h >> 32) * _nbBlocks) >> 32) * BLOCK_SIZE);
+    }
+};
+
+/********************************************************************************/
+
 /** \brief Factory that creates IBloom instances
  *
  */
@@ -1259,6 +1657,7 @@ public:
             case tools::misc::BLOOM_BASIC:     return new BloomSynchronized<T>     (tai_bloom, nbHash);
             case tools::misc::BLOOM_CACHE:     return new BloomCacheCoherent<T>    (tai_bloom, nbHash);
 			case tools::misc::BLOOM_NEIGHBOR:  return new BloomNeighborCoherent<T> (tai_bloom, kmersize, nbHash);
+            case tools::misc::BLOOM_BLOCKED:   return new BloomBlocked<T>          (tai_bloom, kmersize, nbHash);
             case tools::misc::BLOOM_DEFAULT:   return new BloomCacheCoherent<T>    (tai_bloom, nbHash);
             default:        throw system::Exception ("bad Bloom kind %d in createBloom", kind);
         }
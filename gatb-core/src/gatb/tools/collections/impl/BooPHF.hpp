@@ -29,6 +29,9 @@
 #include <gatb/tools/storage/impl/Storage.hpp>
 #include <gatb/tools/misc/impl/Stringify.hpp>
 #include <gatb/tools/misc/impl/Progress.hpp>
+#include <gatb/tools/misc/api/Range.hpp>
+#include <gatb/tools/designpattern/impl/Command.hpp>
+#include <gatb/system/api/IMemory.hpp>
 
 #include <BooPHF/BooPHF.h>
 
@@ -255,6 +258,10 @@ private:
                 // I wanted to return two different hashes depending on how boophf calls it
                 // since I contrl BooPHF code's, I know it calls this function with 0x33333333CCCCCCCCULL as the second seed.
                 }
+
+        /** Part of the key in a partitioned hash function. We use the second hash of the triple,
+         * which is not used by boophf itself. */
+        size_t part (const Key& key, size_t nbParts) const  {  return std::get<1>(emphf_hasher(adaptor(key))) % nbParts;  }
     };
 
     typedef boomphf::mphf<  Key, hasher_t  > boophf_t;
@@ -265,12 +272,14 @@ public:
     typedef u_int64_t Code;
 
     /** Constructor. */
-    BooPHF () : isBuilt(false), nbKeys(0)  {}
+    BooPHF () : isBuilt(false), nbKeys(0), gamma(3.0), nbRounds(0)  {}
 
     /** Build the hash function from a set of items.
      * \param[in] iterable : keys iterator
-     * \param[in] progress : object that listens to the event of the algorithm */
-    void build (tools::collections::Iterable<Key>* iterable, int nbThreads = 1, tools::dp::IteratorListener* progress=0)
+     * \param[in] nbThreads : number of threads used by boophf
+     * \param[in] progress : object that listens to the event of the algorithm
+     * \param[in] gamma : boophf gamma; a bigger value gives a faster construction but a bigger function */
+    void build (tools::collections::Iterable<Key>* iterable, int nbThreads = 1, tools::dp::IteratorListener* progress=0, double gamma=3.0)
     {
         if (isBuilt==true) { throw system::Exception ("MFHP: built already done"); }
 
@@ -288,10 +297,105 @@ public:
 			withprogress = false;
 		
 
-        bphf =  boophf_t(nbElts, kmers, nbThreads, 3.0 /*much faster construction than gamma=1*/, withprogress);
+        bphf =  boophf_t(nbElts, kmers, nbThreads, gamma /* 3.0 gives a much faster construction than gamma=1*/, withprogress);
 
-        isBuilt = true;
-        nbKeys  = iterable->getNbItems();
+        isBuilt     = true;
+        nbKeys      = iterable->getNbItems();
+        this->gamma = gamma;
+    }
+
+    /** Build the hash function as N smaller functions, each one built on one part of the keys.
+     * A key goes to a part according to its hash value; the hash code of a key is then the
+     * code given by the function of its part, plus the number of keys of the previous parts.
+     *
+     * The keys are streamed from the sources (likely the partitions of the solid kmers); each
+     * thread reads whole sources, then builds whole parts. If the keys of all the parts don't
+     * fit in the given memory, the parts are built in several rounds, each round reading the
+     * sources again; no keys are written on disk.
+     *
+     * \param[in] sources : iterables over the keys; a key must be found once among all of them
+     * \param[in] nbParts : number of parts of the hash function
+     * \param[in] nbThreads : number of threads
+     * \param[in] gamma : boophf gamma of each part
+     * \param[in] maxMemory : memory (in MBytes) allowed for the keys held during one round (0 for no limit)
+     * \param[in] progress : object that listens to the event of the algorithm */
+    void buildPartitioned (
+        const std::vector<tools::collections::Iterable<Key>*>& sources,
+        size_t                       nbParts,
+        int                          nbThreads = 1,
+        double                       gamma     = 3.0,
+        u_int64_t                    maxMemory = 0,
+        tools::dp::IteratorListener* progress  = 0
+    )
+    {
+        if (isBuilt==true) { throw system::Exception ("MFHP: built already done"); }
+        if (nbParts==0)    { nbParts = 1; }
+
+        u_int64_t totalKeys = 0;
+        for (size_t s=0; s<sources.size(); s++)  { totalKeys += sources[s]->getNbItems(); }
+
+        /** We compute how many parts we can build at once. The keys of a round are held in the
+         * routing buffers, then copied into the keys of the part being built. */
+        size_t nbPartsPerRound = nbParts;
+        if (maxMemory > 0 && totalKeys > 0)
+        {
+            u_int64_t nbKeysPerRound = maxMemory * system::MBYTE / (2*sizeof(Key));
+            nbPartsPerRound = std::max ((u_int64_t)1, std::min ((u_int64_t)nbParts, (nbKeysPerRound * nbParts) / totalKeys));
+        }
+        nbRounds = (nbParts + nbPartsPerRound - 1) / nbPartsPerRound;
+
+        parts.clear();  parts.resize (nbParts);
+
+        tools::dp::impl::Dispatcher dispatcher (nbThreads);
+
+        system::ISynchronizer* synchro = system::impl::System::thread().newSynchronizer();
+        LOCAL (synchro);
+
+        if (progress)  {  progress->reset (nbParts);  progress->init ();  }
+
+        for (size_t partBegin=0; partBegin<nbParts; partBegin+=nbPartsPerRound)
+        {
+            size_t partEnd = std::min (nbParts, partBegin + nbPartsPerRound);
+
+            /** Keys routed by each source into the parts of the round. Keeping them per source
+             * makes the keys order (and so the built function) independent of the threads. */
+            std::vector<std::vector<std::vector<Key> > > routed (sources.size());
+
+            dispatcher.iterate (new typename misc::Range<size_t>::Iterator (0, sources.size()-1), [&] (size_t s)
+            {
+                std::vector<std::vector<Key> >& local = routed[s];
+                local.resize (partEnd - partBegin);
+
+                tools::dp::Iterator<Key>* it = sources[s]->iterator();  LOCAL (it);
+                for (it->first(); !it->isDone(); it->next())
+                {
+                    size_t p = hasher.part (it->item(), nbParts);
+                    if (p >= partBegin && p < partEnd)  {  local[p-partBegin].push_back (it->item());  }
+                }
+            }, 1);
+
+            dispatcher.iterate (new typename misc::Range<size_t>::Iterator (partBegin, partEnd-1), [&] (size_t p)
+            {
+                std::vector<Key> keys;
+                for (size_t s=0; s<routed.size(); s++)
+                {
+                    std::vector<Key>& current = routed[s][p-partBegin];
+                    keys.insert (keys.end(), current.begin(), current.end());
+                    std::vector<Key>().swap (current);
+                }
+
+                if (keys.empty()==false)  {  parts[p] = boophf_t (keys.size(), keys, 1, gamma, false);  }
+
+                if (progress)  {  system::LocalSynchronizer ls (synchro);  progress->inc (1);  }
+            }, 1);
+        }
+
+        if (progress)  {  progress->finish ();  }
+
+        computeOffsets ();
+
+        isBuilt     = true;
+        this->gamma = gamma;
     }
 
     /** Returns the hash code for the given key. WARNING : default implementation here will
@@ -300,20 +404,86 @@ public:
      * \return the hash value. */
     Code operator () (const Key& key)
     {
-        return bphf.lookup (key);
+        if (parts.empty())  {  return bphf.lookup (key);  }
+
+        size_t p = hasher.part (key, parts.size());
+        Code code = parts[p].lookup (key);
+        return code == ULLONG_MAX ? code : offsets[p] + code;
+    }
+
+    /** Returns the hash codes of several keys. The keys are hashed by groups, and the memory
+     * read for a key is prefetched while the other keys of its group are processed; this is
+     * faster than one operator() call per key. A partitioned function is queried key by key.
+     * \param[in] keys : the keys to be hashed
+     * \param[in] n : number of keys
+     * \param[out] codes : the hash value of each key (n values) */
+    void lookup (const Key* keys, size_t n, Code* codes)
+    {
+        if (parts.empty())  {  bphf.lookup (keys, n, codes);  return;  }
+
+        for (size_t i=0; i<n; i++)  {  codes[i] = (*this) (keys[i]);  }
+    }
+
+    /** Sets the memory layout of the bit arrays of the function: in the interleaved layout, the
+     * rank of each block of 512 bits is stored right before the block, so that a lookup reads one
+     * contiguous piece of memory per level. It uses the same memory as the default layout, and
+     * doesn't change the saved data.
+     * \param[in] interleaved : true for the interleaved layout, false for the default one */
+    void setInterleaved (bool interleaved)
+    {
+        bphf.setInterleaved (interleaved);
+        for (size_t p=0; p<parts.size(); p++)  {  parts[p].setInterleaved (interleaved);  }
+    }
+
+    /** Tells whether the bit arrays use the interleaved layout.
+     * \return true if interleaved */
+    bool isInterleaved () const
+    {
+        for (size_t p=0; p<parts.size(); p++)  {  if (parts[p].nbKeys() > 0)  {  return parts[p].isInterleaved();  }  }
+        return bphf.isInterleaved();
     }
 
     /** Returns the number of keys.
      * \return keys number */
-    size_t size() const { return bphf.nbKeys(); }
+    size_t size() const { return parts.empty() ? bphf.nbKeys() : nbKeys; }
+
+    /** Returns the number of parts (0 if the function is not partitioned).
+     * \return parts number */
+    size_t getNbParts () const { return parts.size(); }
+
+    /** Returns the number of rounds over the keys needed by the partitioned construction.
+     * \return rounds number */
+    size_t getNbRounds () const { return nbRounds; }
+
+    /** Returns the gamma used for the construction.
+     * \return gamma */
+    double getGamma () const { return gamma; }
 
     /** Load hash function from a collection*/
     size_t load (tools::storage::impl::Group& group, const std::string& name)
     {
         /** We need an input stream for the given collection given by group/name. */
         tools::storage::impl::Storage::istream is (group, name);
-		bphf =  boophf_t();
-        bphf.load (is);
+
+        /** A partitioned function has its number of parts as an attribute of the group. */
+        size_t nbParts = atol (group.getProperty (getNbPartsName()).c_str());
+
+        if (nbParts == 0)
+        {
+            bphf =  boophf_t();
+            bphf.load (is);
+        }
+        else
+        {
+            parts.clear();  parts.resize (nbParts);
+            for (size_t p=0; p<nbParts; p++)
+            {
+                u_int64_t nb = 0;
+                is.read (reinterpret_cast<char*>(&nb), sizeof(nb));
+                if (nb > 0)  {  parts[p].load (is);  }
+            }
+            computeOffsets ();
+        }
         return size();
     }
 
@@ -323,9 +493,25 @@ public:
     {
         /** We need an output stream for the given collection given by group/name. */
         tools::storage::impl::Storage::ostream os (group, name);
-        bphf.save (os);
+
+        if (parts.empty())
+        {
+            bphf.save (os);
+        }
+        else
+        {
+            /** Empty parts have no function, so we save the number of keys before each part. */
+            for (size_t p=0; p<parts.size(); p++)
+            {
+                u_int64_t nb = parts[p].nbKeys();
+                os.write (reinterpret_cast<char const*>(&nb), sizeof(nb));
+                if (nb > 0)  {  parts[p].save (os);  }
+            }
+            group.addProperty (getNbPartsName(), misc::impl::Stringify().format("%ld",parts.size()));
+        }
+
         /** We set the number of keys as an attribute of the group. */
-        group.addProperty ("nb_keys", misc::impl::Stringify().format("%d",nbKeys)); // FIXME: maybe overflow here
+        group.addProperty ("nb_keys", misc::impl::Stringify().format("%d",size())); // FIXME: maybe overflow here
         return os.tellp();
     }
 
@@ -334,6 +520,22 @@ private:
     boophf_t  bphf;
     bool      isBuilt;
     size_t    nbKeys;
+    double    gamma;
+
+    /** Partitioned function: one boophf per part, and the number of keys before each part. */
+    std::vector<boophf_t>  parts;
+    std::vector<u_int64_t> offsets;
+    size_t                 nbRounds;
+    hasher_t               hasher;
+
+    static const char* getNbPartsName()  { return "mphf_nb_parts"; }
+
+    void computeOffsets ()
+    {
+        offsets.resize (parts.size());
+        nbKeys = 0;
+        for (size_t p=0; p<parts.size(); p++)  {  offsets[p] = nbKeys;  nbKeys += parts[p].nbKeys();  }
+    }
 
 private:
 
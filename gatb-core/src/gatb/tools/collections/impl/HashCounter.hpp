@@ -0,0 +1,246 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  INRIA
+ *   Authors: R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+/** \file HashCounter.hpp
+ *  \brief Open addressing hash table for counting kmers
+ */
+
+#ifndef _GATB_CORE_TOOLS_COLLECTIONS_IMPL_HASH_COUNTER_HPP_
+#define _GATB_CORE_TOOLS_COLLECTIONS_IMPL_HASH_COUNTER_HPP_
+
+/********************************************************************************/
+
+#include <gatb/system/impl/System.hpp>
+#include <gatb/tools/misc/impl/RadixSort.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/********************************************************************************/
+namespace gatb          {
+namespace core          {
+namespace tools         {
+namespace collections   {
+namespace impl          {
+/********************************************************************************/
+
+/** \brief Open addressing hash table counting the occurrences of keys, with a bounded memory.
+ *
+ * The slots are grouped by buckets of 16. Each slot has a one byte tag (0 for an empty slot,
+ * otherwise 7 bits of the hash with the high bit set), the 16 tags of a bucket being contiguous.
+ * A lookup compares the 16 tags of a bucket at once (with SSE2 when available) and only reads
+ * the keys whose tag matches; if the bucket is full without match, the next bucket is probed.
+ *
+ * Contrary to Hash16, there is no allocation per key: the memory is allocated once in the
+ * constructor, and the table is said to be full when its load factor reaches 7/8. It is up to
+ * the caller to check 'isFull' and to empty the table (for instance by dumping its sorted
+ * content to disk) before inserting new keys.
+ *
+ * The 'sort' method compacts the items at the beginning of the arrays and sorts them in place
+ * with a radix sort, so the sorted items can be read by index without any extra memory.
+ *
+ * Sample of use:
+ * \code
+ *   HashCounter<Type> hash (100*MBYTE);
+ *   for (...)  {  if (hash.isFull())  { dump...; hash.clear(); }   hash.insert (kmer);  }
+ *   u_int64_t nb = hash.sort ();
+ *   for (u_int64_t i=0; i<nb; i++)  {  cout << hash.getKey(i) << " " << hash.getValue(i) << endl;  }
+ * \endcode
+ */
+template <typename Item, typename value_type=u_int32_t> class HashCounter
+{
+public:
+
+    /** Number of slots in a bucket. */
+    static const size_t BUCKET_SIZE = 16;
+
+    /** Constructor.
+     * \param[in] maxMemory : max memory (in bytes) to be used by the hash table
+     */
+    HashCounter (u_int64_t maxMemory) : _tags(0), _keys(0), _values(0), _nbBuckets(1), _mask(0), _nbItems(0), _maxNbItems(0)
+    {
+        u_int64_t bucketBytes = BUCKET_SIZE * (1 + sizeof(Item) + sizeof(value_type));
+
+        /** The number of buckets is the greatest power of two fitting into the memory. */
+        while (2 * _nbBuckets * bucketBytes <= maxMemory)  { _nbBuckets *= 2; }
+
+        _mask       = _nbBuckets - 1;
+        _maxNbItems = (_nbBuckets * BUCKET_SIZE / 8) * 7;
+
+        _tags   = (u_int8_t*)   CALLOC (_nbBuckets * BUCKET_SIZE, sizeof(u_int8_t));
+        _keys   = (Item*)       MALLOC (_nbBuckets * BUCKET_SIZE * sizeof(Item));
+        _values = (value_type*) MALLOC (_nbBuckets * BUCKET_SIZE * sizeof(value_type));
+    }
+
+    /** Destructor. */
+    ~HashCounter ()
+    {
+        FREE (_tags);
+        FREE (_keys);
+        FREE (_values);
+    }
+
+    /** Get the number of items in the hash table.
+     * \return the items number. */
+    u_int64_t size () const  { return _nbItems; }
+
+    /** Get the max number of items before the table is full.
+     * \return the max items number. */
+    u_int64_t getMaxNbItems () const  { return _maxNbItems; }
+
+    /** Get the memory used by the table.
+     * \return the size in bytes. */
+    u_int64_t getByteSize () const  { return _nbBuckets * BUCKET_SIZE * (1 + sizeof(Item) + sizeof(value_type)); }
+
+    /** Tells whether the table has reached its max load factor.
+     * \return true if no new key should be inserted. */
+    bool isFull () const  { return _nbItems >= _maxNbItems; }
+
+    /** Clear the content of the hash table. */
+    void clear ()
+    {
+        memset (_tags, 0, _nbBuckets * BUCKET_SIZE);
+        _nbItems = 0;
+    }
+
+    /** Increment the count of the provided key; the key is inserted with a count of 1
+     * if not already present. The table must not be full.
+     * \param[in] key : the key to be inserted. */
+    inline void insert (const Item& key)
+    {
+        u_int64_t h   = hash1 (key, 0);
+        u_int8_t  tag = (u_int8_t) ((h >> 57) | 0x80);
+
+        for (u_int64_t bucket = h & _mask; ; bucket = (bucket+1) & _mask)
+        {
+            u_int8_t* tags = _tags + bucket * BUCKET_SIZE;
+            size_t    base = bucket * BUCKET_SIZE;
+
+            /** We look for the key among the slots having the same tag. */
+            for (u_int32_t match = matchTag (tags, tag); match != 0; match &= match-1)
+            {
+                size_t slot = base + __builtin_ctz (match);
+                if (_keys[slot] == key)  {  _values[slot] ++;  return;  }
+            }
+
+            /** Not found: if the bucket has an empty slot, the key is not in the table. */
+            u_int32_t empty = matchTag (tags, 0);
+            if (empty != 0)
+            {
+                size_t slot = base + __builtin_ctz (empty);
+                tags    [slot-base] = tag;
+                _keys   [slot]      = key;
+                _values [slot]      = 1;
+                _nbItems ++;
+                return;
+            }
+        }
+    }
+
+    /** Get the count of a key.
+     * \param[in] key : the key to be looked for
+     * \return the count of the key, 0 if the key is not in the table. */
+    value_type get (const Item& key) const
+    {
+        u_int64_t h   = hash1 (key, 0);
+        u_int8_t  tag = (u_int8_t) ((h >> 57) | 0x80);
+
+        for (u_int64_t bucket = h & _mask; ; bucket = (bucket+1) & _mask)
+        {
+            const u_int8_t* tags = _tags + bucket * BUCKET_SIZE;
+            size_t          base = bucket * BUCKET_SIZE;
+
+            for (u_int32_t match = matchTag (tags, tag); match != 0; match &= match-1)
+            {
+                size_t slot = base + __builtin_ctz (match);
+                if (_keys[slot] == key)  {  return _values[slot];  }
+            }
+
+            if (matchTag (tags, 0) != 0)  { return 0; }
+        }
+    }
+
+    /** Compact and sort the items by increasing keys. After this call, the items can be read
+     * with getKey and getValue, and the table must be cleared before new insertions.
+     * \param[in] nbBytes : number of significant bytes of the keys
+     * \return the number of items. */
+    u_int64_t sort (size_t nbBytes=sizeof(Item))
+    {
+        u_int64_t nb = 0;
+
+        for (u_int64_t slot=0; slot < _nbBuckets*BUCKET_SIZE; slot++)
+        {
+            if (_tags[slot] != 0)
+            {
+                _keys  [nb] = _keys  [slot];
+                _values[nb] = _values[slot];
+                nb++;
+            }
+        }
+
+        /** The tags are no more consistent with the keys. */
+        memset (_tags, 0xFF, _nbBuckets * BUCKET_SIZE);
+
+        misc::impl::RadixSort<Item,value_type>::sort (_keys, _values, nb, nbBytes);
+
+        return nb;
+    }
+
+    /** Get the key of a sorted item.
+     * \param[in] idx : index of the item (less than the value returned by 'sort')
+     * \return the key */
+    const Item& getKey (u_int64_t idx) const  { return _keys[idx]; }
+
+    /** Get the count of a sorted item.
+     * \param[in] idx : index of the item (less than the value returned by 'sort')
+     * \return the count */
+    value_type getValue (u_int64_t idx) const  { return _values[idx]; }
+
+private:
+
+    /** Get the slots of a bucket having a given tag.
+     * \return a bit mask of the matching slots. */
+    static inline u_int32_t matchTag (const u_int8_t* tags, u_int8_t tag)
+    {
+#ifdef __SSE2__
+        __m128i v = _mm_loadu_si128 ((const __m128i*) tags);
+        return (u_int32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, _mm_set1_epi8 ((char)tag)));
+#else
+        u_int32_t result = 0;
+        for (size_t i=0; i<BUCKET_SIZE; i++)  {  if (tags[i] == tag)  { result |= (1 << i); }  }
+        return result;
+#endif
+    }
+
+    u_int8_t*   _tags;
+    Item*       _keys;
+    value_type* _values;
+
+    u_int64_t   _nbBuckets;
+    u_int64_t   _mask;
+    u_int64_t   _nbItems;
+    u_int64_t   _maxNbItems;
+};
+
+/********************************************************************************/
+} } } } } /* end of namespaces. */
+/********************************************************************************/
+
+#endif /* _GATB_CORE_TOOLS_COLLECTIONS_IMPL_HASH_COUNTER_HPP_ */
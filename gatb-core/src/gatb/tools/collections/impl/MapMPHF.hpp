@@ -66,24 +66,48 @@ public:
 
     /** Build the hash function from a set of items.
      * \param[in] keys : iterable over the keys of the hash table
+     * \param[in] nbThreads : number of threads
      * \param[in] progress : listener called during the building of the MPHF
+     * \param[in] gamma : gamma of the MPHF
      */
-    void build (tools::collections::Iterable<Key>& keys, int nbThreads = 1, tools::dp::IteratorListener* progress=0)
+    void build (tools::collections::Iterable<Key>& keys, int nbThreads = 1, tools::dp::IteratorListener* progress=0, double gamma=3.0)
     {
         /** We build the hash function. */
-        hash.build (&keys, nbThreads, progress);
+        hash.build (&keys, nbThreads, progress, gamma);
 
         /** We resize the vector of Value objects. */
         data.resize (keys.getNbItems());
         clearData();
     }
 
-    /* use the hash from another MapMPHF class. hmm is this smartpointer legit?
+    /** Build a partitioned hash function from several sets of items (see BooPHF::buildPartitioned).
+     * \param[in] sources : iterables over the keys of the hash table
+     * \param[in] nbParts : number of parts of the MPHF
+     * \param[in] nbThreads : number of threads
+     * \param[in] gamma : gamma of each part of the MPHF
+     * \param[in] maxMemory : memory (in MBytes) allowed for the keys held during the building
+     * \param[in] progress : listener called during the building of the MPHF
+     */
+    void buildPartitioned (
+        const std::vector<tools::collections::Iterable<Key>*>& sources,
+        size_t nbParts, int nbThreads = 1, double gamma = 3.0, u_int64_t maxMemory = 0, tools::dp::IteratorListener* progress=0
+    )
+    {
+        /** We build the hash function. */
+        hash.buildPartitioned (sources, nbParts, nbThreads, gamma, maxMemory, progress);
+
+        /** We resize the vector of Value objects. */
+        data.resize (hash.size());
+        clearData();
+    }
+
+    /* use the hash from another MapMPHF class (possibly with another value type). hmm is this smartpointer legit?
      * also allocate n/x data elements
      */
-    void useHashFrom (MapMPHF *other, int x = 1)
+    template <class OtherValue>
+    void useHashFrom (MapMPHF<Key,OtherValue,Adaptator> *other, int x = 1)
     {
-        hash = other->hash;
+        hash = other->getHash();
         
         /** We resize the vector of Value objects. */
         data.resize ((unsigned long)((hash.size()) / (unsigned long)x) + 1LL); // that +1 and not (hash.size+x-1) / x
@@ -125,15 +149,32 @@ public:
     /** Get the hash code of the given key. */
     typename Hash::Code getCode (const Key& key) { return hash(key); }
 
+    /** Get the hash codes of several keys at once (see BooPHF::lookup).
+     * \param[in] keys : the keys
+     * \param[in] n : number of keys
+     * \param[out] codes : the hash code of each key (n values) */
+    void lookup (const Key* keys, size_t n, typename Hash::Code* codes)  { hash.lookup (keys, n, codes); }
+
+    /** Set the memory layout of the hash function (see BooPHF::setInterleaved).
+     * \param[in] interleaved : true for the interleaved bits and ranks layout */
+    void setInterleaved (bool interleaved)  { hash.setInterleaved (interleaved); }
+
     /** Get the number of keys.
      * \return keys number. */
     size_t size() const { return hash.size(); }
 
+    /** Get the hash function.
+     * \return the hash function. */
+    const Hash& getHash() const { return hash; }
+
     void clearData() { 
         for (unsigned long i = 0; i < data.size(); i ++)
-            data[i] = 0;
+            data[i] = Value();
      }
 
+    /** Release the memory of the values, only the hash function is kept. */
+    void freeData() { std::vector<Value>().swap (data); }
+
 private:
 
     Hash               hash;
@@ -309,14 +309,9 @@ protected:
             /** We begin the iteration. */
             for (bool isRunning=true;  isRunning ; )
             {
-                /** We lock the shared synchronizer before accessing the iterator. */
-                 _synchro.lock ();
-
-                 /** We retrieve some items from the iterator. */
-                 isRunning = _it->get (items);
-
-                 /** We unlock the shared synchronizer after accessing the iterator. */
-                 _synchro.unlock ();
+                 /** We retrieve some items from the iterator. By default, the shared synchronizer is locked
+                  * during the access to the iterator, but some iterators need it only for a part of the work. */
+                 isRunning = _it->getConcurrent (items, _synchro);
 
                  /** We have retrieved some items from the iterator.
                   * Now, we don't need any more to be synchronized, so we can call the current functor
@@ -32,6 +32,7 @@
 
 #include <gatb/system/api/types.hpp>
 #include <gatb/system/api/ISmartPointer.hpp>
+#include <gatb/system/api/IThread.hpp>
 
 #include <vector>
 #include <iostream>
@@ -183,6 +184,21 @@ public:
         return true;
     }
 
+    /** Retrieve some iterated items in a vector, the iterator being shared by several threads.
+     * By default, 'get' is called under the shared synchronizer, so the iteration itself is serialized.
+     * Implementations able to provide items to several threads at the same time (see BankFasta) may
+     * override this method and use the synchronizer only when needed.
+     * \param[in] current : vector to be filled with iterated items. May be resized.
+     * \param[in] synchro : synchronizer shared by the threads using this iterator (IteratorCommand::execute)
+     * \return true if the iteration is not finished, false otherwise. */
+    virtual bool getConcurrent (std::vector<Item>& current, system::ISynchronizer& synchro)
+    {
+        synchro.lock ();
+        bool isRunning = get (current);
+        synchro.unlock ();
+        return isRunning;
+    }
+
     /** Reset the iterator. */
     virtual void reset ()
     {
@@ -77,6 +77,8 @@ enum BloomKind
     BLOOM_CACHE,
     /** Implementation of Bloom filters improving CPU cache management. */
     BLOOM_NEIGHBOR,
+    /** Implementation of Bloom filters testing an item in a single cache line with SIMD instructions. */
+    BLOOM_BLOCKED,
     BLOOM_DEFAULT
 };
 
@@ -89,6 +91,7 @@ static void parse (const std::string& s, BloomKind& kind)
     else if (s == "basic")       { kind = BLOOM_BASIC;  }
     else if (s == "cache")       { kind = BLOOM_CACHE; }
 	else if (s == "neighbor")    { kind = BLOOM_NEIGHBOR; }
+    else if (s == "blocked")     { kind = BLOOM_BLOCKED; }
     else if (s == "default")     { kind = BLOOM_CACHE; }
     else   { throw system::Exception ("bad Bloom kind '%s'", s.c_str()); }
 }
@@ -104,6 +107,7 @@ static const char* toString (BloomKind kind)
         case BLOOM_BASIC:     return "basic";
         case BLOOM_CACHE:     return "cache";
 		case BLOOM_NEIGHBOR:  return "neighbor";
+        case BLOOM_BLOCKED:   return "blocked";
         case BLOOM_DEFAULT:   return "cache";
         default:        throw system::Exception ("bad Bloom kind %d", kind);
     }
@@ -189,6 +193,43 @@ static std::string toString (DebloomImpl kind)
 
 /********************************************************************************/
 
+/** Enumeration for the different kinds of MPHF construction supported in GATB. */
+enum MPHFKind
+{
+    /** One hash function built over all the keys. */
+    MPHF_BASIC,
+    /** One hash function per part of the keys, built in parallel. */
+    MPHF_PARTITIONED,
+    MPHF_DEFAULT
+};
+
+/** Get the enum from a string.
+ * \param[in] s : string to be parsed
+ * \param[out] kind : enum to be set from the string parsing. */
+static void parse (const std::string& s, MPHFKind& kind)
+{
+         if (s == "basic")        { kind = MPHF_BASIC;        }
+    else if (s == "partitioned")  { kind = MPHF_PARTITIONED;  }
+    else if (s == "default")      { kind = MPHF_BASIC;        }
+    else   { throw system::Exception ("bad MPHF kind '%s'", s.c_str()); }
+}
+
+/** Get the string associated to an enum
+ * \param[in] kind : the enum value
+ * \return the associated string */
+static std::string toString (MPHFKind kind)
+{
+    switch (kind)
+    {
+        case MPHF_BASIC:        return "basic";
+        case MPHF_PARTITIONED:  return "partitioned";
+        case MPHF_DEFAULT:      return "basic";
+        default:        throw system::Exception ("bad MPHF kind %d", kind);
+    }
+}
+
+/********************************************************************************/
+
 /** Enumeration for the different kinds of branching storages supported in GATB. */
 enum BranchingKind
 {
@@ -275,6 +316,43 @@ static std::string toString (KmerSolidityKind kind)
 
 /********************************************************************************/
 
+/** Enumeration for the different kinds of sort used when counting kmers by sorted vectors. */
+enum KmerSortKind
+{
+    /** std::sort on each radix bucket */
+    KMER_SORT_STD,
+    /** in-place MSD radix sort on each radix bucket */
+    KMER_SORT_RADIX,
+    KMER_SORT_DEFAULT
+};
+
+/** Get the enum from a string.
+ * \param[in] s : string to be parsed
+ * \param[out] kind : enum to be set from the string parsing. */
+static void parse (const std::string& s, KmerSortKind& kind)
+{
+         if (s == "std")      { kind = KMER_SORT_STD;    }
+    else if (s == "radix")    { kind = KMER_SORT_RADIX;  }
+    else if (s == "default")  { kind = KMER_SORT_RADIX;  }
+    else   { throw system::Exception ("bad kmer sort kind '%s'", s.c_str()); }
+}
+
+/** Get the string associated to an enum
+ * \param[in] kind : the enum value
+ * \return the associated string */
+static std::string toString (KmerSortKind kind)
+{
+    switch (kind)
+    {
+        case KMER_SORT_STD:     return "std";
+        case KMER_SORT_RADIX:   return "radix";
+        case KMER_SORT_DEFAULT: return "radix";
+        default:    throw system::Exception ("bad kmer sort kind %d", kind);
+    }
+}
+
+/********************************************************************************/
+
 /** Enumeration of different kinds of graph traversal. */
 enum TraversalKind
 {
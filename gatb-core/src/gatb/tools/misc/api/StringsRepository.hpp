@@ -107,6 +107,13 @@ public:
     const char* bloom_type     ()  { return "-bloom";          }
     const char* debloom_type   ()  { return "-debloom";        }
     const char* debloom_impl   ()  { return "-debloom-impl";   }
+    const char* bloom_count    ()  { return "-bloom-count";    }
+    const char* bloom_count_bits() { return "-bloom-count-bits"; }
+    const char* mphf_type      ()  { return "-mphf";           }
+    const char* mphf_gamma     ()  { return "-mphf-gamma";     }
+    const char* mphf_parts     ()  { return "-mphf-parts";     }
+    const char* mphf_fused     ()  { return "-mphf-fused";     }
+    const char* mphf_interleaved ()  { return "-mphf-interleaved"; }
     const char* branching_type ()  { return "-branching-nodes";}
     const char* topology_stats ()  { return "-topology-stats";}
     const char* uri_solid_kmers()  { return "-solid-kmers-out";    }
@@ -119,6 +126,12 @@ public:
     const char* compress_level()   { return "-out-compress"; }
     const char* config_only()      { return "-config-only"; }
     const char* storage_type()     { return "-storage-type"; }
+    const char* sort_kind()        { return "-sort-kind"; }
+    const char* dump_split()       { return "-dump-split"; }
+    const char* superk_mmap()      { return "-superk-mmap"; }
+    const char* superk_readahead() { return "-superk-readahead"; }
+    const char* superk_compress()  { return "-superk-compress"; }
+    const char* superk_memory()    { return "-superk-memory"; }
 
     const char* attr_uri_input      ()  { return "input";           }
     const char* attr_kmer_size      ()  { return "kmer_size";       }
@@ -160,6 +173,13 @@ public:
 #define STR_BLOOM_TYPE          gatb::core::tools::misc::StringRepository::singleton().bloom_type()
 #define STR_DEBLOOM_TYPE        gatb::core::tools::misc::StringRepository::singleton().debloom_type()
 #define STR_DEBLOOM_IMPL        gatb::core::tools::misc::StringRepository::singleton().debloom_impl()
+#define STR_BLOOM_COUNT         gatb::core::tools::misc::StringRepository::singleton().bloom_count()
+#define STR_BLOOM_COUNT_BITS    gatb::core::tools::misc::StringRepository::singleton().bloom_count_bits()
+#define STR_MPHF_TYPE           gatb::core::tools::misc::StringRepository::singleton().mphf_type()
+#define STR_MPHF_GAMMA          gatb::core::tools::misc::StringRepository::singleton().mphf_gamma()
+#define STR_MPHF_PARTS          gatb::core::tools::misc::StringRepository::singleton().mphf_parts()
+#define STR_MPHF_FUSED          gatb::core::tools::misc::StringRepository::singleton().mphf_fused()
+#define STR_MPHF_INTERLEAVED    gatb::core::tools::misc::StringRepository::singleton().mphf_interleaved()
 #define STR_BRANCHING_TYPE      gatb::core::tools::misc::StringRepository::singleton().branching_type()
 #define STR_TOPOLOGY_STATS      gatb::core::tools::misc::StringRepository::singleton().topology_stats()
 #define STR_URI_SOLID_KMERS     gatb::core::tools::misc::StringRepository::singleton().uri_solid_kmers()
@@ -171,6 +191,12 @@ public:
 #define STR_COMPRESS_LEVEL      gatb::core::tools::misc::StringRepository::singleton().compress_level()
 #define STR_CONFIG_ONLY         gatb::core::tools::misc::StringRepository::singleton().config_only()
 #define STR_STORAGE_TYPE        gatb::core::tools::misc::StringRepository::singleton().storage_type ()
+#define STR_SORT_KIND           gatb::core::tools::misc::StringRepository::singleton().sort_kind ()
+#define STR_DUMP_SPLIT          gatb::core::tools::misc::StringRepository::singleton().dump_split ()
+#define STR_SUPERK_MMAP         gatb::core::tools::misc::StringRepository::singleton().superk_mmap ()
+#define STR_SUPERK_READAHEAD    gatb::core::tools::misc::StringRepository::singleton().superk_readahead ()
+#define STR_SUPERK_COMPRESS     gatb::core::tools::misc::StringRepository::singleton().superk_compress ()
+#define STR_SUPERK_MEMORY       gatb::core::tools::misc::StringRepository::singleton().superk_memory ()
 
 /********************************************************************************/
 
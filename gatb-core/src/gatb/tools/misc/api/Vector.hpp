@@ -104,6 +104,8 @@ public:
      * \param[in] length : size of the data */
     void setRef (Vector* ref, size_t offset, size_t length)
     {
+        if (_isAllocated && _buffer) {  FREE (_buffer); }
+
         setRef (ref);
         _buffer      = _ref->_buffer + offset;
         _size        = length;
@@ -115,6 +117,8 @@ public:
      * \param[in] length : size of the data */
     void setRef (T* buffer, size_t length)
     {
+        if (_isAllocated && _buffer) {  FREE (_buffer); }
+
         _buffer      = buffer;
         _size        = length;
         _isAllocated = false;
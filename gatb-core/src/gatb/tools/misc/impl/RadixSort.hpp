@@ -0,0 +1,191 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  INRIA
+ *   Authors: R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+/** \file RadixSort.hpp
+ *  \brief In-place MSD radix sort for kmer integer types
+ */
+
+#ifndef _GATB_CORE_TOOLS_MISC_IMPL_RADIX_SORT_HPP_
+#define _GATB_CORE_TOOLS_MISC_IMPL_RADIX_SORT_HPP_
+
+/********************************************************************************/
+
+#include <gatb/system/api/types.hpp>
+#include <algorithm>
+
+/********************************************************************************/
+namespace gatb      {
+namespace core      {
+namespace tools     {
+namespace misc      {
+namespace impl      {
+/********************************************************************************/
+
+/** \brief In-place MSD radix sort (american flag sort) on the bytes of an integer type.
+ *
+ * The keys are read byte per byte through their memory representation; this works for
+ * NativeInt64, NativeInt128 and LargeInt<N> since all of them store their words in little
+ * endian order (value[0] holds the less significant bits).
+ *
+ * An optional satellite array (for instance the bank ids of the kmers) is permuted in the
+ * same pass than the keys, so there is no need to sort indexes and then to reorder both
+ * arrays through a temporary copy.
+ *
+ * Small buckets are finished with an insertion sort relying on the key operator<.
+ *
+ * Sample of use:
+ * \code
+ *   Type* kmers = ...;
+ *   RadixSort<Type>::sort (kmers, nbKmers, sizeof(Type));
+ * \endcode
+ */
+template <typename Key, typename Satellite=u_int8_t>
+class RadixSort
+{
+public:
+
+    /** Sort the provided keys.
+     * \param[in] keys : array to be sorted
+     * \param[in] nb : number of items in the array
+     * \param[in] nbBytes : number of significant bytes of the keys (starting from the less significant one) */
+    static void sort (Key* keys, size_t nb, size_t nbBytes=sizeof(Key))
+    {
+        sort (keys, (Satellite*)0, nb, nbBytes);
+    }
+
+    /** Sort the provided keys and permute the satellite array accordingly.
+     * \param[in] keys : array to be sorted
+     * \param[in] sat : satellite array (may be null)
+     * \param[in] nb : number of items in the arrays
+     * \param[in] nbBytes : number of significant bytes of the keys (starting from the less significant one) */
+    static void sort (Key* keys, Satellite* sat, size_t nb, size_t nbBytes=sizeof(Key))
+    {
+        if (nb < 2 || nbBytes == 0)  { return; }
+
+        if (nbBytes > sizeof(Key))  { nbBytes = sizeof(Key); }
+
+        sort_aux (keys, sat, nb, nbBytes-1);
+    }
+
+private:
+
+    /** Below this bucket size, we use insertion sort. */
+    static const size_t INSERTION_THRESHOLD = 32;
+
+    /** */
+    static inline u_int8_t digit (const Key& key, size_t byte)
+    {
+        return ((const u_int8_t*) &key) [byte];
+    }
+
+    /** */
+    static void insertion_sort (Key* keys, Satellite* sat, size_t nb)
+    {
+        for (size_t i=1; i<nb; i++)
+        {
+            Key k = keys[i];
+
+            if (sat)
+            {
+                Satellite s = sat[i];
+                size_t j = i;
+                for ( ; j>0 && k < keys[j-1]; j--)  { keys[j] = keys[j-1];  sat[j] = sat[j-1]; }
+                keys[j] = k;  sat[j] = s;
+            }
+            else
+            {
+                size_t j = i;
+                for ( ; j>0 && k < keys[j-1]; j--)  { keys[j] = keys[j-1]; }
+                keys[j] = k;
+            }
+        }
+    }
+
+    /** */
+    static void sort_aux (Key* keys, Satellite* sat, size_t nb, size_t byte)
+    {
+        size_t count[256];
+        size_t head [256];
+        size_t tail [256];
+
+        while (true)
+        {
+            if (nb <= INSERTION_THRESHOLD)  {  insertion_sort (keys, sat, nb);  return;  }
+
+            /** We compute the histogram of the current digit. */
+            for (size_t i=0; i<256; i++)  { count[i] = 0; }
+            for (size_t i=0; i<nb;  i++)  { count[digit(keys[i],byte)] ++; }
+
+            /** All the keys share the same digit: we go directly to the next one, nothing to move. */
+            if (count[digit(keys[0],byte)] == nb)
+            {
+                if (byte == 0)  { return; }
+                byte--;
+                continue;
+            }
+
+            /** We compute the buckets boundaries. */
+            size_t offset = 0;
+            for (size_t i=0; i<256; i++)  {  head[i] = offset;  offset += count[i];  tail[i] = offset;  }
+
+            /** We permute the items in place, following the cycles. */
+            for (size_t b=0; b<256; b++)
+            {
+                while (head[b] < tail[b])
+                {
+                    Key       k = keys[head[b]];
+                    Satellite s = sat ? sat[head[b]] : Satellite();
+
+                    u_int8_t d = digit (k, byte);
+
+                    while (d != b)
+                    {
+                        size_t dest = head[d]++;
+
+                        std::swap (k, keys[dest]);
+                        if (sat)  { std::swap (s, sat[dest]); }
+
+                        d = digit (k, byte);
+                    }
+
+                    keys[head[b]] = k;
+                    if (sat)  { sat[head[b]] = s; }
+                    head[b]++;
+                }
+            }
+
+            if (byte == 0)  { return; }
+
+            /** We recurse on each bucket of the current digit. */
+            offset = 0;
+            for (size_t i=0; i<256; i++)
+            {
+                if (count[i] > 1)  {  sort_aux (keys+offset, sat ? sat+offset : 0, count[i], byte-1);  }
+                offset += count[i];
+            }
+            return;
+        }
+    }
+};
+
+/********************************************************************************/
+} } } } } /* end of namespaces. */
+/********************************************************************************/
+
+#endif /* _GATB_CORE_TOOLS_MISC_IMPL_RADIX_SORT_HPP_ */
@@ -81,6 +81,19 @@ void TimeInfo::stop (const char* name)
     _entries [name] += _time.getTimeStamp() - _entriesT0 [name];
 }
 
+/*********************************************************************
+** METHOD  :
+** PURPOSE :
+** INPUT   :
+** OUTPUT  :
+** RETURN  :
+** REMARKS :
+*********************************************************************/
+void TimeInfo::add (const char* name, u_int32_t duration)
+{
+    _entries [name] += duration;
+}
+
 /*********************************************************************
 ** METHOD  :
 ** PURPOSE :
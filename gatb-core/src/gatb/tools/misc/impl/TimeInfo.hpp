@@ -90,6 +90,11 @@ public:
      */
     virtual void stop (const char* name);
 
+    /** Add a duration to a given label.
+     * \param[in] name : the label
+     * \param[in] duration : the duration to be added (same unit than the time factory) */
+    virtual void add (const char* name, u_int32_t duration);
+
     /** Merge the content of the current time info with the provided one.
      * \param[in] ti : info to merged. */
     TimeInfo& operator+= (TimeInfo& ti);
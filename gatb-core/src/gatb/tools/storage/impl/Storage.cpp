@@ -21,6 +21,13 @@
 
 #include <gatb/tools/storage/impl/Storage.hpp>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <zlib.h>
+
 /********************************************************************************/
 namespace gatb { namespace core {  namespace tools {  namespace storage {  namespace impl {
 /********************************************************************************/
@@ -307,10 +314,17 @@ Storage::istream::~istream ()
 ////////// SuperKmerBinFiles //////////
 ///////////////////////////////////////
 	
-SuperKmerBinFiles::SuperKmerBinFiles(const std::string& path,const std::string& name, size_t nb_files) : _basefilename(name), _path(path),_nb_files(nb_files)
+SuperKmerBinFiles::SuperKmerBinFiles(const std::string& path,const std::string& name, size_t nb_files, bool inMemory) : _basefilename(name), _path(path),_nb_files(nb_files), _mappedRead(false), _inMemory(inMemory), _compressionLevel(0)
 {
 	_nbKmerperFile.resize(_nb_files,0);
 	_FileSize.resize(_nb_files,0);
+	_RawFileSize.resize(_nb_files,0);
+	_compressionSkip.resize(_nb_files,0);
+	_mappings.resize(_nb_files,0);
+	_mappingSize.resize(_nb_files,0);
+	_mappingPos.resize(_nb_files,0);
+	_arenaCapacity.resize(_nb_files,0);
+	_arenaRead.resize(_nb_files,0);
 	
 	openFiles("wb"); //at construction will open file for writing
 	// then use close() and openFiles() to open for reading
@@ -322,27 +336,110 @@ void SuperKmerBinFiles::openFile( const char* mode, int fileId)
 	std::stringstream ss;
 	ss << _basefilename << "." << fileId;
 		
-	_files[fileId] = system::impl::System::file().newFile (_path, ss.str(), mode);
+	if(_inMemory)
+	{
+		//the arena is read from its beginning, the next writes (if any) go on after its end
+		_arenaRead[fileId] = mode[0]=='r';
+		_mappingSize[fileId] = _FileSize[fileId];
+		_mappingPos[fileId] = 0;
+	}
+	else if(mode[0]!='r')
+	{
+		//writing : raw descriptor, the file size is the offset of the next reserved block
+		int flags = O_WRONLY | O_CREAT | (mode[0]=='w' ? O_TRUNC : 0);
+		_fds[fileId] = open(getFileName(fileId).c_str(), flags, 0644);
+		if(_fds[fileId] < 0)
+			throw system::Exception ("unable to open superkmer file %s", getFileName(fileId).c_str());
+
+		if(mode[0]=='w')
+		{
+			_FileSize[fileId] = 0;
+			_RawFileSize[fileId] = 0;
+			_nbKmerperFile[fileId] = 0;
+		}
+		else
+		{
+			struct stat st;
+			_FileSize[fileId] = fstat(_fds[fileId], &st) == 0 ? st.st_size : 0;
+		}
+	}
+	else if(_mappedRead)
+		mapFile(fileId);
+	else
+		_files[fileId] = system::impl::System::file().newFile (_path, ss.str(), mode);
 	_synchros[fileId] = system::impl::System::thread().newSynchronizer();
 	_synchros[fileId]->use();
 }
+
+void SuperKmerBinFiles::mapFile(int fileId)
+{
+	_mappings[fileId] = 0;
+	_mappingSize[fileId] = 0;
+	_mappingPos[fileId] = 0;
+
+	int fd = open(getFileName(fileId).c_str(), O_RDONLY);
+	if(fd < 0)
+		throw system::Exception ("unable to open superkmer file %s", getFileName(fileId).c_str());
+
+	struct stat st;
+	if(fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(ptr == MAP_FAILED)
+		{
+			close(fd);
+			throw system::Exception ("unable to map superkmer file %s", getFileName(fileId).c_str());
+		}
+
+		//blocks are consumed in file order
+		madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+
+		_mappings[fileId] = (unsigned char*) ptr;
+		_mappingSize[fileId] = st.st_size;
+	}
+
+	//the mapping remains valid after the file descriptor is closed
+	close(fd);
+}
+
+void SuperKmerBinFiles::unmapFile(int fileId)
+{
+	if(_mappings[fileId]!=0)
+	{
+		munmap(_mappings[fileId], _mappingSize[fileId]);
+		_mappings[fileId] = 0;
+		_mappingSize[fileId] = 0;
+		_mappingPos[fileId] = 0;
+	}
+}
+
+void SuperKmerBinFiles::prefetchFile(int fileId)
+{
+	if(_inMemory)
+		return;
+
+#ifdef POSIX_FADV_WILLNEED
+	int fd = open(getFileName(fileId).c_str(), O_RDONLY);
+	if(fd < 0)
+		return;
+
+	//readahead is asynchronous, closing the descriptor does not cancel it
+	posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	close(fd);
+#endif
+}
 	
 void SuperKmerBinFiles::openFiles( const char* mode)
 {
 	_files.resize(_nb_files,0);
 	_synchros.resize(_nb_files,0);
+	_fds.resize(_nb_files,-1);
 	
 	system::impl::System::file().mkdir(_path, 0755);
 
 	for(int ii=0;ii<_files.size();ii++)
 	{
-		std::stringstream ss;
-		ss << _basefilename << "." << ii;
-		
-		_files[ii] = system::impl::System::file().newFile (_path, ss.str(), mode);
-		_synchros[ii] = system::impl::System::thread().newSynchronizer();
-		_synchros[ii]->use();
-
+		openFile(mode, ii);
 	}
 }
 
@@ -370,6 +467,25 @@ int SuperKmerBinFiles::readBlock(unsigned char ** block, unsigned int* max_block
 		_synchros[file_id]->unlock();
 		return 0;
 	}
+
+	if(*nb_bytes_read & COMPRESSED_BLOCK)
+	{
+		//only the read is serialized, decompression is done by the calling thread
+		unsigned int compressed_size = *nb_bytes_read & ~COMPRESSED_BLOCK;
+		unsigned int raw_size = 0;
+		_files[file_id]->fread(&raw_size, sizeof(raw_size),1);
+
+		unsigned char* zblock = (unsigned char*) malloc(compressed_size);
+		_files[file_id]->fread(zblock, sizeof(unsigned char),compressed_size);
+
+		_synchros[file_id]->unlock();
+
+		uncompressBlock(zblock, compressed_size, block, max_block_size, raw_size, file_id);
+		free(zblock);
+
+		*nb_bytes_read = raw_size;
+		return *nb_bytes_read;
+	}
 	
 	if(*nb_bytes_read > *max_block_size)
 	{
@@ -385,6 +501,72 @@ int SuperKmerBinFiles::readBlock(unsigned char ** block, unsigned int* max_block
 	return *nb_bytes_read;
 }
 
+int SuperKmerBinFiles::nextBlock(unsigned char ** data, unsigned char ** buffer, unsigned int* max_block_size, unsigned int* nb_bytes_read, int file_id)
+{
+	if(_files[file_id]!=0 || !(_mappedRead || _inMemory))
+	{
+		int nbr = readBlock(buffer, max_block_size, nb_bytes_read, file_id);
+		*data = *buffer;
+		return nbr;
+	}
+
+	_synchros[file_id]->lock();
+
+	u_int64_t pos = _mappingPos[file_id];
+
+	if(pos + sizeof(*nb_bytes_read) > _mappingSize[file_id])
+	{
+		_synchros[file_id]->unlock();
+		return 0;
+	}
+
+	//block header, may be unaligned
+	memcpy(nb_bytes_read, _mappings[file_id] + pos, sizeof(*nb_bytes_read));
+
+	if(*nb_bytes_read & COMPRESSED_BLOCK)
+	{
+		unsigned int compressed_size = *nb_bytes_read & ~COMPRESSED_BLOCK;
+		unsigned int raw_size = 0;
+		memcpy(&raw_size, _mappings[file_id] + pos + sizeof(*nb_bytes_read), sizeof(raw_size));
+
+		unsigned char* zblock = _mappings[file_id] + pos + sizeof(*nb_bytes_read) + sizeof(raw_size);
+		_mappingPos[file_id] = pos + sizeof(*nb_bytes_read) + sizeof(raw_size) + compressed_size;
+
+		_synchros[file_id]->unlock();
+
+		//the block cannot be used in place : it is decompressed into the buffer
+		uncompressBlock(zblock, compressed_size, buffer, max_block_size, raw_size, file_id);
+		releaseBlock(zblock, compressed_size, file_id);
+
+		*data = *buffer;
+		*nb_bytes_read = raw_size;
+		return *nb_bytes_read;
+	}
+
+	*data = _mappings[file_id] + pos + sizeof(*nb_bytes_read);
+	_mappingPos[file_id] = pos + sizeof(*nb_bytes_read) + *nb_bytes_read;
+
+	_synchros[file_id]->unlock();
+
+	return *nb_bytes_read;
+}
+
+void SuperKmerBinFiles::releaseBlock(unsigned char * data, unsigned int nb_bytes, int file_id)
+{
+	//an arena is freed as a whole when the partition is closed
+	if(_inMemory || _mappings[file_id]==0 || data < _mappings[file_id] || data >= _mappings[file_id] + _mappingSize[file_id])
+		return;
+
+	//only the pages entirely inside the block can be dropped, the others are shared with the neighbour blocks
+	static const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+	uintptr_t begin = ((uintptr_t)data + pageSize - 1) & ~(pageSize - 1);
+	uintptr_t end   = ((uintptr_t)data + nb_bytes) & ~(pageSize - 1);
+
+	if(begin < end)
+		madvise((void*)begin, end - begin, MADV_DONTNEED);
+}
+
 int SuperKmerBinFiles::getNbItems(int fileId)
 {
 	return _nbKmerperFile[fileId];
@@ -397,6 +579,12 @@ u_int64_t SuperKmerBinFiles::getFileSize(int fileId)
 	return _FileSize[fileId];
 }
 
+u_int64_t SuperKmerBinFiles::getRawFileSize(int fileId)
+{
+
+	return _RawFileSize[fileId];
+}
+
 void SuperKmerBinFiles::getFilesStats(u_int64_t & total, u_int64_t & biggest, u_int64_t & smallest, float & mean)
 {
 	total =0;
@@ -417,37 +605,160 @@ void SuperKmerBinFiles::getFilesStats(u_int64_t & total, u_int64_t & biggest, u_
 	
 void SuperKmerBinFiles::writeBlock(unsigned char * block, unsigned int block_size, int file_id, int nbkmers)
 {
+	//compression is done before taking the lock, so that writer threads compress in parallel
+	unsigned int compressed_size = 0;
+	unsigned char* zblock = 0;
+	if(_compressionLevel > 0)
+		zblock = compressBlock(block, block_size, file_id, compressed_size);
 
-	_synchros[file_id]->lock();
-	
-	_nbKmerperFile[file_id]+=nbkmers;
-	_FileSize[file_id] += block_size+sizeof(block_size);
-	//block header
-	_files[file_id]->fwrite(&block_size, sizeof(block_size),1);
+	//block header (followed by the raw size if compressed), then block
+	unsigned int header[2];
+	struct iovec iov[2];
 
-	//block
-	_files[file_id]->fwrite(block, sizeof(unsigned char),block_size);
-	
-	_synchros[file_id]->unlock();
+	if(zblock!=0)
+	{
+		header[0] = compressed_size | COMPRESSED_BLOCK;
+		header[1] = block_size;
+		iov[0].iov_len  = 2*sizeof(block_size);
+		iov[1].iov_base = zblock;
+		iov[1].iov_len  = compressed_size;
+	}
+	else
+	{
+		header[0] = block_size;
+		iov[0].iov_len  = sizeof(block_size);
+		iov[1].iov_base = block;
+		iov[1].iov_len  = block_size;
+	}
+	iov[0].iov_base = header;
+
+	//reserve the room of the block in the file, the write itself needs no lock
+	u_int64_t offset = __sync_fetch_and_add(&_FileSize[file_id], iov[0].iov_len + iov[1].iov_len);
+	__sync_fetch_and_add(&_RawFileSize[file_id], block_size+sizeof(block_size));
+	__sync_fetch_and_add(&_nbKmerperFile[file_id], nbkmers);
+
+	if(_inMemory)
+		writeArena(file_id, iov, 2, offset);
+	else
+		writeAt(file_id, iov, 2, offset);
 
+	free(zblock);
 }
-	
-void SuperKmerBinFiles::flushFiles()
+
+void SuperKmerBinFiles::writeAt(int fileId, struct iovec* iov, int iovcnt, u_int64_t offset)
 {
-	for(int ii=0;ii<_files.size();ii++)
+	while(iovcnt > 0)
 	{
-		_synchros[ii]->lock();
+#ifdef __APPLE__
+		//pwritev is missing from older macos versions : one positional write per buffer
+		ssize_t nb = pwrite(_fds[fileId], iov->iov_base, iov->iov_len, offset);
+#else
+		ssize_t nb = pwritev(_fds[fileId], iov, iovcnt, offset);
+#endif
+		if(nb < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			throw system::Exception ("unable to write superkmer file %s", getFileName(fileId).c_str());
+		}
 
-		if(_files[ii]!=0)
+		//short write : skip what has been written and go on with the rest
+		offset += nb;
+		while(iovcnt > 0 && (size_t)nb >= iov->iov_len)
 		{
-			_files[ii]->flush();
+			nb -= iov->iov_len;
+			iov++;
+			iovcnt--;
 		}
-		
-		_synchros[ii]->unlock();
+		if(iovcnt > 0)
+		{
+			iov->iov_base = (char*)iov->iov_base + nb;
+			iov->iov_len -= nb;
+		}
+	}
+}
+
+void SuperKmerBinFiles::writeArena(int fileId, struct iovec* iov, int iovcnt, u_int64_t offset)
+{
+	u_int64_t size = 0;
+	for(int ii=0;ii<iovcnt;ii++)
+		size += iov[ii].iov_len;
+
+	//the arena may be moved when it grows, so the copy is done under the lock
+	_synchros[fileId]->lock();
+
+	if(offset + size > _arenaCapacity[fileId])
+	{
+		u_int64_t capacity = std::max (std::max (offset + size, 2*_arenaCapacity[fileId]), (u_int64_t)(1<<16));
+		unsigned char* arena = (unsigned char*) realloc(_mappings[fileId], capacity);
+		if(arena==0)
+		{
+			_synchros[fileId]->unlock();
+			throw system::Exception ("unable to allocate %lld bytes for superkmer partition %d", capacity, fileId);
+		}
+		_mappings[fileId] = arena;
+		_arenaCapacity[fileId] = capacity;
+	}
 
+	for(int ii=0;ii<iovcnt;ii++)
+	{
+		memcpy(_mappings[fileId] + offset, iov[ii].iov_base, iov[ii].iov_len);
+		offset += iov[ii].iov_len;
 	}
+
+	_synchros[fileId]->unlock();
+}
+
+void SuperKmerBinFiles::freeArena(int fileId)
+{
+	free(_mappings[fileId]);
+	_mappings[fileId] = 0;
+	_mappingSize[fileId] = 0;
+	_mappingPos[fileId] = 0;
+	_arenaCapacity[fileId] = 0;
+	_arenaRead[fileId] = 0;
 }
 
+unsigned char* SuperKmerBinFiles::compressBlock(unsigned char * block, unsigned int block_size, int file_id, unsigned int& compressed_size)
+{
+	//the last block of this file did not compress, the next few ones are written raw without trying
+	static const int nbSkippedBlocks = 16;
+
+	int skip = __sync_fetch_and_sub(&_compressionSkip[file_id], 1);
+	if(skip > 0)
+		return 0;
+
+	//nothing to skip: undo our decrement so that the counter stays bounded
+	__sync_fetch_and_add(&_compressionSkip[file_id], 1);
+
+	uLongf zsize = compressBound(block_size);
+	unsigned char* zblock = (unsigned char*) malloc(zsize);
+
+	//a compressed block must save at least 1/8 of its size to be worth the decompression
+	if(compress2(zblock, &zsize, block, block_size, _compressionLevel) != Z_OK || zsize + sizeof(block_size) > block_size - block_size/8)
+	{
+		free(zblock);
+		__sync_lock_test_and_set(&_compressionSkip[file_id], nbSkippedBlocks);
+		return 0;
+	}
+
+	compressed_size = zsize;
+	return zblock;
+}
+
+void SuperKmerBinFiles::uncompressBlock(const unsigned char * data, unsigned int compressed_size, unsigned char ** block, unsigned int* max_block_size, unsigned int raw_size, int file_id)
+{
+	if(raw_size > *max_block_size)
+	{
+		*block = (unsigned char *) realloc(*block, raw_size);
+		*max_block_size = raw_size;
+	}
+
+	uLongf size = raw_size;
+	if(uncompress(*block, &size, data, compressed_size) != Z_OK || size != raw_size)
+		throw system::Exception ("corrupted compressed block in superkmer file %s", getFileName(file_id).c_str());
+}
+	
 void SuperKmerBinFiles::eraseFiles()
 {
 	for(int ii=0;ii<_files.size();ii++)
@@ -466,7 +777,20 @@ void SuperKmerBinFiles::closeFile(  int fileId)
 	{
 		delete _files[fileId];
 		_files[fileId] = 0;
+	}
+	if(_fds[fileId]>=0)
+	{
+		close(_fds[fileId]);
+		_fds[fileId] = -1;
+	}
+	if(!_inMemory)
+		unmapFile(fileId);
+	else if(_arenaRead[fileId])
+		freeArena(fileId);
+	if(_synchros[fileId]!=0)
+	{
 		_synchros[fileId]->forget();
+		_synchros[fileId] = 0;
 	}
 }
 
@@ -475,18 +799,18 @@ void SuperKmerBinFiles::closeFiles()
 {
 	for(int ii=0;ii<_files.size();ii++)
 	{
-		if(_files[ii]!=0)
-		{
-			delete _files[ii];
-			_files[ii] = 0;
-			_synchros[ii]->forget();
-		}
+		closeFile(ii);
 	}
 }
 	
 SuperKmerBinFiles::~SuperKmerBinFiles()
 {
 	this->closeFiles();
+	if(_inMemory)
+	{
+		for(int ii=0;ii<_nb_files;ii++)
+			freeArena(ii);
+	}
 	this->eraseFiles();
 }
 	
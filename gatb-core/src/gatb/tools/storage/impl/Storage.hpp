@@ -52,6 +52,7 @@
 #include <vector>
 #include <map>
 #include <cstring>
+#include <sys/uio.h>
 
 /********************************************************************************/
 namespace gatb      {
@@ -243,6 +244,16 @@ protected:
 //the  block structure makes it easier for buffered read,
 //otherwise we would not know how to read a big chunk without stopping in the middle of superkmer
 
+//compressed block : header = 4B = compressed size | COMPRESSED_BLOCK , then 4B = raw block size, then the zlib stream
+//compression is chosen per block, a block is stored raw when it does not compress well enough
+
+//writes are lock-free : a writer reserves the room of its block at the end of the file (atomic add on the file size)
+//then writes header and block with a single pwritev at the reserved offset, concurrently with the other writers.
+//blocks of different threads are thus interleaved in the file, which is fine since they are independent
+
+//in memory mode, no file is written : each partition is a growing memory arena with the same layout as the file,
+//which is read in place by nextBlock as if the file was mapped, and freed when the partition has been read
+
 class SuperKmerBinFiles
 {
 	
@@ -250,12 +261,12 @@ public:
 	
 	//construtor will open the files for writing
 	//use closeFiles to close them all then openFiles to open in different mode
-	SuperKmerBinFiles(const std::string& path,const std::string& name, size_t nb_files);
+	//inMemory : keep the partitions in memory arenas instead of files
+	SuperKmerBinFiles(const std::string& path,const std::string& name, size_t nb_files, bool inMemory = false);
 	
 	~SuperKmerBinFiles();
 
 	void closeFiles();
-	void flushFiles();
 	void eraseFiles();
 	void openFiles(const char* mode);
 	void openFile( const char* mode, int fileId);
@@ -263,17 +274,47 @@ public:
 
 	//read/write block of superkmers to filefile_id
 	//readBlock will re-allocate the block buffer if needed (current size passed by max_block_size)
+	//writeBlock can be called concurrently by several threads on the same file, without locking
 	int readBlock(unsigned char ** block, unsigned int* max_block_size, unsigned int* nb_bytes_read, int file_id);
 	void writeBlock(unsigned char * block, unsigned int block_size, int file_id, int nbkmers);
 
+	//zero-copy read : when set, files opened for reading are mapped in memory (mmap)
+	//and nextBlock gives a pointer to the block inside the mapping instead of copying it
+	void setMappedRead(bool mapped) { _mappedRead = mapped; }
+	bool isMappedRead() { return _mappedRead; }
+
+	bool isInMemory() { return _inMemory; }
+
+	//same as readBlock, except that *data points to the block : inside the file mapping
+	//if the file is mapped (buffer is then untouched), in the (re-allocated) buffer otherwise
+	int nextBlock(unsigned char ** data, unsigned char ** buffer, unsigned int* max_block_size, unsigned int* nb_bytes_read, int file_id);
+
+	//tells that a block given by nextBlock has been consumed,
+	//so that its pages can be dropped from memory (no-op if the file is not mapped)
+	void releaseBlock(unsigned char * data, unsigned int nb_bytes, int file_id);
+
+	//asks the system to read ahead a whole file, so that it is in the page cache when it is opened
+	void prefetchFile(int fileId);
+
+	//block compression for the following writes : 0 for none, otherwise the zlib level (1 = fastest)
+	//blocks are compressed by the writer threads and decompressed by the reader threads
+	void setCompression(int level) { _compressionLevel = level; }
+	int getCompression() { return _compressionLevel; }
+
 	int nbFiles();
 	int getNbItems(int fileId);
 	
 	void getFilesStats(u_int64_t & total, u_int64_t & biggest, u_int64_t & smallest, float & mean);
 	u_int64_t getFileSize(int fileId);
 
+	//size the file would have without compression (equals getFileSize if compression is off)
+	u_int64_t getRawFileSize(int fileId);
+
 	
 	std::string getFileName(int fileId);
+
+	static const unsigned int COMPRESSED_BLOCK = 0x80000000;
+
 private:
 
 	std::string _basefilename;
@@ -281,10 +322,38 @@ private:
 	
 	std::vector<int> _nbKmerperFile;
 	std::vector<u_int64_t> _FileSize;
+	std::vector<u_int64_t> _RawFileSize;
 
 	std::vector<system::IFile* > _files;
 	std::vector <system::ISynchronizer*> _synchros;
+
+	//descriptors of the files opened for writing (-1 otherwise), written with pwritev
+	std::vector<int> _fds;
+	void writeAt(int fileId, struct iovec* iov, int iovcnt, u_int64_t offset);
 	int _nb_files;
+
+	bool _mappedRead;
+	//in memory mode, _mappings holds the arenas of the partitions
+	std::vector<unsigned char*> _mappings;
+	std::vector<u_int64_t> _mappingSize;
+	std::vector<u_int64_t> _mappingPos;
+
+	void mapFile(int fileId);
+	void unmapFile(int fileId);
+
+	bool _inMemory;
+	std::vector<u_int64_t> _arenaCapacity;
+	//one byte per file (not a packed vector<bool>) since the partitions are opened and closed concurrently
+	std::vector<u_int8_t> _arenaRead;
+	void writeArena(int fileId, struct iovec* iov, int iovcnt, u_int64_t offset);
+	void freeArena(int fileId);
+
+	int _compressionLevel;
+	//number of blocks still to be written raw before trying compression again (per file)
+	std::vector<int> _compressionSkip;
+
+	unsigned char* compressBlock(unsigned char * block, unsigned int block_size, int file_id, unsigned int& compressed_size);
+	void uncompressBlock(const unsigned char * data, unsigned int compressed_size, unsigned char ** block, unsigned int* max_block_size, unsigned int raw_size, int file_id);
 };
 
 
@@ -76,6 +76,8 @@ using namespace gatb::core::tools::collections::impl;
 
 using namespace gatb::core::tools::math;
 
+typedef Kmer<>::Type kmer_type;
+
 #define MAX_RANDOM 2147483648
 #define srandomdev() srand((unsigned) time(NULL))
 
@@ -126,7 +128,7 @@ int main (int argc, char* argv[])
      srandomdev(); 
     
 
-    kmer_type start = random();
+    kmer_type start;  start.setVal (random());
     kmer_type kmer_random, kmer_current;
     kmer_current = start;
     // We define a try/catch block in case some method fails (bad filename for instance)
@@ -140,6 +142,7 @@ int main (int argc, char* argv[])
       //  Bloom<kmer_type>* bloom =  new Bloom<kmer_type> (bloomsize,nhash);
         BloomCacheCoherent<kmer_type>* bloomcc =  new BloomCacheCoherent<kmer_type> (bloomsize,nhash,12);
         Bloom<kmer_type>*    bloom_std =  new Bloom<kmer_type> (bloomsize,nhash);
+        BloomBlocked<kmer_type>* bloomblk =  new BloomBlocked<kmer_type> (bloomsize,31,nhash);
 
         //testing bloom cache coherent
         _timeInfo.start ("Inserting N elements cache_coherent");
@@ -192,11 +195,33 @@ int main (int argc, char* argv[])
         }
         _timeInfo.stop ("Query N elements std");
         
+
+        //testing bloom blocked
+        _timeInfo.start ("Inserting N elements blocked");
+        kmer_current = start;
+        for(int ii =0; ii<nelems; ii++)
+        {
+            bloomblk->insert(kmer_current);
+            kmer_current = kmer_current +1;
+        }
+        _timeInfo.stop ("Inserting N elements blocked");
+
+        //we query the elements just inserted, ie only positive elements
+        _timeInfo.start ("Query N elements blocked");
+        kmer_current = start;
+        for(int ii =0; ii<nelems; ii++)
+        {
+            resu+=bloomblk->contains(kmer_current);
+            kmer_current = kmer_current +1;
+        }
+        _timeInfo.stop ("Query N elements blocked");
+        
         
         
         
         uint64_t ntrue = 0;
         uint64_t ntruecc = 0;
+        uint64_t ntrueblk = 0;
         uint64_t ntested = 10000000;
 
         //////////////////////// testing fp rate with random elements
@@ -207,31 +232,55 @@ int main (int argc, char* argv[])
         delete bloomcc;
         bloomcc =  new BloomCacheCoherent<kmer_type> (bloomsize,nhash,12);
 
+        delete bloomblk;
+        bloomblk =  new BloomBlocked<kmer_type> (bloomsize,31,nhash);
+
         //insert n randoms
         for(int ii = 0; ii<nelems; ii++)
         {
-            kmer_random = random64();
+            kmer_random.setVal (random64());
             bloom_std->insert(kmer_random);
             bloomcc->insert(kmer_random);
+            bloomblk->insert(kmer_random);
         }
         
 
+        //random queries (mostly negative), same sequence of elements for each kind
+        vector<kmer_type> queries (ntested);
+        for(int ii = 0; ii<ntested; ii++)
+        {
+            queries[ii].setVal (random64()); // we expect it not be in the bloom
+        }
 
-
+        _timeInfo.start ("Query random elements std");
         for(int ii = 0; ii<ntested; ii++)
         {
-            kmer_random = random64(); // we expect it not be in the bloom
-            
-            if (bloom_std->contains(kmer_random)) // FP
+            if (bloom_std->contains(queries[ii])) // FP
             {
                 ntrue++;
             }
-            
-            if (bloomcc->contains(kmer_random)) 
+        }
+        _timeInfo.stop ("Query random elements std");
+
+        _timeInfo.start ("Query random elements cache_coherent");
+        for(int ii = 0; ii<ntested; ii++)
+        {
+            if (bloomcc->contains(queries[ii])) 
             {
                 ntruecc++;
             }
         }
+        _timeInfo.stop ("Query random elements cache_coherent");
+
+        _timeInfo.start ("Query random elements blocked");
+        for(int ii = 0; ii<ntested; ii++)
+        {
+            if (bloomblk->contains(queries[ii]))
+            {
+                ntrueblk++;
+            }
+        }
+        _timeInfo.stop ("Query random elements blocked");
         
         measured_FP =  ntrue / (double) ntested ;
         
@@ -263,6 +312,7 @@ int main (int argc, char* argv[])
 
         res.add (1, "measured FP, standard bloom", "%g", measured_FP);
         res.add (1, "measured FP, bloomCacheCoherent", "%g",  ntruecc / (double) ntested);
+        res.add (1, "measured FP, bloomBlocked", "%g",  ntrueblk / (double) ntested);
 
         
         RawDumpPropertiesVisitor visit;
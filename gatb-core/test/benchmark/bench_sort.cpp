@@ -0,0 +1,159 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+/* compares std::sort and the in-place radix sort used by PartitionsByVectorCommand
+ * on buckets of kxmers, with and without bank ids. */
+
+#include <chrono>
+#define diff_wtime(x,y) chrono::duration_cast<chrono::nanoseconds>(y - x).count()
+
+#include <gatb/system/impl/System.hpp>
+#include <gatb/bank/api/IBank.hpp>
+#include <gatb/kmer/impl/Model.hpp>
+#include <gatb/tools/misc/impl/RadixSort.hpp>
+#include <gatb/tools/math/Integer.hpp>
+#include <gatb/tools/misc/api/Macros.hpp>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace std;
+using namespace gatb::core::system;
+using namespace gatb::core::system::impl;
+using namespace gatb::core::kmer;
+using namespace gatb::core::kmer::impl;
+using namespace gatb::core::tools::misc::impl;
+using namespace gatb::core::tools::math;
+
+/********************************************************************************/
+
+struct Parameter
+{
+    Parameter (size_t k, size_t nbItems, size_t nbDistinct) : k(k), nbItems(nbItems), nbDistinct(nbDistinct) {}
+    size_t k;
+    size_t nbItems;
+    size_t nbDistinct;
+};
+
+template<size_t span> struct bench_sort {  void operator ()  (Parameter params)
+{
+    typedef typename Kmer<span>::Type  Type;
+    typedef gatb::core::bank::BankIdType BankId;
+
+    double unit = 1000000000;
+    cout.setf(ios_base::fixed);
+    cout.precision(3);
+
+    /** We build random kxmers (shifted like in SuperKReader), drawn from a pool of distinct values
+     * so that there are duplicates, as in real partitions. */
+    Type un;  un.setVal(1);
+    Type mask = (un << (2*params.k)) - un;
+
+    vector<Type> pool (params.nbDistinct);
+    for (size_t i=0; i<pool.size(); i++)
+    {
+        Type v;  v.setVal(0);
+        for (size_t j=0; j<(2*params.k+31)/32; j++)  {  Type r;  r.setVal(random());  v = (v << 32) | r;  }
+        pool[i] = (v & mask) << 8;
+    }
+
+    vector<Type>   ref (params.nbItems);
+    vector<BankId> refIds (params.nbItems);
+    for (size_t i=0; i<ref.size(); i++)  {  ref[i] = pool[random() % pool.size()];  refIds[i] = random() % 4;  }
+
+    size_t nbBytes = std::min (sizeof(Type), (2*params.k + 8 + 7) / 8);
+
+    /** std::sort on kmers only. */
+    vector<Type> v1 (ref);
+    auto start_t=chrono::system_clock::now();
+    std::sort (v1.begin(), v1.end());
+    auto end_t=chrono::system_clock::now();
+    double t_std = diff_wtime(start_t, end_t) / unit;
+
+    /** radix sort on kmers only. */
+    vector<Type> v2 (ref);
+    start_t=chrono::system_clock::now();
+    RadixSort<Type>::sort (v2.data(), v2.size(), nbBytes);
+    end_t=chrono::system_clock::now();
+    double t_radix = diff_wtime(start_t, end_t) / unit;
+
+    /** std::sort on indexes then reorder through a temporary vector (old multi-bank path). */
+    vector<Type>   v3 (ref);
+    vector<BankId> ids3 (refIds);
+    start_t=chrono::system_clock::now();
+    {
+        struct Tmp { Type kmer;  BankId id; };
+        vector<size_t> idx (v3.size());
+        for (size_t i=0; i<idx.size(); i++)  { idx[i]=i; }
+        std::sort (idx.begin(), idx.end(), [&v3] (size_t a, size_t b) { return v3[a] < v3[b]; });
+        vector<Tmp> tmp (idx.size());
+        for (size_t i=0; i<idx.size(); i++)  {  tmp[i].kmer = v3[idx[i]];  tmp[i].id = ids3[idx[i]];  }
+        for (size_t i=0; i<idx.size(); i++)  {  v3[i] = tmp[i].kmer;  ids3[i] = tmp[i].id;  }
+    }
+    end_t=chrono::system_clock::now();
+    double t_std_ids = diff_wtime(start_t, end_t) / unit;
+
+    /** radix sort moving kmers and bank ids together. */
+    vector<Type>   v4 (ref);
+    vector<BankId> ids4 (refIds);
+    start_t=chrono::system_clock::now();
+    RadixSort<Type,BankId>::sort (v4.data(), ids4.data(), v4.size(), nbBytes);
+    end_t=chrono::system_clock::now();
+    double t_radix_ids = diff_wtime(start_t, end_t) / unit;
+
+    /** We check the results. */
+    bool ok = v1 == v2 && v1 == v3 && v1 == v4;
+
+    cout << "k=" << params.k << " (" << Type::getName() << ")  " << params.nbItems << " items" << endl;
+    cout << "   std::sort                 : " << t_std       << " s" << endl;
+    cout << "   radix sort                : " << t_radix     << " s  (x" << t_std/t_radix << ")" << endl;
+    cout << "   std::sort + bank ids      : " << t_std_ids   << " s" << endl;
+    cout << "   radix sort + bank ids     : " << t_radix_ids << " s  (x" << t_std_ids/t_radix_ids << ")" << endl;
+    cout << "   agreement                 : " << (ok ? "ok" : "FAIL") << endl;
+
+    if (!ok)  { exit (EXIT_FAILURE); }
+}};
+
+/********************************************************************************/
+
+int main (int argc, char* argv[])
+{
+    size_t nbItems    = argc > 1 ? atoll (argv[1]) : 10*1000*1000;
+    size_t nbDistinct = argc > 2 ? atoll (argv[2]) : nbItems / 4;
+
+    if (nbDistinct == 0)  { nbDistinct = 1; }
+
+    size_t kmerSizes[] = { 31, 63, 127 };
+
+    try
+    {
+        for (size_t i=0; i<ARRAY_SIZE(kmerSizes); i++)
+        {
+            Integer::apply<bench_sort,Parameter> (kmerSizes[i], Parameter (kmerSizes[i], nbItems, nbDistinct));
+        }
+    }
+    catch (Exception& e)
+    {
+        cerr << "EXCEPTION: " << e.getMessage() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+/*****************************************************************************
+ *   GATB : Genome Assembly Tool Box
+ *   Copyright (C) 2014  R.Chikhi, G.Rizk, E.Drezen
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+/* compares the superkmer decoding loop formerly used by the counting commands (one LargeInt
+ * shift per nucleotide) and the SuperKmerDecoder kernel, on a block of random superkmers. */
+
+#include <chrono>
+#define diff_wtime(x,y) chrono::duration_cast<chrono::nanoseconds>(y - x).count()
+
+#include <gatb/system/impl/System.hpp>
+#include <gatb/kmer/impl/Model.hpp>
+#include <gatb/kmer/impl/SuperKmerDecoder.hpp>
+#include <gatb/tools/math/Integer.hpp>
+#include <gatb/tools/misc/api/Macros.hpp>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+
+using namespace std;
+using namespace gatb::core::system;
+using namespace gatb::core::system::impl;
+using namespace gatb::core::kmer;
+using namespace gatb::core::kmer::impl;
+using namespace gatb::core::tools::math;
+
+/********************************************************************************/
+
+struct Parameter
+{
+    Parameter (size_t k, size_t nbSuperKmers, size_t meanLength) : k(k), nbSuperKmers(nbSuperKmers), meanLength(meanLength) {}
+    size_t k;
+    size_t nbSuperKmers;
+    size_t meanLength;
+};
+
+/** The former decoding loop of PartitionsByHashCommand: returns the sum of the canonical kmers. */
+template<typename Type> Type referenceDecode (const vector<u_int8_t>& block, size_t kmerSize, u_int64_t& nbKmers)
+{
+    Type un; un.setVal(1);
+    Type kmerMask = (un << (kmerSize*2)) - un;
+    size_t shift = 2*(kmerSize-1);
+
+    Type sum;  sum.setVal(0);
+    nbKmers = 0;
+
+    const u_int8_t* ptr = block.data();
+    while (ptr < block.data() + block.size())
+    {
+        u_int8_t nbK = *ptr; ptr++;
+        int rem_size = kmerSize;
+
+        Type Tnewbyte, seedk;
+        u_int8_t newbyte = 0;
+        int nbr=0;
+        seedk.setVal(0);
+        while(rem_size>=4)
+        {
+            newbyte = *ptr ; ptr++;
+            Tnewbyte.setVal(newbyte);
+            seedk =  seedk  |  (Tnewbyte  << (8*nbr)) ;
+            rem_size -= 4; nbr++;
+        }
+
+        int uid = 4;
+        if(rem_size>0)
+        {
+            newbyte = *ptr ; ptr++;
+            Tnewbyte.setVal(newbyte);
+            seedk = ( seedk  |  (Tnewbyte  << (8*nbr)) ) ;
+            uid = rem_size;
+        }
+        seedk = seedk & kmerMask;
+
+        u_int8_t rem = nbK;
+        Type temp = seedk;
+        Type rev_temp = revcomp(temp,kmerSize);
+        Type newnt;
+
+        for (int ii=0; ii< nbK; ii++,rem--)
+        {
+            sum = sum + std::min (rev_temp, temp);
+            nbKmers++;
+
+            if(rem < 2) break;
+
+            if(uid>=4)
+            {
+                newbyte = *ptr ; ptr++;
+                Tnewbyte.setVal(newbyte);
+                uid =0;
+            }
+
+            newnt = (Tnewbyte >> (2*uid))& 3; uid++;
+            temp = ((temp << 2 ) |  newnt   ) & kmerMask;
+
+            newnt.setVal(comp_NT[newnt.getVal()]) ;
+            rev_temp = ((rev_temp >> 2 ) |  (newnt << shift) ) & kmerMask;
+        }
+    }
+    return sum;
+}
+
+template<size_t span> struct bench_superk {  void operator ()  (Parameter params)
+{
+    typedef typename Kmer<span>::Type  Type;
+
+    double unit = 1000000000;
+    cout.setf(ios_base::fixed);
+    cout.precision(3);
+
+    /** We build a block of random superkmers: one byte for the kmers number, then the packed nucleotides. */
+    vector<u_int8_t> block;
+    for (size_t i=0; i<params.nbSuperKmers; i++)
+    {
+        size_t nbK     = 1 + random() % std::min ((size_t)255, 2*params.meanLength);
+        size_t nbBytes = (params.k + nbK - 1 + 3) / 4;
+        block.push_back (nbK);
+        for (size_t j=0; j<nbBytes; j++)  {  block.push_back (random() & 0xFF);  }
+    }
+
+    size_t nbRepetitions = 5;
+
+    /** Former decoding loop. */
+    u_int64_t nbRef = 0;
+    Type sumRef;  sumRef.setVal(0);
+    auto start_t=chrono::system_clock::now();
+    for (size_t r=0; r<nbRepetitions; r++)  {  sumRef = referenceDecode<Type> (block, params.k, nbRef);  }
+    auto end_t=chrono::system_clock::now();
+    double t_ref = diff_wtime(start_t, end_t) / unit;
+
+    /** Decoding kernel. */
+    u_int64_t nbKernel = 0;
+    Type sumKernel;  sumKernel.setVal(0);
+    SuperKmerDecoder<span> decoder (params.k);
+    start_t=chrono::system_clock::now();
+    for (size_t r=0; r<nbRepetitions; r++)
+    {
+        sumKernel.setVal(0);  nbKernel = 0;
+        for (const u_int8_t* ptr=block.data(); ptr<block.data()+block.size(); )
+        {
+            size_t nbK;
+            const Type* kmers = decoder.decodeCanonical (ptr, block.data()+block.size(), nbK);
+            for (size_t i=0; i<nbK; i++)  {  sumKernel = sumKernel + kmers[i];  }
+            nbKernel += nbK;
+        }
+    }
+    end_t=chrono::system_clock::now();
+    double t_kernel = diff_wtime(start_t, end_t) / unit;
+
+    bool ok = nbRef == nbKernel && sumRef == sumKernel;
+
+    cout << "k=" << params.k << " (" << Type::getName() << ")  " << nbRef << " kmers" << endl;
+    cout << "   former loop        : " << t_ref    << " s  (" << t_ref*unit/(nbRef*nbRepetitions)       << " ns/kmer)" << endl;
+    cout << "   decoding kernel    : " << t_kernel << " s  (" << t_kernel*unit/(nbRef*nbRepetitions)    << " ns/kmer, x" << t_ref/t_kernel << ")" << endl;
+    cout << "   agreement          : " << (ok ? "ok" : "FAIL") << endl;
+
+    if (!ok)  { exit (EXIT_FAILURE); }
+}};
+
+/********************************************************************************/
+
+int main (int argc, char* argv[])
+{
+    size_t nbSuperKmers = argc > 1 ? atoll (argv[1]) : 1000*1000;
+    size_t meanLength   = argc > 2 ? atoll (argv[2]) : 20;
+
+    if (meanLength == 0)  { meanLength = 1; }
+
+    size_t kmerSizes[] = { 21, 31, 63, 127 };
+
+    try
+    {
+        for (size_t i=0; i<ARRAY_SIZE(kmerSizes); i++)
+        {
+            Integer::apply<bench_superk,Parameter> (kmerSizes[i], Parameter (kmerSizes[i], nbSuperKmers, meanLength));
+        }
+    }
+    catch (Exception& e)
+    {
+        cerr << "EXCEPTION: " << e.getMessage() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -26,11 +26,13 @@
 #include <gatb/bank/impl/BankHelpers.hpp>
 
 #include <gatb/tools/designpattern/impl/IteratorHelpers.hpp>
+#include <gatb/tools/designpattern/impl/Command.hpp>
 
 #include <gatb/tools/misc/api/Macros.hpp>
 
 #include <list>
 #include <stdlib.h>     /* srand, rand */
+#include <math.h>       /* fabs */
 #include <time.h>       /* time */
 
 using namespace std;
@@ -85,6 +87,11 @@ class TestBank : public Test
         //        CPPUNIT_TEST_GATB (bank_datalinesize); // disabled since we're printing fasta in one line now (see "#if 1" in BankFasta)
         CPPUNIT_TEST_GATB (bank_registery_types);
         CPPUNIT_TEST_GATB (bank_checkPower2);
+        CPPUNIT_TEST_GATB (bank_checkConcurrent);
+        CPPUNIT_TEST_GATB (bank_checkBgzf);
+        CPPUNIT_TEST_GATB (bank_checkZeroCopy);
+        CPPUNIT_TEST_GATB (bank_checkBinaryIndex);
+        CPPUNIT_TEST_GATB (bank_checkEstimateSampling);
 
     CPPUNIT_TEST_SUITE_GATB_END();
 
@@ -1092,6 +1099,396 @@ public:
         System::file().remove(filename);
         CPPUNIT_ASSERT (System::file().doesExist(filename) == false);
     }
+
+    /********************************************************************************/
+    struct ConcurrentFunctor
+    {
+        ISynchronizer*       synchro;
+        vector<string>&      items;
+        ConcurrentFunctor (ISynchronizer* synchro, vector<string>& items) : synchro(synchro), items(items) {}
+
+        void operator() (Sequence& seq)
+        {
+            string item = seq.getComment() + "|" + seq.toString() + "|" + seq.getQuality();
+
+            LocalSynchronizer ls (synchro);
+            if (seq.getIndex() >= items.size())  { items.resize (seq.getIndex() + 1); }
+            CPPUNIT_ASSERT (items[seq.getIndex()].empty());
+            items[seq.getIndex()] = item;
+        }
+    };
+
+    void bank_checkConcurrent_aux (const string& filename, BankFasta::Iterator::CommentMode_e mode)
+    {
+        BankFasta b (filename);
+
+        /** We iterate the bank in a serial way. */
+        vector<string> expected;
+        BankFasta::Iterator itSerial (b, mode);
+        for (itSerial.first(); !itSerial.isDone(); itSerial.next())
+        {
+            expected.push_back (itSerial->getComment() + "|" + itSerial->toString() + "|" + itSerial->getQuality());
+        }
+        CPPUNIT_ASSERT (expected.size() > 0);
+
+        /** We iterate it with several threads, twice (the iterator is reset by the dispatcher). */
+        BankFasta::Iterator* it = new BankFasta::Iterator (b, mode);
+        LOCAL (it);
+        for (size_t nbCores=1; nbCores<=4; nbCores+=3)
+        {
+            ISynchronizer* synchro = System::thread().newSynchronizer();
+            LOCAL (synchro);
+
+            vector<string> items;
+            Dispatcher(nbCores).iterate (it, ConcurrentFunctor (synchro, items));
+
+            /** We must get the same sequences with the same indexes. */
+            CPPUNIT_ASSERT (items.size() == expected.size());
+            for (size_t i=0; i<items.size(); i++)  {  CPPUNIT_ASSERT (items[i] == expected[i]);  }
+        }
+    }
+
+    /** \brief Test the iteration of a bank by several threads at the same time
+     *
+     * The files are split into chunks parsed by different threads (see BankFasta::Iterator::getConcurrent).
+     * We check that we get the same sequences, with the same indexes, as with a serial iteration.
+     */
+    void bank_checkConcurrent ()
+    {
+        string filename = "test_concurrent.fa";
+
+        /** We create a multi-line FASTA file of several chunks, with some empty sequences. */
+        ofstream file (filename.c_str());
+        CPPUNIT_ASSERT (file.is_open());
+        const char* nt = "ACGT";
+        for (size_t i=0; i<20000; i++)
+        {
+            file << ">seq" << i << " len=" << (i*37)%500 << endl;
+            for (size_t j=0; j<(i*37)%500; j++)  {  file << nt[(i+j*j)%4];  if (j%60 == 59) { file << endl; }  }
+            file << endl;
+        }
+        file.close ();
+
+        bank_checkConcurrent_aux (filename, BankFasta::Iterator::FULL);
+        bank_checkConcurrent_aux (filename, BankFasta::Iterator::IDONLY);
+
+        bank_checkConcurrent_aux (DBPATH("reads1.fa"),      BankFasta::Iterator::FULL);
+        bank_checkConcurrent_aux (DBPATH("reads1.fa.gz"),   BankFasta::Iterator::FULL);
+        bank_checkConcurrent_aux (DBPATH("sample.fastq"),   BankFasta::Iterator::FULL);
+        bank_checkConcurrent_aux (DBPATH("sample.fastq.gz"),BankFasta::Iterator::IDONLY);
+        bank_checkConcurrent_aux (DBPATH("NIST7035_TAAGGCGA_L001_R1_001_5OK.fastq.gz"), BankFasta::Iterator::FULL);
+        bank_checkConcurrent_aux (DBPATH("reads2_bgzf.fa.gz"), BankFasta::Iterator::FULL);
+
+        System::file().remove (filename);
+    }
+
+    /** \brief Test a BGZF bank (reads2.fa compressed in small BGZF blocks, with its .gzi index)
+     *
+     * We check that we get the same sequences as from the uncompressed bank, and that the size of the
+     * uncompressed data is known from the index (so the estimation of the number of sequences is exact).
+     */
+    void bank_checkBgzf ()
+    {
+        BankFasta b1 (DBPATH("reads2.fa"));
+        BankFasta b2 (DBPATH("reads2_bgzf.fa.gz"));
+
+        CPPUNIT_ASSERT (b2.getSize() == System::file().getSize (DBPATH("reads2.fa")));
+        CPPUNIT_ASSERT (b2.estimateNbItems() == 1000);
+
+        BankFasta::Iterator it1 (b1);
+        BankFasta::Iterator it2 (b2);
+        size_t nb = 0;
+        for (it1.first(), it2.first(); !it1.isDone(); it1.next(), it2.next(), nb++)
+        {
+            CPPUNIT_ASSERT (!it2.isDone());
+            CPPUNIT_ASSERT (it1->getComment() == it2->getComment());
+            CPPUNIT_ASSERT (it1->toString()   == it2->toString());
+        }
+        CPPUNIT_ASSERT (it2.isDone());
+        CPPUNIT_ASSERT (nb == 1000);
+    }
+
+    /********************************************************************************/
+    void bank_checkZeroCopy_aux (const string& filename, BankFasta::Iterator::CommentMode_e mode)
+    {
+        BankFasta b (filename);
+
+        BankFasta::Iterator it1 (b, mode);
+        BankFasta::Iterator it2 (b, mode, true);
+
+        Sequence  previous;
+        Sequence* copied = 0;
+        string    previousData;
+        size_t nb = 0;
+        for (it1.first(), it2.first(); !it1.isDone(); it1.next(), it2.next(), nb++)
+        {
+            CPPUNIT_ASSERT (!it2.isDone());
+            CPPUNIT_ASSERT (it1->getIndex()   == it2->getIndex());
+            CPPUNIT_ASSERT (it1->toString()   == it2->toString());
+            CPPUNIT_ASSERT (it1->getComment() == it2->getComment());
+            CPPUNIT_ASSERT (it1->getQuality() == it2->getQuality());
+
+            /** A copy of the sequence (affectation or copy constructor) must not depend on the parsing buffers. */
+            if (nb > 0)
+            {
+                CPPUNIT_ASSERT (previous.toString() == previousData);
+                CPPUNIT_ASSERT (copied->toString()  == previousData);
+                delete copied;
+            }
+            previous     = it2.item();
+            copied       = new Sequence (it2.item());
+            previousData = it1->toString();
+            CPPUNIT_ASSERT (previous.getComment() == it1->getComment());
+            CPPUNIT_ASSERT (copied->getComment()  == it1->getComment());
+            CPPUNIT_ASSERT (copied->getQuality()  == it1->getQuality());
+            CPPUNIT_ASSERT (copied->getIndex()    == it1->getIndex());
+        }
+        delete copied;
+        CPPUNIT_ASSERT (it2.isDone());
+        CPPUNIT_ASSERT (nb > 0);
+    }
+
+    /** \brief Test the zero copy iteration of a bank
+     *
+     * The sequences then refer to the parsing buffers of the iterator; we check that we get the same
+     * sequences as with the default iteration.
+     */
+    void bank_checkZeroCopy ()
+    {
+        bank_checkZeroCopy_aux (DBPATH("reads1.fa"),        BankFasta::Iterator::FULL);
+        bank_checkZeroCopy_aux (DBPATH("reads1.fa.gz"),     BankFasta::Iterator::NONE);
+        bank_checkZeroCopy_aux (DBPATH("sample.fastq"),     BankFasta::Iterator::FULL);
+        bank_checkZeroCopy_aux (DBPATH("sample.fastq.gz"),  BankFasta::Iterator::IDONLY);
+        bank_checkZeroCopy_aux (DBPATH("sample1.fa"),       BankFasta::Iterator::FULL);
+
+        /** A comment reference is built only when asked for, and a copy of the sequence owns it. */
+        const char* buffer = "read_1 some comment";
+        Sequence s1;
+        s1.setCommentRef (buffer, 6);
+        Sequence s2 (s1);
+        CPPUNIT_ASSERT (s1.getComment() == "read_1");
+        CPPUNIT_ASSERT (s2.getComment() == "read_1");
+        s1.setComment ("read_2");
+        CPPUNIT_ASSERT (s1.getComment() == "read_2");
+        CPPUNIT_ASSERT (s1.getQuality().empty());
+    }
+
+    /********************************************************************************/
+    struct BinaryFunctor
+    {
+        ISynchronizer*       synchro;
+        vector<string>&      items;
+        BinaryFunctor (ISynchronizer* synchro, vector<string>& items) : synchro(synchro), items(items) {}
+
+        void operator() (Sequence& seq)
+        {
+            CPPUNIT_ASSERT (seq.getDataEncoding() == Data::BINARY);
+            string item (seq.getDataBuffer(), seq.getData().getBufferLength());
+
+            LocalSynchronizer ls (synchro);
+            if (seq.getIndex() >= items.size())  { items.resize (seq.getIndex() + 1); }
+            CPPUNIT_ASSERT (items[seq.getIndex()].empty());
+            items[seq.getIndex()] = item;
+        }
+    };
+
+    void bank_checkBinaryIndex_aux (BankBinary& bank, const vector<string>& expected, u_int64_t totalSize, u_int64_t maxSize)
+    {
+        /** We check the serial iteration. */
+        BankBinary::Iterator itSerial (bank);
+        size_t nb = 0;
+        for (itSerial.first(); !itSerial.isDone(); itSerial.next(), nb++)
+        {
+            CPPUNIT_ASSERT (itSerial->getIndex() == nb);
+            CPPUNIT_ASSERT (string (itSerial->getDataBuffer(), itSerial->getData().getBufferLength()) == expected[nb]);
+        }
+        CPPUNIT_ASSERT (nb == expected.size());
+
+        /** We check the iteration with several threads. */
+        BankBinary::Iterator* it = new BankBinary::Iterator (bank);
+        LOCAL (it);
+        for (size_t nbCores=1; nbCores<=4; nbCores+=3)
+        {
+            ISynchronizer* synchro = System::thread().newSynchronizer();
+            LOCAL (synchro);
+
+            vector<string> items;
+            Dispatcher(nbCores).iterate (it, BinaryFunctor (synchro, items));
+            CPPUNIT_ASSERT (items == expected);
+        }
+
+        /** We check the estimation (exact for an indexed file). */
+        u_int64_t number=0, total=0, max=0;
+        bank.estimate (number, total, max);
+        if (bank.isIndexed())
+        {
+            CPPUNIT_ASSERT (bank.getNbItems() == (int64_t)expected.size());
+            CPPUNIT_ASSERT (number == expected.size());
+            CPPUNIT_ASSERT (total  == totalSize);
+            CPPUNIT_ASSERT (max    == maxSize);
+        }
+        else
+        {
+            CPPUNIT_ASSERT (bank.getNbItems() == -1);
+            CPPUNIT_ASSERT (number > 0);
+        }
+
+        /** We check the random access. */
+        Sequence seq;
+        for (size_t i=0; i<expected.size(); i+=7)
+        {
+            CPPUNIT_ASSERT (bank.getSequence (i, seq) == bank.isIndexed());
+            if (bank.isIndexed())
+            {
+                CPPUNIT_ASSERT (seq.getIndex() == i);
+                CPPUNIT_ASSERT (string (seq.getDataBuffer(), seq.getData().getBufferLength()) == expected[i]);
+            }
+        }
+        CPPUNIT_ASSERT (bank.getSequence (expected.size(), seq) == false);
+    }
+
+    /** \brief Test the index of binary banks
+     *
+     * A binary bank is written with an index of its blocks, which allows to iterate it with several
+     * threads, to get sequences by their index and to know exactly the number of sequences. We check
+     * too that a file written without index (by previous versions) can still be read.
+     */
+    void bank_checkBinaryIndex ()
+    {
+        string filenameBin = "test_index.bin";
+
+        /** We use small blocks in order to get many blocks. */
+        BankBinary::setBufferSize (2000);
+
+        BankFasta  bank1 (DBPATH("reads1.fa"));
+        BankBinary bank2 (filenameBin);
+
+        vector<string> expected;
+        u_int64_t totalSize = 0, maxSize = 0;
+
+        BankFasta::Iterator itSeq1 (bank1);
+        for (itSeq1.first(); !itSeq1.isDone(); itSeq1.next())
+        {
+            bank2.insert (*itSeq1);
+
+            /** We keep the binary data of the sequence. */
+            string binary ((itSeq1->getDataSize()+3)/4, 0);
+            for (size_t i=0; i<itSeq1->getDataSize(); i++)
+            {
+                binary[i/4] |= Data::ConvertASCII::get (itSeq1->getDataBuffer(), i).first << ((3-(i%4))*2);
+            }
+            expected.push_back (binary);
+
+            totalSize += itSeq1->getDataSize();
+            maxSize    = std::max (maxSize, (u_int64_t)itSeq1->getDataSize());
+        }
+
+        /** The index can't be used while the bank is written, but it must be once flushed. */
+        CPPUNIT_ASSERT (bank2.isIndexed() == false);
+        bank2.flush ();
+
+        BankBinary::setBufferSize (100000);
+
+        CPPUNIT_ASSERT (bank2.isIndexed() == true);
+        bank_checkBinaryIndex_aux (bank2, expected, totalSize, maxSize);
+
+        /** We check a bank of version 1 holding the same sequences. */
+        BankBinary bank3 (DBPATH("reads1_v1.bin"));
+        CPPUNIT_ASSERT (BankBinary::check (DBPATH("reads1_v1.bin")) == true);
+        CPPUNIT_ASSERT (bank3.isIndexed() == false);
+        bank_checkBinaryIndex_aux (bank3, expected, totalSize, maxSize);
+
+        bank2.remove ();
+        CPPUNIT_ASSERT (System::file().doesExist (filenameBin) == false);
+    }
+
+    /********************************************************************************/
+    void bank_checkEstimateExact_aux (IBank& bank)
+    {
+        u_int64_t number=0, totalSize=0, maxSize=0;
+
+        Iterator<Sequence>* it = bank.iterator();
+        LOCAL (it);
+        for (it->first(); !it->isDone(); it->next())
+        {
+            number++;
+            totalSize += (*it)->getDataSize();
+            maxSize    = std::max (maxSize, (u_int64_t) (*it)->getDataSize());
+        }
+
+        u_int64_t estNumber=0, estTotalSize=0, estMaxSize=0;
+        bank.estimate (estNumber, estTotalSize, estMaxSize);
+
+        CPPUNIT_ASSERT (bank.getEstimateError() == 0);
+        CPPUNIT_ASSERT (estNumber    == number);
+        CPPUNIT_ASSERT (estTotalSize == totalSize);
+        CPPUNIT_ASSERT (estMaxSize   == maxSize);
+    }
+
+    void bank_checkEstimateSampling_aux (bool fastq)
+    {
+        string filename = fastq ? "estimate.fastq" : "estimate.fa";
+
+        /** We create a file too big for being read entirely by the estimation (see BankFasta::estimate). */
+        FILE* file = fopen (filename.c_str(), "w");
+        CPPUNIT_ASSERT (file != 0);
+
+        const char* nt = "ACGT";
+        u_int64_t number=0, totalSize=0;
+        string data, quality;
+        for (u_int64_t size=0; size < 48*1024*1024; number++)
+        {
+            size_t len = 50 + rand() % 101;
+            data.resize (len);
+            for (size_t i=0; i<len; i++)  { data[i] = nt[rand() % 4]; }
+            quality.assign (len, 'I');
+
+            if (fastq)  {  size += fprintf (file, "@read_%ld\n%s\n+\n%s\n", (long)number, data.c_str(), quality.c_str());  }
+            else        {  size += fprintf (file, ">read_%ld\n%s\n",         (long)number, data.c_str());  }
+            totalSize += len;
+        }
+        fclose (file);
+
+        BankFasta bank (filename);
+
+        u_int64_t estNumber=0, estTotalSize=0, estMaxSize=0;
+        bank.estimate (estNumber, estTotalSize, estMaxSize);
+
+        /** The estimation comes from samples, so it has a (small) error. */
+        double error = bank.getEstimateError();
+        CPPUNIT_ASSERT (error > 0  &&  error < 0.01);
+        CPPUNIT_ASSERT (fabs ((double)estNumber    - number)    < (5*error + 0.001) * number);
+        CPPUNIT_ASSERT (fabs ((double)estTotalSize - totalSize) < 0.01 * totalSize);
+        CPPUNIT_ASSERT (estMaxSize > 140  &&  estMaxSize <= 150);
+
+        CPPUNIT_ASSERT (System::file().remove (filename) == 0);
+    }
+
+    /** \brief Test the estimation of sequences information
+     *
+     * Small and gzipped files are read entirely, so their estimation is exact. Bigger files are sampled,
+     * so we check that the estimation is close to the actual values.
+     */
+    void bank_checkEstimateSampling ()
+    {
+        const char* filenames[] = { "sample1.fa", "reads1.fa.gz", "sample.fastq", "sample.fastq.gz", "reads2_bgzf.fa.gz" };
+
+        for (size_t i=0; i<ARRAY_SIZE(filenames); i++)
+        {
+            BankFasta bank (DBPATH(filenames[i]));
+            bank_checkEstimateExact_aux (bank);
+        }
+
+        /** The errors of the banks of a composite are combined. */
+        vector<IBank*> banks;
+        banks.push_back (new BankFasta (DBPATH("reads1.fa.gz")));
+        banks.push_back (new BankFasta (DBPATH("sample.fastq")));
+        BankComposite composite (banks);
+        bank_checkEstimateExact_aux (composite);
+
+        bank_checkEstimateSampling_aux (false);
+        bank_checkEstimateSampling_aux (true);
+    }
 };
 
 /********************************************************************************/
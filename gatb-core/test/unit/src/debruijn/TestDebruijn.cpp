@@ -33,6 +33,7 @@
 #include <gatb/debruijn/impl/Graph.hpp>
 #include <gatb/debruijn/impl/Terminator.hpp>
 #include <gatb/debruijn/impl/Traversal.hpp>
+#include <gatb/debruijn/impl/NodesDeleter.hpp>
 
 #include <gatb/kmer/impl/SortingCountAlgorithm.hpp>
 #include <gatb/kmer/impl/BloomAlgorithm.hpp>
@@ -89,6 +90,7 @@ class TestDebruijn : public Test
 
         CPPUNIT_TEST_GATB (debruijn_test7); 
         CPPUNIT_TEST_GATB (debruijn_deletenode);
+        CPPUNIT_TEST_GATB (debruijn_nodesdeleter);
         //CPPUNIT_TEST_GATB (debruijn_checksum); // FIXME removed it because it's a damn long test
         CPPUNIT_TEST_GATB (debruijn_test2);
         CPPUNIT_TEST_GATB (debruijn_test3); // that one is long when compiled in debug, fast in release
@@ -783,12 +785,12 @@ public:
     }
 
     /********************************************************************************/
-    void debruijn_mphf_aux (const char* sequences[], size_t len, const int abundances[])
+    void debruijn_mphf_aux (const char* sequences[], size_t len, const int abundances[], const char* options="")
     {
         size_t kmerSize = strlen (sequences[0]);
 
         // We create the graph.
-        Graph graph = Graph::create (new BankStrings (sequences, len),  "-kmer-size %d  -abundance-min 1  -verbose 0 -max-memory %d", kmerSize, MAX_MEMORY);
+        Graph graph = Graph::create (new BankStrings (sequences, len),  "-kmer-size %d  -abundance-min 1  -verbose 0 -max-memory %d %s", kmerSize, MAX_MEMORY, options);
 
         GraphIterator<Node> it = graph.iterator();
 
@@ -806,6 +808,26 @@ public:
             int abundance = graph.queryAbundance(node);
             //std::cout << graph.toString(node) << " test printing node abundance " << abundance << " expected abundance:" << abundances[i] << std::endl;
             CPPUNIT_ASSERT (abundance == abundances[i]);
+
+            // the node state is kept apart from the abundance
+            graph.setNodeState (node, 3);
+            CPPUNIT_ASSERT (graph.queryNodeState(node) == 3);
+            CPPUNIT_ASSERT (graph.queryAbundance(node) == abundances[i]);
+            graph.setNodeState (node, 0);
+        }
+
+        // batch query of the abundances and indexes
+        vector<Node> nodes;
+        for (size_t i=0; i<len; i++)  {  nodes.push_back (graph.buildNode ((char*)sequences[i]));  }
+        vector<int>           abundancesBatch (len);
+        vector<unsigned long> indexesBatch    (len);
+        graph.queryAbundance (nodes.data(), len, abundancesBatch.data());
+        graph.nodeMPHFIndex  (nodes.data(), len, indexesBatch.data());
+        for (size_t i=0; i<len; i++)
+        {
+            CPPUNIT_ASSERT (abundancesBatch[i] == abundances[i]);
+            Node node = graph.buildNode ((char*)sequences[i]);
+            CPPUNIT_ASSERT (indexesBatch[i] == graph.nodeMPHFIndex (node));
         }
     }
 
@@ -829,6 +851,8 @@ public:
         const int abundances[] = { 1, 2, 2, 3, 3, 3, 4, 4, 4, 4 };
 
         debruijn_mphf_aux (sequences1, ARRAY_SIZE(sequences1), abundances);
+        debruijn_mphf_aux (sequences1, ARRAY_SIZE(sequences1), abundances, "-mphf-fused 1");
+        debruijn_mphf_aux (sequences1, ARRAY_SIZE(sequences1), abundances, "-mphf-interleaved 1");
     }
 
 
@@ -909,10 +933,12 @@ public:
         Graph::create (inputBank,  "-kmer-size 31 -out %s -abundance-min 1  -verbose 0  -max-memory %d",                        "g1", MAX_MEMORY);
         Graph::create (inputBank,  "-kmer-size 31 -out %s -abundance-min 1  -verbose 0 -branching-nodes none  -max-memory %d",  "g2", MAX_MEMORY);
         Graph::create (inputBank,  "-kmer-size 31 -out %s -abundance-min 1  -verbose 0 -solid-kmers-out none  -max-memory %d",  "g3", MAX_MEMORY);
+        Graph::create (inputBank,  "-kmer-size 31 -out %s -abundance-min 1  -verbose 0 -bloom-count 1  -max-memory %d",         "g4", MAX_MEMORY);
 
         debruijn_build_entry r1 = debruijn_build_aux_aux ("g1", true,  true);
         debruijn_build_entry r2 = debruijn_build_aux_aux ("g2", true,  true);
         debruijn_build_entry r3 = debruijn_build_aux_aux ("g3", false, true);
+        debruijn_build_entry r4 = debruijn_build_aux_aux ("g4", true,  true);
 
         CPPUNIT_ASSERT (r1.nbNodes       == r2.nbNodes);
         CPPUNIT_ASSERT (r1.checksumNodes == r2.checksumNodes);
@@ -925,6 +951,12 @@ public:
         CPPUNIT_ASSERT (r1.checksumBranchingNodes == r2.checksumBranchingNodes);
         CPPUNIT_ASSERT (r1.nbBranchingNodes       == r3.nbBranchingNodes);
         CPPUNIT_ASSERT (r1.checksumBranchingNodes == r3.checksumBranchingNodes);
+
+        /** The Bloom filter filled during the counting must give the same graph. */
+        CPPUNIT_ASSERT (r1.nbNodes                == r4.nbNodes);
+        CPPUNIT_ASSERT (r1.checksumNodes          == r4.checksumNodes);
+        CPPUNIT_ASSERT (r1.nbBranchingNodes       == r4.nbBranchingNodes);
+        CPPUNIT_ASSERT (r1.checksumBranchingNodes == r4.checksumBranchingNodes);
     }
 
     /********************************************************************************/
@@ -1199,6 +1231,61 @@ public:
         graph2.precomputeAdjacency(1, false);
         
         debruijn_deletenode_fct (graph2);
+
+        /* and with adjacency information held in the fused node records */
+
+        Graph graph3 = Graph::create (new BankStrings ("AGGCGCC", "ACTGACTGACTGACTG",0),  "-kmer-size 5  -abundance-min 1  -verbose 0  -max-memory %d -mphf-fused 1", MAX_MEMORY);
+        graph3.precomputeAdjacency(1, false);
+
+        debruijn_deletenode_fct (graph3);
+    }
+
+    void debruijn_nodesdeleter_fct (Graph& graph)
+    {
+        /** We mark one node out of three from several threads, then flush the deleter. */
+        GraphIterator<Node> itNodes = graph.iterator();
+
+        NodesDeleter<Node,Edge,Graph> nodesDeleter (graph, itNodes.size(), 4, false);
+
+        Dispatcher(4).iterate (itNodes, [&] (Node& node)
+        {
+            if (graph.nodeMPHFIndex(node) % 3 == 0)  {  nodesDeleter.markToDelete (node);  }
+        });
+
+        nodesDeleter.flush();
+
+        size_t nbDeleted = 0;
+        for (itNodes.first(); !itNodes.isDone(); itNodes.next())
+        {
+            Node& node = itNodes.item();
+            unsigned long index = graph.nodeMPHFIndex(node);
+
+            CPPUNIT_ASSERT (nodesDeleter.get(index) == (index % 3 == 0));
+            CPPUNIT_ASSERT (graph.isNodeDeleted(node) == (index % 3 == 0));
+
+            if (graph.isNodeDeleted(node))  {  nbDeleted++;  continue;  }
+
+            /** The adjacency of the remaining nodes must not reference deleted nodes anymore. */
+            CPPUNIT_ASSERT (graph.debugCompareNeighborhoods (node, DIR_OUTCOMING, "nodesdeleter") == false);
+            CPPUNIT_ASSERT (graph.debugCompareNeighborhoods (node, DIR_INCOMING,  "nodesdeleter") == false);
+        }
+
+        CPPUNIT_ASSERT (nbDeleted == nodesDeleter.nbNodesToDelete);
+        CPPUNIT_ASSERT (nbDeleted > 0);
+    }
+
+    void debruijn_nodesdeleter ()
+    {
+        const char* seq = "CATTGATAGTGGATGGTAGACTAGCTTGGATCCGATCGGCTATCGACTACGATCGATTTTTCGCGATTAGCAAAGGCCTAGCTAACAAGCT";
+
+        Graph graph = Graph::create (new BankStrings (seq, 0),  "-kmer-size 11  -abundance-min 1  -verbose 0  -max-memory %d", MAX_MEMORY);
+        debruijn_nodesdeleter_fct (graph);
+
+        /* rerun this test with adjacency information, updated concurrently by the deleter */
+
+        Graph graph2 = Graph::create (new BankStrings (seq, 0),  "-kmer-size 11  -abundance-min 1  -verbose 0  -max-memory %d", MAX_MEMORY);
+        graph2.precomputeAdjacency(1, false);
+        debruijn_nodesdeleter_fct (graph2);
     }
 
     void debruijn_deletenode2_fct (const Graph& graph) 
@@ -34,6 +34,8 @@
 #include <gatb/debruijn/impl/GraphUnitigs.hpp>
 #include <gatb/debruijn/impl/Terminator.hpp>
 #include <gatb/debruijn/impl/Traversal.hpp>
+#include <gatb/debruijn/impl/LinkTigs.hpp>
+#include <gatb/debruijn/impl/ExtremityInfo.hpp>
 
 #include <gatb/kmer/impl/SortingCountAlgorithm.hpp>
 #include <gatb/kmer/impl/BloomAlgorithm.hpp>
@@ -47,6 +49,10 @@
 
 #include <iostream>
 #include <memory>
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
 
 using namespace std;
 
@@ -105,6 +111,8 @@ class TestDebruijnUnitigs : public Test
         CPPUNIT_TEST_GATB (debruijn_unitigs_test6);
         CPPUNIT_TEST_GATB (debruijn_unitigs_test13);
         CPPUNIT_TEST_GATB (debruijn_unitigs_build);
+        CPPUNIT_TEST_GATB (debruijn_unitigs_links);
+        CPPUNIT_TEST_GATB (debruijn_unitigs_ids);
         //CPPUNIT_TEST_GATB (debruijn_unitigs_traversal1); // would need to be fixed
         
         CPPUNIT_TEST_SUITE_GATB_END();
@@ -843,6 +851,227 @@ public:
         debruijn_unitigs_build_aux (sequences, ARRAY_SIZE(sequences));
     }
 
+    /********************************************************************************/
+    /* links of the unitigs, as computed by the former link_tigs: 8 passes chosen by the first two and last two
+     * nucleotides of each extremity, links found through a hash table of the extremities of the pass, and
+     * links strings merged by (unitig, pass) with the begin of a unitig before its end. */
+    static string links_revcomp (const string& s)
+    {
+        string rc (s.rbegin(), s.rend());
+        for (size_t i = 0; i < rc.size(); i++)  { rc[i] = rc[i]=='A' ? 'T' : rc[i]=='C' ? 'G' : rc[i]=='G' ? 'C' : 'A'; }
+        return rc;
+    }
+
+    static int debruijn_unitigs_links_pass (const string& seq, Unitig_pos p, size_t kmerSize)
+    {
+        static const char* nt = "ACTG";
+        size_t e = (p == UNITIG_END) ? seq.size()-(kmerSize-1) : 0;
+        unsigned char smallmer = 0;
+        const char c[4] = { seq[e], seq[e+1], seq[e+kmerSize-1-1-1], seq[e+kmerSize-1-1] };
+        for (size_t i=0; i<4; i++)  { smallmer = (smallmer << 2) + (strchr(nt,c[i]) - nt); }
+        const unsigned char rev = revcomp_4NT[smallmer];
+        return std::min (smallmer, rev) % 8;
+    }
+
+    vector<string> debruijn_unitigs_links_reference (const vector<string>& unitigs, size_t kmerSize)
+    {
+        typedef Kmer<32>::ModelCanonical Model;
+        Model modelKminusOne (kmerSize - 1);
+
+        vector<tuple<u_int64_t, int, int, string> > records;
+
+        for (int pass = 0; pass < 8; pass++)
+        {
+            unordered_map<u_int64_t, vector<u_int64_t> > utigs_links_map;
+
+            for (size_t utig = 0; utig < unitigs.size(); utig++)
+            {
+                const string& seq = unitigs[utig];
+                for (int p = 0; p < 2; p++)
+                {
+                    Unitig_pos pos = p == 0 ? UNITIG_BEGIN : UNITIG_END;
+                    if (debruijn_unitigs_links_pass (seq, pos, kmerSize) != pass)  { continue; }
+                    string extremity = p == 0 ? seq.substr (0, kmerSize-1) : seq.substr (seq.size()-kmerSize+1);
+                    Model::Kmer kmer = modelKminusOne.codeSeed (extremity.c_str(), Data::ASCII);
+                    ExtremityInfo e (utig, modelKminusOne.toString (kmer.value()) != extremity, pos);
+                    utigs_links_map[kmer.value().getVal()].push_back (e.pack());
+                }
+            }
+
+            for (size_t utig = 0; utig < unitigs.size(); utig++)
+            {
+                const string& seq = unitigs[utig];
+                for (int p = 0; p < 2; p++)
+                {
+                    Unitig_pos pos = p == 0 ? UNITIG_BEGIN : UNITIG_END;
+                    if (debruijn_unitigs_links_pass (seq, pos, kmerSize) != pass)  { continue; }
+                    string extremity = p == 0 ? seq.substr (0, kmerSize-1) : seq.substr (seq.size()-kmerSize+1);
+                    Model::Kmer kmer = modelKminusOne.codeSeed (extremity.c_str(), Data::ASCII);
+                    bool same       = modelKminusOne.toString (kmer.value()) == extremity;
+                    bool nevermind  = ((kmerSize - 1) % 2 == 0) && kmer.isPalindrome();
+
+                    string links = " ";
+                    for (auto packed : utigs_links_map[kmer.value().getVal()])
+                    {
+                        ExtremityInfo o (packed);
+                        bool valid = (pos == UNITIG_BEGIN) ?
+                            ((same && o.pos == UNITIG_END && !o.rc) || (same && o.pos == UNITIG_BEGIN && o.rc) ||
+                            (!same && o.pos == UNITIG_END && o.rc) || (!same && o.pos == UNITIG_BEGIN && !o.rc)) :
+                            ((same && o.pos == UNITIG_BEGIN && !o.rc) || (same && o.pos == UNITIG_END && o.rc) ||
+                            (!same && o.pos == UNITIG_BEGIN && o.rc) || (!same && o.pos == UNITIG_END && !o.rc));
+                        if (!(valid || nevermind))  { continue; }
+                        if (nevermind && o.unitig == utig)  { continue; }
+
+                        bool rc = o.rc ^ (!same);
+                        if (pos == UNITIG_BEGIN)
+                        {
+                            links += "L:-:" + to_string(o.unitig) + ":" + (rc?"+":"-") + " ";
+                            if (nevermind)  { links += "L:-:" + to_string(o.unitig) + ":" + ((!rc)?"+":"-") + " "; }
+                        }
+                        else
+                        {
+                            links += "L:+:" + to_string(o.unitig) + ":" + (rc?"-":"+") + " ";
+                            if (nevermind)  { links += "L:+:" + to_string(o.unitig) + ":" + ((!rc)?"-":"+") + " "; }
+                        }
+                    }
+                    records.push_back (make_tuple (utig, pass, p, links));
+                }
+            }
+        }
+
+        std::sort (records.begin(), records.end());
+
+        vector<string> result (unitigs.size());
+        for (size_t i = 0; i < records.size(); i++)  { result[get<0>(records[i])] += get<3>(records[i]); }
+        return result;
+    }
+
+    /** Unitigs are built from a small set of extremity (k-1)-mers (with palindromes when k-1 is even),
+     * so that they share many links. The links written by link_tigs must be the ones of the former
+     * implementation, in the same order, whatever the number of passes set by the memory. */
+    void debruijn_unitigs_links_aux (size_t kmerSize, size_t nbUnitigs, u_int64_t maxMemory)
+    {
+        static const char* nt = "ACGT";
+        srand (kmerSize + nbUnitigs);
+
+        vector<string> extremities (nbUnitigs / 4);
+        for (size_t i = 0; i < extremities.size(); i++)
+        {
+            size_t len = ((kmerSize - 1) % 2 == 0 && i % 10 == 0) ? (kmerSize - 1) / 2 : kmerSize - 1;
+            for (size_t j = 0; j < len; j++)  { extremities[i] += nt[rand() % 4]; }
+            if (len < kmerSize - 1)  { extremities[i] += links_revcomp (extremities[i]); }
+        }
+
+        vector<string> unitigs (nbUnitigs);
+        string filename = "test_links_" + to_string(kmerSize) + ".fa";
+        System::file().remove (filename);
+        {
+            BankFasta bank (filename);
+            for (size_t i = 0; i < nbUnitigs; i++)
+            {
+                string begin = extremities[rand() % extremities.size()];
+                string end   = extremities[rand() % extremities.size()];
+                if (rand() % 2)  { begin = links_revcomp (begin); }
+                if (rand() % 2)  { end   = links_revcomp (end);   }
+                unitigs[i] = begin;
+                for (int j = rand() % 20; j > 0; j--)  { unitigs[i] += nt[rand() % 4]; }
+                unitigs[i] += end;
+
+                Sequence s (Data::ASCII);
+                s.getData().setRef ((char*)unitigs[i].c_str(), unitigs[i].size());
+                s._comment = "LN:i:" + to_string(unitigs[i].size());
+                bank.insert (s);
+            }
+            bank.flush();
+        }
+
+        vector<string> expected = debruijn_unitigs_links_reference (unitigs, kmerSize);
+
+        u_int64_t nb_unitigs = 0;
+        link_tigs<32> (filename, kmerSize, 4, nb_unitigs, false, maxMemory);
+        CPPUNIT_ASSERT (nb_unitigs == nbUnitigs);
+
+        BankFasta bank (filename);
+        Iterator<Sequence>* it = bank.iterator();  LOCAL (it);
+        size_t i = 0;
+        for (it->first(); !it->isDone(); it->next(), i++)
+        {
+            CPPUNIT_ASSERT (i < nbUnitigs);
+            CPPUNIT_ASSERT (it->item().toString() == unitigs[i]);
+            CPPUNIT_ASSERT (it->item().getComment() == "LN:i:" + to_string(unitigs[i].size()) + " " + expected[i]);
+        }
+        CPPUNIT_ASSERT (i == nbUnitigs);
+
+        System::file().remove (filename);
+    }
+
+    void debruijn_unitigs_links ()
+    {
+        debruijn_unitigs_links_aux (21, 2000,  0);
+        debruijn_unitigs_links_aux (32, 2000,  0);
+        /** these ones have several passes, the unitigs file being larger than the memory */
+        debruijn_unitigs_links_aux (21, 30000, 1);
+        debruijn_unitigs_links_aux (32, 30000, 1);
+    }
+
+    /********************************************************************************/
+    /** The id of a unitig is its position in the unitigs file (link_tigs, GraphUnitigs): the header of each
+     * unitig must give its position, and the links must point to the unitigs that overlap, whatever the
+     * number of threads that glue the unitigs. */
+    void debruijn_unitigs_ids ()
+    {
+        static const char* nt = "ACGT";
+        size_t kmerSize = 31;
+
+        srand (31);
+        string genome;
+        for (size_t i=0; i<30000; i++)  {  genome += nt[rand()%4];  }
+
+        vector<string> reads;
+        for (size_t i=0; i<6000; i++)
+        {
+            string read = genome.substr (rand() % (genome.size()-100), 100);
+            if (rand() % 2)  {  read[rand() % read.size()] = nt[rand()%4];  }
+            reads.push_back (read);
+        }
+
+        GraphUnitigs graph = GraphUnitigs::create (new BankStrings (reads), "-kmer-size %d  -abundance-min 1  -verbose 0  -max-memory %d -nb-cores 4", kmerSize, MAX_MEMORY);
+
+        vector<string> unitigs, comments;
+        BankFasta bank ("dummy.unitigs.fa");
+        Iterator<Sequence>* it = bank.iterator();  LOCAL (it);
+        for (it->first(); !it->isDone(); it->next())
+        {
+            unitigs.push_back  (it->item().toString());
+            comments.push_back (it->item().getComment());
+        }
+        CPPUNIT_ASSERT (unitigs.size() > 1000);
+
+        size_t nbLinks = 0;
+        for (size_t i=0; i<unitigs.size(); i++)
+        {
+            stringstream ss (comments[i]);
+            string token;
+            ss >> token;
+            CPPUNIT_ASSERT (token == to_string(i));
+
+            /** An outgoing link from the end of a unitig goes to the start of the next one, or to the end of its reverse complement. */
+            string end = unitigs[i].substr (unitigs[i].size()-(kmerSize-1));
+            while (ss >> token)
+            {
+                if (token.compare (0, 4, "L:+:") != 0)  { continue; }
+                size_t sep = token.find (':', 4);
+                size_t j   = stoull (token.substr (4, sep-4));
+                CPPUNIT_ASSERT (j < unitigs.size());
+
+                if (token[sep+1] == '+')  {  CPPUNIT_ASSERT (unitigs[j].substr (0, kmerSize-1) == end);  }
+                else                      {  CPPUNIT_ASSERT (links_revcomp (unitigs[j].substr (unitigs[j].size()-(kmerSize-1))) == end);  }
+                nbLinks++;
+            }
+        }
+        CPPUNIT_ASSERT (nbLinks > 0);
+    }
+
     /********************************************************************************/
 
     void debruijn_unitigs_traversal1_aux_aux (bool useCopyTerminator, size_t kmerSize, const char** seqs, size_t seqsSize,
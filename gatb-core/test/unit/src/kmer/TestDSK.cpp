@@ -98,6 +98,8 @@ class TestDSK : public Test
         CPPUNIT_TEST_GATB (DSK_check1);
         CPPUNIT_TEST_GATB (DSK_check2);
         CPPUNIT_TEST_GATB (DSK_check3);
+        CPPUNIT_TEST_GATB (DSK_superkmerStorage);
+        CPPUNIT_TEST_GATB (DSK_checkSolidEstimate);
 
         /*
          * disabled multi-bank DSK testing, since DSK3 does not support it anymore
@@ -441,6 +443,124 @@ public:
 #endif
     }
 
+    /********************************************************************************/
+    /** Check the bound of the number of solid kmers, used for sizing a Bloom filter filled during the counting. */
+    void DSK_checkSolidEstimate ()
+    {
+        /** Each read is seen 50 times: there are far less distinct kmers than kmers / abundance min. */
+        srand (23);
+        vector<string> reads;
+        for (size_t i=0; i<20; i++)
+        {
+            string read;
+            for (size_t j=0; j<100; j++)  {  read += "ACGT"[rand()%4];  }
+            for (size_t j=0; j<50; j++)   {  reads.push_back (read);  }
+        }
+
+        IBank* bank = new BankStrings (reads);  LOCAL (bank);
+
+        IProperties* params = SortingCountAlgorithm<>::getDefaultProperties();  LOCAL (params);
+        params->setInt (STR_KMER_SIZE,          31);
+        params->setInt (STR_MAX_MEMORY,         MAX_MEMORY);
+        params->setInt (STR_KMER_ABUNDANCE_MIN, 2);
+        params->setStr (STR_URI_OUTPUT,         "foo");
+        params->add    (0, STR_BLOOM_COUNT_BITS, "10000");
+
+        SortingCountAlgorithm<> sortingCount (bank, params);
+        sortingCount.execute();
+
+        const Configuration& config = sortingCount.getConfig();
+        u_int64_t nbSolids = sortingCount.getSolidCounts()->getNbItems();
+
+        CPPUNIT_ASSERT (nbSolids == 20*(100-31+1));
+        CPPUNIT_ASSERT (config._solidKmersEstimate >= nbSolids);
+        CPPUNIT_ASSERT (config._solidKmersEstimate <  nbSolids*11/10);
+
+        /** The Bloom filter is charged to the counting memory. */
+        CPPUNIT_ASSERT (config._bloomCountMemory == config._solidKmersEstimate * 10000 / 8 / MBYTE + 1);
+        CPPUNIT_ASSERT (config.getCountingMemory() == config._max_memory - config._superkArenaMemory - config._bloomCountMemory);
+    }
+
+    /********************************************************************************/
+    template<size_t span>
+    void DSK_superkmerStorage_aux (IBank* bank, size_t kmerSize, int superkMemory, int superkCompress, bool superkMmap,
+        vector< pair<typename Kmer<span>::Type,CountNumber> >& counts, double& ratio, bool& inMemory
+    )
+    {
+        /** Shortcut. */
+        typedef typename Kmer<span>::Count Count;
+
+        /** We configure parameters for a SortingCountAlgorithm object. */
+        IProperties* params = SortingCountAlgorithm<>::getDefaultProperties();  LOCAL (params);
+        params->setInt (STR_KMER_SIZE,          kmerSize);
+        params->setInt (STR_MAX_MEMORY,         MAX_MEMORY);
+        params->setInt (STR_KMER_ABUNDANCE_MIN, 1);
+        params->setInt (STR_SUPERK_MEMORY,      superkMemory);
+        params->setInt (STR_SUPERK_COMPRESS,    superkCompress);
+        params->setInt (STR_SUPERK_MMAP,        superkMmap ? 1 : 0);
+        params->setStr (STR_URI_OUTPUT,         "foo");
+
+        SortingCountAlgorithm<span> sortingCount (bank, params);
+        sortingCount.execute();
+
+        ratio    = sortingCount.getInfo()->getDouble ("compression ratio");
+        inMemory = sortingCount.getConfig()._superkInMemory;
+
+        counts.clear();
+        Iterator<Count>* iter = sortingCount.getSolidCounts()->iterator();  LOCAL (iter);
+        for (iter->first(); !iter->isDone(); iter->next())  {  counts.push_back (make_pair (iter->item().value, iter->item().abundance));  }
+        sort (counts.begin(), counts.end());
+    }
+
+    /** Check that the counts don't depend on the way the superkmers partitions are stored. */
+    void DSK_superkmerStorage ()
+    {
+        typedef Kmer<KSIZE_1>::Type Type;
+
+        /** We build reads from a small random genome, so that the partitions hold many copies
+         * of the same superkmers and can be compressed. */
+        srand (17);
+        string genome;
+        for (size_t i=0; i<20000; i++)  {  genome += "ACGT"[rand()%4];  }
+
+        vector<string> reads;
+        for (size_t i=0; i<20000; i++)  {  reads.push_back (genome.substr (rand() % (genome.size()-100), 100));  }
+
+        IBank* bank = new BankStrings (reads);  LOCAL (bank);
+
+        vector< pair<Type,CountNumber> > ref, check;
+        double ratio    = 0;
+        bool   inMemory = false;
+
+        DSK_superkmerStorage_aux<KSIZE_1> (bank, 31, 0, 0, false, ref, ratio, inMemory);
+        CPPUNIT_ASSERT (ref.size() > 0);
+        CPPUNIT_ASSERT (ratio == 1.0);
+        CPPUNIT_ASSERT (inMemory == false);
+
+        /** Compressed partitions files, read by blocks then through memory mapping. */
+        DSK_superkmerStorage_aux<KSIZE_1> (bank, 31, 0, 1, false, check, ratio, inMemory);
+        CPPUNIT_ASSERT (ratio > 1.0);
+        CPPUNIT_ASSERT (check == ref);
+
+        DSK_superkmerStorage_aux<KSIZE_1> (bank, 31, 0, 1, true, check, ratio, inMemory);
+        CPPUNIT_ASSERT (ratio > 1.0);
+        CPPUNIT_ASSERT (check == ref);
+
+        /** Partitions kept in memory, by default (single pass that fits), raw then compressed. */
+        DSK_superkmerStorage_aux<KSIZE_1> (bank, 31, 1, 0, false, check, ratio, inMemory);
+        CPPUNIT_ASSERT (inMemory == true);
+        CPPUNIT_ASSERT (check == ref);
+
+        DSK_superkmerStorage_aux<KSIZE_1> (bank, 31, 2, 0, false, check, ratio, inMemory);
+        CPPUNIT_ASSERT (inMemory == true);
+        CPPUNIT_ASSERT (check == ref);
+
+        DSK_superkmerStorage_aux<KSIZE_1> (bank, 31, 2, 1, false, check, ratio, inMemory);
+        CPPUNIT_ASSERT (inMemory == true);
+        CPPUNIT_ASSERT (ratio > 1.0);
+        CPPUNIT_ASSERT (check == ref);
+    }
+
     /********************************************************************************/
     template<size_t span>
     void DSK_perBank_aux (IBank* bank, size_t kmerSize, size_t nksMin, size_t nksMax, KmerSolidityKind solidityKind, size_t checkNb)
@@ -22,6 +22,8 @@
 
 #include <gatb/bank/impl/BankStrings.hpp>
 
+#include <algorithm>
+
 #include <gatb/kmer/impl/SortingCountAlgorithm.hpp>
 #include <gatb/kmer/impl/BloomAlgorithm.hpp>
 #include <gatb/kmer/impl/DebloomAlgorithm.hpp>
@@ -32,6 +34,7 @@
 #include <gatb/tools/math/LargeInt.hpp>
 
 #include <gatb/tools/storage/impl/Storage.hpp>
+#include <gatb/tools/storage/impl/StorageTools.hpp>
 
 using namespace std;
 
@@ -68,6 +71,8 @@ class TestDebloom : public Test
     CPPUNIT_TEST_SUITE_GATB (TestDebloom);
 
         CPPUNIT_TEST_GATB (Debloom_check1);
+        CPPUNIT_TEST_GATB (Debloom_checkBloomKinds);
+        CPPUNIT_TEST_GATB (Debloom_checkCascading);
 
     CPPUNIT_TEST_SUITE_GATB_END();
 
@@ -160,6 +165,142 @@ public:
 
         CPPUNIT_ASSERT (checkValues.size() == okValues.size());
     }
+
+    /********************************************************************************/
+    void Debloom_checkBloomKinds_aux (BloomKind bloomKind)
+    {
+        size_t kmerSize = 21;
+        size_t miniSize = 8;
+
+        const char* seqs[] = {
+            "CGCTACAGCAGCTAGTTCATCATTGTTTATCAATGATAAAATATAATAAGCTAAAAGGAAACTATAAATA"
+            "ACCATGTATAATTATAAGTAGGTACCTATTTTTTTATTTTAAACTGAAATTCAATATTATATAGGCAAAG"
+            "ACTTAGATGTAAGATTTCGAAGACTTGGATGTAAACAACAAATAAGATAATAACCATAAAAATAGAAATG"
+        } ;
+
+        IProperties* params = SortingCountAlgorithm<>::getDefaultProperties();  LOCAL (params);
+        params->setInt (STR_KMER_SIZE,          kmerSize);
+        params->setInt (STR_MINIMIZER_SIZE,     miniSize);
+        params->setInt (STR_MAX_MEMORY,         MAX_MEMORY);
+        params->setInt (STR_KMER_ABUNDANCE_MIN, 1);
+        params->setStr (STR_URI_OUTPUT,         "foo");
+
+        SortingCountAlgorithm<> sortingCount (new BankStrings (seqs, ARRAY_SIZE(seqs)), params);
+        sortingCount.execute();
+
+        Storage* storage = sortingCount.getStorage();
+        LOCAL (storage);
+
+        Partition<SortingCountAlgorithm<>::Count>& counts = storage->getGroup("dsk").getPartition<Kmer<>::Count> ("solid");
+
+        /** The Bloom filter is built by a BloomBuilder, then loaded from the storage. */
+        BloomAlgorithm<> bloomAlgo (*storage, &counts, kmerSize, DebloomAlgorithm<>::getNbBitsPerKmer (kmerSize, DEBLOOM_CASCADING), 0, bloomKind);
+        bloomAlgo.execute ();
+
+        IBloom<Kmer<>::Type>* bloom = StorageTools::singleton().loadBloom<Kmer<>::Type> (storage->getGroup("bloom"), "bloom");
+        LOCAL (bloom);
+
+        CPPUNIT_ASSERT (bloom->getName() == toString (bloomKind));
+
+        /** No false negative. */
+        set<Kmer<>::Type> solids;
+        Iterator<Kmer<>::Count>* itSolid = counts.iterator();  LOCAL (itSolid);
+        for (itSolid->first(); !itSolid->isDone(); itSolid->next())
+        {
+            CPPUNIT_ASSERT (bloom->contains (itSolid->item().value));
+            solids.insert (itSolid->item().value);
+        }
+
+        /** The debloom builds its own filters with a BloomBuilder: the critical kmers are not solid. */
+        DebloomAlgorithm<> debloom (
+            storage->getGroup("bloom"),
+            storage->getGroup("debloom"),
+            &counts, kmerSize, miniSize, 1000, 0, bloomKind, DEBLOOM_CASCADING
+        );
+        debloom.execute();
+
+        Iterator<Kmer<>::Type>* itCritical = debloom.getCriticalKmers()->iterator();  LOCAL (itCritical);
+        for (itCritical->first(); !itCritical->isDone(); itCritical->next())
+        {
+            CPPUNIT_ASSERT (solids.find (itCritical->item()) == solids.end());
+        }
+    }
+
+    /** */
+    void Debloom_checkBloomKinds ()
+    {
+        BloomKind kinds[] = { BLOOM_BASIC, BLOOM_CACHE, BLOOM_NEIGHBOR, BLOOM_BLOCKED };
+
+        for (size_t i=0; i<ARRAY_SIZE(kinds); i++)  {  Debloom_checkBloomKinds_aux (kinds[i]);  }
+    }
+
+    /********************************************************************************/
+    void Debloom_checkCascading ()
+    {
+        typedef Kmer<>::Type Type;
+
+        size_t kmerSize = 31;
+        size_t miniSize = 8;
+
+        /** We build reads from a random genome, with a few errors so that there are false positives. */
+        srand (11);
+        string genome;
+        for (size_t i=0; i<50000; i++)  {  genome += "ACGT"[rand()%4];  }
+
+        vector<string> reads;
+        for (size_t i=0; i<5000; i++)
+        {
+            string read = genome.substr (rand() % (genome.size()-100), 100);
+            if (i%10 == 0)  {  read[rand()%100] = "ACGT"[rand()%4];  }
+            reads.push_back (read);
+        }
+
+        IProperties* params = SortingCountAlgorithm<>::getDefaultProperties();  LOCAL (params);
+        params->setInt (STR_KMER_SIZE,          kmerSize);
+        params->setInt (STR_MINIMIZER_SIZE,     miniSize);
+        params->setInt (STR_MAX_MEMORY,         MAX_MEMORY);
+        params->setInt (STR_KMER_ABUNDANCE_MIN, 1);
+        params->setStr (STR_URI_OUTPUT,         "foo");
+
+        SortingCountAlgorithm<> sortingCount (new BankStrings (reads), params);
+        sortingCount.execute();
+
+        Storage* storage = sortingCount.getStorage();
+        LOCAL (storage);
+
+        Partition<SortingCountAlgorithm<>::Count>& counts = storage->getGroup("dsk").getPartition<Kmer<>::Count> ("solid");
+
+        BloomAlgorithm<> bloom (*storage, &counts, kmerSize, DebloomAlgorithm<>::getNbBitsPerKmer (kmerSize, DEBLOOM_CASCADING), 0, BLOOM_NEIGHBOR);
+        bloom.execute ();
+
+        DebloomAlgorithm<> debloom (
+            storage->getGroup("bloom"),
+            storage->getGroup("debloom"),
+            &counts, kmerSize, miniSize, 1000, 0, BLOOM_NEIGHBOR, DEBLOOM_CASCADING
+        );
+        debloom.execute();
+
+        /** We compute the cFP set as the former implementation did: the T2 kmers (solid kmers
+         * found in bloom2) that are found in bloom4, sorted. */
+        IBloom<Type>* bloom2 = StorageTools::singleton().loadBloom<Type> (storage->getGroup("debloom"), "bloom2");  LOCAL (bloom2);
+        IBloom<Type>* bloom4 = StorageTools::singleton().loadBloom<Type> (storage->getGroup("debloom"), "bloom4");  LOCAL (bloom4);
+
+        vector<Type> expected;
+        Iterator<Kmer<>::Count>* itSolid = counts.iterator();  LOCAL (itSolid);
+        for (itSolid->first(); !itSolid->isDone(); itSolid->next())
+        {
+            const Type& kmer = itSolid->item().value;
+            if (bloom2->contains (kmer) && bloom4->contains (kmer))  {  expected.push_back (kmer);  }
+        }
+        std::sort (expected.begin(), expected.end());
+
+        vector<Type> cfp;
+        Iterator<Type>* itCritical = debloom.getCriticalKmers()->iterator();  LOCAL (itCritical);
+        for (itCritical->first(); !itCritical->isDone(); itCritical->next())  {  cfp.push_back (itCritical->item());  }
+
+        CPPUNIT_ASSERT (debloom.getCriticalKmers()->getNbItems() > 0);
+        CPPUNIT_ASSERT (cfp == expected);
+    }
 };
 
 /********************************************************************************/
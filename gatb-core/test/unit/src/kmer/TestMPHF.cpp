@@ -74,6 +74,8 @@ class TestMPHF : public Test
 
         // no mphf1 anymore
         CPPUNIT_TEST_GATB (test_mphf2);
+        CPPUNIT_TEST_GATB (test_mphf_partitioned);
+        CPPUNIT_TEST_GATB (test_mphf_batch);
 
     CPPUNIT_TEST_SUITE_GATB_END();
 
@@ -321,6 +323,116 @@ public:
             // We check that all codes have been seen
             for (size_t i=0; i<check.size(); i++)  { CPPUNIT_ASSERT(check[i]==true); }
         }
+
+    /********************************************************************************/
+    void test_mphf_partitioned_aux (size_t nbParts, int nbThreads, u_int64_t maxMemory)
+    {
+        typedef u_int64_t Key;
+        typedef BooPHF<Key> Hash;
+
+        size_t nbSources = 3;
+        size_t nbKeys    = 0;
+
+        // We split some keys into several files, as the solid kmers partitions would be.
+        vector<IterableFile<Key>*> files;
+        vector<Iterable<Key>*>     sources;
+        for (size_t s=0; s<nbSources; s++)
+        {
+            stringstream ss;  ss << "./keys_part" << s;
+
+            BagFile<Key> bagFile (ss.str());
+            for (Key k=s; k<200000; k+=nbSources, nbKeys++)  {  bagFile.insert (k*2654435761ULL);  }
+            bagFile.flush();
+
+            files.push_back   (new IterableFile<Key> (ss.str()));
+            sources.push_back (files.back());
+        }
+
+        Hash hash;
+        hash.buildPartitioned (sources, nbParts, nbThreads, 2.0, maxMemory);
+
+        CPPUNIT_ASSERT (hash.size()       == nbKeys);
+        CPPUNIT_ASSERT (hash.getNbParts() == nbParts);
+        CPPUNIT_ASSERT (maxMemory > 0 ? hash.getNbRounds() > 1 : hash.getNbRounds() == 1);
+
+        // The codes must be a bijection on [0,nbKeys[
+        vector<bool> check (nbKeys);
+        for (size_t s=0; s<nbSources; s++)
+        {
+            Iterator<Key>* itKeys = files[s]->iterator();  LOCAL (itKeys);
+            for (itKeys->first(); !itKeys->isDone(); itKeys->next())
+            {
+                Hash::Code code = hash (itKeys->item());
+                CPPUNIT_ASSERT (code < nbKeys);
+                CPPUNIT_ASSERT (check[code]==false);
+                check[code]=true;
+            }
+        }
+
+        for (size_t s=0; s<nbSources; s++)
+        {
+            stringstream ss;  ss << "./keys_part" << s;
+            delete files[s];
+            System::file().remove (ss.str());
+        }
+    }
+
+    /********************************************************************************/
+    void test_mphf_partitioned (void)
+    {
+        test_mphf_partitioned_aux (1, 1, 0);
+        test_mphf_partitioned_aux (8, 2, 0);
+
+        // A very small memory forces several rounds over the sources.
+        test_mphf_partitioned_aux (16, 4, 1);
+    }
+
+    /********************************************************************************/
+    void test_mphf_batch_aux (bool partitioned)
+    {
+        typedef u_int64_t Key;
+        typedef BooPHF<Key> Hash;
+
+        vector<Key> keys;
+        BagFile<Key> bagFile ("./keys_batch");
+        for (Key k=0; k<100000; k++)  {  keys.push_back (k*2654435761ULL);  bagFile.insert (keys.back());  }
+        bagFile.flush();
+
+        IterableFile<Key>* iterable = new IterableFile<Key> ("./keys_batch");
+
+        Hash hash;
+        if (partitioned)  {  hash.buildPartitioned (vector<Iterable<Key>*> (1, iterable), 4);  }
+        else              {  hash.build (iterable);  }
+
+        vector<Hash::Code> codes (keys.size());
+
+        for (int interleaved=0; interleaved<=1; interleaved++)
+        {
+            hash.setInterleaved (interleaved==1);
+            CPPUNIT_ASSERT (hash.isInterleaved() == (interleaved==1));
+
+            // The batch lookup gives the same codes as the single key lookup, whatever the layout
+            hash.lookup (keys.data(), keys.size(), codes.data());
+
+            vector<bool> check (keys.size());
+            for (size_t i=0; i<keys.size(); i++)
+            {
+                CPPUNIT_ASSERT (codes[i] == hash (keys[i]));
+                CPPUNIT_ASSERT (codes[i] < keys.size() && check[codes[i]]==false);
+                check[codes[i]] = true;
+            }
+        }
+
+        delete iterable;
+        System::file().remove ("./keys_batch");
+    }
+
+    /********************************************************************************/
+    void test_mphf_batch (void)
+    {
+        test_mphf_batch_aux (false);
+        test_mphf_batch_aux (true);
+    }
 };
 
 /********************************************************************************/
@@ -36,6 +36,7 @@ using namespace std;
 using namespace gatb::core::tools::collections;
 using namespace gatb::core::tools::collections::impl;
 using namespace gatb::core::tools::math;
+using namespace gatb::core::tools::misc;
 
 /********************************************************************************/
 namespace gatb  {  namespace tests  {
@@ -51,6 +52,8 @@ class TestContainer : public Test
     CPPUNIT_TEST_SUITE_GATB (TestContainer);
 
         CPPUNIT_TEST_GATB (bloom_checkContains);
+        CPPUNIT_TEST_GATB (bloom_checkContainsBatch);
+        CPPUNIT_TEST_GATB (bloom_checkBlockedSimd);
 
     CPPUNIT_TEST_SUITE_GATB_END();
 
@@ -132,6 +135,87 @@ public:
         bloom_checkContains_aux<LargeInt<5> > (values2, ARRAY_SIZE(values2));
         bloom_checkContains_aux<LargeInt<5> > (values3, ARRAY_SIZE(values3));
     }
+
+    /********************************************************************************/
+    template<typename Item> void bloom_checkContainsBatch_aux (BloomKind kind, size_t kmerSize)
+    {
+        const size_t nbItems = 1000;
+
+        IBloom<Item>* bloom = BloomFactory::singleton().createBloom<Item> (kind, 10*nbItems, 7, kmerSize);
+        LOCAL (bloom);
+
+        Item un;  un.setVal(1);
+        Item kmerMask = (un << (2*kmerSize)) - un;
+
+        /** We insert canonical kmers and ask for as many other kmers (not a multiple of the batch size). */
+        Item items [2*nbItems + 3];
+        for (size_t i=0; i<ARRAY_SIZE(items); i++)
+        {
+            Item item;  item.setVal ((((u_int64_t)rand()) << 32) ^ rand());
+            item = item & kmerMask;
+            Item rev = revcomp (item, kmerSize);
+            items[i] = rev < item ? rev : item;
+
+            if (i < nbItems)  {  bloom->insert (items[i]);  }
+        }
+
+        bool result [ARRAY_SIZE(items)];
+        bloom->containsBatch (items, ARRAY_SIZE(items), result);
+
+        for (size_t i=0; i<ARRAY_SIZE(items); i++)
+        {
+            CPPUNIT_ASSERT (result[i] == bloom->contains (items[i]));
+
+            /** No false negative. */
+            if (i < nbItems)  {  CPPUNIT_ASSERT (result[i]);  }
+        }
+    }
+
+    /** */
+    void bloom_checkContainsBatch ()
+    {
+        BloomKind kinds[] = { BLOOM_BASIC, BLOOM_CACHE, BLOOM_NEIGHBOR, BLOOM_BLOCKED };
+
+        for (size_t i=0; i<ARRAY_SIZE(kinds); i++)
+        {
+            bloom_checkContainsBatch_aux<LargeInt<1> > (kinds[i], 31);
+            bloom_checkContainsBatch_aux<LargeInt<2> > (kinds[i], 61);
+        }
+    }
+
+    /********************************************************************************/
+    /** The blocked Bloom filter tests its bits with AVX2 or AVX-512 when the CPU supports them:
+     * each supported instruction set must give the same result as the scalar loop. */
+    void bloom_checkBlockedSimd ()
+    {
+        typedef BloomBlocked<LargeInt<1> > Bloom;
+
+        for (size_t nbHash=1; nbHash<=16; nbHash++)
+        {
+            /** A small filter, so that its blocks are dense and the tests give both answers. */
+            Bloom bloom (64*512, 31, nbHash);
+
+            for (size_t i=0; i<2*64*512/nbHash; i++)
+            {
+                LargeInt<1> item;  item.setVal ((((u_int64_t)rand()) << 32) ^ rand());
+                bloom.insert (item);
+            }
+
+            size_t nbFound = 0;
+            for (size_t i=0; i<100*1000; i++)
+            {
+                u_int64_t h = (((u_int64_t)rand()) << 33) ^ (((u_int64_t)rand()) << 2) ^ rand();
+
+                bool found = bloom.containsHash (h, Bloom::SIMD_NONE);
+                if (Bloom::getSimd() >= Bloom::SIMD_AVX2)    {  CPPUNIT_ASSERT (bloom.containsHash (h, Bloom::SIMD_AVX2)   == found);  }
+                if (Bloom::getSimd() >= Bloom::SIMD_AVX512)  {  CPPUNIT_ASSERT (bloom.containsHash (h, Bloom::SIMD_AVX512) == found);  }
+                CPPUNIT_ASSERT (bloom.containsHash (h) == found);
+
+                nbFound += found ? 1 : 0;
+            }
+            CPPUNIT_ASSERT (nbFound > 0 && nbFound < 100*1000);
+        }
+    }
 };
 
 /********************************************************************************/
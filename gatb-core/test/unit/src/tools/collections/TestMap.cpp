@@ -21,6 +21,7 @@
 #include <gatb/system/impl/System.hpp>
 #include <gatb/tools/designpattern/api/Iterator.hpp>
 #include <gatb/tools/collections/impl/OAHash.hpp>
+#include <gatb/tools/collections/impl/HashCounter.hpp>
 #include <gatb/tools/collections/impl/MapMPHF.hpp>
 #include <gatb/tools/math/NativeInt64.hpp>
 #include <gatb/tools/math/NativeInt128.hpp>
@@ -61,6 +62,7 @@ class TestMap : public Test
     CPPUNIT_TEST_SUITE_GATB (TestMap);
 
         CPPUNIT_TEST_GATB (checkOAHash);
+        CPPUNIT_TEST_GATB (checkHashCounter);
         CPPUNIT_TEST_GATB (checkMapMPHF);
 
     CPPUNIT_TEST_SUITE_GATB_END();
@@ -130,6 +132,69 @@ public:
         }
     }
 
+    /********************************************************************************/
+    template<typename T>
+    void checkHashCounter_aux (size_t maxMemory)
+    {
+        /** We create a hash with a maximum memory size. */
+        HashCounter <T> hash (maxMemory);
+
+        CPPUNIT_ASSERT (hash.getByteSize() <= maxMemory);
+
+        size_t nbKeys = hash.getMaxNbItems();
+
+        /** We insert each key i exactly (i%5)+1 times, in a shuffled order. */
+        vector<T> keys;
+        for (size_t i=1; i<=nbKeys; i++)
+        {
+            T idx; idx.setVal(i*7919);
+            for (size_t j=0; j<=i%5; j++)  { keys.push_back (idx); }
+        }
+        std::random_shuffle (keys.begin(), keys.end());
+
+        for (size_t i=0; i<keys.size(); i++)  {  hash.insert (keys[i]);  }
+
+        CPPUNIT_ASSERT (hash.size() == nbKeys);
+        CPPUNIT_ASSERT (hash.isFull() == true);
+
+        /** We check the counts. */
+        for (size_t i=1; i<=nbKeys; i++)
+        {
+            T idx; idx.setVal(i*7919);
+            CPPUNIT_ASSERT (hash.get (idx) == (i%5)+1);
+        }
+        T badKey;  badKey.setVal(7919*(nbKeys+1));
+        CPPUNIT_ASSERT (hash.get (badKey) == 0);
+
+        /** We check the sorted items. */
+        CPPUNIT_ASSERT (hash.sort() == nbKeys);
+        for (size_t i=0; i<nbKeys; i++)
+        {
+            T idx; idx.setVal((i+1)*7919);
+            CPPUNIT_ASSERT (hash.getKey(i)   == idx);
+            CPPUNIT_ASSERT (hash.getValue(i) == ((i+1)%5)+1);
+        }
+
+        /** The table can be reused after a clear. */
+        hash.clear();
+        CPPUNIT_ASSERT (hash.size() == 0);
+        hash.insert (badKey);
+        CPPUNIT_ASSERT (hash.get (badKey) == 1);
+    }
+
+    /********************************************************************************/
+    void checkHashCounter ()
+    {
+        size_t table[] = { 1024, 10*1024, 100*1024, 1000*1024};
+
+        for (size_t i=0; i<ARRAY_SIZE(table); i++)
+        {
+            checkHashCounter_aux<LargeInt<1> >  (table[i]);
+            checkHashCounter_aux<LargeInt<2> >  (table[i]);
+            checkHashCounter_aux<LargeInt<3> >  (table[i]);
+        }
+    }
+
     /********************************************************************************/
     static void checkMapMPHF_progress (size_t round, size_t initial, size_t remaining)
     {
@@ -29,6 +29,9 @@
 #include <gatb/tools/misc/impl/Property.hpp>
 
 #include <gatb/tools/misc/impl/StringLine.hpp>
+#include <gatb/tools/misc/impl/RadixSort.hpp>
+
+#include <gatb/tools/math/LargeInt.hpp>
 
 #include <stdlib.h>     /* srand, rand */
 #include <time.h>       /* time */
@@ -67,6 +70,8 @@ class TestMisc : public Test
 
         CPPUNIT_TEST_GATB (stringline_check1);
 
+        CPPUNIT_TEST_GATB (radixsort_check1);
+
     CPPUNIT_TEST_SUITE_GATB_END();
 
 public:
@@ -406,6 +411,48 @@ public:
         CPPUNIT_ASSERT (StringLine::format (s1).size() == StringLine::getDefaultWidth());
         CPPUNIT_ASSERT (StringLine::format (s2).size() == StringLine::getDefaultWidth());
     }
+
+    /********************************************************************************/
+    template<typename Type>
+    void radixsort_check1_aux (size_t nbItems, size_t nbBytes)
+    {
+        vector<Type>      kmers (nbItems);
+        vector<u_int16_t> ids   (nbItems);
+
+        for (size_t i=0; i<nbItems; i++)
+        {
+            Type v;  v.setVal(0);
+            for (size_t j=0; j<sizeof(Type)/4; j++)  {  Type r;  r.setVal (rand() % 1000);  v = (v << 32) | r;  }
+            kmers[i] = v;
+            ids[i]   = i;
+        }
+
+        vector<Type> orig  (kmers);
+        vector<Type> check (kmers);
+        std::sort (check.begin(), check.end());
+
+        gatb::core::tools::misc::impl::RadixSort<Type,u_int16_t>::sort (kmers.data(), ids.data(), nbItems, nbBytes);
+
+        for (size_t i=0; i<nbItems; i++)
+        {
+            /** The kmers must be sorted and the satellite ids must have followed them. */
+            CPPUNIT_ASSERT (kmers[i] == check[i]);
+            CPPUNIT_ASSERT (orig[ids[i]] == kmers[i]);
+        }
+    }
+
+    /** \brief test of the radix sort used for counting kmers by sorted vectors. */
+    void radixsort_check1 (void)
+    {
+        size_t nbItems[] = { 0, 1, 10, 1000, 50000 };
+
+        for (size_t i=0; i<ARRAY_SIZE(nbItems); i++)
+        {
+            radixsort_check1_aux < gatb::core::tools::math::LargeInt<1> > (nbItems[i],  8);
+            radixsort_check1_aux < gatb::core::tools::math::LargeInt<2> > (nbItems[i], 16);
+            radixsort_check1_aux < gatb::core::tools::math::LargeInt<4> > (nbItems[i], 32);
+        }
+    }
 };
 
 /********************************************************************************/
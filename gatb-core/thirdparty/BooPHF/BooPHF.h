@@ -9,6 +9,7 @@
 #include <iostream>
 #include <math.h>
 
+#include <algorithm>
 #include <array>
 #include <unordered_map>
 #include <vector>
@@ -441,8 +442,13 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 			 _size =  r._size;
 			 _nchar = r._nchar;
 			 _ranks = r._ranks;
-			 _bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
-			 memcpy(_bitArray, r._bitArray, _nchar*sizeof(uint64_t) );
+			 _interleaved = r._interleaved;
+			 _bitArray = nullptr;
+			 if(r._bitArray != nullptr)
+			 {
+				 _bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
+				 memcpy(_bitArray, r._bitArray, _nchar*sizeof(uint64_t) );
+			 }
 		 }
 		
 		// Copy assignment operator
@@ -453,10 +459,15 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 				_size =  r._size;
 				_nchar = r._nchar;
 				_ranks = r._ranks;
+				_interleaved = r._interleaved;
 				if(_bitArray != nullptr)
 					free(_bitArray);
-				_bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
-				memcpy(_bitArray, r._bitArray, _nchar*sizeof(uint64_t) );
+				_bitArray = nullptr;
+				if(r._bitArray != nullptr)
+				{
+					_bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
+					memcpy(_bitArray, r._bitArray, _nchar*sizeof(uint64_t) );
+				}
 			}
 			return *this;
 		}
@@ -473,6 +484,7 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 				_size =  std::move (r._size);
 				_nchar = std::move (r._nchar);
 				_ranks = std::move (r._ranks);
+				_interleaved = std::move (r._interleaved);
 				_bitArray = r._bitArray;
 				r._bitArray = nullptr;
 			}
@@ -498,7 +510,11 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 			return _size;
 		}
 
-		uint64_t bitSize() const {return (_nchar*64ULL + _ranks.capacity()*64ULL );}
+		uint64_t bitSize() const
+		{
+			if(isInterleaved()) return _interleaved.capacity()*64ULL;
+			return (_nchar*64ULL + _ranks.capacity()*64ULL );
+		}
 
 		//clear whole array
 		void clear()
@@ -553,6 +569,7 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 		//return value at pos
 		uint64_t operator[](uint64_t pos) const
 		{
+			if(isInterleaved()) return (_interleaved[interleavedWord(pos)] >> (pos & 63 ) ) & 1;
 			return (_bitArray[pos >> 6ULL] >> (pos & 63 ) ) & 1;
 		}
 
@@ -609,6 +626,19 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 
 		uint64_t rank(uint64_t pos) const
 		{
+			if(isInterleaved())
+			{
+				const uint64_t* block = &_interleaved[(pos / _nb_bits_per_rank_sample) * _nb_words_per_interleaved_block];
+				uint64_t word_in_block = (pos % _nb_bits_per_rank_sample) / 64ULL;
+				uint64_t r = block[0];
+				for (uint64_t w = 0; w < word_in_block; ++w) {
+					r += popcount_64( block[1+w] );
+				}
+				uint64_t mask = (uint64_t(1) << (pos % 64) ) - 1;
+				r += popcount_64( block[1+word_in_block] & mask);
+				return r;
+			}
+
 			uint64_t word_idx = pos / 64ULL;
 			uint64_t word_offset = pos % 64;
 			uint64_t block = pos / _nb_bits_per_rank_sample;
@@ -623,8 +653,79 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 		}
 
 
+		//prefetch the memory read by get(pos) and rank(pos)
+		void prefetch(uint64_t pos) const
+		{
+			if(isInterleaved())
+			{
+				const uint64_t* block = &_interleaved[(pos / _nb_bits_per_rank_sample) * _nb_words_per_interleaved_block];
+				__builtin_prefetch(block);
+				__builtin_prefetch(block + _nb_words_per_interleaved_block - 1);
+				return;
+			}
+			__builtin_prefetch(_bitArray + (pos >> 6ULL));
+		}
+
+		//prefetch the memory read by rank(pos) only (the bits are supposed to be prefetched already)
+		void prefetchRank(uint64_t pos) const
+		{
+			if(isInterleaved()) return; // the rank is in the block of the bits
+			__builtin_prefetch(&_ranks[pos / _nb_bits_per_rank_sample]);
+			__builtin_prefetch(_bitArray + (pos / _nb_bits_per_rank_sample) * (_nb_bits_per_rank_sample / 64));
+		}
+
+		//interleaved layout: each block of 512 bits is stored right after its rank, so that a rank query
+		//reads one contiguous piece of memory. The ranks must have been built.
+		void interleave()
+		{
+			if(isInterleaved() || _bitArray == nullptr) return;
+
+			uint64_t words = _nb_bits_per_rank_sample / 64;
+			uint64_t nbBlocks = _ranks.size();
+			_interleaved.assign(nbBlocks * _nb_words_per_interleaved_block, 0);
+			for (uint64_t b = 0; b < nbBlocks; b++)
+			{
+				_interleaved[b * _nb_words_per_interleaved_block] = _ranks[b];
+				for (uint64_t w = 0; w < words && b*words+w < _nchar; w++)
+					_interleaved[b * _nb_words_per_interleaved_block + 1 + w] = _bitArray[b*words+w];
+			}
+
+			free(_bitArray);
+			_bitArray = nullptr;
+			std::vector<uint64_t>().swap(_ranks);
+		}
+
+		//back to the separate bits and ranks arrays
+		void deinterleave()
+		{
+			if(!isInterleaved()) return;
+
+			uint64_t words = _nb_bits_per_rank_sample / 64;
+			uint64_t nbBlocks = _interleaved.size() / _nb_words_per_interleaved_block;
+			_bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
+			_ranks.resize(nbBlocks);
+			for (uint64_t b = 0; b < nbBlocks; b++)
+			{
+				_ranks[b] = _interleaved[b * _nb_words_per_interleaved_block];
+				for (uint64_t w = 0; w < words && b*words+w < _nchar; w++)
+					_bitArray[b*words+w] = _interleaved[b * _nb_words_per_interleaved_block + 1 + w];
+			}
+			std::vector<uint64_t>().swap(_interleaved);
+		}
+
+		bool isInterleaved() const { return !_interleaved.empty(); }
+
 		void save(std::ostream& os) const
 		{
+			//the saved format is always the separate one
+			if(isInterleaved())
+			{
+				bitVector tmp(*this);
+				tmp.deinterleave();
+				tmp.save(os);
+				return;
+			}
+
 			os.write(reinterpret_cast<char const*>(&_size), sizeof(_size));
 			os.write(reinterpret_cast<char const*>(&_nchar), sizeof(_nchar));
 			os.write(reinterpret_cast<char const*>(_bitArray), (std::streamsize)(sizeof(uint64_t) * _nchar));
@@ -635,6 +736,7 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 
 		void load(std::istream& is)
 		{
+			std::vector<uint64_t>().swap(_interleaved);
 			is.read(reinterpret_cast<char*>(&_size), sizeof(_size));
 			is.read(reinterpret_cast<char*>(&_nchar), sizeof(_nchar));
 			this->resize(_size);
@@ -657,6 +759,15 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 		// additional size for rank is epsilon * _size
 		static const uint64_t _nb_bits_per_rank_sample = 512; //512 seems ok
 		std::vector<uint64_t> _ranks;
+
+		// interleaved layout (empty if not used): for each block, the rank then the 8 words of bits
+		static const uint64_t _nb_words_per_interleaved_block = 1 + _nb_bits_per_rank_sample / 64;
+		std::vector<uint64_t> _interleaved;
+
+		uint64_t interleavedWord(uint64_t pos) const
+		{
+			return (pos / _nb_bits_per_rank_sample) * _nb_words_per_interleaved_block + 1 + (pos % _nb_bits_per_rank_sample) / 64;
+		}
 	};
 
 ////////////////////////////////////////////////////////////////
@@ -820,6 +931,89 @@ we need this 2-functors scheme because HashFunctors won't work with unordered_ma
 			return minimal_hp;
 		}
 
+		//batch lookup: the levels are walked for a group of keys at once, and the bits (then the
+		//ranks) needed by a key are prefetched while the other keys of the group are hashed
+		void lookup(const elem_t* elems, size_t n, uint64_t* res)
+		{
+			if(! _built)
+			{
+				for(size_t i=0; i<n; i++) res[i] = ULLONG_MAX;
+				return;
+			}
+
+			static const size_t batchSize = 32;
+			hash_pair_t bbhash[batchSize];
+			uint64_t pos[batchSize]; // position of the key in the bit array of its level
+			int level[batchSize];
+			size_t todo[batchSize];
+
+			for(size_t start=0; start<n; start+=batchSize)
+			{
+				size_t nb = std::min(batchSize, n-start);
+				const elem_t* batch = elems + start;
+
+				size_t nbTodo = nb;
+				for(size_t j=0; j<nb; j++) { todo[j] = j; level[j] = 0; }
+
+				for(int ii=0; ii<(_nb_levels-1) && nbTodo>0; ii++)
+				{
+					for(size_t t=0; t<nbTodo; t++)
+					{
+						size_t j = todo[t];
+						uint64_t hash_raw;
+						if(ii == 0)       hash_raw = _hasher.h0(bbhash[j],batch[j]);
+						else if(ii == 1)  hash_raw = _hasher.h1(bbhash[j],batch[j]);
+						else              hash_raw = _hasher.next(bbhash[j]);
+						pos[j] = hash_raw % _levels[ii].hash_domain;
+						_levels[ii].bitset.prefetch(pos[j]);
+					}
+
+					size_t nbNext = 0;
+					for(size_t t=0; t<nbTodo; t++)
+					{
+						size_t j = todo[t];
+						if(_levels[ii].bitset.get(pos[j]))  { level[j] = ii; }
+						else                              { level[j] = ii+1;  todo[nbNext++] = j; }
+					}
+					nbTodo = nbNext;
+				}
+
+				for(size_t j=0; j<nb; j++)
+				{
+					if(level[j] < _nb_levels-1)
+						_levels[level[j]].bitset.prefetchRank(pos[j]);
+				}
+
+				for(size_t j=0; j<nb; j++)
+				{
+					if(level[j] == (_nb_levels-1))
+					{
+						auto in_final_map  = _final_hash.find (batch[j]);
+						res[start+j] = in_final_map == _final_hash.end() ? ULLONG_MAX : in_final_map->second + _lastbitsetrank;
+					}
+					else
+					{
+						res[start+j] = _levels[level[j]].bitset.rank(pos[j]);
+					}
+				}
+			}
+		}
+
+		//switch the bit arrays of the levels to (or from) the interleaved bits and ranks layout
+		void setInterleaved(bool interleaved)
+		{
+			for(int ii=0; ii<(int)_levels.size(); ii++)
+			{
+				if(interleaved)  _levels[ii].bitset.interleave();
+				else             _levels[ii].bitset.deinterleave();
+			}
+		}
+
+		bool isInterleaved() const
+		{
+			return !_levels.empty() && _levels[0].bitset.isInterleaved();
+		}
+
 		uint64_t nbKeys() const
 		{
             return _nelem;